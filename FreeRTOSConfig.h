@@ -65,6 +65,7 @@ increase the amount of time spent in standby mode, thus reducing average power c
 #define configUSE_CO_ROUTINES 0
 #define configUSE_16_BIT_TICKS 0
 #define configUSE_MUTEXES 1
+#define configUSE_QUEUE_SETS 1
 
 /* Enable static allocation (no malloc for FreeRTOS objects) */
 #define configSUPPORT_STATIC_ALLOCATION 1
@@ -92,6 +93,7 @@ to exclude the API function. */
 #define INCLUDE_vTaskDelayUntil 1
 #define INCLUDE_uxTaskPriorityGet 0
 #define INCLUDE_vTaskDelay 1
+#define INCLUDE_xTaskGetSchedulerState 1
 
 /* # of priority bits (configured in hardware) is provided by CMSIS */
 #define configPRIO_BITS __NVIC_PRIO_BITS
@@ -11,6 +11,10 @@
 #include "max7325.h"
 #include <stdio.h>
 
+#if BENCH_ENABLE
+#include "bench.h"
+#endif
+
 /**************************************************************************************************
   Macros
 **************************************************************************************************/
@@ -21,6 +25,11 @@
 /* Set to 1 to enable serial keyboard test input (conflicts with BLE terminal) */
 #define ENABLE_SERIAL_TEST      0
 
+/* Set by project.mk (make BENCH=1): run the microbenchmarks before the tasks start */
+#ifndef BENCH_ENABLE
+#define BENCH_ENABLE            0
+#endif
+
 /**************************************************************************************************
   Public Functions
 **************************************************************************************************/
@@ -33,6 +42,10 @@ bool App_Init(void)
     printf("   MAX32655 WORKOUT TRACKER\n");
     printf("========================================\n");
     printf("\n");
+
+#if BENCH_ENABLE
+    Bench_RunAll(BENCH_DEFAULT_ITERATIONS, BENCH_OUT_JSON);
+#endif
     
     /* Initialize all tasks (workout control, etc.) */
     if (!Tasks_Init(ENABLE_SERIAL_TEST))
@@ -52,10 +65,10 @@ bool App_Init(void)
     }
     else
     {
-        /* Start button polling task */
-        if (!Max7325_StartPollingTask())
+        /* Start button input task (woken by the MAX7325 INT line) */
+        if (!Max7325_StartInputTask())
         {
-            printf("[APP] WARNING: Button polling task failed to start\n");
+            printf("[APP] WARNING: Button input task failed to start\n");
         }
     }
 #endif
@@ -168,7 +168,7 @@ int main(void)
         }
     }
 
-    /* Start the BLE application */
+    /* Start the BLE application (trims the 32 kHz crystal, then calibrates the capture timer) */
     bleStartup();
 
     /* Start scheduler */
@@ -0,0 +1,498 @@
+/*************************************************************************************************/
+/*!
+ *  \file   bench.c
+ *
+ *  \brief  Microbenchmarks for the serializer, offline buffer, time, workout and HR code.
+ *
+ *  Each case times a whole run of calls with one clock read at each end, so the clock
+ *  itself adds nothing per call. Work a case needs between calls that is not part of what
+ *  it measures (resetting a finished workout) is bracketed by benchPause()/benchResume().
+ */
+/*************************************************************************************************/
+
+#include "bench.h"
+#include "protocol.h"
+#include "buffer.h"
+#include "workout_state.h"
+#include "hr_dsp.h"
+#include "time_utils.h"
+#include "log.h"
+#include "mxc_device.h"
+#include <stdio.h>
+#include <string.h>
+
+#if !defined(DWT_CTRL_CYCCNTENA_Msk)
+#include <time.h>
+#endif
+
+/**************************************************************************************************
+  Macros
+**************************************************************************************************/
+
+#define BENCH_OUT_BUF_LEN   128     /* Serializer / formatter output buffer */
+#define BENCH_TIME_BUF_LEN  16      /* Fits both formatters for any value */
+#define BENCH_TIME_WRAP_MS  3600000 /* Keep minutes at two digits so bytes/call is stable */
+#define BENCH_HMS_STEP_MS   3650123 /* Walks every field of HH:MM:SS.mmm */
+#define BENCH_HMS_WRAP_MS   360000000 /* Keep hours at two digits */
+#define BENCH_LAP_US        95123456ULL /* Press-to-press time fed to Workout_RecordLap() */
+
+/* PPG fed to the HR pipeline: 80 BPM, one FIFO block (SENSOR_FIFO_BLOCK_SAMPLES) per call */
+#define BENCH_PPG_BLOCK     17
+#define BENCH_PPG_SAMPLES   (BENCH_PPG_BLOCK * 20)
+#define BENCH_PPG_BEAT      75          /* Samples per beat */
+#define BENCH_PPG_BASELINE  120000
+#define BENCH_PPG_PULSE     1500        /* Systolic dip, counts */
+
+/* Prints a value stored as tenths */
+#define BENCH_X10_FMT       "%lu.%lu"
+#define BENCH_X10_ARG(v)    (unsigned long)((v) / 10), (unsigned long)((v) % 10)
+
+/**************************************************************************************************
+  Data Types
+**************************************************************************************************/
+
+#if defined(DWT_CTRL_CYCCNTENA_Msk)
+#define BENCH_UNIT "cycles"
+typedef uint32_t BenchTicks_t;  /* Wraps after 2^32 cycles, far longer than a run */
+#else
+#define BENCH_UNIT "ns"
+typedef uint64_t BenchTicks_t;
+#endif
+
+/*! One case: setup is not timed, run makes the calls and returns the bytes produced */
+typedef struct
+{
+    const char *pName;
+    void (*pfSetup)(void);
+    uint32_t (*pfRun)(uint32_t iterations);
+} BenchCase_t;
+
+/**************************************************************************************************
+  Local Variables
+**************************************************************************************************/
+
+/* Lap event as sent mid-workout: multi-byte varints and a typical JSON length */
+static const WorkoutEvent_t s_lapEvent = {
+    .type = EVENT_LAP_COMPLETE,
+    .timestamp_ms = 1234567,
+    .current_lap = 3,
+    .lap_data = {.lap_number = 3, .lap_time_ms = 95123, .split_time_ms = 287456},
+};
+
+static PpgSample_t s_ppg[BENCH_PPG_SAMPLES];
+
+static BenchTicks_t s_pausedAt;
+static BenchTicks_t s_excluded;
+
+/* Results are written here so the calls cannot be optimized away */
+static volatile uint32_t s_sink;
+
+/**************************************************************************************************
+  Local Functions
+**************************************************************************************************/
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Read the benchmark clock.
+ */
+/*************************************************************************************************/
+static inline BenchTicks_t benchNow(void)
+{
+#if defined(DWT_CTRL_CYCCNTENA_Msk)
+    return DWT->CYCCNT;
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Start the benchmark clock (the DWT cycle counter is off after reset).
+ */
+/*************************************************************************************************/
+static void benchClockInit(void)
+{
+#if defined(DWT_CTRL_CYCCNTENA_Msk)
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Benchmark clock rate for the report (0 when the unit is already time).
+ */
+/*************************************************************************************************/
+static uint32_t benchClockHz(void)
+{
+#if defined(DWT_CTRL_CYCCNTENA_Msk)
+    return SystemCoreClock;
+#else
+    return 0;
+#endif
+}
+
+/*************************************************************************************************/
+static void benchPause(void)
+{
+    s_pausedAt = benchNow();
+}
+
+/*************************************************************************************************/
+static void benchResume(void)
+{
+    s_excluded += benchNow() - s_pausedAt;
+}
+
+/*************************************************************************************************/
+static uint32_t runProtocolJson(uint32_t iterations)
+{
+    char out[BENCH_OUT_BUF_LEN];
+    uint32_t bytes = 0;
+
+    while (iterations-- > 0)
+    {
+        bytes += Protocol_SerializeEvent(&s_lapEvent, out, sizeof(out));
+    }
+    s_sink = (uint8_t)out[0];
+
+    return bytes;
+}
+
+/*************************************************************************************************/
+static uint32_t runProtocolBinary(uint32_t iterations)
+{
+    uint8_t out[BENCH_OUT_BUF_LEN];
+    uint32_t bytes = 0;
+
+    while (iterations-- > 0)
+    {
+        bytes += Protocol_SerializeEventBinary(&s_lapEvent, out, sizeof(out));
+    }
+    s_sink = out[0];
+
+    return bytes;
+}
+
+/*************************************************************************************************/
+static void setupBuffer(void)
+{
+    Buffer_Init();
+    Buffer_Clear();
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  One event in and out per call: the store-and-forward path while disconnected.
+ */
+/*************************************************************************************************/
+static uint32_t runBufferPushPop(uint32_t iterations)
+{
+    WorkoutEvent_t out = {0};
+    uint32_t bytes = 0;
+
+    while (iterations-- > 0)
+    {
+        if (Buffer_Push(&s_lapEvent) && Buffer_Pop(&out))
+        {
+            bytes += sizeof(out);
+        }
+    }
+    s_sink = out.timestamp_ms;
+
+    return bytes;
+}
+
+/*************************************************************************************************/
+static uint32_t runTimeFormat(uint32_t iterations)
+{
+    char out[BENCH_TIME_BUF_LEN];
+    uint32_t bytes = 0;
+    uint32_t ms = 287456;
+
+    while (iterations-- > 0)
+    {
+        bytes += strlen(Time_FormatMmSsMsss(ms, out, sizeof(out)));
+        ms = (ms + 1013) % BENCH_TIME_WRAP_MS;
+    }
+    s_sink = (uint8_t)out[0];
+
+    return bytes;
+}
+
+/*************************************************************************************************/
+static uint32_t runTimeFormatHms(uint32_t iterations)
+{
+    char out[BENCH_TIME_BUF_LEN];
+    uint32_t bytes = 0;
+    uint32_t ms = 287456;
+
+    while (iterations-- > 0)
+    {
+        bytes += strlen(Time_FormatHhMmSsMsss(ms, out, sizeof(out)));
+        ms = (ms + BENCH_HMS_STEP_MS) % BENCH_HMS_WRAP_MS;
+    }
+    s_sink = (uint8_t)out[0];
+
+    return bytes;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Reference: the snprintf() MM:SS.mmm formatter Time_FormatMmSsMsss() replaced, on
+ *          the same inputs as time_format_mmss, to keep the gap between them visible.
+ */
+/*************************************************************************************************/
+static uint32_t runTimeFormatSnprintf(uint32_t iterations)
+{
+    char out[BENCH_TIME_BUF_LEN];
+    uint32_t bytes = 0;
+    uint32_t ms = 287456;
+
+    while (iterations-- > 0)
+    {
+        bytes += (uint32_t)snprintf(out, sizeof(out), "%02lu:%02lu.%03lu",
+                                    (unsigned long)(ms / 60000), (unsigned long)(ms / 1000 % 60),
+                                    (unsigned long)(ms % 1000));
+        ms = (ms + 1013) % BENCH_TIME_WRAP_MS;
+    }
+    s_sink = (uint8_t)out[0];
+
+    return bytes;
+}
+
+/*************************************************************************************************/
+static void setupWorkout(void)
+{
+    Workout_Init();
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Record laps back to back; restarting a completed workout is not timed.
+ */
+/*************************************************************************************************/
+static uint32_t runWorkoutRecordLap(uint32_t iterations)
+{
+    LapRecord_t lap = {0};
+    uint32_t bytes = 0;
+    uint64_t pressUs = 0;
+
+    while (iterations-- > 0)
+    {
+        if (Workout_GetState() != STATE_RUNNING)
+        {
+            benchPause();
+            Workout_Reset();
+            Workout_Start(pressUs);
+            benchResume();
+        }
+
+        pressUs += BENCH_LAP_US;
+        if (Workout_RecordLap(pressUs, &lap))
+        {
+            bytes += sizeof(lap);
+        }
+    }
+    s_sink = lap.lap_time_ms;
+
+    return bytes;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Fill s_ppg with a triangular pulse plus noise and start the pipeline.
+ */
+/*************************************************************************************************/
+static void setupHrDsp(void)
+{
+    uint32_t noise = 1;
+    uint32_t phase;
+    uint32_t dip;
+    uint16_t i;
+
+    for (i = 0; i < BENCH_PPG_SAMPLES; i++)
+    {
+        phase = i % BENCH_PPG_BEAT;
+        dip = (phase < 10) ? phase * (BENCH_PPG_PULSE / 10)
+              : (phase < 40) ? (40 - phase) * (BENCH_PPG_PULSE / 30) : 0;
+        noise = noise * 1664525u + 1013904223u;
+
+        s_ppg[i].ir = BENCH_PPG_BASELINE - dip + (noise >> 25);
+        s_ppg[i].red = s_ppg[i].ir - s_ppg[i].ir / 5;
+    }
+
+    HrDsp_Init();
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Process one FIFO block per call, as the sensor task does.
+ */
+/*************************************************************************************************/
+static uint32_t runHrDspBlock(uint32_t iterations)
+{
+    HrDspResult_t result = {0};
+    uint32_t bytes = 0;
+    uint16_t pos = 0;
+
+    while (iterations-- > 0)
+    {
+        HrDsp_Process(&s_ppg[pos], BENCH_PPG_BLOCK);
+        HrDsp_GetResult(&result);
+        bytes += sizeof(result);
+
+        pos += BENCH_PPG_BLOCK;
+        if (pos >= BENCH_PPG_SAMPLES)
+        {
+            pos = 0;
+        }
+    }
+    s_sink = result.bpm;
+
+    return bytes;
+}
+
+/*************************************************************************************************/
+/*! Case names are the regression-tracking keys: rename only with the baseline. */
+static const BenchCase_t s_cases[] = {
+    {"protocol_serialize_json", NULL, runProtocolJson},
+    {"protocol_serialize_binary", NULL, runProtocolBinary},
+    {"buffer_push_pop", setupBuffer, runBufferPushPop},
+    {"time_format_mmss", NULL, runTimeFormat},
+    {"time_format_hms", NULL, runTimeFormatHms},
+    {"time_format_mmss_snprintf", NULL, runTimeFormatSnprintf},
+    {"workout_record_lap", setupWorkout, runWorkoutRecordLap},
+    {"hr_dsp_block", setupHrDsp, runHrDspBlock},
+};
+
+#define BENCH_CASE_COUNT (sizeof(s_cases) / sizeof(s_cases[0]))
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Per-call value in tenths.
+ */
+/*************************************************************************************************/
+static uint32_t perCallX10(uint64_t total, uint32_t calls)
+{
+    return (calls > 0) ? (uint32_t)((total * 10) / calls) : 0;
+}
+
+/**************************************************************************************************
+  Public Functions
+**************************************************************************************************/
+
+/*************************************************************************************************/
+uint8_t Bench_GetCount(void)
+{
+    return BENCH_CASE_COUNT;
+}
+
+/*************************************************************************************************/
+bool Bench_Run(uint8_t index, uint32_t iterations, BenchResult_t *pResult)
+{
+    const BenchCase_t *pCase;
+    BenchTicks_t start;
+    BenchTicks_t elapsed;
+    BenchTicks_t best = 0;
+    uint64_t total = 0;
+    uint32_t bytes = 0;
+    uint8_t workoutLevel;
+    uint8_t run;
+
+    if (index >= BENCH_CASE_COUNT || pResult == NULL)
+    {
+        return false;
+    }
+
+    pCase = &s_cases[index];
+    iterations = (iterations > 0) ? iterations : BENCH_DEFAULT_ITERATIONS;
+
+    /* Measure the state machine, not the console */
+    workoutLevel = g_logLevel[LOG_MOD_WORKOUT];
+    Log_SetLevel(LOG_MOD_WORKOUT, LOG_LEVEL_NONE);
+
+    benchClockInit();
+
+    if (pCase->pfSetup != NULL)
+    {
+        pCase->pfSetup();
+    }
+
+    /* Run 0 warms caches (and, on the host, faults in pages) and is not counted */
+    for (run = 0; run <= BENCH_RUNS; run++)
+    {
+        s_excluded = 0;
+
+        start = benchNow();
+        bytes = pCase->pfRun(iterations);
+        elapsed = benchNow() - start - s_excluded;
+
+        if (run == 0)
+        {
+            continue;
+        }
+
+        total += elapsed;
+        if (run == 1 || elapsed < best)
+        {
+            best = elapsed;
+        }
+    }
+
+    Log_SetLevel(LOG_MOD_WORKOUT, workoutLevel);
+
+    pResult->pName = pCase->pName;
+    pResult->iterations = iterations;
+    pResult->minX10 = perCallX10(best, iterations);
+    pResult->meanX10 = perCallX10(total / BENCH_RUNS, iterations);
+    pResult->bytesX10 = perCallX10(bytes, iterations);
+
+    return true;
+}
+
+/*************************************************************************************************/
+void Bench_RunAll(uint32_t iterations, BenchOutput_t output)
+{
+    BenchResult_t results[BENCH_CASE_COUNT];
+    uint8_t count = 0;
+    uint8_t i;
+
+    for (i = 0; i < BENCH_CASE_COUNT; i++)
+    {
+        if (Bench_Run(i, iterations, &results[count]))
+        {
+            count++;
+        }
+    }
+
+    if (output == BENCH_OUT_JSON)
+    {
+        printf("{\"bench\":\"max_firmware\",\"unit\":\"%s\",\"clock_hz\":%lu,\"runs\":%d,"
+               "\"results\":[",
+               BENCH_UNIT, (unsigned long)benchClockHz(), BENCH_RUNS);
+        for (i = 0; i < count; i++)
+        {
+            printf("%s{\"name\":\"%s\",\"iterations\":%lu,\"min\":" BENCH_X10_FMT
+                   ",\"mean\":" BENCH_X10_FMT ",\"bytes\":" BENCH_X10_FMT "}",
+                   (i > 0) ? "," : "", results[i].pName, (unsigned long)results[i].iterations,
+                   BENCH_X10_ARG(results[i].minX10), BENCH_X10_ARG(results[i].meanX10),
+                   BENCH_X10_ARG(results[i].bytesX10));
+        }
+        printf("]}\n");
+        return;
+    }
+
+    printf("[BENCH] %-28s %10s %10s %8s  (%s per call)\n", "case", "min", "mean", "bytes",
+           BENCH_UNIT);
+    for (i = 0; i < count; i++)
+    {
+        printf("[BENCH] %-28s %8lu.%lu %8lu.%lu %6lu.%lu\n", results[i].pName,
+               BENCH_X10_ARG(results[i].minX10), BENCH_X10_ARG(results[i].meanX10),
+               BENCH_X10_ARG(results[i].bytesX10));
+    }
+}
@@ -0,0 +1,98 @@
+/*************************************************************************************************/
+/*!
+ *  \file   bench.h
+ *
+ *  \brief  Microbenchmarks for the serializer, offline buffer, time, workout and HR code.
+ *
+ *  Each case calls one function in a tight loop and reports the cost per call and the
+ *  bytes it produced. On the MAX32655 the cost is in CPU cycles from the DWT cycle
+ *  counter; on the host build it is in nanoseconds from CLOCK_MONOTONIC. Every case is
+ *  run once to warm up and then BENCH_RUNS times; the fastest run is the number to
+ *  track, as it is the least disturbed by interrupts and, on the host, by the OS.
+ *
+ *  The JSON report is a single line starting with {"bench": so it can be picked out of a
+ *  console capture; tools/bench_compare.py compares two reports.
+ *
+ *  Run before the scheduler starts. The buffer case clears the offline event log.
+ */
+/*************************************************************************************************/
+
+#ifndef BENCH_BENCH_H
+#define BENCH_BENCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**************************************************************************************************
+  Constants
+**************************************************************************************************/
+
+#define BENCH_DEFAULT_ITERATIONS    1000    /* Calls per run */
+#define BENCH_RUNS                  5       /* Timed runs per case, after one warm-up run */
+
+/**************************************************************************************************
+  Data Types
+**************************************************************************************************/
+
+/*! Report format */
+typedef enum
+{
+    BENCH_OUT_TEXT, /* One aligned line per case */
+    BENCH_OUT_JSON  /* One JSON object on a single line */
+} BenchOutput_t;
+
+/*! Result of one case. Costs are in BENCH units (cycles or ns) times 10. */
+typedef struct
+{
+    const char *pName;      /* Case name, stable across releases */
+    uint32_t iterations;    /* Calls per run */
+    uint32_t minX10;        /* Cost per call in the fastest run */
+    uint32_t meanX10;       /* Cost per call over all runs */
+    uint32_t bytesX10;      /* Output bytes per call */
+} BenchResult_t;
+
+/**************************************************************************************************
+  Function Declarations
+**************************************************************************************************/
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Get the number of benchmark cases.
+ *
+ *  \return Case count.
+ */
+/*************************************************************************************************/
+uint8_t Bench_GetCount(void);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Run one benchmark case.
+ *
+ *  \param  index       Case index (0 to Bench_GetCount() - 1).
+ *  \param  iterations  Calls per run (0 selects BENCH_DEFAULT_ITERATIONS).
+ *  \param  pResult     Receives the result.
+ *
+ *  \return true if the case exists and ran.
+ */
+/*************************************************************************************************/
+bool Bench_Run(uint8_t index, uint32_t iterations, BenchResult_t *pResult);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Run every case and print the report.
+ *
+ *  \param  iterations  Calls per run (0 selects BENCH_DEFAULT_ITERATIONS).
+ *  \param  output      Report format.
+ */
+/*************************************************************************************************/
+void Bench_RunAll(uint32_t iterations, BenchOutput_t output);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BENCH_BENCH_H */
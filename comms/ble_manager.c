@@ -23,7 +23,11 @@
 #include "ble_manager.h"
 #include "ble_uuid.h"
 #include "svc_custom.h"
-#include "control_task.h"
+#include "protocol.h"
+#include "ble_tx.h"
+#include "cmd_parser.h"
+#include "workout_control.h"
+#include "time_utils.h"
 
 /* ---------- BLE Configuration ---------- */
 
@@ -33,6 +37,13 @@
 #define TRIM_TIMER_EVT        0x99
 #define TRIM_TIMER_PERIOD_MS 60000
 
+/* Notifications the stack accepts before it reports ATT_ERR_OVERFLOW */
+#ifdef ATT_NUM_SIMUL_NTF
+#define DATS_TX_CREDITS       ATT_NUM_SIMUL_NTF
+#else
+#define DATS_TX_CREDITS       1
+#endif
+
 enum
 {
     DATS_GATT_SC_CCC_IDX,
@@ -136,6 +147,7 @@ static struct
     wsfHandlerId_t handlerId;
     dmConnId_t     connId;
     bool_t         connected;
+    uint8_t        txCredits;   /* Free notification slots */
 } bleCb;
 
 static wsfTimer_t trimTimer;
@@ -149,6 +161,34 @@ bool_t BLE_IsConnected(void)
     return bleCb.connected;
 }
 
+bool_t BLE_IsNotifyEnabled(void)
+{
+    if (!bleCb.connected || bleCb.connId == DM_CONN_ID_NONE)
+    {
+        return FALSE;
+    }
+
+    return AttsCccEnabled(bleCb.connId, DATS_CUSTOM_TX_CCC_IDX) ? TRUE : FALSE;
+}
+
+uint8_t BLE_GetConnId(void)
+{
+    return bleCb.connId;
+}
+
+uint16_t BLE_GetMaxPayload(void)
+{
+    uint16_t mtu;
+
+    if (!bleCb.connected || bleCb.connId == DM_CONN_ID_NONE)
+    {
+        return ATT_DEFAULT_PAYLOAD_LEN;
+    }
+
+    mtu = AttGetMtu(bleCb.connId) - ATT_VALUE_NTF_LEN;
+    return (mtu > CUSTOM_MAX_DATA_LEN) ? CUSTOM_MAX_DATA_LEN : mtu;
+}
+
 bool_t DataSend(const uint8_t *pData, uint16_t len)
 {
     if (!bleCb.connected || bleCb.connId == DM_CONN_ID_NONE)
@@ -166,11 +206,26 @@ bool_t DataSend(const uint8_t *pData, uint16_t len)
     if (len > CUSTOM_MAX_DATA_LEN)
         len = CUSTOM_MAX_DATA_LEN;
 
+    /* Only hand the stack what it can queue - credit returns on ATTS_HANDLE_VALUE_CNF */
+    WsfCsEnter();
+    if (bleCb.txCredits == 0)
+    {
+        WsfCsExit();
+        return FALSE;
+    }
+    bleCb.txCredits--;
+    WsfCsExit();
+
     AttsHandleValueNtf(bleCb.connId, CUSTOM_TX_HDL, len, (uint8_t *)pData);
     APP_TRACE_INFO1("DataSend: %d bytes", len);
     return TRUE;
 }
 
+uint8_t BLE_GetTxCredits(void)
+{
+    return bleCb.txCredits;
+}
+
 bool_t DataSendString(const char *pStr)
 {
     return DataSend((const uint8_t *)pStr, strlen(pStr));
@@ -178,6 +233,36 @@ bool_t DataSendString(const char *pStr)
 
 /* ---------- RX Callback (ESP32 -> MAX) ---------- */
 
+static void rxCmdHandler(const Cmd_t *pCmd, void *pCtx)
+{
+    (void)pCtx;
+
+    switch (pCmd->id)
+    {
+    case CMD_FMT_BIN:
+        Protocol_SetFormat(PROTOCOL_FMT_BINARY);
+        break;
+
+    case CMD_FMT_JSON:
+        Protocol_SetFormat(PROTOCOL_FMT_JSON);
+        break;
+
+    case CMD_TIME_SYNC:
+        /* Answered here, so the receive time is not skewed by queueing */
+        BleTx_SendTimeSync(pCmd->arg, Time_GetMs64());
+        break;
+
+    case CMD_SYNC_SINCE:
+        BleTx_RequestResend(pCmd->arg);
+        break;
+
+    default:
+        /* Everything else is workout control - leave it to the control task */
+        WorkoutControl_SendCommand(pCmd);
+        break;
+    }
+}
+
 static uint8_t customWriteCback(dmConnId_t connId,
                                 uint16_t handle,
                                 uint8_t  operation,
@@ -186,24 +271,13 @@ static uint8_t customWriteCback(dmConnId_t connId,
                                 uint8_t *pValue,
                                 attsAttr_t *pAttr)
 {
-    if (handle == CUSTOM_RX_HDL)
+    uint8_t count;
+
+    if (handle == CUSTOM_RX_HDL && len > 0 && len <= CUSTOM_MAX_DATA_LEN)
     {
-        /* Data received from ESP32 - process commands here */
-        if (len > 0 && len < CUSTOM_MAX_DATA_LEN)
-        {
-            char tempBuf[CUSTOM_MAX_DATA_LEN + 1];
-            memcpy(tempBuf, pValue, len);
-            tempBuf[len] = '\0';
-
-            /* Parse commands from ESP32 if needed */
-            APP_TRACE_INFO1("ESP32: %s", tempBuf);
-
-            /* Notify control task when ESP signals HR completion */
-            if (strstr(tempBuf, "\"cmd\":\"hr_done\"") != NULL)
-            {
-                ControlTask_SendBleEvent(BLE_CTRL_EVT_HR_DONE);
-            }
-        }
+        /* Parsed in place - nothing is copied out of the stack's buffer */
+        count = CmdParser_Parse(pValue, len, rxCmdHandler, NULL);
+        APP_TRACE_INFO2("ESP32: %d bytes, %d command(s)", len, count);
     }
 
     return ATT_SUCCESS;
@@ -252,7 +326,39 @@ static void cccCback(attsCccEvt_t *pEvt)
             "ESP32 notifications enabled - ready to send" :
             "ESP32 notifications disabled"
         );
+
+        if (pEvt->value == ATT_CLIENT_CFG_NOTIFY)
+        {
+            BleTx_OnLinkChange(TRUE); /* Backlog can go out now */
+        }
+    }
+}
+
+/* ---------- TX Flow Control ---------- */
+
+static void txCreditReturn(uint8_t status)
+{
+    WsfCsEnter();
+    if (bleCb.txCredits < DATS_TX_CREDITS)
+    {
+        bleCb.txCredits++;
     }
+    WsfCsExit();
+
+    BleTx_OnTxComplete(status == ATT_SUCCESS);
+}
+
+static uint8_t txCreditReset(void)
+{
+    uint8_t outstanding;
+
+    /* Outstanding notifications die with the link */
+    WsfCsEnter();
+    outstanding = DATS_TX_CREDITS - bleCb.txCredits;
+    bleCb.txCredits = DATS_TX_CREDITS;
+    WsfCsExit();
+
+    return outstanding;
 }
 
 /* ---------- Trim (optional) ---------- */
@@ -304,7 +410,9 @@ static void processMsg(dmEvt_t *pMsg)
     case DM_CONN_OPEN_IND:
         bleCb.connected = TRUE;
         bleCb.connId = (dmConnId_t)pMsg->hdr.param;
-        ControlTask_SendBleEvent(BLE_CTRL_EVT_CONNECTED);
+        txCreditReset();
+        Protocol_SetFormat(PROTOCOL_FMT_JSON); /* Each connection starts in JSON until it opts in */
+        BleTx_OnLinkChange(TRUE);
         APP_TRACE_INFO0("=== ESP32 Connected! ===");
         APP_TRACE_INFO1("Connection ID: %d", bleCb.connId);
         break;
@@ -312,8 +420,12 @@ static void processMsg(dmEvt_t *pMsg)
     case DM_CONN_CLOSE_IND:
         bleCb.connected = FALSE;
         bleCb.connId = DM_CONN_ID_NONE;
+        if (txCreditReset() > 0)
+        {
+            BleTx_OnTxComplete(FALSE); /* Lost in flight - also unblocks a TX task waiting for credit */
+        }
         WsfTimerStop(&trimTimer);
-        ControlTask_SendBleEvent(BLE_CTRL_EVT_DISCONNECTED);
+        BleTx_OnLinkChange(FALSE);
         APP_TRACE_INFO0("=== Connection Closed ===");
         APP_TRACE_INFO1("Reason: 0x%02x", pMsg->connClose.reason);
         break;
@@ -348,6 +460,7 @@ void DatsHandlerInit(wsfHandlerId_t handlerId)
     bleCb.handlerId = handlerId;
     bleCb.connId = DM_CONN_ID_NONE;
     bleCb.connected = FALSE;
+    bleCb.txCredits = DATS_TX_CREDITS;
 
     /* ✅ CRITICAL: Set configuration pointers */
     pAppSlaveCfg = (appSlaveCfg_t *)&slaveCfg;
@@ -379,6 +492,19 @@ void DatsHandler(wsfEventMask_t event, wsfMsgHdr_t *pMsg)
         // ATT events are processed by the stack automatically
         // MTU exchange is handled automatically based on attCfg.desiredMtu (241)
         AppServerProcAttMsg(pMsg);
+
+        /* A bigger payload may let events held for the MTU exchange go out */
+        if (pMsg->event == ATT_MTU_UPDATE_IND)
+        {
+            BleTx_OnLinkChange(TRUE);
+        }
+
+        /* Notification on the TX characteristic left the stack - refill a credit */
+        if (pMsg->event == ATTS_HANDLE_VALUE_CNF &&
+            ((attEvt_t *)pMsg)->handle == CUSTOM_TX_HDL)
+        {
+            txCreditReturn(pMsg->status);
+        }
     }
     else if (pMsg->event >= DM_CBACK_START && pMsg->event <= DM_CBACK_END)
     {
@@ -64,7 +64,11 @@ extern "C"
      *  \param  pData   Pointer to data to send.
      *  \param  len     Length of data in bytes.
      *
-     *  \return TRUE if sent successfully, FALSE otherwise.
+     *  Each call consumes one TX credit; the credit is returned when the stack reports the
+     *  notification complete (ATTS_HANDLE_VALUE_CNF).
+     *
+     *  \return TRUE if the notification was handed to the stack, FALSE if not connected,
+     *          notifications are disabled, or no TX credit is available.
      */
     /*************************************************************************************************/
     bool_t DataSend(const uint8_t *pData, uint16_t len);
@@ -107,6 +111,15 @@ extern "C"
     /*************************************************************************************************/
     bool_t BLE_IsConnected(void);
 
+    /*************************************************************************************************/
+    /*!
+     *  \brief  Check if the central has enabled notifications on the TX characteristic.
+     *
+     *  \return TRUE if connected and notifications are enabled, FALSE otherwise.
+     */
+    /*************************************************************************************************/
+    bool_t BLE_IsNotifyEnabled(void);
+
     /*************************************************************************************************/
     /*!
      *  \brief  Get the current connection ID.
@@ -116,6 +129,24 @@ extern "C"
     /*************************************************************************************************/
     uint8_t BLE_GetConnId(void);
 
+    /*************************************************************************************************/
+    /*!
+     *  \brief  Get the largest payload a single notification can carry on this connection.
+     *
+     *  \return Negotiated ATT MTU minus the notification header, capped at CUSTOM_MAX_DATA_LEN.
+     */
+    /*************************************************************************************************/
+    uint16_t BLE_GetMaxPayload(void);
+
+    /*************************************************************************************************/
+    /*!
+     *  \brief  Get the number of notifications that can be queued to the stack right now.
+     *
+     *  \return Free TX credits (0 when all notification slots are in flight).
+     */
+    /*************************************************************************************************/
+    uint8_t BLE_GetTxCredits(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -61,6 +61,7 @@
 #include "pal_led.h"
 
 #include "FreeRTOSConfig.h"
+#include "time_utils.h"
 
 #include "wut.h"
 #include "rtc.h"
@@ -261,7 +262,7 @@ void setInterruptPriority(void)
     NVIC_SetPriority(DMA2_IRQn, (configMAX_PRIORITIES - 0));
     NVIC_SetPriority(DMA3_IRQn, (configMAX_PRIORITIES - 0));
 
-    NVIC_SetPriority(GPIO0_IRQn, (configMAX_PRIORITIES - 0));
+    /* GPIO0 (button and HR sensor INT lines) is set up by gpio_irq.c */
     NVIC_SetPriority(GPIO1_IRQn, (configMAX_PRIORITIES - 0));
 }
 
@@ -357,6 +358,10 @@ void bleStartup(void)
     trim32k();
 #endif
 
+    /* Button capture timer: calibrate against the 32 kHz crystal only now, trim32k() does
+     * not return until wutTrimCb() has run, and the trim uses the same WUT counter */
+    Time_InitCapture();
+
     setInterruptPriority();
 
 #if configUSE_TICKLESS_IDLE
@@ -10,9 +10,12 @@
 #include "ble_manager.h"
 #include "protocol.h"
 #include "buffer.h"
+#include "ble_uuid.h"
+#include "time_utils.h"
 #include "FreeRTOS.h"
 #include "task.h"
 #include "queue.h"
+#include "semphr.h"
 #include <stdio.h>
 #include <string.h>
 
@@ -23,6 +26,24 @@
 #define BLE_TX_TASK_STACK_SIZE 320
 #define BLE_TX_TASK_PRIORITY (tskIDLE_PRIORITY + 1)
 #define EVENT_QUEUE_LENGTH 4
+#define TIME_SYNC_QUEUE_LENGTH 1 /* A central waits for each reply before the next request */
+#define BLE_TX_QUEUE_SET_LENGTH (EVENT_QUEUE_LENGTH + 1 + TIME_SYNC_QUEUE_LENGTH) /* + link semaphore */
+#define BLE_TX_MAX_BATCH 16     /* Most events packed into one notification */
+#define BLE_TX_CREDIT_TIMEOUT_MS 1000 /* Give up on a stalled link and buffer instead */
+
+/* Task notification bits */
+#define BLE_TX_NOTIFY_CREDIT (1UL << 0) /* A notification completed - credit may be free */
+
+/**************************************************************************************************
+  Data Types
+**************************************************************************************************/
+
+/*! A time_sync request, answered by the task */
+typedef struct
+{
+    uint64_t refMs; /* Central's clock from the command */
+    uint64_t rxMs;  /* Our clock when the command arrived */
+} TimeSyncReq_t;
 
 /**************************************************************************************************
   Static Memory for FreeRTOS Objects
@@ -32,6 +53,13 @@
 static StaticQueue_t s_eventQueueBuffer;
 static uint8_t s_eventQueueStorage[EVENT_QUEUE_LENGTH * sizeof(WorkoutEvent_t)];
 
+/* Static time_sync request queue storage */
+static StaticQueue_t s_timeSyncQueueBuffer;
+static uint8_t s_timeSyncQueueStorage[TIME_SYNC_QUEUE_LENGTH * sizeof(TimeSyncReq_t)];
+
+/* Static link-change semaphore storage */
+static StaticSemaphore_t s_linkSemBuffer;
+
 /* Static task storage */
 static StaticTask_t s_bleTxTaskBuffer;
 static StackType_t s_bleTxTaskStack[BLE_TX_TASK_STACK_SIZE];
@@ -47,8 +75,345 @@ QueueHandle_t g_eventQueue = NULL;
 **************************************************************************************************/
 
 static TaskHandle_t s_bleTxTaskHandle = NULL;
-static bool s_wasConnected = false;
-static char s_msgBuf[PROTOCOL_MAX_MSG_LEN]; /* Static buffer for serialization */
+static SemaphoreHandle_t s_linkSem = NULL;
+static QueueHandle_t s_timeSyncQueue = NULL;
+static QueueSetHandle_t s_txQueueSet = NULL;
+
+/* Link-up bookkeeping, written from BLE stack context */
+static volatile bool s_linkUp = false;
+static volatile bool s_linkUpSeen = false;   /* Set on connect, cleared by the task */
+static volatile uint32_t s_connectMs = 0;
+
+/* Resend request from the Control task, carried out by the TX task (the buffer's reader) */
+static volatile bool s_resendPending = false;
+static volatile uint64_t s_resendSinceMs = 0;
+
+/* A backlog existed at reconnect and has not drained yet */
+static bool s_drainPending = false;
+static uint8_t s_msgBuf[CUSTOM_MAX_DATA_LEN]; /* Notification payload being built */
+
+/* Events carried by the payload in s_msgBuf, kept so they can be buffered if the send fails */
+static ProtocolFrame_t s_frame;
+static WorkoutEvent_t s_batch[BLE_TX_MAX_BATCH];
+static uint8_t s_batchCount = 0;
+
+static BleTxStats_t s_stats;
+
+/**************************************************************************************************
+  Local Functions
+**************************************************************************************************/
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Start a new notification payload sized to the connection MTU.
+ */
+/*************************************************************************************************/
+static void batchBegin(void)
+{
+    Protocol_FrameInit(&s_frame, s_msgBuf, BLE_GetMaxPayload());
+    s_batchCount = 0;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Deal with an event that does not fit even an empty payload.
+ *
+ *  Until the MTU exchange a payload is 20 bytes, too small for a JSON event. Such an event
+ *  is kept in the offline buffer and goes out once the payload grows. Only an event that
+ *  cannot be encoded at all is dropped.
+ */
+/*************************************************************************************************/
+static void holdEvent(const WorkoutEvent_t *pEvent)
+{
+    uint16_t needed = Protocol_FrameNeeded(&s_frame, pEvent);
+
+    if (needed == 0)
+    {
+        s_stats.eventsDropped++;
+        printf("[BLE_TX] ERROR: Event type %d cannot be encoded, dropped\n", pEvent->type);
+        return;
+    }
+
+    s_stats.eventsHeld++;
+    Buffer_Push(pEvent);
+    printf("[BLE_TX] Event needs %u of %u payload bytes - held until the MTU grows\n",
+           (unsigned)needed, (unsigned)s_frame.cap);
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Add an event to the current payload.
+ *
+ *  \return false if the payload is full and must be sent first. An event too big for any
+ *          payload at this MTU is passed to holdEvent() and reported as added.
+ */
+/*************************************************************************************************/
+static bool batchAdd(const WorkoutEvent_t *pEvent)
+{
+    if (s_batchCount >= BLE_TX_MAX_BATCH)
+    {
+        return false;
+    }
+
+    if (!Protocol_FrameAppend(&s_frame, pEvent))
+    {
+        if (s_frame.count > 0)
+        {
+            return false;
+        }
+
+        holdEvent(pEvent);
+        return true;
+    }
+
+    s_batch[s_batchCount++] = *pEvent;
+    return true;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Block until the stack can take another notification.
+ *
+ *  \return true if a credit is available, false on disconnect or timeout.
+ */
+/*************************************************************************************************/
+static bool waitForCredit(void)
+{
+    uint32_t bits;
+
+    s_stats.creditWaits++;
+
+    while (BLE_IsConnected() && BLE_GetTxCredits() == 0)
+    {
+        /* Bits set since the last wait are kept, so a completion that raced the check still wakes us */
+        if (xTaskNotifyWait(0, BLE_TX_NOTIFY_CREDIT, &bits,
+                            pdMS_TO_TICKS(BLE_TX_CREDIT_TIMEOUT_MS)) != pdTRUE)
+        {
+            return false;
+        }
+    }
+
+    return BLE_IsConnected();
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Send the payload in s_msgBuf, waiting for a credit if the stack is busy.
+ *
+ *  \param  events  Number of events carried by the payload.
+ *
+ *  \return true once the stack has accepted the notification.
+ */
+/*************************************************************************************************/
+static bool frameSend(uint16_t events)
+{
+    while (BLE_IsConnected())
+    {
+        if (DataSend(s_msgBuf, s_frame.len))
+        {
+            s_stats.framesSent++;
+            s_stats.eventsSent += events;
+            return true;
+        }
+
+        /* Only a credit shortage is worth waiting out */
+        if (BLE_GetTxCredits() > 0 || !waitForCredit())
+        {
+            break;
+        }
+    }
+
+    return false;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Send the current payload, if it holds any events. On failure its events go to
+ *          the offline buffer. Either way the payload is empty afterwards.
+ *
+ *  \return true if sent.
+ */
+/*************************************************************************************************/
+static bool batchSend(void)
+{
+    bool sent;
+    uint8_t i;
+
+    if (s_batchCount == 0)
+    {
+        return true;
+    }
+
+    sent = frameSend(s_batchCount);
+    if (!sent)
+    {
+        for (i = 0; i < s_batchCount; i++)
+        {
+            Buffer_Push(&s_batch[i]);
+        }
+    }
+    s_batchCount = 0;
+
+    return sent;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Send the offline backlog and record how long a reconnect took to drain it.
+ */
+/*************************************************************************************************/
+static void drainBacklog(void)
+{
+    uint32_t elapsed;
+
+    BleTx_FlushBuffer();
+
+    if (s_drainPending && Buffer_IsEmpty())
+    {
+        elapsed = Time_ElapsedMs(s_connectMs);
+        s_stats.lastDrainMs = elapsed;
+        if (elapsed > s_stats.maxDrainMs)
+        {
+            s_stats.maxDrainMs = elapsed;
+        }
+        s_drainPending = false;
+
+        printf("[BLE_TX] Backlog drained %lu ms after reconnect\n", (unsigned long)elapsed);
+    }
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  React to a connect, disconnect or notification-enable from the BLE stack, or to
+ *          a resend request.
+ */
+/*************************************************************************************************/
+static void handleLinkChange(void)
+{
+    uint32_t count;
+
+    if (s_resendPending)
+    {
+        s_resendPending = false;
+        count = Buffer_Rewind(s_resendSinceMs);
+        printf("[BLE_TX] Resending %lu stored event(s)\n", (unsigned long)count);
+    }
+
+    if (!BLE_IsConnected())
+    {
+        s_drainPending = false;
+        return;
+    }
+
+    if (s_linkUpSeen)
+    {
+        s_linkUpSeen = false;
+        s_stats.reconnects++;
+        s_drainPending = !Buffer_IsEmpty();
+    }
+
+    /* Backlog can only go out once the central has enabled notifications */
+    if (BLE_IsNotifyEnabled())
+    {
+        drainBacklog();
+    }
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Take one event off the queue and add it to the payload being built.
+ *
+ *  Called once per queue set entry for g_eventQueue, so each entry is matched by exactly
+ *  one read. The task sends the payload once nothing else is waiting, or this function
+ *  does when the event does not fit alongside the ones already packed.
+ */
+/*************************************************************************************************/
+static void handleEvent(void)
+{
+    WorkoutEvent_t event;
+
+    if (xQueueReceive(g_eventQueue, &event, 0) != pdTRUE)
+    {
+        return;
+    }
+
+    if (!BLE_IsNotifyEnabled())
+    {
+        /* Not connected - buffer event for later, after anything packed before the drop */
+        batchSend();
+        Buffer_Push(&event);
+        return;
+    }
+
+    if (s_batchCount == 0)
+    {
+        /* Anything buffered is older and goes first */
+        if (!Buffer_IsEmpty())
+        {
+            drainBacklog();
+        }
+
+        /* Whatever is still buffered (held for a bigger MTU, or a send failed) stays ahead */
+        if (!Buffer_IsEmpty())
+        {
+            Buffer_Push(&event);
+            return;
+        }
+
+        batchBegin();
+    }
+
+    /* Failed sends are buffered inside batchSend() */
+    if (!batchAdd(&event))
+    {
+        batchSend();
+        batchBegin();
+        batchAdd(&event);
+    }
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Take one time_sync request off its queue and send the reply.
+ *
+ *  Called once per queue set entry for s_timeSyncQueue. The reply goes out through the same
+ *  credit accounting as events, after any payload already packed.
+ */
+/*************************************************************************************************/
+static void handleTimeSync(void)
+{
+    TimeSyncReq_t req;
+    uint16_t len = 0;
+    bool sent = false;
+
+    if (xQueueReceive(s_timeSyncQueue, &req, 0) != pdTRUE)
+    {
+        return;
+    }
+
+    /* Packed events were queued first, and s_msgBuf is needed for the reply */
+    batchSend();
+
+    /* Take the tx stamp once a credit is in hand, so waiting for one is not counted as
+     * part of the round trip */
+    if (BLE_IsConnected() && (BLE_GetTxCredits() > 0 || waitForCredit()))
+    {
+        len = Protocol_EncodeTimeSync(req.refMs, req.rxMs, Time_GetMs64(), s_msgBuf,
+                                      BLE_GetMaxPayload());
+        sent = (len > 0) && DataSend(s_msgBuf, len);
+    }
+
+    if (!sent)
+    {
+        s_stats.timeSyncFailed++;
+        printf("[BLE_TX] WARNING: time_sync reply not sent (%s)\n",
+               !BLE_IsConnected() ? "disconnected" : (len == 0) ? "too big for payload" : "no credit");
+        return;
+    }
+
+    s_stats.framesSent++;
+    s_stats.timeSyncSent++;
+}
 
 /**************************************************************************************************
   Public Functions
@@ -70,6 +435,33 @@ bool BleTx_Init(void)
         return false;
     }
 
+    /* Link changes from the BLE stack wake the task through the same queue set */
+    s_linkSem = xSemaphoreCreateBinaryStatic(&s_linkSemBuffer);
+    s_txQueueSet = xQueueCreateSet(BLE_TX_QUEUE_SET_LENGTH);
+
+    if (s_linkSem == NULL || s_txQueueSet == NULL)
+    {
+        printf("[BLE_TX] ERROR: Failed to create queue set\n");
+        return false;
+    }
+
+    /* time_sync replies are sent by the task too, so they take a TX credit like any event */
+    s_timeSyncQueue = xQueueCreateStatic(
+        TIME_SYNC_QUEUE_LENGTH,
+        sizeof(TimeSyncReq_t),
+        s_timeSyncQueueStorage,
+        &s_timeSyncQueueBuffer);
+
+    if (s_timeSyncQueue == NULL)
+    {
+        printf("[BLE_TX] ERROR: Failed to create time_sync queue\n");
+        return false;
+    }
+
+    xQueueAddToSet(g_eventQueue, s_txQueueSet);
+    xQueueAddToSet(s_linkSem, s_txQueueSet);
+    xQueueAddToSet(s_timeSyncQueue, s_txQueueSet);
+
     printf("[BLE_TX] Event queue initialized (static)\n");
     return true;
 }
@@ -116,82 +508,167 @@ bool BleTx_SendEvent(const WorkoutEvent_t *pEvent)
 }
 
 /*************************************************************************************************/
-uint8_t BleTx_FlushBuffer(void)
+void BleTx_OnTxComplete(bool success)
 {
-    uint8_t count = 0;
-    WorkoutEvent_t event;
-    uint16_t len;
+    if (success)
+    {
+        s_stats.ntfConfirmed++;
+    }
+    else
+    {
+        s_stats.ntfFailed++;
+    }
+
+    if (s_bleTxTaskHandle != NULL)
+    {
+        xTaskNotify(s_bleTxTaskHandle, BLE_TX_NOTIFY_CREDIT, eSetBits);
+    }
+}
+
+/*************************************************************************************************/
+void BleTx_GetStats(BleTxStats_t *pStats)
+{
+    if (pStats != NULL)
+    {
+        *pStats = s_stats;
+    }
+}
 
-    /* Flush buffered events to BLE */
-    while (Buffer_Pop(&event))
+/*************************************************************************************************/
+uint16_t BleTx_FlushBuffer(void)
+{
+    const WorkoutEvent_t *pEvents[BLE_TX_MAX_BATCH];
+    uint16_t count = 0;
+    uint16_t avail;
+    uint16_t used;
+
+    /* Serialize straight out of the buffer; events are only removed once the stack has them */
+    while (BLE_IsConnected())
     {
-        len = Protocol_SerializeEvent(&event, s_msgBuf, sizeof(s_msgBuf));
-        if (len > 0)
+        avail = Buffer_PeekSpan(pEvents, BLE_TX_MAX_BATCH);
+        if (avail == 0)
         {
-            if (DataSend((const uint8_t *)s_msgBuf, len))
+            break;
+        }
+
+        Protocol_FrameInit(&s_frame, s_msgBuf, BLE_GetMaxPayload());
+
+        for (used = 0; used < avail; used++)
+        {
+            if (!Protocol_FrameAppend(&s_frame, pEvents[used]))
+            {
+                break;
+            }
+        }
+
+        if (used == 0)
+        {
+            if (Protocol_FrameNeeded(&s_frame, pEvents[0]) != 0)
             {
-                count++;
+                /* Too big for this MTU - leave the backlog in place until the payload grows */
+                break;
             }
+
+            /* Can't be encoded in any payload - the one event that is dropped */
+            s_stats.eventsDropped++;
+            printf("[BLE_TX] ERROR: Stored event type %d cannot be encoded, dropped\n",
+                   pEvents[0]->type);
+            Buffer_Commit(1);
+            continue;
         }
-        /* Small delay between sends */
-        vTaskDelay(pdMS_TO_TICKS(50));
+
+        if (!frameSend(used))
+        {
+            break;
+        }
+
+        Buffer_Commit(used);
+        count += used;
     }
 
     return count;
 }
 
 /*************************************************************************************************/
-void BleTxTask(void *pvParameters)
+void BleTx_OnLinkChange(bool connected)
 {
-    (void)pvParameters;
-    WorkoutEvent_t event;
-    uint16_t len;
-    bool connected;
+    if (connected && !s_linkUp)
+    {
+        s_connectMs = Time_GetMs();
+        s_linkUpSeen = true;
+    }
+    s_linkUp = connected;
 
-    /* Initialize as "was connected" to avoid false reconnection flush on first connect */
-    s_wasConnected = true;
+    if (s_linkSem != NULL)
+    {
+        xSemaphoreGive(s_linkSem);
+    }
+}
 
-    while (1)
+/*************************************************************************************************/
+void BleTx_RequestResend(uint64_t sinceMs)
+{
+    s_resendSinceMs = sinceMs;
+    s_resendPending = true;
+
+    if (s_linkSem != NULL)
     {
-        /* Wait for event from Control task */
-        if (xQueueReceive(g_eventQueue, &event, portMAX_DELAY) == pdTRUE)
-        {
-            /* Check connection status */
-            connected = BLE_IsConnected();
+        xSemaphoreGive(s_linkSem);
+    }
+}
 
-            /* Check for reconnection - flush buffer */
-            if (connected && !s_wasConnected)
-            {
-                vTaskDelay(pdMS_TO_TICKS(100)); /* Wait for connection to stabilize */
-                BleTx_FlushBuffer();
-            }
-            s_wasConnected = connected;
+/*************************************************************************************************/
+bool BleTx_SendTimeSync(uint64_t centralMs, uint64_t rxMs)
+{
+    TimeSyncReq_t req;
 
-            /* Serialize event to JSON */
-            len = Protocol_SerializeEvent(&event, s_msgBuf, sizeof(s_msgBuf));
+    if (s_timeSyncQueue == NULL)
+    {
+        return false;
+    }
 
-            if (len > 0)
-            {
-                if (connected)
-                {
-                    /* Send via BLE */
-                    if (DataSend((const uint8_t *)s_msgBuf, len))
-                    {
-                        /* Brief yield to let BLE stack process */
-                        vTaskDelay(pdMS_TO_TICKS(10));
-                    }
-                    else
-                    {
-                        /* Failed to send - buffer it */
-                        Buffer_Push(&event);
-                    }
-                }
-                else
-                {
-                    /* Not connected - buffer event for later */
-                    Buffer_Push(&event);
-                }
-            }
+    req.refMs = centralMs;
+    req.rxMs = rxMs;
+
+    if (xQueueSend(s_timeSyncQueue, &req, 0) != pdTRUE)
+    {
+        printf("[BLE_TX] WARNING: time_sync still being answered, request dropped\n");
+        return false;
+    }
+
+    return true;
+}
+
+/*************************************************************************************************/
+void BleTxTask(void *pvParameters)
+{
+    (void)pvParameters;
+    QueueSetMemberHandle_t member;
+
+    while (1)
+    {
+        /* Sleep until an event is queued or the link changes. While a payload is being
+         * packed, only look for events already waiting, and send it once there are none. */
+        member = xQueueSelectFromSet(s_txQueueSet, (s_batchCount > 0) ? 0 : portMAX_DELAY);
+
+        if (member == s_linkSem)
+        {
+            /* Packed events were queued before the link changed */
+            batchSend();
+            xSemaphoreTake(s_linkSem, 0);
+            handleLinkChange();
+        }
+        else if (member == g_eventQueue)
+        {
+            handleEvent();
+        }
+        else if (member == s_timeSyncQueue)
+        {
+            handleTimeSync();
+        }
+        else
+        {
+            batchSend();
         }
     }
 }
@@ -23,6 +23,27 @@
 extern "C" {
 #endif
 
+/**************************************************************************************************
+  Type Definitions
+**************************************************************************************************/
+
+/*! TX path counters */
+typedef struct
+{
+    uint32_t framesSent;     /*!< Notifications handed to the stack */
+    uint32_t eventsSent;     /*!< Events carried by those notifications */
+    uint32_t ntfConfirmed;   /*!< Notifications the stack reported as sent */
+    uint32_t ntfFailed;      /*!< Notifications completed with an error status */
+    uint32_t creditWaits;    /*!< Times the task blocked waiting for a TX credit */
+    uint32_t reconnects;     /*!< Connections opened */
+    uint32_t lastDrainMs;    /*!< Connect-to-backlog-empty time of the last reconnect with a backlog */
+    uint32_t maxDrainMs;     /*!< Worst connect-to-backlog-empty time seen */
+    uint32_t eventsHeld;     /*!< Events buffered because no payload at the current MTU fits them */
+    uint32_t eventsDropped;  /*!< Events that could not be encoded at all */
+    uint32_t timeSyncSent;   /*!< time_sync replies handed to the stack */
+    uint32_t timeSyncFailed; /*!< time_sync replies lost: disconnected, no credit or too big */
+} BleTxStats_t;
+
 /**************************************************************************************************
   Global Variables
 **************************************************************************************************/
@@ -67,10 +88,73 @@ bool BleTx_SendEvent(const WorkoutEvent_t *pEvent);
 /*!
  *  \brief  Flush any buffered events when BLE reconnects.
  *
+ *  Events leave the buffer only once the stack has accepted them. Flushing stops at an
+ *  event too big for the current payload; it and everything behind it stay buffered.
+ *
  *  \return Number of events flushed.
  */
 /*************************************************************************************************/
-uint8_t BleTx_FlushBuffer(void);
+uint16_t BleTx_FlushBuffer(void);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Report completion of a TX-characteristic notification (called from BLE stack context).
+ *
+ *  Wakes the TX task if it is waiting for a credit.
+ *
+ *  \param  success  true if the stack sent the notification.
+ */
+/*************************************************************************************************/
+void BleTx_OnTxComplete(bool success);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Report a link change (called from BLE stack context).
+ *
+ *  Called on connect, on disconnect, when the central enables notifications and when the
+ *  MTU changes. Wakes the TX task so the offline backlog drains as soon as it can be sent,
+ *  without waiting for the next workout event.
+ *
+ *  \param  connected  true if a connection is open.
+ */
+/*************************************************************************************************/
+void BleTx_OnLinkChange(bool connected);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Ask the TX task to resend stored events (sync_since command).
+ *
+ *  \param  sinceMs  Oldest event timestamp the central wants again.
+ */
+/*************************************************************************************************/
+void BleTx_RequestResend(uint64_t sinceMs);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Answer a time_sync command (called from the RX callback).
+ *
+ *  Hands the request to the TX task, which echoes the central's clock with ours at receipt
+ *  and at reply so the central can work out the offset and round-trip time itself. The
+ *  reply is encoded in the connection's format (Protocol_EncodeTimeSync()) and sent like
+ *  an event, waiting for a TX credit; its tx time is taken just before it goes out. A reply
+ *  that cannot be sent is logged and counted in BleTxStats_t.timeSyncFailed.
+ *
+ *  \param  centralMs  Central's clock from the command.
+ *  \param  rxMs       Time_GetMs64() when the command arrived.
+ *
+ *  \return true if the request was queued, false (logged) if one is still pending.
+ */
+/*************************************************************************************************/
+bool BleTx_SendTimeSync(uint64_t centralMs, uint64_t rxMs);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Get TX path counters.
+ *
+ *  \param  pStats  Receives a snapshot of the counters.
+ */
+/*************************************************************************************************/
+void BleTx_GetStats(BleTxStats_t *pStats);
 
 /*************************************************************************************************/
 /*!
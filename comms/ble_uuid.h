@@ -39,8 +39,8 @@ extern "C" {
 #define CUSTOM_RX_CHAR_UUID         0xF2, 0xDE, 0xBC, 0x9A, 0x78, 0x56, 0x34, 0x12, \
                                     0x78, 0x56, 0x34, 0x12, 0x78, 0x56, 0x34, 0x12
 
-/*! \brief Maximum data length for characteristics */
-#define CUSTOM_MAX_DATA_LEN         128
+/*! \brief Maximum data length for characteristics (desired ATT MTU 241 - 3 byte notification header) */
+#define CUSTOM_MAX_DATA_LEN         238
 
 /*! \brief Human-readable UUID strings for ESP32 code reference:
  *  
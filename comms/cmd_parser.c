@@ -0,0 +1,418 @@
+/*************************************************************************************************/
+/*!
+ *  \file   cmd_parser.c
+ *
+ *  \brief  Allocation-free RX command parser and command table.
+ */
+/*************************************************************************************************/
+
+#include "cmd_parser.h"
+#include "protocol.h"
+#include <string.h>
+
+/**************************************************************************************************
+  Macros
+**************************************************************************************************/
+
+#define CMD_ENTRY(name, id)     { name, sizeof(name) - 1, id }
+
+#define CMD_VARINT_MAX_LEN      10  /* Bytes in a 64-bit LEB128 varint */
+
+/**************************************************************************************************
+  Data Types
+**************************************************************************************************/
+
+/*! Command table entry */
+typedef struct
+{
+    const char *name;
+    uint8_t nameLen;
+    CmdId_t id;
+} CmdEntry_t;
+
+/*! Read position in the payload being parsed */
+typedef struct
+{
+    const uint8_t *p;
+    const uint8_t *end;
+    uint16_t steps;         /* Bytes examined plus table probes */
+} CmdCursor_t;
+
+/*! A string token, pointing into the payload */
+typedef struct
+{
+    const uint8_t *p;
+    uint8_t len;
+} CmdToken_t;
+
+/**************************************************************************************************
+  Local Variables
+**************************************************************************************************/
+
+static const CmdEntry_t s_cmdTable[] = {
+    CMD_ENTRY("hr_done", CMD_HR_DONE),
+    CMD_ENTRY("start", CMD_START),
+    CMD_ENTRY("lap", CMD_LAP),
+    CMD_ENTRY("stop", CMD_STOP),
+    CMD_ENTRY("mode", CMD_MODE),
+    CMD_ENTRY("time_sync", CMD_TIME_SYNC),
+    CMD_ENTRY("sync_since", CMD_SYNC_SINCE),
+    CMD_ENTRY("fmt_bin", CMD_FMT_BIN),
+    CMD_ENTRY("fmt_json", CMD_FMT_JSON),
+};
+
+#define CMD_TABLE_LEN   (sizeof(s_cmdTable) / sizeof(s_cmdTable[0]))
+
+static CmdParserStats_t s_stats;
+
+/**************************************************************************************************
+  Local Functions
+**************************************************************************************************/
+
+/*************************************************************************************************/
+static CmdId_t lookupName(CmdCursor_t *pCur, const CmdToken_t *pName)
+{
+    uint8_t i;
+
+    for (i = 0; i < CMD_TABLE_LEN; i++)
+    {
+        pCur->steps++;
+
+        if (s_cmdTable[i].nameLen == pName->len &&
+            memcmp(s_cmdTable[i].name, pName->p, pName->len) == 0)
+        {
+            return s_cmdTable[i].id;
+        }
+    }
+
+    return CMD_NONE;
+}
+
+/*************************************************************************************************/
+static void skipSpace(CmdCursor_t *pCur)
+{
+    while (pCur->p < pCur->end &&
+           (*pCur->p == ' ' || *pCur->p == '\t' || *pCur->p == '\r' || *pCur->p == '\n'))
+    {
+        pCur->p++;
+        pCur->steps++;
+    }
+}
+
+/*************************************************************************************************/
+static bool expectChar(CmdCursor_t *pCur, uint8_t c)
+{
+    skipSpace(pCur);
+
+    if (pCur->p >= pCur->end || *pCur->p != c)
+    {
+        return false;
+    }
+
+    pCur->p++;
+    pCur->steps++;
+    return true;
+}
+
+/*************************************************************************************************/
+static bool readString(CmdCursor_t *pCur, CmdToken_t *pTok)
+{
+    const uint8_t *start;
+
+    if (!expectChar(pCur, '"'))
+    {
+        return false;
+    }
+
+    start = pCur->p;
+
+    while (pCur->p < pCur->end && *pCur->p != '"')
+    {
+        /* Escapes never appear in command names; step over them so the string still ends right */
+        if (*pCur->p == '\\' && pCur->p + 1 < pCur->end)
+        {
+            pCur->p++;
+            pCur->steps++;
+        }
+        pCur->p++;
+        pCur->steps++;
+    }
+
+    if (pCur->p >= pCur->end || pCur->p - start > UINT8_MAX)
+    {
+        return false;
+    }
+
+    pTok->p = start;
+    pTok->len = (uint8_t)(pCur->p - start);
+    pCur->p++;  /* Closing quote */
+    pCur->steps++;
+
+    return true;
+}
+
+/*************************************************************************************************/
+static bool readUint(CmdCursor_t *pCur, uint64_t *pValue)
+{
+    uint64_t value = 0;
+    bool any = false;
+
+    while (pCur->p < pCur->end && *pCur->p >= '0' && *pCur->p <= '9')
+    {
+        if (value > (UINT64_MAX - 9) / 10)
+        {
+            return false;
+        }
+
+        value = value * 10 + (uint64_t)(*pCur->p - '0');
+        any = true;
+        pCur->p++;
+        pCur->steps++;
+    }
+
+    *pValue = value;
+    return any;
+}
+
+/*************************************************************************************************/
+static bool skipScalar(CmdCursor_t *pCur)
+{
+    const uint8_t *start = pCur->p;
+
+    /* true / false / null / signed or fractional numbers - not used, just stepped over */
+    while (pCur->p < pCur->end && *pCur->p != ',' && *pCur->p != '}' &&
+           *pCur->p != '{' && *pCur->p != '[' && *pCur->p != '"')
+    {
+        pCur->p++;
+        pCur->steps++;
+    }
+
+    return (pCur->p > start);
+}
+
+/*************************************************************************************************/
+static bool parseJson(CmdCursor_t *pCur, Cmd_t *pCmd, bool *pFound)
+{
+    CmdToken_t key;
+    CmdToken_t name = { NULL, 0 };
+    bool haveName = false;
+
+    pCmd->id = CMD_NONE;
+    pCmd->arg = 0;
+    *pFound = false;
+
+    if (!expectChar(pCur, '{'))
+    {
+        return false;
+    }
+
+    skipSpace(pCur);
+    if (pCur->p < pCur->end && *pCur->p == '}')
+    {
+        pCur->p++;
+        return true;
+    }
+
+    do
+    {
+        if (!readString(pCur, &key) || !expectChar(pCur, ':'))
+        {
+            return false;
+        }
+
+        skipSpace(pCur);
+        if (pCur->p >= pCur->end)
+        {
+            return false;
+        }
+
+        if (key.len == 3 && memcmp(key.p, "cmd", 3) == 0)
+        {
+            if (!readString(pCur, &name))
+            {
+                return false;
+            }
+            haveName = true;
+        }
+        else if (key.len == 3 && memcmp(key.p, "arg", 3) == 0)
+        {
+            if (!readUint(pCur, &pCmd->arg))
+            {
+                return false;
+            }
+        }
+        else if (*pCur->p == '"')
+        {
+            if (!readString(pCur, &key))
+            {
+                return false;
+            }
+        }
+        else if (!skipScalar(pCur))
+        {
+            /* Nested objects and arrays are not part of the command format */
+            return false;
+        }
+    } while (expectChar(pCur, ','));
+
+    if (!expectChar(pCur, '}'))
+    {
+        return false;
+    }
+
+    if (haveName)
+    {
+        pCmd->id = lookupName(pCur, &name);
+        *pFound = true;
+    }
+
+    return true;
+}
+
+/*************************************************************************************************/
+static bool readVarint(CmdCursor_t *pCur, uint64_t *pValue)
+{
+    uint64_t value = 0;
+    uint8_t shift = 0;
+    uint8_t b;
+
+    while (pCur->p < pCur->end && shift < 7 * CMD_VARINT_MAX_LEN)
+    {
+        b = *pCur->p++;
+        pCur->steps++;
+        value |= (uint64_t)(b & 0x7F) << shift;
+
+        if ((b & 0x80) == 0)
+        {
+            *pValue = value;
+            return true;
+        }
+        shift += 7;
+    }
+
+    return false;
+}
+
+/*************************************************************************************************/
+static uint8_t parseBinary(CmdCursor_t *pCur, CmdHandler_t handler, void *pCtx)
+{
+    CmdCursor_t rec;
+    Cmd_t cmd;
+    uint8_t count = 0;
+    uint8_t recLen;
+
+    pCur->p++;  /* Frame header */
+    pCur->steps++;
+
+    while (pCur->p < pCur->end)
+    {
+        recLen = *pCur->p++;
+        pCur->steps++;
+
+        if (recLen == 0 || recLen > pCur->end - pCur->p)
+        {
+            s_stats.errors++;
+            break;
+        }
+
+        rec.p = pCur->p;
+        rec.end = pCur->p + recLen;
+        rec.steps = 0;
+        pCur->p = rec.end;
+
+        cmd.id = (CmdId_t)*rec.p++;
+        cmd.arg = 0;
+
+        if ((rec.p < rec.end && !readVarint(&rec, &cmd.arg)) || rec.p != rec.end)
+        {
+            s_stats.errors++;
+        }
+        else if (cmd.id == CMD_NONE || cmd.id >= CMD_COUNT)
+        {
+            s_stats.unknown++;
+        }
+        else
+        {
+            handler(&cmd, pCtx);
+            count++;
+        }
+
+        pCur->steps += rec.steps + 1;
+    }
+
+    return count;
+}
+
+/**************************************************************************************************
+  Public Functions
+**************************************************************************************************/
+
+/*************************************************************************************************/
+uint8_t CmdParser_Parse(const uint8_t *pData, uint16_t len, CmdHandler_t handler, void *pCtx)
+{
+    CmdCursor_t cur;
+    Cmd_t cmd;
+    uint8_t count = 0;
+    bool found;
+
+    if (pData == NULL || len == 0 || handler == NULL)
+    {
+        return 0;
+    }
+
+    cur.p = pData;
+    cur.end = pData + len;
+    cur.steps = 0;
+    s_stats.writes++;
+
+    if (pData[0] == PROTOCOL_FRAME_HDR)
+    {
+        count = parseBinary(&cur, handler, pCtx);
+    }
+    else if (!parseJson(&cur, &cmd, &found))
+    {
+        s_stats.errors++;
+    }
+    else if (found && cmd.id == CMD_NONE)
+    {
+        s_stats.unknown++;
+    }
+    else if (found)
+    {
+        handler(&cmd, pCtx);
+        count = 1;
+    }
+
+    s_stats.commands += count;
+    if (cur.steps > s_stats.maxSteps)
+    {
+        s_stats.maxSteps = cur.steps;
+    }
+
+    return count;
+}
+
+/*************************************************************************************************/
+const char *CmdParser_Name(CmdId_t id)
+{
+    uint8_t i;
+
+    for (i = 0; i < CMD_TABLE_LEN; i++)
+    {
+        if (s_cmdTable[i].id == id)
+        {
+            return s_cmdTable[i].name;
+        }
+    }
+
+    return "unknown";
+}
+
+/*************************************************************************************************/
+void CmdParser_GetStats(CmdParserStats_t *pStats)
+{
+    if (pStats != NULL)
+    {
+        *pStats = s_stats;
+    }
+}
@@ -0,0 +1,114 @@
+/*************************************************************************************************/
+/*!
+ *  \file   cmd_parser.h
+ *
+ *  \brief  Command parser for writes to the RX characteristic.
+ *
+ *  Parses a write in place, without copying or allocating, and reports each command it
+ *  finds through a callback. Two encodings are accepted:
+ *
+ *  - JSON: one object per write, {"cmd":"<name>"} with an optional unsigned "arg",
+ *    e.g. {"cmd":"mode","arg":2}. Other keys are ignored.
+ *  - Binary: a frame like the TX side uses,
+ *
+ *      byte 0      PROTOCOL_FRAME_HDR
+ *      records     [len (1 byte)][opcode (CmdId_t)][arg (LEB128 varint, optional)]
+ *
+ *  Work is a single forward pass over the payload plus a lookup in a fixed command table,
+ *  so cost is bounded by the write length (at most CUSTOM_MAX_DATA_LEN bytes).
+ */
+/*************************************************************************************************/
+
+#ifndef COMMS_CMD_PARSER_H
+#define COMMS_CMD_PARSER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**************************************************************************************************
+  Data Types
+**************************************************************************************************/
+
+/*! Commands a central can send. Values are the binary opcodes and must not change. */
+typedef enum
+{
+    CMD_NONE = 0,
+    CMD_HR_DONE = 1,        /* HR measurement finished */
+    CMD_START = 2,          /* Same as the START button */
+    CMD_LAP = 3,            /* Same as the LAP button */
+    CMD_STOP = 4,           /* Same as the STOP button */
+    CMD_MODE = 5,           /* arg: WorkoutMode_t, only while idle */
+    CMD_TIME_SYNC = 6,      /* arg: central's clock in ms, echoed back with ours */
+    CMD_SYNC_SINCE = 7,     /* arg: resend stored events with timestamp_ms >= arg */
+    CMD_FMT_BIN = 8,        /* Switch this connection to binary events */
+    CMD_FMT_JSON = 9,       /* Switch this connection to JSON events */
+    CMD_COUNT
+} CmdId_t;
+
+/*! One parsed command */
+typedef struct
+{
+    CmdId_t id;
+    uint64_t arg;           /* 0 when not given */
+} Cmd_t;
+
+/*! Called for each command found in a write */
+typedef void (*CmdHandler_t)(const Cmd_t *pCmd, void *pCtx);
+
+/*! Parser counters since boot */
+typedef struct
+{
+    uint32_t writes;        /* Payloads parsed */
+    uint32_t commands;      /* Commands dispatched */
+    uint32_t unknown;       /* Well-formed commands not in the table */
+    uint32_t errors;        /* Malformed payloads or records */
+    uint16_t maxSteps;      /* Most bytes and table probes spent on one payload */
+} CmdParserStats_t;
+
+/**************************************************************************************************
+  Function Declarations
+**************************************************************************************************/
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Parse a write and dispatch the commands it contains.
+ *
+ *  \param  pData    Write payload (not modified, not retained).
+ *  \param  len      Payload length.
+ *  \param  handler  Called once per command, in order.
+ *  \param  pCtx     Passed through to handler.
+ *
+ *  \return Number of commands dispatched.
+ */
+/*************************************************************************************************/
+uint8_t CmdParser_Parse(const uint8_t *pData, uint16_t len, CmdHandler_t handler, void *pCtx);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Get the JSON name of a command.
+ *
+ *  \param  id  Command.
+ *
+ *  \return Name, or "unknown".
+ */
+/*************************************************************************************************/
+const char *CmdParser_Name(CmdId_t id);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Get parser counters.
+ *
+ *  \param  pStats  Receives a copy of the counters.
+ */
+/*************************************************************************************************/
+void CmdParser_GetStats(CmdParserStats_t *pStats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* COMMS_CMD_PARSER_H */
@@ -8,9 +8,42 @@
 
 #include "protocol.h"
 #include "workout_state.h"
+#include "time_utils.h"
 #include <stdio.h>
 #include <string.h>
 
+/**************************************************************************************************
+  Local Variables
+**************************************************************************************************/
+
+/*! Wire format for the current connection (written by BLE stack, read by TX task) */
+static volatile ProtocolFormat_t s_format = PROTOCOL_FMT_JSON;
+
+/**************************************************************************************************
+  Local Functions
+**************************************************************************************************/
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Write an unsigned LEB128 varint.
+ *
+ *  \return Number of bytes written (1-10).
+ */
+/*************************************************************************************************/
+static uint8_t putVarint(uint8_t *p, uint64_t value)
+{
+    uint8_t n = 0;
+
+    while (value >= 0x80)
+    {
+        p[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    p[n++] = (uint8_t)value;
+
+    return n;
+}
+
 /**************************************************************************************************
   Public Functions
 **************************************************************************************************/
@@ -25,6 +58,7 @@ const char* Protocol_EventTypeToString(EventType_t type)
         case EVENT_LAP_COMPLETE:    return "lap";
         case EVENT_WORKOUT_DONE:    return "done";
         case EVENT_STATUS_UPDATE:   return "status";
+        case EVENT_HR_RESULT:       return "hr";
         default:                    return "unknown";
     }
 }
@@ -34,45 +68,49 @@ uint16_t Protocol_SerializeEvent(const WorkoutEvent_t *pEvent, char *pBuffer, ui
 {
     int len = 0;
     const WorkoutSession_t *session = Workout_GetSession();
+    char ts[TIME_MS64_STR_LEN];
     
-    if (pEvent == NULL || pBuffer == NULL || bufLen < 50)
+    /* Too small a buffer is caught by the truncation check below */
+    if (pEvent == NULL || pBuffer == NULL || bufLen == 0)
     {
         return 0;
     }
 
+    Time_FormatMs64(pEvent->timestamp_ms, ts, sizeof(ts));
+
     switch (pEvent->type)
     {
         case EVENT_WORKOUT_START:
             len = snprintf(pBuffer, bufLen,
-                "{\"event\":\"start\",\"mode\":\"%s\",\"laps\":%d,\"ts\":%lu}",
+                "{\"event\":\"start\",\"mode\":\"%s\",\"laps\":%d,\"ts\":%s}",
                 Workout_ModeToString(session->config.mode),
                 session->config.total_laps,
-                (unsigned long)pEvent->timestamp_ms);
+                ts);
             break;
 
         case EVENT_LAP_COMPLETE:
             len = snprintf(pBuffer, bufLen,
-                "{\"event\":\"lap\",\"lap\":%d,\"lap_ms\":%lu,\"split_ms\":%lu,\"ts\":%lu}",
+                "{\"event\":\"lap\",\"lap\":%d,\"lap_ms\":%lu,\"split_ms\":%lu,\"ts\":%s}",
                 pEvent->lap_data.lap_number,
                 (unsigned long)pEvent->lap_data.lap_time_ms,
                 (unsigned long)pEvent->lap_data.split_time_ms,
-                (unsigned long)pEvent->timestamp_ms);
+                ts);
             break;
 
         case EVENT_WORKOUT_STOP:
             len = snprintf(pBuffer, bufLen,
-                "{\"event\":\"stop\",\"laps\":%d,\"total_ms\":%lu,\"ts\":%lu}",
+                "{\"event\":\"stop\",\"laps\":%d,\"total_ms\":%lu,\"ts\":%s}",
                 pEvent->current_lap,
-                (unsigned long)pEvent->timestamp_ms - session->workout_start_ms,
-                (unsigned long)pEvent->timestamp_ms);
+                (unsigned long)(pEvent->timestamp_ms - session->workout_start_us / 1000u),
+                ts);
             break;
 
         case EVENT_WORKOUT_DONE:
             len = snprintf(pBuffer, bufLen,
-                "{\"event\":\"done\",\"laps\":%d,\"total_ms\":%lu,\"ts\":%lu}",
+                "{\"event\":\"done\",\"laps\":%d,\"total_ms\":%lu,\"ts\":%s}",
                 session->config.total_laps,
                 (unsigned long)pEvent->lap_data.split_time_ms,
-                (unsigned long)pEvent->timestamp_ms);
+                ts);
             break;
 
         case EVENT_STATUS_UPDATE:
@@ -83,6 +121,15 @@ uint16_t Protocol_SerializeEvent(const WorkoutEvent_t *pEvent, char *pBuffer, ui
                 (unsigned long)Workout_GetElapsedMs());
             break;
 
+        case EVENT_HR_RESULT:
+            len = snprintf(pBuffer, bufLen,
+                "{\"event\":\"hr\",\"lap\":%d,\"bpm\":%d,\"spo2\":%d,\"ts\":%s}",
+                pEvent->lap_data.lap_number,
+                pEvent->hr_bpm,
+                pEvent->spo2,
+                ts);
+            break;
+
         default:
             len = snprintf(pBuffer, bufLen,
                 "{\"event\":\"unknown\",\"type\":%d}",
@@ -97,3 +144,212 @@ uint16_t Protocol_SerializeEvent(const WorkoutEvent_t *pEvent, char *pBuffer, ui
 
     return (uint16_t)len;
 }
+
+/*************************************************************************************************/
+uint16_t Protocol_SerializeEventBinary(const WorkoutEvent_t *pEvent, uint8_t *pBuffer, uint16_t bufLen)
+{
+    uint8_t *p = pBuffer;
+    const WorkoutSession_t *session = Workout_GetSession();
+
+    if (pEvent == NULL || pBuffer == NULL || bufLen < PROTOCOL_BIN_MAX_LEN)
+    {
+        return 0;
+    }
+
+    *p++ = (uint8_t)((PROTOCOL_BIN_VERSION << 4) | ((uint8_t)pEvent->type & 0x0F));
+
+    switch (pEvent->type)
+    {
+        case EVENT_WORKOUT_START:
+            p += putVarint(p, (uint32_t)session->config.mode);
+            p += putVarint(p, session->config.total_laps);
+            p += putVarint(p, pEvent->timestamp_ms);
+            break;
+
+        case EVENT_LAP_COMPLETE:
+            p += putVarint(p, pEvent->lap_data.lap_number);
+            p += putVarint(p, pEvent->lap_data.lap_time_ms);
+            p += putVarint(p, pEvent->lap_data.split_time_ms);
+            p += putVarint(p, pEvent->timestamp_ms);
+            break;
+
+        case EVENT_WORKOUT_STOP:
+            p += putVarint(p, pEvent->current_lap);
+            p += putVarint(p, (uint32_t)(pEvent->timestamp_ms - session->workout_start_us / 1000u));
+            p += putVarint(p, pEvent->timestamp_ms);
+            break;
+
+        case EVENT_WORKOUT_DONE:
+            p += putVarint(p, session->config.total_laps);
+            p += putVarint(p, pEvent->lap_data.split_time_ms);
+            p += putVarint(p, pEvent->timestamp_ms);
+            break;
+
+        case EVENT_STATUS_UPDATE:
+            p += putVarint(p, (uint32_t)session->state);
+            p += putVarint(p, pEvent->current_lap);
+            p += putVarint(p, Workout_GetElapsedMs());
+            break;
+
+        case EVENT_HR_RESULT:
+            p += putVarint(p, pEvent->lap_data.lap_number);
+            p += putVarint(p, pEvent->hr_bpm);
+            p += putVarint(p, pEvent->spo2);
+            p += putVarint(p, pEvent->timestamp_ms);
+            break;
+
+        default:
+            /* Header only - type nibble identifies the event */
+            break;
+    }
+
+    return (uint16_t)(p - pBuffer);
+}
+
+/*************************************************************************************************/
+uint16_t Protocol_EncodeEvent(const WorkoutEvent_t *pEvent, uint8_t *pBuffer, uint16_t bufLen)
+{
+    if (s_format == PROTOCOL_FMT_BINARY)
+    {
+        return Protocol_SerializeEventBinary(pEvent, pBuffer, bufLen);
+    }
+
+    return Protocol_SerializeEvent(pEvent, (char *)pBuffer, bufLen);
+}
+
+/*************************************************************************************************/
+void Protocol_SetFormat(ProtocolFormat_t format)
+{
+    s_format = format;
+}
+
+/*************************************************************************************************/
+ProtocolFormat_t Protocol_GetFormat(void)
+{
+    return s_format;
+}
+
+/*************************************************************************************************/
+void Protocol_FrameInit(ProtocolFrame_t *pFrame, uint8_t *pBuf, uint16_t cap)
+{
+    pFrame->pBuf = pBuf;
+    pFrame->cap = cap;
+    pFrame->len = 0;
+    pFrame->count = 0;
+    pFrame->format = s_format;
+}
+
+/*************************************************************************************************/
+bool Protocol_FrameAppend(ProtocolFrame_t *pFrame, const WorkoutEvent_t *pEvent)
+{
+    uint8_t record[PROTOCOL_BIN_MAX_LEN];
+    uint16_t len;
+
+    if (pFrame->format != PROTOCOL_FMT_BINARY)
+    {
+        /* JSON: one self-contained object per notification */
+        if (pFrame->count > 0)
+        {
+            return false;
+        }
+
+        len = Protocol_SerializeEvent(pEvent, (char *)pFrame->pBuf, pFrame->cap);
+        if (len == 0)
+        {
+            return false;
+        }
+
+        pFrame->len = len;
+        pFrame->count = 1;
+        return true;
+    }
+
+    len = Protocol_SerializeEventBinary(pEvent, record, sizeof(record));
+    if (len == 0)
+    {
+        return false;
+    }
+
+    /* Frame header + length prefix + record must fit */
+    if ((pFrame->count == 0 ? 1 : 0) + pFrame->len + 1 + len > pFrame->cap)
+    {
+        return false;
+    }
+
+    if (pFrame->count == 0)
+    {
+        pFrame->pBuf[pFrame->len++] = PROTOCOL_FRAME_HDR;
+    }
+
+    pFrame->pBuf[pFrame->len++] = (uint8_t)len;
+    memcpy(&pFrame->pBuf[pFrame->len], record, len);
+    pFrame->len += len;
+    pFrame->count++;
+
+    return true;
+}
+
+/*************************************************************************************************/
+uint16_t Protocol_FrameNeeded(const ProtocolFrame_t *pFrame, const WorkoutEvent_t *pEvent)
+{
+    char json[PROTOCOL_MAX_MSG_LEN];
+    uint8_t record[PROTOCOL_BIN_MAX_LEN];
+    uint16_t len;
+
+    if (pFrame->format != PROTOCOL_FMT_BINARY)
+    {
+        return Protocol_SerializeEvent(pEvent, json, sizeof(json));
+    }
+
+    len = Protocol_SerializeEventBinary(pEvent, record, sizeof(record));
+
+    /* Frame header + length prefix + record */
+    return (len == 0) ? 0 : (uint16_t)(2 + len);
+}
+
+/*************************************************************************************************/
+uint16_t Protocol_EncodeTimeSync(uint64_t refMs, uint64_t rxMs, uint64_t txMs,
+                                 uint8_t *pBuffer, uint16_t bufLen)
+{
+    char ref[TIME_MS64_STR_LEN];
+    char rx[TIME_MS64_STR_LEN];
+    char tx[TIME_MS64_STR_LEN];
+    uint8_t record[1 + 3 * 10]; /* Header + three 64-bit varints */
+    uint8_t *p = record;
+    uint16_t len;
+    int n;
+
+    if (pBuffer == NULL || bufLen == 0)
+    {
+        return 0;
+    }
+
+    if (s_format != PROTOCOL_FMT_BINARY)
+    {
+        n = snprintf((char *)pBuffer, bufLen,
+                     "{\"cmd\":\"time\",\"ref\":%s,\"rx\":%s,\"tx\":%s}",
+                     Time_FormatMs64(refMs, ref, sizeof(ref)),
+                     Time_FormatMs64(rxMs, rx, sizeof(rx)),
+                     Time_FormatMs64(txMs, tx, sizeof(tx)));
+
+        return (n < 0 || n >= (int)bufLen) ? 0 : (uint16_t)n;
+    }
+
+    *p++ = (uint8_t)((PROTOCOL_BIN_VERSION << 4) | PROTOCOL_BIN_TYPE_TIME);
+    p += putVarint(p, refMs);
+    p += putVarint(p, rxMs);
+    p += putVarint(p, txMs);
+    len = (uint16_t)(p - record);
+
+    /* A one-record frame, so a central parses it like any other binary notification */
+    if (2 + len > bufLen)
+    {
+        return 0;
+    }
+
+    pBuffer[0] = PROTOCOL_FRAME_HDR;
+    pBuffer[1] = (uint8_t)len;
+    memcpy(&pBuffer[2], record, len);
+
+    return (uint16_t)(2 + len);
+}
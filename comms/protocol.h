@@ -4,7 +4,35 @@
  *
  *  \brief  Communication protocol for workout data serialization.
  *
- *  This module handles JSON serialization of workout events for BLE transmission.
+ *  This module handles serialization of workout events for BLE transmission. Two encodings
+ *  are supported and selected per connection:
+ *
+ *  - JSON (default): human-readable, kept for debugging and legacy centrals.
+ *  - Binary: one header byte followed by unsigned LEB128 varint fields.
+ *
+ *  Binary layout:
+ *
+ *      byte 0      header = (PROTOCOL_BIN_VERSION << 4) | EventType_t
+ *      byte 1..n   varint fields, depending on the event type:
+ *                    start   mode, laps, ts
+ *                    lap     lap, lap_ms, split_ms, ts
+ *                    stop    laps, total_ms, ts
+ *                    done    laps, total_ms, ts
+ *                    status  state, lap, elapsed_ms
+ *                    hr      lap, bpm, spo2, ts
+ *
+ *  Field meanings match the JSON keys of the same name.
+ *
+ *  In binary mode several events are packed into one notification as a frame:
+ *
+ *      byte 0      PROTOCOL_FRAME_HDR
+ *      records     [len (1 byte)][binary event (len bytes)] repeated until end of notification
+ *
+ *  JSON events are never framed - each notification carries exactly one JSON object.
+ *
+ *  The time_sync reply is encoded in the same format: {"cmd":"time","ref":..,"rx":..,"tx":..}
+ *  in JSON, or a frame with one record whose type nibble is PROTOCOL_BIN_TYPE_TIME and whose
+ *  varint fields are ref, rx, tx.
  */
 /*************************************************************************************************/
 
@@ -25,6 +53,31 @@ extern "C"
   **************************************************************************************************/
 
 #define PROTOCOL_MAX_MSG_LEN 128 /* Maximum serialized message length */
+#define PROTOCOL_BIN_VERSION 1   /* Binary encoding version (upper nibble of header) */
+#define PROTOCOL_BIN_MAX_LEN 26  /* Worst-case binary event length (header + 3 x 5-byte varints + 10-byte ts) */
+#define PROTOCOL_FRAME_HDR 0xB1  /* First byte of a multi-event binary frame */
+#define PROTOCOL_BIN_TYPE_TIME 0x0F /* Header type nibble of a time_sync reply (not an EventType_t) */
+
+  /**************************************************************************************************
+    Type Definitions
+  **************************************************************************************************/
+
+  /*! Wire encoding used for outgoing events */
+  typedef enum
+  {
+    PROTOCOL_FMT_JSON,  /* JSON text (debug / legacy) */
+    PROTOCOL_FMT_BINARY /* Packed header + varints */
+  } ProtocolFormat_t;
+
+  /*! One notification payload under construction */
+  typedef struct
+  {
+    uint8_t *pBuf;           /* Output buffer */
+    uint16_t cap;            /* Usable size of pBuf (notification payload limit) */
+    uint16_t len;            /* Bytes written so far */
+    uint8_t count;           /* Events in the frame */
+    ProtocolFormat_t format; /* Format captured when the frame was started */
+  } ProtocolFrame_t;
 
   /**************************************************************************************************
     Function Declarations
@@ -54,6 +107,105 @@ extern "C"
   /*************************************************************************************************/
   const char *Protocol_EventTypeToString(EventType_t type);
 
+  /*************************************************************************************************/
+  /*!
+   *  \brief  Serialize a workout event to the packed binary format.
+   *
+   *  \param  pEvent      Pointer to workout event.
+   *  \param  pBuffer     Output buffer (at least PROTOCOL_BIN_MAX_LEN bytes).
+   *  \param  bufLen      Size of output buffer.
+   *
+   *  \return Number of bytes written, or 0 on error.
+   */
+  /*************************************************************************************************/
+  uint16_t Protocol_SerializeEventBinary(const WorkoutEvent_t *pEvent, uint8_t *pBuffer, uint16_t bufLen);
+
+  /*************************************************************************************************/
+  /*!
+   *  \brief  Serialize a workout event using the currently selected format.
+   *
+   *  \param  pEvent      Pointer to workout event.
+   *  \param  pBuffer     Output buffer.
+   *  \param  bufLen      Size of output buffer.
+   *
+   *  \return Number of bytes written, or 0 on error.
+   */
+  /*************************************************************************************************/
+  uint16_t Protocol_EncodeEvent(const WorkoutEvent_t *pEvent, uint8_t *pBuffer, uint16_t bufLen);
+
+  /*************************************************************************************************/
+  /*!
+   *  \brief  Select the wire format for the current connection.
+   *
+   *  \param  format  Format to use for subsequent Protocol_EncodeEvent() calls.
+   */
+  /*************************************************************************************************/
+  void Protocol_SetFormat(ProtocolFormat_t format);
+
+  /*************************************************************************************************/
+  /*!
+   *  \brief  Get the currently selected wire format.
+   *
+   *  \return Current format.
+   */
+  /*************************************************************************************************/
+  ProtocolFormat_t Protocol_GetFormat(void);
+
+  /*************************************************************************************************/
+  /*!
+   *  \brief  Start a new notification payload in the currently selected format.
+   *
+   *  \param  pFrame      Frame to initialize.
+   *  \param  pBuf        Output buffer.
+   *  \param  cap         Maximum payload length (negotiated MTU - 3).
+   */
+  /*************************************************************************************************/
+  void Protocol_FrameInit(ProtocolFrame_t *pFrame, uint8_t *pBuf, uint16_t cap);
+
+  /*************************************************************************************************/
+  /*!
+   *  \brief  Append an event to a frame.
+   *
+   *  Binary frames take as many length-prefixed events as fit; JSON frames take exactly one.
+   *
+   *  \param  pFrame      Frame being built.
+   *  \param  pEvent      Event to append.
+   *
+   *  \return true if the event was appended, false if it does not fit (or cannot be encoded).
+   */
+  /*************************************************************************************************/
+  bool Protocol_FrameAppend(ProtocolFrame_t *pFrame, const WorkoutEvent_t *pEvent);
+
+  /*************************************************************************************************/
+  /*!
+   *  \brief  Get the payload size an empty frame of pFrame's format needs to take an event.
+   *
+   *  Tells an event that does not fit this payload from one that cannot be encoded at all.
+   *
+   *  \param  pFrame      Frame whose format applies.
+   *  \param  pEvent      Event to measure.
+   *
+   *  \return Payload bytes needed, or 0 if the event cannot be encoded.
+   */
+  /*************************************************************************************************/
+  uint16_t Protocol_FrameNeeded(const ProtocolFrame_t *pFrame, const WorkoutEvent_t *pEvent);
+
+  /*************************************************************************************************/
+  /*!
+   *  \brief  Encode a time_sync reply as a complete payload in the currently selected format.
+   *
+   *  \param  refMs       Central's clock from the command.
+   *  \param  rxMs        Our clock when the command arrived.
+   *  \param  txMs        Our clock now.
+   *  \param  pBuffer     Output buffer.
+   *  \param  bufLen      Size of output buffer (notification payload limit).
+   *
+   *  \return Number of bytes written, or 0 if the reply does not fit.
+   */
+  /*************************************************************************************************/
+  uint16_t Protocol_EncodeTimeSync(uint64_t refMs, uint64_t rxMs, uint64_t txMs,
+                                   uint8_t *pBuffer, uint16_t bufLen);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,57 @@
+/*************************************************************************************************/
+/*!
+ *  \file   FreeRTOSConfig.h
+ *
+ *  \brief  FreeRTOS configuration for the Linux host build (POSIX port).
+ *
+ *  Mirrors the firmware configuration where it affects application behaviour (tick rate,
+ *  static allocation, queue sets, timers, trace facility). Interrupt priorities and
+ *  tickless idle have no meaning on the POSIX port and are left out. Task stack sizes
+ *  are not mirrored either; see the note on pthread_attr_setstack in host/Makefile.
+ */
+/*************************************************************************************************/
+
+#ifndef HOST_FREERTOSCONFIG_H
+#define HOST_FREERTOSCONFIG_H
+
+#include <stdint.h>
+
+#define configTICK_RATE_HZ ((TickType_t)1000)
+#define configTOTAL_HEAP_SIZE ((size_t)(70 * 1024))
+#define configMINIMAL_STACK_SIZE ((uint16_t)128) /* Ignored: tasks run on default pthread stacks */
+#define configMAX_PRIORITIES 7
+#define configMAX_TASK_NAME_LEN 16
+#define configSTACK_DEPTH_TYPE uint32_t /* Matches the idle/timer memory callbacks in host/main.c */
+
+#define configUSE_PREEMPTION 1
+#define configUSE_IDLE_HOOK 1
+#define configUSE_TICK_HOOK 0
+#define configUSE_CO_ROUTINES 0
+#define configUSE_16_BIT_TICKS 0
+#define configUSE_MUTEXES 1
+#define configUSE_QUEUE_SETS 1
+#define configSUPPORT_STATIC_ALLOCATION 1
+#define configSUPPORT_DYNAMIC_ALLOCATION 1
+
+void vAssertCalled(const char *const pcFileName, uint32_t ulLine);
+#define configASSERT(x) \
+    if ((x) == 0)       \
+    vAssertCalled(__FILE__, __LINE__)
+
+#define configUSE_TIMERS 1
+#define configTIMER_TASK_PRIORITY (configMAX_PRIORITIES - 3)
+#define configTIMER_QUEUE_LENGTH 8
+#define configTIMER_TASK_STACK_DEPTH configMINIMAL_STACK_SIZE
+
+#define configUSE_TRACE_FACILITY 1
+#define configUSE_STATS_FORMATTING_FUNCTIONS 1
+
+#define INCLUDE_vTaskPrioritySet 0
+#define INCLUDE_vTaskDelete 0
+#define INCLUDE_vTaskSuspend 1
+#define INCLUDE_vTaskDelayUntil 1
+#define INCLUDE_uxTaskPriorityGet 0
+#define INCLUDE_vTaskDelay 1
+#define INCLUDE_xTaskGetSchedulerState 1
+
+#endif /* HOST_FREERTOSCONFIG_H */
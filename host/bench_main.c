@@ -0,0 +1,59 @@
+/*************************************************************************************************/
+/*!
+ *  \file   bench_main.c
+ *
+ *  \brief  Linux host entry point for the microbenchmarks (bench/bench.h).
+ *
+ *  The cases run before any scheduler starts, on the calling thread, the same way the
+ *  BENCH=1 target build runs them from App_Init().
+ *
+ *  Usage: max_firmware_bench [-j] [-n iterations]
+ *    -j  print the JSON report (default: text table)
+ *    -n  calls per run (default 100000)
+ */
+/*************************************************************************************************/
+
+#include "bench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/**************************************************************************************************
+  Macros
+**************************************************************************************************/
+
+/* A run of the cheap cases takes microseconds at the target default; a desktop OS needs
+ * longer runs for the fastest one to be repeatable */
+#define HOST_BENCH_ITERATIONS 100000
+
+/**************************************************************************************************
+  Public Functions
+**************************************************************************************************/
+
+/*************************************************************************************************/
+int main(int argc, char **argv)
+{
+    BenchOutput_t output = BENCH_OUT_TEXT;
+    uint32_t iterations = HOST_BENCH_ITERATIONS;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "jn:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'j':
+            output = BENCH_OUT_JSON;
+            break;
+        case 'n':
+            iterations = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-j] [-n iterations]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    Bench_RunAll(iterations, output);
+
+    return 0;
+}
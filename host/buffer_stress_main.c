@@ -0,0 +1,311 @@
+/*************************************************************************************************/
+/*!
+ *  \file   buffer_stress_main.c
+ *
+ *  \brief  Producer/consumer stress test of the offline buffer on the FreeRTOS POSIX port.
+ *
+ *  A producer task pushes numbered lap events with Buffer_Push() while a consumer task at
+ *  the same priority takes them back through Buffer_Pop() and Buffer_PeekSpan() with full
+ *  and partial Buffer_Commit() calls, the way BleTx_FlushBuffer() does. Time slicing
+ *  switches between the two at any instruction, so every index update in the buffer and
+ *  the event log underneath it races the other side millions of times.
+ *
+ *  The consumer checks that the numbers come back in order: a number skipped is a lost
+ *  event, one seen again a duplicate. A push refused because the log is full is retried,
+ *  so every event must arrive exactly once. Every 64th event is a stop, which makes the
+ *  producer program its staged records (EventLog_Sync()) in the middle of the run.
+ *
+ *  Usage: max_firmware_stress [-n events] [-s seed]
+ *    -n  events to pass through the buffer (default 2000000)
+ *    -s  seed for the consumer's batch sizes (default 1)
+ *
+ *  Exits 0 if every event arrived exactly once and in order, 1 otherwise.
+ */
+/*************************************************************************************************/
+
+#include "buffer.h"
+#include "event_log.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/**************************************************************************************************
+  Macros
+**************************************************************************************************/
+
+#define STRESS_DEFAULT_EVENTS 2000000UL
+#define STRESS_SYNC_EVERY 64            /* Every Nth event is a stop, which syncs the log */
+#define STRESS_MAX_SPAN 16              /* Largest Buffer_PeekSpan() the consumer asks for */
+#define STRESS_REPORT_LIMIT 8           /* Individual losses/duplicates printed */
+
+#define STRESS_TASK_STACK_SIZE 512
+#define STRESS_TASK_PRIORITY (tskIDLE_PRIORITY + 1) /* Same for both, so they time-slice */
+
+/**************************************************************************************************
+  Static Memory for FreeRTOS Objects
+**************************************************************************************************/
+
+static StaticTask_t s_producerTaskBuffer;
+static StackType_t s_producerTaskStack[STRESS_TASK_STACK_SIZE];
+
+static StaticTask_t s_consumerTaskBuffer;
+static StackType_t s_consumerTaskStack[STRESS_TASK_STACK_SIZE];
+
+/**************************************************************************************************
+  Local Variables
+**************************************************************************************************/
+
+static uint32_t s_events = STRESS_DEFAULT_EVENTS;
+static uint32_t s_seed = 1;
+
+/* Set by the producer once its last event is in the log */
+static atomic_bool s_producerDone;
+
+/* Producer side */
+static uint32_t s_fullRetries = 0;
+
+/* Consumer side */
+static uint32_t s_next = 0;             /* Number expected next */
+static uint32_t s_lost = 0;
+static uint32_t s_duplicated = 0;
+static uint32_t s_reported = 0;
+static uint32_t s_pops = 0;
+static uint32_t s_spans = 0;
+
+/**************************************************************************************************
+  Local Functions
+**************************************************************************************************/
+
+/*************************************************************************************************/
+static uint64_t wallNowMs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  xorshift32: cheap, and private to the consumer so the run is repeatable per seed.
+ */
+/*************************************************************************************************/
+static uint32_t nextRandom(uint32_t *pState)
+{
+    uint32_t x = *pState;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *pState = x;
+
+    return x;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Check one event taken from the buffer against the number expected next.
+ */
+/*************************************************************************************************/
+static void checkEvent(const WorkoutEvent_t *pEvent)
+{
+    uint32_t n = (uint32_t)pEvent->timestamp_ms;
+
+    if (n == s_next)
+    {
+        s_next++;
+        return;
+    }
+
+    if (s_reported < STRESS_REPORT_LIMIT)
+    {
+        fprintf(stderr, "[STRESS] Expected event %lu, got %lu\n", (unsigned long)s_next,
+                (unsigned long)n);
+        s_reported++;
+    }
+
+    if (n > s_next)
+    {
+        s_lost += n - s_next;
+        s_next = n + 1;
+    }
+    else
+    {
+        s_duplicated++;
+    }
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Producer: push s_events numbered events, retrying while the log is full.
+ */
+/*************************************************************************************************/
+static void producerTask(void *pvParameters)
+{
+    WorkoutEvent_t event;
+    uint32_t n;
+
+    (void)pvParameters;
+
+    memset(&event, 0, sizeof(event));
+
+    for (n = 0; n < s_events; n++)
+    {
+        /* The last event is a stop too, so nothing is left staged at the end */
+        event.type = ((n % STRESS_SYNC_EVERY) == STRESS_SYNC_EVERY - 1 || n == s_events - 1)
+                         ? EVENT_WORKOUT_STOP
+                         : EVENT_LAP_COMPLETE;
+        event.timestamp_ms = n;
+        event.lap_data.lap_number = (uint8_t)n;
+
+        while (!Buffer_Push(&event))
+        {
+            s_fullRetries++;
+            taskYIELD();
+        }
+    }
+
+    atomic_store(&s_producerDone, true);
+    vTaskSuspend(NULL);
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Consumer: take events back with pops and with spans of random size and commit
+ *          length, until the producer is done and the buffer is empty. Then report and exit.
+ */
+/*************************************************************************************************/
+static void consumerTask(void *pvParameters)
+{
+    const WorkoutEvent_t *pEvents[STRESS_MAX_SPAN];
+    WorkoutEvent_t event;
+    EventLogStats_t log;
+    uint32_t rng = s_seed;
+    uint64_t wallStart = wallNowMs();
+    uint64_t wallMs;
+    uint16_t count;
+    uint16_t commit;
+    uint16_t i;
+    bool done;
+    bool ok;
+
+    (void)pvParameters;
+
+    while (1)
+    {
+        /* Read the flag first: once set, an empty buffer really is the end */
+        done = atomic_load(&s_producerDone);
+
+        if ((nextRandom(&rng) & 3) == 0)
+        {
+            if (Buffer_Pop(&event))
+            {
+                s_pops++;
+                checkEvent(&event);
+                continue;
+            }
+        }
+        else
+        {
+            count = Buffer_PeekSpan(pEvents, (uint16_t)(1 + nextRandom(&rng) % STRESS_MAX_SPAN));
+            if (count > 0)
+            {
+                /* Commit all of the span, or only its head as a failed send would */
+                commit = (nextRandom(&rng) & 1) ? count : (uint16_t)(1 + nextRandom(&rng) % count);
+                for (i = 0; i < commit; i++)
+                {
+                    checkEvent(pEvents[i]);
+                }
+                Buffer_Commit(commit);
+                s_spans++;
+                continue;
+            }
+        }
+
+        if (done)
+        {
+            break;
+        }
+
+        taskYIELD();
+    }
+
+    wallMs = wallNowMs() - wallStart;
+    EventLog_GetStats(&log);
+
+    /* Anything never seen after the last event received is lost too */
+    if (s_next < s_events)
+    {
+        s_lost += s_events - s_next;
+    }
+
+    ok = (s_lost == 0 && s_duplicated == 0 && log.corrupt == 0 && log.flashErrors == 0 &&
+          Buffer_IsEmpty());
+
+    printf("[STRESS] %lu events in %llu ms: %lu pops, %lu spans, %lu full retries, "
+           "%lu page erases\n",
+           (unsigned long)s_events, (unsigned long long)wallMs, (unsigned long)s_pops,
+           (unsigned long)s_spans, (unsigned long)s_fullRetries,
+           (unsigned long)log.pageErases);
+    printf("[STRESS] lost %lu, duplicated %lu, corrupt %lu, flash errors %lu: %s\n",
+           (unsigned long)s_lost, (unsigned long)s_duplicated, (unsigned long)log.corrupt,
+           (unsigned long)log.flashErrors, ok ? "PASS" : "FAIL");
+    fflush(stdout);
+
+    exit(ok ? 0 : 1);
+}
+
+/**************************************************************************************************
+  Public Functions
+**************************************************************************************************/
+
+/*************************************************************************************************/
+int main(int argc, char **argv)
+{
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:s:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            s_events = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 's':
+            s_seed = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        default:
+            optind = argc + 1;
+            break;
+        }
+    }
+
+    if (optind != argc || s_events == 0 || s_seed == 0)
+    {
+        fprintf(stderr, "usage: %s [-n events] [-s seed]\n", argv[0]);
+        return 2;
+    }
+
+    Buffer_Init();
+
+    if (xTaskCreateStatic(producerTask, "Producer", STRESS_TASK_STACK_SIZE, NULL,
+                          STRESS_TASK_PRIORITY, s_producerTaskStack,
+                          &s_producerTaskBuffer) == NULL ||
+        xTaskCreateStatic(consumerTask, "Consumer", STRESS_TASK_STACK_SIZE, NULL,
+                          STRESS_TASK_PRIORITY, s_consumerTaskStack,
+                          &s_consumerTaskBuffer) == NULL)
+    {
+        fprintf(stderr, "ERROR: Task creation failed\n");
+        return 1;
+    }
+
+    vTaskStartScheduler();
+
+    fprintf(stderr, "ERROR: FreeRTOS did not start\n");
+    return 1;
+}
@@ -0,0 +1,451 @@
+/*************************************************************************************************/
+/*!
+ *  \file   cmdfuzz_main.c
+ *
+ *  \brief  Fuzzes the RX command parser (comms/cmd_parser.h) under ASan and UBSan.
+ *
+ *  First a set of known writes must parse to the expected commands, so the parser is
+ *  checked for what it accepts as well as for what it survives. Then random payloads of
+ *  1 to CUSTOM_MAX_DATA_LEN bytes go through CmdParser_Parse(), in four shapes:
+ *  - JSON-shaped: tokens of the command format ("cmd", "arg", names, digits, punctuation,
+ *    escapes) in random order;
+ *  - binary-shaped: a frame header and records whose length bytes are mostly right;
+ *  - mutated: a known write with bytes flipped, inserted, deleted or cut off;
+ *  - random bytes.
+ *
+ *  Each payload sits at the very end of a heap block of its exact size, so reading one
+ *  byte past it is an ASan fault. Every parse is also checked for:
+ *  - as many handler calls as the return value says, with valid command ids;
+ *  - cost within the documented bound: payload bytes plus one pass over the command table.
+ *
+ *  Usage: max_firmware_cmdfuzz [-n payloads] [-s seed]
+ *    -n  random payloads (default 2000000)
+ *    -s  generator seed (default 1)
+ *
+ *  Exits 0 if every check passes; 1 on a failed check. A sanitizer fault aborts the run.
+ */
+/*************************************************************************************************/
+
+#include "cmd_parser.h"
+#include "protocol.h"
+#include "ble_uuid.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**************************************************************************************************
+  Macros
+**************************************************************************************************/
+
+#define FUZZ_DEFAULT_PAYLOADS 2000000UL
+#define FUZZ_MAX_CALLS 32               /* Handler calls recorded per payload */
+#define FUZZ_REPORT_LIMIT 8             /* Individual failures printed */
+
+/* Commands a payload can cost the parser beyond one step per byte: one table lookup */
+#define FUZZ_STEP_SLACK (CMD_COUNT - 1)
+
+#define FUZZ_ARRAY_LEN(a) (sizeof(a) / sizeof((a)[0]))
+
+/**************************************************************************************************
+  Data Types
+**************************************************************************************************/
+
+/*! A write and the commands it must produce */
+typedef struct
+{
+    const char *pName;
+    const uint8_t *pData;
+    uint16_t len;
+    uint8_t count;
+    Cmd_t cmds[3];
+} FuzzKnown_t;
+
+/*! Handler calls seen for one payload */
+typedef struct
+{
+    uint8_t count;
+    Cmd_t cmds[FUZZ_MAX_CALLS];
+} FuzzCalls_t;
+
+/**************************************************************************************************
+  Local Variables
+**************************************************************************************************/
+
+#define FUZZ_JSON(s) (const uint8_t *)(s), sizeof(s) - 1
+
+static const uint8_t s_binStartModeSync[] = {
+    PROTOCOL_FRAME_HDR,
+    0x01, CMD_START,
+    0x02, CMD_MODE, 0x03,
+    0x03, CMD_TIME_SYNC, 0xAC, 0x02,    /* 300 */
+};
+
+static const uint8_t s_binBadLen[] = { PROTOCOL_FRAME_HDR, 0x05, CMD_LAP };
+
+static const uint8_t s_binUnknownThenStop[] = {
+    PROTOCOL_FRAME_HDR,
+    0x01, 0x7F,
+    0x01, CMD_STOP,
+};
+
+static const FuzzKnown_t s_known[] = {
+    { "json mode", FUZZ_JSON("{\"cmd\":\"mode\",\"arg\":2}"), 1, { { CMD_MODE, 2 } } },
+    { "json spaces, arg first", FUZZ_JSON(" { \"arg\" : 5 ,\t\"cmd\" : \"sync_since\" } "), 1,
+      { { CMD_SYNC_SINCE, 5 } } },
+    { "json other keys", FUZZ_JSON("{\"cmd\":\"start\",\"x\":true,\"y\":\"a\\\"b\",\"z\":-1.5}"),
+      1, { { CMD_START, 0 } } },
+    { "json hr_done", FUZZ_JSON("{\"cmd\":\"hr_done\"}"), 1, { { CMD_HR_DONE, 0 } } },
+    { "json 64-bit arg", FUZZ_JSON("{\"cmd\":\"time_sync\",\"arg\":1700000000123}"), 1,
+      { { CMD_TIME_SYNC, 1700000000123ULL } } },
+    { "json unknown name", FUZZ_JSON("{\"cmd\":\"nope\"}"), 0, { { CMD_NONE, 0 } } },
+    { "json truncated", FUZZ_JSON("{\"cmd\":\"lap\""), 0, { { CMD_NONE, 0 } } },
+    { "json nested", FUZZ_JSON("{\"cmd\":\"lap\",\"x\":{}}"), 0, { { CMD_NONE, 0 } } },
+    { "json arg overflow", FUZZ_JSON("{\"cmd\":\"mode\",\"arg\":99999999999999999999}"), 0,
+      { { CMD_NONE, 0 } } },
+    { "binary three records", s_binStartModeSync, sizeof(s_binStartModeSync), 3,
+      { { CMD_START, 0 }, { CMD_MODE, 3 }, { CMD_TIME_SYNC, 300 } } },
+    { "binary bad length", s_binBadLen, sizeof(s_binBadLen), 0, { { CMD_NONE, 0 } } },
+    { "binary unknown opcode", s_binUnknownThenStop, sizeof(s_binUnknownThenStop), 1,
+      { { CMD_STOP, 0 } } },
+};
+
+/* Pieces JSON-shaped payloads are built from */
+static const char *const s_jsonTokens[] = {
+    "{", "}", "\"", ":", ",", " ", "\t", "\\", "\\\"", "[", "]",
+    "\"cmd\"", "\"arg\"", "\"x\"", "\"\"",
+    "\"hr_done\"", "\"start\"", "\"lap\"", "\"stop\"", "\"mode\"", "\"time_sync\"",
+    "\"sync_since\"", "\"fmt_bin\"", "\"fmt_json\"", "\"lapx\"",
+    "0", "7", "42", "18446744073709551615", "99999999999999999999", "-1", "1.5",
+    "true", "null",
+};
+
+static uint32_t s_rng;
+static FuzzCalls_t s_calls;
+static uint32_t s_failures = 0;
+
+/**************************************************************************************************
+  Local Functions
+**************************************************************************************************/
+
+/*************************************************************************************************/
+static uint32_t nextRandom(void)
+{
+    uint32_t x = s_rng;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    s_rng = x;
+
+    return x;
+}
+
+/*************************************************************************************************/
+static void recordCall(const Cmd_t *pCmd, void *pCtx)
+{
+    FuzzCalls_t *pCalls = (FuzzCalls_t *)pCtx;
+
+    if (pCalls->count < FUZZ_MAX_CALLS)
+    {
+        pCalls->cmds[pCalls->count] = *pCmd;
+    }
+    pCalls->count++;
+}
+
+/*************************************************************************************************/
+static void fail(const char *pWhat, const uint8_t *pData, uint16_t len)
+{
+    uint16_t i;
+
+    if (s_failures++ >= FUZZ_REPORT_LIMIT)
+    {
+        return;
+    }
+
+    fprintf(stderr, "[FUZZ] FAIL: %s, payload (%u bytes):", pWhat, (unsigned)len);
+    for (i = 0; i < len; i++)
+    {
+        fprintf(stderr, " %02x", pData[i]);
+    }
+    fprintf(stderr, "\n");
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Parse a payload from an exactly-sized heap copy and check the invariants.
+ *
+ *  \return Number of commands dispatched.
+ */
+/*************************************************************************************************/
+static uint8_t parseChecked(const uint8_t *pData, uint16_t len)
+{
+    CmdParserStats_t before;
+    CmdParserStats_t after;
+    uint8_t *pCopy = malloc(len);
+    uint8_t count;
+    uint8_t i;
+
+    if (pCopy == NULL)
+    {
+        fprintf(stderr, "[FUZZ] Out of memory\n");
+        exit(1);
+    }
+    memcpy(pCopy, pData, len);
+
+    s_calls.count = 0;
+    CmdParser_GetStats(&before);
+    count = CmdParser_Parse(pCopy, len, recordCall, &s_calls);
+    CmdParser_GetStats(&after);
+
+    if (count != s_calls.count || after.commands - before.commands != count)
+    {
+        fail("return value, handler calls and command counter disagree", pData, len);
+    }
+
+    for (i = 0; i < count && i < FUZZ_MAX_CALLS; i++)
+    {
+        if (s_calls.cmds[i].id == CMD_NONE || s_calls.cmds[i].id >= CMD_COUNT)
+        {
+            fail("handler called with an invalid command id", pData, len);
+        }
+    }
+
+    /* maxSteps only grows, so a parse that went over the bound shows up here */
+    if (after.maxSteps > before.maxSteps && after.maxSteps > len + FUZZ_STEP_SLACK)
+    {
+        fail("cost above payload length plus one table lookup", pData, len);
+    }
+
+    free(pCopy);
+    return count;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Check every known write.
+ */
+/*************************************************************************************************/
+static void runKnown(void)
+{
+    const FuzzKnown_t *pK;
+    size_t k;
+    uint8_t i;
+
+    for (k = 0; k < FUZZ_ARRAY_LEN(s_known); k++)
+    {
+        pK = &s_known[k];
+
+        if (parseChecked(pK->pData, pK->len) != pK->count)
+        {
+            fprintf(stderr, "[FUZZ] Known write \"%s\": %u commands, expected %u\n",
+                    pK->pName, (unsigned)s_calls.count, (unsigned)pK->count);
+            s_failures++;
+            continue;
+        }
+
+        for (i = 0; i < pK->count; i++)
+        {
+            if (s_calls.cmds[i].id != pK->cmds[i].id || s_calls.cmds[i].arg != pK->cmds[i].arg)
+            {
+                fprintf(stderr, "[FUZZ] Known write \"%s\": command %u is %s/%llu, expected "
+                                "%s/%llu\n",
+                        pK->pName, (unsigned)i, CmdParser_Name(s_calls.cmds[i].id),
+                        (unsigned long long)s_calls.cmds[i].arg, CmdParser_Name(pK->cmds[i].id),
+                        (unsigned long long)pK->cmds[i].arg);
+                s_failures++;
+            }
+        }
+    }
+}
+
+/*************************************************************************************************/
+static uint16_t makeJson(uint8_t *pBuf, uint16_t max)
+{
+    const char *pTok;
+    uint16_t len = 0;
+    size_t tokLen;
+
+    while (len < max)
+    {
+        pTok = s_jsonTokens[nextRandom() % FUZZ_ARRAY_LEN(s_jsonTokens)];
+        tokLen = strlen(pTok);
+        if (len + tokLen > max || (nextRandom() % 24) == 0)
+        {
+            break;
+        }
+        memcpy(&pBuf[len], pTok, tokLen);
+        len += (uint16_t)tokLen;
+    }
+
+    return len;
+}
+
+/*************************************************************************************************/
+static uint16_t makeBinary(uint8_t *pBuf, uint16_t max)
+{
+    uint16_t len = 1;
+    uint16_t recLen;
+    uint16_t i;
+
+    pBuf[0] = PROTOCOL_FRAME_HDR;
+
+    while (len < max && (nextRandom() % 8) != 0)
+    {
+        recLen = 1 + nextRandom() % 12;
+
+        /* Mostly a length byte that matches the record, sometimes one that does not */
+        pBuf[len++] = ((nextRandom() % 8) == 0) ? (uint8_t)nextRandom() : (uint8_t)recLen;
+
+        for (i = 0; i < recLen && len < max; i++)
+        {
+            /* Opcode in range, then varint bytes with the continuation bit set at random */
+            pBuf[len++] = (i == 0) ? (uint8_t)(nextRandom() % (CMD_COUNT + 2))
+                                   : (uint8_t)nextRandom();
+        }
+    }
+
+    return len;
+}
+
+/*************************************************************************************************/
+static uint16_t makeMutated(uint8_t *pBuf, uint16_t max)
+{
+    const FuzzKnown_t *pK = &s_known[nextRandom() % FUZZ_ARRAY_LEN(s_known)];
+    uint16_t len = pK->len;
+    uint16_t edits = 1 + nextRandom() % 4;
+    uint16_t pos;
+
+    memcpy(pBuf, pK->pData, len);
+
+    while (edits-- > 0 && len > 0)
+    {
+        pos = nextRandom() % len;
+
+        switch (nextRandom() % 4)
+        {
+        case 0:
+            pBuf[pos] ^= (uint8_t)(1u << (nextRandom() % 8));
+            break;
+        case 1:
+            if (len < max)
+            {
+                memmove(&pBuf[pos + 1], &pBuf[pos], len - pos);
+                pBuf[pos] = (uint8_t)nextRandom();
+                len++;
+            }
+            break;
+        case 2:
+            memmove(&pBuf[pos], &pBuf[pos + 1], len - pos - 1);
+            len--;
+            break;
+        default:
+            len = pos;
+            break;
+        }
+    }
+
+    return len;
+}
+
+/*************************************************************************************************/
+static uint16_t makeRandom(uint8_t *pBuf, uint16_t max)
+{
+    uint16_t len = 1 + nextRandom() % max;
+    uint16_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        pBuf[i] = (uint8_t)nextRandom();
+    }
+
+    return len;
+}
+
+/**************************************************************************************************
+  Public Functions
+**************************************************************************************************/
+
+/*************************************************************************************************/
+int main(int argc, char **argv)
+{
+    static const char *const shapeNames[] = { "JSON-shaped", "binary-shaped", "mutated",
+                                              "random" };
+    uint8_t payload[CUSTOM_MAX_DATA_LEN];
+    uint32_t shapeCount[4] = { 0 };
+    unsigned long payloads = FUZZ_DEFAULT_PAYLOADS;
+    unsigned long n;
+    CmdParserStats_t stats;
+    uint16_t len;
+    uint8_t shape;
+    int opt;
+
+    s_rng = 1;
+
+    while ((opt = getopt(argc, argv, "n:s:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            payloads = strtoul(optarg, NULL, 0);
+            break;
+        case 's':
+            s_rng = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        default:
+            optind = argc + 1;
+            break;
+        }
+    }
+
+    if (optind != argc || s_rng == 0)
+    {
+        fprintf(stderr, "usage: %s [-n payloads] [-s seed]\n", argv[0]);
+        return 2;
+    }
+
+    runKnown();
+
+    for (n = 0; n < payloads; n++)
+    {
+        shape = (uint8_t)(nextRandom() % 4);
+
+        switch (shape)
+        {
+        case 0:
+            len = makeJson(payload, sizeof(payload));
+            break;
+        case 1:
+            len = makeBinary(payload, sizeof(payload));
+            break;
+        case 2:
+            len = makeMutated(payload, sizeof(payload));
+            break;
+        default:
+            len = makeRandom(payload, sizeof(payload));
+            break;
+        }
+
+        if (len == 0)
+        {
+            continue;       /* A mutation cut it to nothing; the parser rejects that up front */
+        }
+
+        shapeCount[shape]++;
+        parseChecked(payload, len);
+    }
+
+    CmdParser_GetStats(&stats);
+
+    printf("[FUZZ] %lu payloads (%lu %s, %lu %s, %lu %s, %lu %s)\n",
+           (unsigned long)(shapeCount[0] + shapeCount[1] + shapeCount[2] + shapeCount[3]),
+           (unsigned long)shapeCount[0], shapeNames[0], (unsigned long)shapeCount[1],
+           shapeNames[1], (unsigned long)shapeCount[2], shapeNames[2],
+           (unsigned long)shapeCount[3], shapeNames[3]);
+    printf("[FUZZ] %lu commands, %lu unknown, %lu malformed, max %u steps: %s\n",
+           (unsigned long)stats.commands, (unsigned long)stats.unknown,
+           (unsigned long)stats.errors, (unsigned)stats.maxSteps,
+           (s_failures == 0) ? "PASS" : "FAIL");
+
+    return (s_failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,66 @@
+/*************************************************************************************************/
+/*!
+ *  \file   freertos_hooks.c
+ *
+ *  \brief  FreeRTOS application hooks for the host programs - FULLY STATIC ALLOCATION.
+ */
+/*************************************************************************************************/
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/**************************************************************************************************
+  Macros
+**************************************************************************************************/
+
+#define HOST_IDLE_SLEEP_US 1000 /* Keep the idle thread from spinning a core */
+
+/**************************************************************************************************
+  Static Memory for FreeRTOS Objects
+**************************************************************************************************/
+
+static StaticTask_t s_idleTaskTCB;
+static StackType_t s_idleTaskStack[configMINIMAL_STACK_SIZE];
+
+static StaticTask_t s_timerTaskTCB;
+static StackType_t s_timerTaskStack[configTIMER_TASK_STACK_DEPTH];
+
+/**************************************************************************************************
+  FreeRTOS Hooks
+**************************************************************************************************/
+
+/*************************************************************************************************/
+void vAssertCalled(const char *const pcFileName, uint32_t ulLine)
+{
+    fprintf(stderr, "ASSERT: %s:%lu\n", pcFileName, (unsigned long)ulLine);
+    abort();
+}
+
+/*************************************************************************************************/
+void vApplicationIdleHook(void)
+{
+    usleep(HOST_IDLE_SLEEP_US);
+}
+
+/*************************************************************************************************/
+void vApplicationGetIdleTaskMemory(StaticTask_t **ppxIdleTaskTCBBuffer,
+                                   StackType_t **ppxIdleTaskStackBuffer,
+                                   uint32_t *pulIdleTaskStackSize)
+{
+    *ppxIdleTaskTCBBuffer = &s_idleTaskTCB;
+    *ppxIdleTaskStackBuffer = s_idleTaskStack;
+    *pulIdleTaskStackSize = configMINIMAL_STACK_SIZE;
+}
+
+/*************************************************************************************************/
+void vApplicationGetTimerTaskMemory(StaticTask_t **ppxTimerTaskTCBBuffer,
+                                    StackType_t **ppxTimerTaskStackBuffer,
+                                    uint32_t *pulTimerTaskStackSize)
+{
+    *ppxTimerTaskTCBBuffer = &s_timerTaskTCB;
+    *ppxTimerTaskStackBuffer = s_timerTaskStack;
+    *pulTimerTaskStackSize = configTIMER_TASK_STACK_DEPTH;
+}
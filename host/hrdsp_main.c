@@ -0,0 +1,430 @@
+/*************************************************************************************************/
+/*!
+ *  \file   hrdsp_main.c
+ *
+ *  \brief  Feeds PPG traces through the heart rate pipeline (input/hr_dsp.h) and scores it.
+ *
+ *  Each trace runs through HrDsp_Process() in SENSOR_FIFO_BLOCK_SAMPLES blocks, as the
+ *  sensor task delivers them. After every block the result is compared with the trace's
+ *  references; the report gives, per trace, the mean and worst absolute BPM error over
+ *  the valid results, the share of blocks with a valid result, the time to the first one,
+ *  the mean absolute SpO2 error and quality over the results that have an SpO2, and the
+ *  pipeline cost in ns per sample (host CPU; the target cost in cycles comes from the
+ *  hr_dsp_block case of the microbenchmarks).
+ *
+ *  Trace file: one sample per line at 100 Hz, "<red> <ir> [<ref_bpm> [<ref_spo2>]]" in ADC
+ *  counts and percent; a reference of 0 or none means unknown and is not scored. '#' starts
+ *  a comment.
+ *
+ *  Synthetic trace (-s): 60 s of a two-wave pulse on a 120000-count IR baseline with
+ *  breathing wander, +-3% beat-to-beat variation and noise; deterministic for a given BPM.
+ *  The red channel has its own baseline and a pulse sized for a ratio of ratios of
+ *  HRDSP_SYN_RATIO; its reference SpO2 is that ratio on the pipeline's calibration curve.
+ *
+ *  Usage: max_firmware_hrdsp [-e max_error_bpm] [-p max_error_spo2] [-s bpm[,bpm...]]
+ *                            [trace...]
+ *    -e  fail (exit 1) if a trace's mean BPM error exceeds this (default 3)
+ *    -p  fail (exit 1) if a trace's mean SpO2 error exceeds this (default 2)
+ *    -s  score synthetic traces at these rates
+ */
+/*************************************************************************************************/
+
+#include "hr_dsp.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/**************************************************************************************************
+  Macros
+**************************************************************************************************/
+
+#define HRDSP_BLOCK_SAMPLES     17          /* SENSOR_FIFO_BLOCK_SAMPLES (sensor_task.h) */
+#define HRDSP_MAX_SAMPLES       (HR_DSP_SAMPLE_RATE_HZ * 60 * 30)  /* 30 min per trace */
+#define HRDSP_LINE_LEN          128
+#define HRDSP_DEFAULT_MAX_ERROR 3.0
+#define HRDSP_DEFAULT_MAX_SPO2_ERROR 2.0
+
+/* Synthetic trace */
+#define HRDSP_SYN_SECONDS       60
+#define HRDSP_SYN_BASELINE      120000.0
+#define HRDSP_SYN_PULSE         1500.0      /* Systolic dip, counts */
+#define HRDSP_SYN_WANDER        800.0       /* Breathing, counts at 0.25 Hz */
+#define HRDSP_SYN_NOISE         60.0        /* Uniform noise, +- counts */
+#define HRDSP_SYN_FIXED_BPM     75.0
+#define HRDSP_SYN_RED_BASELINE  90000.0
+#define HRDSP_SYN_RATIO         0.6         /* (AC_red / DC_red) / (AC_ir / DC_ir) */
+
+/**************************************************************************************************
+  Data Types
+**************************************************************************************************/
+
+typedef struct
+{
+    PpgSample_t sample;
+    float refBpm;       /* 0 = unknown */
+    float refSpo2;      /* 0 = unknown */
+} HrdspPoint_t;
+
+typedef struct
+{
+    double bpmError;    /* Mean absolute, -1 if nothing was scored */
+    double spo2Error;   /* Mean absolute, -1 if nothing was scored */
+} HrdspScore_t;
+
+/**************************************************************************************************
+  Local Variables
+**************************************************************************************************/
+
+static HrdspPoint_t s_trace[HRDSP_MAX_SAMPLES];
+static uint32_t s_traceLen;
+
+static uint32_t s_noiseState;
+
+/**************************************************************************************************
+  Local Functions
+**************************************************************************************************/
+
+/*************************************************************************************************/
+static uint64_t nowNs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Uniform in [-1, 1), from a fixed LCG so the trace is the same on every host.
+ */
+/*************************************************************************************************/
+static double noise(void)
+{
+    s_noiseState = s_noiseState * 1664525u + 1013904223u;
+    return (double)(s_noiseState >> 8) / (double)(1u << 23) - 1.0;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Fill s_trace with a synthetic recording at bpm.
+ */
+/*************************************************************************************************/
+static void makeSynthetic(double bpm)
+{
+    double beatStart = 0.0;
+    double beatLen = 60.0 / bpm;
+    double r = HRDSP_SYN_RATIO;
+    double redPulse = HRDSP_SYN_RATIO * HRDSP_SYN_PULSE / HRDSP_SYN_BASELINE *
+                      HRDSP_SYN_RED_BASELINE;
+    uint32_t i;
+
+    s_noiseState = (uint32_t)(bpm * 1000.0);
+    s_traceLen = HRDSP_SYN_SECONDS * HR_DSP_SAMPLE_RATE_HZ;
+
+    for (i = 0; i < s_traceLen; i++)
+    {
+        double t = (double)i / HR_DSP_SAMPLE_RATE_HZ;
+        double phase;
+        double pulse;
+        double wander;
+        double ir;
+        double red;
+
+        while (t >= beatStart + beatLen)
+        {
+            beatStart += beatLen;
+            beatLen = 60.0 / bpm * (1.0 + 0.03 * noise());
+        }
+
+        /* Systolic wave and a smaller diastolic one; their timing scales with the beat
+         * above HRDSP_SYN_FIXED_BPM and stays put below it, as systole does */
+        phase = (t - beatStart) / fmin(beatLen, 60.0 / HRDSP_SYN_FIXED_BPM);
+        pulse = exp(-pow((phase - 0.15) / 0.08, 2.0)) +
+                0.35 * exp(-pow((phase - 0.45) / 0.10, 2.0));
+
+        wander = sin(2.0 * M_PI * 0.25 * t);
+        ir = HRDSP_SYN_BASELINE - HRDSP_SYN_PULSE * pulse + HRDSP_SYN_WANDER * wander +
+             HRDSP_SYN_NOISE * noise();
+        red = HRDSP_SYN_RED_BASELINE - redPulse * pulse +
+              HRDSP_SYN_WANDER * HRDSP_SYN_RED_BASELINE / HRDSP_SYN_BASELINE * wander +
+              HRDSP_SYN_NOISE * noise();
+
+        s_trace[i].sample.ir = (uint32_t)ir;
+        s_trace[i].sample.red = (uint32_t)red;
+        s_trace[i].refBpm = (float)bpm;
+        s_trace[i].refSpo2 = (float)(-45.060 * r * r + 30.354 * r + 94.845);
+    }
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Load a trace file into s_trace.
+ *
+ *  \return true if it has at least one sample.
+ */
+/*************************************************************************************************/
+static bool loadTrace(const char *pPath)
+{
+    char line[HRDSP_LINE_LEN];
+    unsigned long red;
+    unsigned long ir;
+    float ref;
+    float refSpo2;
+    unsigned int lineNo = 0;
+    char *pHash;
+    int fields;
+    bool ok = true;
+    FILE *pFile = fopen(pPath, "r");
+
+    if (pFile == NULL)
+    {
+        perror(pPath);
+        return false;
+    }
+
+    s_traceLen = 0;
+
+    while (fgets(line, sizeof(line), pFile) != NULL)
+    {
+        lineNo++;
+
+        if ((pHash = strchr(line, '#')) != NULL)
+        {
+            *pHash = '\0';
+        }
+
+        ref = 0.0f;
+        refSpo2 = 0.0f;
+        fields = sscanf(line, "%lu %lu %f %f", &red, &ir, &ref, &refSpo2);
+        if (fields <= 0)
+        {
+            continue; /* Blank or comment */
+        }
+
+        if (fields < 2)
+        {
+            fprintf(stderr, "%s:%u: expected \"<red> <ir> [<ref_bpm> [<ref_spo2>]]\"\n", pPath, lineNo);
+            ok = false;
+            break;
+        }
+
+        if (s_traceLen >= HRDSP_MAX_SAMPLES)
+        {
+            fprintf(stderr, "%s:%u: more than %d samples\n", pPath, lineNo, HRDSP_MAX_SAMPLES);
+            ok = false;
+            break;
+        }
+
+        s_trace[s_traceLen].sample.red = (uint32_t)red;
+        s_trace[s_traceLen].sample.ir = (uint32_t)ir;
+        s_trace[s_traceLen].refBpm = ref;
+        s_trace[s_traceLen].refSpo2 = refSpo2;
+        s_traceLen++;
+    }
+
+    fclose(pFile);
+
+    if (ok && s_traceLen == 0)
+    {
+        fprintf(stderr, "%s: no samples\n", pPath);
+        ok = false;
+    }
+
+    return ok;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Run s_trace through the pipeline and print one report line.
+ *
+ *  \return Mean absolute errors of the referenced results.
+ */
+/*************************************************************************************************/
+static HrdspScore_t scoreTrace(const char *pName)
+{
+    HrdspScore_t score;
+    PpgSample_t block[HRDSP_BLOCK_SAMPLES];
+    HrDspResult_t result;
+    uint32_t blocks = 0;
+    uint32_t validBlocks = 0;
+    uint32_t scored = 0;
+    uint32_t firstValid = 0;
+    double errSum = 0.0;
+    double errMax = 0.0;
+    uint32_t spo2Scored = 0;
+    double spo2ErrSum = 0.0;
+    double qualitySum = 0.0;
+    uint64_t ns = 0;
+    uint64_t start;
+    uint32_t pos;
+    uint16_t n;
+    uint16_t i;
+
+    HrDsp_Init();
+
+    for (pos = 0; pos < s_traceLen; pos += n)
+    {
+        n = (s_traceLen - pos < HRDSP_BLOCK_SAMPLES) ? (uint16_t)(s_traceLen - pos)
+                                                     : HRDSP_BLOCK_SAMPLES;
+        for (i = 0; i < n; i++)
+        {
+            block[i] = s_trace[pos + i].sample;
+        }
+
+        start = nowNs();
+        HrDsp_Process(block, n);
+        ns += nowNs() - start;
+
+        HrDsp_GetResult(&result);
+        blocks++;
+
+        if (result.spo2 != 0 && s_trace[pos + n - 1].refSpo2 > 0.0f)
+        {
+            spo2ErrSum += fabs((double)result.spo2 - s_trace[pos + n - 1].refSpo2);
+            qualitySum += result.spo2Quality;
+            spo2Scored++;
+        }
+
+        if (!result.valid)
+        {
+            continue;
+        }
+
+        if (validBlocks++ == 0)
+        {
+            firstValid = pos + n;
+        }
+
+        if (s_trace[pos + n - 1].refBpm > 0.0f)
+        {
+            double err = fabs((double)result.bpm - s_trace[pos + n - 1].refBpm);
+
+            errSum += err;
+            errMax = (err > errMax) ? err : errMax;
+            scored++;
+        }
+    }
+
+    printf("%-24s %7lu %6.1f%% %7.2f %7.1f %9.1f %8.2f %7.1f %8.1f\n", pName,
+           (unsigned long)s_traceLen, 100.0 * validBlocks / blocks,
+           scored ? errSum / scored : 0.0, errMax,
+           validBlocks ? (double)firstValid / HR_DSP_SAMPLE_RATE_HZ : -1.0,
+           spo2Scored ? spo2ErrSum / spo2Scored : 0.0,
+           spo2Scored ? qualitySum / spo2Scored : 0.0, (double)ns / s_traceLen);
+
+    score.bpmError = scored ? errSum / scored : -1.0;
+    score.spo2Error = spo2Scored ? spo2ErrSum / spo2Scored : -1.0;
+    return score;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Score and judge one trace.
+ *
+ *  \return true if it passes.
+ */
+/*************************************************************************************************/
+static bool judge(const char *pName, double maxError, double maxSpo2Error)
+{
+    HrdspScore_t score = scoreTrace(pName);
+    bool ok = true;
+
+    if (score.bpmError < 0.0)
+    {
+        fprintf(stderr, "[HRDSP] %s: no valid result with a reference\n", pName);
+        return false;
+    }
+
+    if (score.bpmError > maxError)
+    {
+        fprintf(stderr, "[HRDSP] %s: mean error %.2f BPM exceeds %.2f\n", pName,
+                score.bpmError, maxError);
+        ok = false;
+    }
+
+    /* SpO2 is only judged where the trace has a reference for it */
+    if (score.spo2Error > maxSpo2Error)
+    {
+        fprintf(stderr, "[HRDSP] %s: mean SpO2 error %.2f%% exceeds %.2f\n", pName,
+                score.spo2Error, maxSpo2Error);
+        ok = false;
+    }
+
+    return ok;
+}
+
+/**************************************************************************************************
+  Public Functions
+**************************************************************************************************/
+
+/*************************************************************************************************/
+int main(int argc, char **argv)
+{
+    double maxError = HRDSP_DEFAULT_MAX_ERROR;
+    double maxSpo2Error = HRDSP_DEFAULT_MAX_SPO2_ERROR;
+    const char *pRates = NULL;
+    char name[HRDSP_LINE_LEN];
+    unsigned int failed = 0;
+    char *pNext;
+    double bpm;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "e:p:s:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'e':
+            maxError = strtod(optarg, NULL);
+            break;
+        case 'p':
+            maxSpo2Error = strtod(optarg, NULL);
+            break;
+        case 's':
+            pRates = optarg;
+            break;
+        default:
+            optind = argc + 1;
+            break;
+        }
+    }
+
+    if (optind > argc || (pRates == NULL && optind == argc))
+    {
+        fprintf(stderr,
+                "usage: %s [-e max_error_bpm] [-p max_error_spo2] [-s bpm[,bpm...]] [trace...]\n",
+                argv[0]);
+        return 2;
+    }
+
+    printf("%-24s %7s %7s %7s %7s %9s %8s %7s %8s\n", "trace", "samples", "valid", "err_avg",
+           "err_max", "first_s", "spo2_err", "quality", "ns/smp");
+
+    while (pRates != NULL && *pRates != '\0')
+    {
+        bpm = strtod(pRates, &pNext);
+        if (pNext == pRates || bpm < HR_DSP_MIN_BPM || bpm > HR_DSP_MAX_BPM)
+        {
+            fprintf(stderr, "[HRDSP] bad rate list '%s'\n", pRates);
+            return 2;
+        }
+        pRates = (*pNext == ',') ? pNext + 1 : pNext;
+
+        makeSynthetic(bpm);
+        snprintf(name, sizeof(name), "synthetic_%g", bpm);
+        failed += judge(name, maxError, maxSpo2Error) ? 0 : 1;
+    }
+
+    for (; optind < argc; optind++)
+    {
+        if (!loadTrace(argv[optind]))
+        {
+            return 2;
+        }
+        failed += judge(argv[optind], maxError, maxSpo2Error) ? 0 : 1;
+    }
+
+    return (failed > 0) ? 1 : 0;
+}
@@ -0,0 +1,145 @@
+/*************************************************************************************************/
+/*!
+ *  \file   main.c
+ *
+ *  \brief  Linux host entry point: the firmware task graph on the FreeRTOS POSIX port.
+ *
+ *  Starts the same tasks as app/app_init.c, with the keyboard test input enabled and the
+ *  MAX7325 and BLE link simulated. Notifications the firmware sends are printed.
+ *
+ *  Usage: max_firmware_host [-d] [-m mtu] [-c credits] [-i interval_ms] [-n]
+ *    -d  start disconnected (default: central connected, notifications enabled)
+ *    -m  ATT MTU of the simulated connection (default 247)
+ *    -c  notification credits (default 4)
+ *    -i  connection interval in ms (default 30)
+ *    -n  do not read keyboard input from stdin
+ */
+/*************************************************************************************************/
+
+#include "tasks.h"
+#include "max7325.h"
+#include "sim_ble.h"
+#include "sim_hw.h"
+#include "time_utils.h"
+#include "mxc_errors.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/**************************************************************************************************
+  Macros
+**************************************************************************************************/
+
+#define HOST_DEFAULT_MTU 247
+#define HOST_DEFAULT_CREDITS 4
+#define HOST_DEFAULT_CONN_INTERVAL_MS 30
+
+/**************************************************************************************************
+  Local Variables
+**************************************************************************************************/
+
+/*! Simulated MAX7325 input port: all buttons released (active low) */
+static uint8_t s_max7325Port = 0xFF;
+
+/**************************************************************************************************
+  Local Functions
+**************************************************************************************************/
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Simulated MAX7325 input port: reads return [port levels][transition flags].
+ */
+/*************************************************************************************************/
+static int max7325Device(void *pCtx, const uint8_t *pTx, unsigned int txLen, uint8_t *pRx,
+                         unsigned int rxLen)
+{
+    uint8_t *pPort = (uint8_t *)pCtx;
+
+    (void)pTx;
+    (void)txLen;
+
+    if (rxLen > 0)
+    {
+        pRx[0] = *pPort;
+    }
+    if (rxLen > 1)
+    {
+        pRx[1] = 0x00;
+    }
+
+    return E_NO_ERROR;
+}
+
+/**************************************************************************************************
+  Public Functions
+**************************************************************************************************/
+
+/*************************************************************************************************/
+int main(int argc, char **argv)
+{
+    bool connect = true;
+    uint16_t mtu = HOST_DEFAULT_MTU;
+    uint8_t credits = HOST_DEFAULT_CREDITS;
+    uint16_t intervalMs = HOST_DEFAULT_CONN_INTERVAL_MS;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "dm:c:i:n")) != -1)
+    {
+        switch (opt)
+        {
+        case 'd':
+            connect = false;
+            break;
+        case 'm':
+            mtu = (uint16_t)atoi(optarg);
+            break;
+        case 'c':
+            credits = (uint8_t)atoi(optarg);
+            break;
+        case 'i':
+            intervalMs = (uint16_t)atoi(optarg);
+            break;
+        case 'n':
+            SimUart_DisableInput();
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-d] [-m mtu] [-c credits] [-i interval_ms] [-n]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+
+    /* Console output is a pipe or terminal; do not let stdio hold lines back */
+    setvbuf(stdout, NULL, _IONBF, 0);
+
+    printf("\n-=- MAX Firmware (host, FreeRTOS %s) -=-\n", tskKERNEL_VERSION_NUMBER);
+
+    SimI2c_Attach(MAX7325_INPUT_ADDR, max7325Device, &s_max7325Port);
+
+    if (!SimBle_Init(credits, intervalMs) || !Tasks_Init(true))
+    {
+        printf("ERROR: Application initialization failed!\n");
+        return 1;
+    }
+
+    if (Max7325_Init())
+    {
+        Max7325_StartInputTask();
+    }
+
+    SimBle_SetEcho(true);
+    if (connect)
+    {
+        SimBle_Connect(mtu);
+        SimBle_EnableNotify(true);
+    }
+
+    Time_InitCapture();
+
+    vTaskStartScheduler();
+
+    printf("ERROR: FreeRTOS did not start\n");
+    return 1;
+}
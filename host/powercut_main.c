@@ -0,0 +1,290 @@
+/*************************************************************************************************/
+/*!
+ *  \file   powercut_main.c
+ *
+ *  \brief  Cuts power to the event log while it erases a checkpoint page (no kernel).
+ *
+ *  Events go through the log one batch at a time: EventLog_Append(), EventLog_Sync(),
+ *  EventLog_PeekSpan() and EventLog_Commit(), so every batch writes one checkpoint. When
+ *  the checkpoint page in use fills up the next one is erased; the flash simulator's erase
+ *  hook stops the run right after that erase, before the new checkpoint is programmed, the
+ *  way a reset would. The log is then mounted again, as after a reboot.
+ *
+ *  After each cut only the batch whose commit was cut may be unread again (at-least-once
+ *  delivery), and it must come back first. The run continues from there, so the cuts hit
+ *  both checkpoint pages in turn.
+ *
+ *  At the end the simulator's per-page erase counts must match the log's own pageErases
+ *  counter, the record pages must be worn evenly (within one erase of each other), and the
+ *  checkpoint pages must have been erased twice per cut: the erase that was cut short, and
+ *  the same page again on the first checkpoint after the remount.
+ *
+ *  Usage: max_firmware_powercut [-c cuts]
+ *    -c  power cuts to inject (default 6)
+ *
+ *  Exits 0 if every cut kept the last checkpoint and the wear checks pass; 1 otherwise.
+ */
+/*************************************************************************************************/
+
+#include "event_log.h"
+#include "flash_port_sim.h"
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**************************************************************************************************
+  Macros
+**************************************************************************************************/
+
+#define POWERCUT_DEFAULT_CUTS 6
+
+/* First offset past the record pages: erases from here on are checkpoint page erases */
+#define POWERCUT_CKPT_OFFSET (EVENT_LOG_DATA_PAGES * FLASH_PORT_PAGE_SIZE)
+
+/* One checkpoint (16 bytes) per batch: two pages' worth is more than a cut can take */
+#define POWERCUT_MAX_BATCHES (2 * (FLASH_PORT_PAGE_SIZE / 16) + 2)
+
+/**************************************************************************************************
+  Local Variables
+**************************************************************************************************/
+
+/*! Where the erase hook returns to when it cuts power */
+static jmp_buf s_cut;
+
+/*! Number of the next event to append, and of the next one expected back */
+static uint32_t s_nextAppend = 0;
+static uint32_t s_nextExpected = 0;
+
+/*! pageErases of every mount so far (EventLog_Init() clears the counters) */
+static uint32_t s_logErases = 0;
+
+static uint32_t s_failures = 0;
+
+/**************************************************************************************************
+  Local Functions
+**************************************************************************************************/
+
+/*************************************************************************************************/
+static void checkpointEraseHook(uint32_t offset)
+{
+    if (offset >= POWERCUT_CKPT_OFFSET)
+    {
+        longjmp(s_cut, 1);
+    }
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Read back the oldest batch, check it is the next one expected and commit it.
+ */
+/*************************************************************************************************/
+static void consumeBatch(void)
+{
+    const WorkoutEvent_t *pEvents[EVENT_LOG_BATCH];
+    uint16_t count;
+    uint16_t i;
+
+    count = EventLog_PeekSpan(pEvents, EVENT_LOG_BATCH);
+    if (count != EVENT_LOG_BATCH)
+    {
+        printf("FAIL: %u event(s) in the log, expected %d\n", (unsigned)count, EVENT_LOG_BATCH);
+        s_failures++;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if (pEvents[i]->timestamp_ms != s_nextExpected + i)
+        {
+            printf("FAIL: read event %llu, expected %lu\n",
+                   (unsigned long long)pEvents[i]->timestamp_ms,
+                   (unsigned long)(s_nextExpected + i));
+            s_failures++;
+            break;
+        }
+    }
+
+    EventLog_Commit(count);
+    s_nextExpected += count;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Pass one batch of events through the log.
+ */
+/*************************************************************************************************/
+static void runBatch(void)
+{
+    WorkoutEvent_t event;
+    uint16_t i;
+
+    memset(&event, 0, sizeof(event));
+    event.type = EVENT_LAP_COMPLETE;
+
+    for (i = 0; i < EVENT_LOG_BATCH; i++)
+    {
+        event.timestamp_ms = s_nextAppend++;
+        EventLog_Append(&event);
+    }
+    EventLog_Sync();
+
+    consumeBatch();
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Add the current mount's erase count to s_logErases (before a remount).
+ */
+/*************************************************************************************************/
+static void collectLogErases(void)
+{
+    EventLogStats_t stats;
+
+    EventLog_GetStats(&stats);
+    s_logErases += stats.pageErases;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Check the simulator's erase counts against the log and against even wear.
+ */
+/*************************************************************************************************/
+static void checkWear(unsigned long cuts)
+{
+    uint32_t page;
+    uint32_t count;
+    uint32_t total = 0;
+    uint32_t ckptErases = 0;
+    uint32_t minErases = UINT32_MAX;
+    uint32_t maxErases = 0;
+
+    for (page = 0; page < FLASH_PORT_REGION_PAGES; page++)
+    {
+        count = FlashPort_SimEraseCount(page);
+        total += count;
+
+        if (page >= EVENT_LOG_DATA_PAGES)
+        {
+            ckptErases += count;
+            continue;
+        }
+
+        minErases = (count < minErases) ? count : minErases;
+        maxErases = (count > maxErases) ? count : maxErases;
+    }
+
+    printf("Erases: record pages %lu-%lu, checkpoint pages %lu, flash %lu, log %lu\n",
+           (unsigned long)minErases, (unsigned long)maxErases, (unsigned long)ckptErases,
+           (unsigned long)total, (unsigned long)s_logErases);
+
+    if (total != s_logErases)
+    {
+        printf("FAIL: flash saw %lu erases, the log counted %lu\n",
+               (unsigned long)total, (unsigned long)s_logErases);
+        s_failures++;
+    }
+
+    if (maxErases - minErases > 1)
+    {
+        printf("FAIL: uneven record page wear\n");
+        s_failures++;
+    }
+
+    if (ckptErases != 2 * cuts)
+    {
+        printf("FAIL: %lu checkpoint page erases, expected %lu\n",
+               (unsigned long)ckptErases, 2 * cuts);
+        s_failures++;
+    }
+}
+
+/**************************************************************************************************
+  Public Functions
+**************************************************************************************************/
+
+/*************************************************************************************************/
+int main(int argc, char **argv)
+{
+    unsigned long cuts = POWERCUT_DEFAULT_CUTS;
+    unsigned long cut;
+    unsigned long injected = 0;
+    uint32_t batches;
+    uint32_t unread;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "c:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'c':
+            cuts = strtoul(optarg, NULL, 0);
+            break;
+        default:
+            optind = argc + 1;
+            break;
+        }
+    }
+
+    if (optind != argc)
+    {
+        fprintf(stderr, "usage: %s [-c cuts]\n", argv[0]);
+        return 2;
+    }
+
+    EventLog_Init();
+
+    for (cut = 0; cut < cuts && s_failures == 0; cut++)
+    {
+        /* volatile: read again after longjmp() */
+        volatile uint32_t done = 0;
+
+        FlashPort_SimSetEraseHook(checkpointEraseHook);
+
+        if (setjmp(s_cut) == 0)
+        {
+            for (done = 0; done < POWERCUT_MAX_BATCHES; done++)
+            {
+                runBatch();
+            }
+
+            printf("FAIL: no checkpoint page erase in %lu batches\n", (unsigned long)done);
+            s_failures++;
+            break;
+        }
+
+        /* Power is back: the commit that was cut never reached flash, and consumeBatch()
+         * did not get to move s_nextExpected past it */
+        batches = done + 1;
+        injected++;
+        FlashPort_SimSetEraseHook(NULL);
+
+        collectLogErases();
+        EventLog_Init();
+        unread = EventLog_Count();
+
+        printf("Cut %lu after %lu batches: %lu unread event(s) after remount\n",
+               cut + 1, (unsigned long)batches, (unsigned long)unread);
+
+        if (unread != EVENT_LOG_BATCH)
+        {
+            printf("FAIL: expected the %d events of the cut commit, checkpoint lost\n",
+                   EVENT_LOG_BATCH);
+            s_failures++;
+            break;
+        }
+
+        consumeBatch();
+    }
+
+    collectLogErases();
+    if (s_failures == 0)
+    {
+        checkWear(injected);
+    }
+
+    printf("Power cut test: %lu cut(s), %lu events, %s\n", injected,
+           (unsigned long)s_nextAppend, (s_failures == 0) ? "PASS" : "FAIL");
+
+    return (s_failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,452 @@
+/*************************************************************************************************/
+/*!
+ *  \file   replay_main.c
+ *
+ *  \brief  Replays recorded button timelines through the firmware under a virtual clock.
+ *
+ *  Runs the same tasks as main.c, with Time_GetMs64() reading a virtual clock (host/Makefile
+ *  builds time_utils.c with TIME_SOURCE_MS=SimClock_GetMs). A driver task sets the clock to
+ *  each step's time and puts the button event on g_buttonQueue. It runs below every
+ *  firmware task, so by the time its send returns the control and BLE TX tasks have
+ *  handled the event and are blocked again: the clock never moves while the firmware is
+ *  working, and the output depends only on the script, not on the host.
+ *
+ *  The output is the notification stream the central would receive (JSON, one event per
+ *  line), prefixed with the repetition number. Each repetition also gets a digest of its
+ *  stream with the "ts" fields made relative to the repetition start; any repetition
+ *  whose digest differs from the first one has drifted.
+ *
+ *  Script: one step per line, "<ms> <START|LAP|STOP|MODE|STATUS|RESET>", times from the
+ *  start of the script and non-decreasing; '#' starts a comment. End the script with the workout
+ *  stopped or completed so the next repetition starts from the same state.
+ *
+ *  Usage: max_firmware_replay [-r repeats] [-t start_ms] [-g gap_ms] [-a] [-v] script
+ *    -r  replay the script this many times back to back (default 1)
+ *    -t  virtual time of the first repetition (default 0; 4294000000 crosses the point
+ *        where a 32-bit millisecond count would wrap)
+ *    -g  virtual time between the last step of one repetition and the next (default 60000)
+ *    -a  print the stream of every repetition (default: the first one)
+ *    -v  keep the firmware console output (on stderr)
+ */
+/*************************************************************************************************/
+
+#include "tasks.h"
+#include "buttons.h"
+#include "ble_tx.h"
+#include "ble_manager.h"
+#include "buffer.h"
+#include "log.h"
+#include "sim_ble.h"
+#include "sim_hw.h"
+#include "time_utils.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+
+/**************************************************************************************************
+  Macros
+**************************************************************************************************/
+
+#define REPLAY_MAX_STEPS 1024
+#define REPLAY_LINE_LEN 128
+#define REPLAY_DEFAULT_GAP_MS 60000
+
+#define REPLAY_TASK_STACK_SIZE 512
+#define REPLAY_TASK_PRIORITY (tskIDLE_PRIORITY) /* Below every firmware task */
+
+/* Link fast enough that the TX task never waits for a credit in practice */
+#define REPLAY_MTU 247
+#define REPLAY_CREDITS 255
+#define REPLAY_CONN_INTERVAL_MS 1
+
+#define REPLAY_FNV_OFFSET 2166136261UL
+#define REPLAY_FNV_PRIME 16777619UL
+
+/**************************************************************************************************
+  Data Types
+**************************************************************************************************/
+
+typedef struct
+{
+    uint32_t ms;                /* Offset from the start of the script */
+    ButtonEventType_t type;
+} ReplayStep_t;
+
+/**************************************************************************************************
+  Static Memory for FreeRTOS Objects
+**************************************************************************************************/
+
+static StaticTask_t s_replayTaskBuffer;
+static StackType_t s_replayTaskStack[REPLAY_TASK_STACK_SIZE];
+
+/**************************************************************************************************
+  Local Variables
+**************************************************************************************************/
+
+static const struct
+{
+    const char *pName;
+    ButtonEventType_t type;
+} s_buttonNames[] = {
+    {"START", BTN_START},
+    {"LAP", BTN_LAP},
+    {"STOP", BTN_STOP},
+    {"MODE", BTN_MODE_NEXT},
+    {"STATUS", BTN_STATUS},
+    {"RESET", BTN_RESET},
+};
+
+static ReplayStep_t s_steps[REPLAY_MAX_STEPS];
+static uint16_t s_stepCount = 0;
+
+static uint32_t s_repeats = 1;
+static uint64_t s_startMs = 0;
+static uint32_t s_gapMs = REPLAY_DEFAULT_GAP_MS;
+static bool s_printAll = false;
+
+static FILE *s_out = NULL;
+
+/* Current repetition, written by the driver and read by the notify hook (TX task) */
+static uint32_t s_rep;
+static uint64_t s_repBase;
+static uint32_t s_repDigest;
+static uint32_t s_repEvents;
+static uint32_t s_totalEvents;
+
+/**************************************************************************************************
+  Local Functions
+**************************************************************************************************/
+
+/*************************************************************************************************/
+static void digestBytes(const uint8_t *pData, uint16_t len)
+{
+    while (len-- > 0)
+    {
+        s_repDigest = (s_repDigest ^ *pData++) * REPLAY_FNV_PRIME;
+    }
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Record one notification: print it and add it to the repetition digest, with
+ *          the "ts" value taken relative to the repetition start.
+ */
+/*************************************************************************************************/
+static void onNotification(const SimBleNotification_t *pNtf)
+{
+    static const char tsKey[] = "\"ts\":";
+    char text[CUSTOM_MAX_DATA_LEN + 1];
+    const char *pTs;
+    char *pEnd;
+    uint64_t rel;
+
+    memcpy(text, pNtf->data, pNtf->len);
+    text[pNtf->len] = '\0';
+
+    if (s_rep == 0 || s_printAll)
+    {
+        fprintf(s_out, "%lu %s\n", (unsigned long)(s_rep + 1), text);
+    }
+
+    pTs = strstr(text, tsKey);
+    if (pTs != NULL)
+    {
+        pTs += sizeof(tsKey) - 1;
+        rel = (uint64_t)strtoull(pTs, &pEnd, 10) - s_repBase;
+        digestBytes((const uint8_t *)text, (uint16_t)(pTs - text));
+        digestBytes((const uint8_t *)&rel, sizeof(rel));
+        digestBytes((const uint8_t *)pEnd, (uint16_t)strlen(pEnd));
+    }
+    else
+    {
+        digestBytes(pNtf->data, pNtf->len);
+    }
+
+    s_repEvents++;
+    s_totalEvents++;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Wait until every event produced so far has been sent.
+ */
+/*************************************************************************************************/
+static void waitForTxIdle(void)
+{
+    /* The TX task outranks this one, so if it is not out of credits it is idle */
+    while (uxQueueMessagesWaiting(g_eventQueue) > 0 || !Buffer_IsEmpty() ||
+           BLE_GetTxCredits() == 0)
+    {
+        vTaskDelay(1);
+    }
+}
+
+/*************************************************************************************************/
+static uint64_t wallNowMs(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Driver task: replay the script s_repeats times, then report and exit.
+ */
+/*************************************************************************************************/
+static void replayTask(void *pvParameters)
+{
+    ButtonEvent_t evt;
+    uint32_t span = s_steps[s_stepCount - 1].ms + s_gapMs;
+    uint32_t firstDigest = 0;
+    uint32_t firstEvents = 0;
+    uint32_t drifted = 0;
+    uint64_t wallStart;
+    uint64_t wallMs;
+    uint16_t i;
+
+    (void)pvParameters;
+
+    wallStart = wallNowMs();
+
+    for (s_rep = 0; s_rep < s_repeats; s_rep++)
+    {
+        s_repBase = s_startMs + (uint64_t)s_rep * span;
+        s_repDigest = REPLAY_FNV_OFFSET;
+        s_repEvents = 0;
+
+        for (i = 0; i < s_stepCount; i++)
+        {
+            /* Never let events pile up behind a credit wait: the event queue could overflow */
+            waitForTxIdle();
+
+            evt.type = s_steps[i].type;
+            evt.timestamp_us = (s_repBase + s_steps[i].ms) * 1000u;
+            evt.arg = 0;
+
+            SimClock_SetMs(s_repBase + s_steps[i].ms);
+            xQueueSend(g_buttonQueue, &evt, portMAX_DELAY);
+        }
+
+        waitForTxIdle();
+
+        if (s_rep == 0)
+        {
+            firstDigest = s_repDigest;
+            firstEvents = s_repEvents;
+        }
+        else if (s_repDigest != firstDigest || s_repEvents != firstEvents)
+        {
+            fprintf(stderr, "[REPLAY] Repetition %lu differs from repetition 1 "
+                            "(%lu events, digest %08lx vs %lu, %08lx)\n",
+                    (unsigned long)(s_rep + 1), (unsigned long)s_repEvents,
+                    (unsigned long)s_repDigest, (unsigned long)firstEvents,
+                    (unsigned long)firstDigest);
+            drifted++;
+        }
+    }
+
+    wallMs = wallNowMs() - wallStart;
+
+    fflush(s_out);
+    fprintf(stderr, "[REPLAY] %lu repetitions, %lu steps, %lu events in %llu ms "
+                    "(%llu repetitions/s), digest %08lx, %lu drifted\n",
+            (unsigned long)s_repeats, (unsigned long)s_repeats * s_stepCount,
+            (unsigned long)s_totalEvents, (unsigned long long)wallMs,
+            (unsigned long long)(s_repeats * 1000ULL / (wallMs > 0 ? wallMs : 1)),
+            (unsigned long)firstDigest, (unsigned long)drifted);
+
+    exit(drifted > 0 ? 1 : 0);
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Load a script into s_steps.
+ *
+ *  \return true if the script is valid and has at least one step.
+ */
+/*************************************************************************************************/
+static bool loadScript(const char *pPath)
+{
+    char line[REPLAY_LINE_LEN];
+    char name[REPLAY_LINE_LEN];
+    unsigned long ms;
+    unsigned int lineNo = 0;
+    bool ok = true;
+    char *pHash;
+    size_t i;
+    FILE *pFile = fopen(pPath, "r");
+
+    if (pFile == NULL)
+    {
+        perror(pPath);
+        return false;
+    }
+
+    while (fgets(line, sizeof(line), pFile) != NULL)
+    {
+        lineNo++;
+
+        if ((pHash = strchr(line, '#')) != NULL)
+        {
+            *pHash = '\0';
+        }
+
+        if (sscanf(line, " %c", name) != 1)
+        {
+            continue; /* Blank or comment */
+        }
+
+        if (sscanf(line, "%lu %127s", &ms, name) != 2)
+        {
+            fprintf(stderr, "%s:%u: expected \"<ms> <button>\"\n", pPath, lineNo);
+            ok = false;
+            break;
+        }
+
+        if (s_stepCount > 0 && ms < s_steps[s_stepCount - 1].ms)
+        {
+            fprintf(stderr, "%s:%u: time goes backwards\n", pPath, lineNo);
+            ok = false;
+            break;
+        }
+
+        if (s_stepCount >= REPLAY_MAX_STEPS)
+        {
+            fprintf(stderr, "%s:%u: more than %d steps\n", pPath, lineNo, REPLAY_MAX_STEPS);
+            ok = false;
+            break;
+        }
+
+        for (i = 0; i < sizeof(s_buttonNames) / sizeof(s_buttonNames[0]); i++)
+        {
+            if (strcasecmp(name, s_buttonNames[i].pName) == 0)
+            {
+                break;
+            }
+        }
+
+        if (i == sizeof(s_buttonNames) / sizeof(s_buttonNames[0]))
+        {
+            fprintf(stderr, "%s:%u: unknown button '%s'\n", pPath, lineNo, name);
+            ok = false;
+            break;
+        }
+
+        s_steps[s_stepCount].ms = (uint32_t)ms;
+        s_steps[s_stepCount].type = s_buttonNames[i].type;
+        s_stepCount++;
+    }
+
+    fclose(pFile);
+
+    if (ok && s_stepCount == 0)
+    {
+        fprintf(stderr, "%s: no steps\n", pPath);
+        ok = false;
+    }
+
+    return ok;
+}
+
+/**************************************************************************************************
+  Public Functions
+**************************************************************************************************/
+
+/*************************************************************************************************/
+int main(int argc, char **argv)
+{
+    bool verbose = false;
+    int mod;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "r:t:g:av")) != -1)
+    {
+        switch (opt)
+        {
+        case 'r':
+            s_repeats = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 't':
+            s_startMs = (uint64_t)strtoull(optarg, NULL, 0);
+            break;
+        case 'g':
+            s_gapMs = (uint32_t)strtoul(optarg, NULL, 0);
+            break;
+        case 'a':
+            s_printAll = true;
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            optind = argc + 1;
+            break;
+        }
+    }
+
+    if (optind != argc - 1 || s_repeats == 0)
+    {
+        fprintf(stderr, "usage: %s [-r repeats] [-t start_ms] [-g gap_ms] [-a] [-v] script\n",
+                argv[0]);
+        return 2;
+    }
+
+    if (!loadScript(argv[optind]))
+    {
+        return 2;
+    }
+
+    /* The stream keeps stdout; the firmware console goes to stderr or nowhere */
+    s_out = fdopen(dup(STDOUT_FILENO), "w");
+    if (s_out == NULL ||
+        (verbose ? dup2(STDERR_FILENO, STDOUT_FILENO) < 0
+                 : freopen("/dev/null", "w", stdout) == NULL))
+    {
+        perror("stdout");
+        return 1;
+    }
+    setvbuf(stdout, NULL, _IONBF, 0);
+
+    if (!verbose)
+    {
+        for (mod = 0; mod < LOG_MOD_COUNT; mod++)
+        {
+            Log_SetLevel((LogModule_t)mod, LOG_LEVEL_NONE);
+        }
+    }
+
+    SimClock_SetMs(s_startMs);
+
+    if (!SimBle_Init(REPLAY_CREDITS, REPLAY_CONN_INTERVAL_MS) || !Tasks_Init(false))
+    {
+        fprintf(stderr, "ERROR: Application initialization failed!\n");
+        return 1;
+    }
+
+    /* Central connected with notifications on; JSON keeps one event per notification */
+    SimBle_SetNotifyHook(onNotification);
+    SimBle_Connect(REPLAY_MTU);
+    SimBle_EnableNotify(true);
+
+    Time_InitCapture();
+
+    if (xTaskCreateStatic(replayTask, "Replay", REPLAY_TASK_STACK_SIZE, NULL,
+                          REPLAY_TASK_PRIORITY, s_replayTaskStack, &s_replayTaskBuffer) == NULL)
+    {
+        fprintf(stderr, "ERROR: Replay task creation failed\n");
+        return 1;
+    }
+
+    vTaskStartScheduler();
+
+    fprintf(stderr, "ERROR: FreeRTOS did not start\n");
+    return 1;
+}
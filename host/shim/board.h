@@ -0,0 +1,14 @@
+/*************************************************************************************************/
+/*!
+ *  \file   board.h
+ *
+ *  \brief  Host shim for the MSDK board header.
+ */
+/*************************************************************************************************/
+
+#ifndef HOST_SHIM_BOARD_H
+#define HOST_SHIM_BOARD_H
+
+#define CONSOLE_UART 0
+
+#endif /* HOST_SHIM_BOARD_H */
@@ -0,0 +1,45 @@
+/*************************************************************************************************/
+/*!
+ *  \file   gpio.h
+ *
+ *  \brief  Host shim for the MSDK GPIO API.
+ *
+ *  Pins read high (the idle level of the open-drain lines the firmware watches) and no
+ *  simulated pin raises an interrupt, so registered callbacks are never called.
+ */
+/*************************************************************************************************/
+
+#ifndef HOST_SHIM_GPIO_H
+#define HOST_SHIM_GPIO_H
+
+#include <stdint.h>
+#include "mxc_device.h"
+
+#define MXC_GPIO_PIN_19 ((uint32_t)(1u << 19))
+
+typedef enum { MXC_GPIO_FUNC_IN, MXC_GPIO_FUNC_OUT } mxc_gpio_func_t;
+typedef enum { MXC_GPIO_PAD_NONE, MXC_GPIO_PAD_PULL_UP, MXC_GPIO_PAD_PULL_DOWN } mxc_gpio_pad_t;
+typedef enum { MXC_GPIO_VSSEL_VDDIO, MXC_GPIO_VSSEL_VDDIOH } mxc_gpio_vssel_t;
+typedef enum { MXC_GPIO_INT_LOW, MXC_GPIO_INT_HIGH, MXC_GPIO_INT_RISING,
+               MXC_GPIO_INT_FALLING, MXC_GPIO_INT_BOTH } mxc_gpio_int_pol_t;
+
+typedef struct
+{
+    mxc_gpio_regs_t *port;
+    uint32_t mask;
+    mxc_gpio_func_t func;
+    mxc_gpio_pad_t pad;
+    mxc_gpio_vssel_t vssel;
+} mxc_gpio_cfg_t;
+
+typedef void (*mxc_gpio_callback_fn)(void *cbdata);
+
+int MXC_GPIO_Config(const mxc_gpio_cfg_t *cfg);
+uint32_t MXC_GPIO_InGet(mxc_gpio_regs_t *port, uint32_t mask);
+void MXC_GPIO_RegisterCallback(const mxc_gpio_cfg_t *cfg, mxc_gpio_callback_fn callback,
+                               void *cbdata);
+void MXC_GPIO_IntConfig(const mxc_gpio_cfg_t *cfg, mxc_gpio_int_pol_t pol);
+void MXC_GPIO_EnableInt(mxc_gpio_regs_t *port, uint32_t mask);
+void MXC_GPIO_Handler(unsigned int port);
+
+#endif /* HOST_SHIM_GPIO_H */
@@ -0,0 +1,42 @@
+/*************************************************************************************************/
+/*!
+ *  \file   i2c.h
+ *
+ *  \brief  Host shim for the MSDK I2C master API.
+ *
+ *  Transactions are routed to simulated devices registered with SimI2c_Attach()
+ *  (host/sim_hw.h). An address with no device NACKs (E_COMM_ERR). There is no interrupt:
+ *  an asynchronous transaction completes, and calls its callback, before it returns.
+ */
+/*************************************************************************************************/
+
+#ifndef HOST_SHIM_I2C_H
+#define HOST_SHIM_I2C_H
+
+#include <stdint.h>
+#include "mxc_device.h"
+
+typedef struct _i2c_req_t mxc_i2c_req_t;
+typedef void (*mxc_i2c_complete_cb_t)(mxc_i2c_req_t *req, int result);
+
+struct _i2c_req_t
+{
+    mxc_i2c_regs_t *i2c;
+    uint8_t addr;
+    unsigned char *tx_buf;
+    unsigned int tx_len;
+    unsigned char *rx_buf;
+    unsigned int rx_len;
+    int restart;
+    mxc_i2c_complete_cb_t callback;
+};
+
+int MXC_I2C_Init(mxc_i2c_regs_t *i2c, int masterMode, unsigned int slaveAddr);
+int MXC_I2C_Shutdown(mxc_i2c_regs_t *i2c);
+int MXC_I2C_SetFrequency(mxc_i2c_regs_t *i2c, unsigned int hz);
+int MXC_I2C_MasterTransaction(mxc_i2c_req_t *req);
+int MXC_I2C_MasterTransactionAsync(mxc_i2c_req_t *req);
+int MXC_I2C_AbortAsync(mxc_i2c_req_t *req);
+void MXC_I2C_AsyncHandler(mxc_i2c_regs_t *i2c);
+
+#endif /* HOST_SHIM_I2C_H */
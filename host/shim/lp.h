@@ -0,0 +1,20 @@
+/*************************************************************************************************/
+/*!
+ *  \file   lp.h
+ *
+ *  \brief  Host shim for the MSDK low-power API (the host never sleeps, so wake-up
+ *          sources are accepted and ignored).
+ */
+/*************************************************************************************************/
+
+#ifndef HOST_SHIM_LP_H
+#define HOST_SHIM_LP_H
+
+#include "gpio.h"
+
+static inline void MXC_LP_EnableGPIOWakeup(mxc_gpio_cfg_t *wu_pins)
+{
+    (void)wu_pins;
+}
+
+#endif /* HOST_SHIM_LP_H */
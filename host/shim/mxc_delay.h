@@ -0,0 +1,19 @@
+/*************************************************************************************************/
+/*!
+ *  \file   mxc_delay.h
+ *
+ *  \brief  Host shim for MSDK busy-wait delays.
+ */
+/*************************************************************************************************/
+
+#ifndef HOST_SHIM_MXC_DELAY_H
+#define HOST_SHIM_MXC_DELAY_H
+
+#include <stdint.h>
+
+#define MXC_DELAY_USEC(us) ((uint32_t)(us))
+#define MXC_DELAY_MSEC(ms) ((uint32_t)(ms) * 1000UL)
+
+int MXC_Delay(uint32_t us);
+
+#endif /* HOST_SHIM_MXC_DELAY_H */
@@ -0,0 +1,48 @@
+/*************************************************************************************************/
+/*!
+ *  \file   mxc_device.h
+ *
+ *  \brief  Host shim for the MSDK device header: peripheral instances as opaque handles.
+ */
+/*************************************************************************************************/
+
+#ifndef HOST_SHIM_MXC_DEVICE_H
+#define HOST_SHIM_MXC_DEVICE_H
+
+#include <stdint.h>
+#include "mxc_errors.h"
+
+/* Register blocks are never dereferenced on the host; instances only need distinct addresses */
+typedef struct { uint8_t instance; } mxc_i2c_regs_t;
+typedef struct { uint8_t instance; } mxc_uart_regs_t;
+typedef struct { uint8_t instance; } mxc_gpio_regs_t;
+
+extern mxc_i2c_regs_t g_simI2cRegs[3];
+extern mxc_uart_regs_t g_simUartRegs[3];
+extern mxc_gpio_regs_t g_simGpioRegs[2];
+
+#define MXC_I2C0 (&g_simI2cRegs[0])
+#define MXC_I2C1 (&g_simI2cRegs[1])
+#define MXC_I2C2 (&g_simI2cRegs[2])
+
+#define MXC_UART_GET_UART(i) (&g_simUartRegs[(i)])
+
+#define MXC_GPIO0 (&g_simGpioRegs[0])
+#define MXC_GPIO1 (&g_simGpioRegs[1])
+#define MXC_GPIO_GET_IDX(p) ((p)->instance)
+
+/* There is no interrupt controller; the firmware's NVIC calls do nothing */
+typedef enum { GPIO0_IRQn, GPIO1_IRQn, I2C0_IRQn, I2C1_IRQn, I2C2_IRQn } IRQn_Type;
+
+static inline void NVIC_EnableIRQ(IRQn_Type irq)
+{
+    (void)irq;
+}
+
+static inline void NVIC_SetPriority(IRQn_Type irq, uint32_t priority)
+{
+    (void)irq;
+    (void)priority;
+}
+
+#endif /* HOST_SHIM_MXC_DEVICE_H */
@@ -0,0 +1,26 @@
+/*************************************************************************************************/
+/*!
+ *  \file   mxc_errors.h
+ *
+ *  \brief  Host shim for MSDK error codes (same values as the SDK).
+ */
+/*************************************************************************************************/
+
+#ifndef HOST_SHIM_MXC_ERRORS_H
+#define HOST_SHIM_MXC_ERRORS_H
+
+#define E_NO_ERROR 0
+#define E_SUCCESS 0
+#define E_NULL_PTR -1
+#define E_NO_DEVICE -2
+#define E_BAD_PARAM -3
+#define E_INVALID -4
+#define E_UNINITIALIZED -5
+#define E_BUSY -6
+#define E_BAD_STATE -7
+#define E_UNKNOWN -8
+#define E_COMM_ERR -9
+#define E_TIME_OUT -10
+#define E_NO_RESPONSE -11
+
+#endif /* HOST_SHIM_MXC_ERRORS_H */
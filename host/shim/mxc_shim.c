@@ -0,0 +1,305 @@
+/*************************************************************************************************/
+/*!
+ *  \file   mxc_shim.c
+ *
+ *  \brief  Host implementations of the MXC driver calls the firmware modules make.
+ *
+ *  I2C transactions go to simulated devices (sim_hw.h) and complete at once, the console
+ *  UART reads stdin, GPIO inputs read high without interrupts and delays sleep the calling
+ *  thread. The virtual clock is only read by builds that make it the time source (host
+ *  replay).
+ */
+/*************************************************************************************************/
+
+#include "sim_hw.h"
+#include "mxc_device.h"
+#include "mxc_delay.h"
+#include "i2c.h"
+#include "uart.h"
+#include "gpio.h"
+#include <poll.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <unistd.h>
+
+/**************************************************************************************************
+  Macros
+**************************************************************************************************/
+
+#define SIM_I2C_MAX_DEVICES 8
+#define SIM_GPIO_PORTS 2
+
+/**************************************************************************************************
+  Data Types
+**************************************************************************************************/
+
+typedef struct
+{
+    uint8_t addr;
+    SimI2cDevice_t handler;
+    void *pCtx;
+} SimI2cSlot_t;
+
+/**************************************************************************************************
+  Global Variables
+**************************************************************************************************/
+
+mxc_i2c_regs_t g_simI2cRegs[3] = { { 0 }, { 1 }, { 2 } };
+mxc_uart_regs_t g_simUartRegs[3] = { { 0 }, { 1 }, { 2 } };
+mxc_gpio_regs_t g_simGpioRegs[SIM_GPIO_PORTS] = { { 0 }, { 1 } };
+
+/**************************************************************************************************
+  Local Variables
+**************************************************************************************************/
+
+static SimI2cSlot_t s_devices[SIM_I2C_MAX_DEVICES];
+static uint8_t s_deviceCount = 0;
+static bool s_i2cReady[3];
+static SimI2cStats_t s_i2cStats;
+
+static bool s_uartInput = true;
+
+/* Written by the replay driver, read from every task thread */
+static volatile uint64_t s_clockMs = 0;
+
+/**************************************************************************************************
+  Public Functions - simulation control
+**************************************************************************************************/
+
+/*************************************************************************************************/
+bool SimI2c_Attach(uint8_t addr, SimI2cDevice_t handler, void *pCtx)
+{
+    if (s_deviceCount >= SIM_I2C_MAX_DEVICES || handler == NULL)
+    {
+        return false;
+    }
+
+    s_devices[s_deviceCount].addr = addr;
+    s_devices[s_deviceCount].handler = handler;
+    s_devices[s_deviceCount].pCtx = pCtx;
+    s_deviceCount++;
+
+    return true;
+}
+
+/*************************************************************************************************/
+void SimI2c_GetStats(SimI2cStats_t *pStats)
+{
+    if (pStats != NULL)
+    {
+        *pStats = s_i2cStats;
+    }
+}
+
+/*************************************************************************************************/
+void SimUart_DisableInput(void)
+{
+    s_uartInput = false;
+}
+
+/*************************************************************************************************/
+uint64_t SimClock_GetMs(void)
+{
+    return s_clockMs;
+}
+
+/*************************************************************************************************/
+void SimClock_SetMs(uint64_t ms)
+{
+    s_clockMs = ms;
+}
+
+/**************************************************************************************************
+  Public Functions - MXC driver API
+**************************************************************************************************/
+
+/*************************************************************************************************/
+int MXC_I2C_Init(mxc_i2c_regs_t *i2c, int masterMode, unsigned int slaveAddr)
+{
+    (void)slaveAddr;
+
+    if (i2c == NULL || !masterMode)
+    {
+        return E_BAD_PARAM;
+    }
+
+    s_i2cReady[i2c->instance] = true;
+    return E_NO_ERROR;
+}
+
+/*************************************************************************************************/
+int MXC_I2C_Shutdown(mxc_i2c_regs_t *i2c)
+{
+    if (i2c == NULL)
+    {
+        return E_BAD_PARAM;
+    }
+
+    s_i2cReady[i2c->instance] = false;
+    return E_NO_ERROR;
+}
+
+/*************************************************************************************************/
+int MXC_I2C_SetFrequency(mxc_i2c_regs_t *i2c, unsigned int hz)
+{
+    return (i2c != NULL && hz > 0) ? (int)hz : E_BAD_PARAM;
+}
+
+/*************************************************************************************************/
+int MXC_I2C_MasterTransaction(mxc_i2c_req_t *req)
+{
+    uint8_t i;
+
+    if (req == NULL || req->i2c == NULL)
+    {
+        return E_BAD_PARAM;
+    }
+
+    if (!s_i2cReady[req->i2c->instance])
+    {
+        return E_UNINITIALIZED;
+    }
+
+    s_i2cStats.transactions++;
+
+    for (i = 0; i < s_deviceCount; i++)
+    {
+        if (s_devices[i].addr == req->addr)
+        {
+            s_i2cStats.bytes += req->tx_len + req->rx_len;
+            return s_devices[i].handler(s_devices[i].pCtx, req->tx_buf, req->tx_len,
+                                        req->rx_buf, req->rx_len);
+        }
+    }
+
+    s_i2cStats.nacks++;
+    return E_COMM_ERR;
+}
+
+/*************************************************************************************************/
+int MXC_I2C_MasterTransactionAsync(mxc_i2c_req_t *req)
+{
+    int result = MXC_I2C_MasterTransaction(req);
+
+    /* A transaction that could not start has no completion, as on the target */
+    if (result == E_BAD_PARAM || result == E_UNINITIALIZED)
+    {
+        return result;
+    }
+
+    if (req->callback != NULL)
+    {
+        req->callback(req, result);
+    }
+
+    return E_NO_ERROR;
+}
+
+/*************************************************************************************************/
+int MXC_I2C_AbortAsync(mxc_i2c_req_t *req)
+{
+    return (req != NULL) ? E_NO_ERROR : E_BAD_PARAM;
+}
+
+/*************************************************************************************************/
+void MXC_I2C_AsyncHandler(mxc_i2c_regs_t *i2c)
+{
+    (void)i2c;
+}
+
+/*************************************************************************************************/
+int MXC_UART_GetRXFIFOAvailable(mxc_uart_regs_t *uart)
+{
+    struct pollfd pfd = { .fd = STDIN_FILENO, .events = POLLIN };
+
+    (void)uart;
+
+    if (!s_uartInput)
+    {
+        return 0;
+    }
+
+    return (poll(&pfd, 1, 0) > 0 && (pfd.revents & POLLIN)) ? 1 : 0;
+}
+
+/*************************************************************************************************/
+int MXC_UART_ReadCharacter(mxc_uart_regs_t *uart)
+{
+    unsigned char ch;
+
+    (void)uart;
+
+    if (read(STDIN_FILENO, &ch, 1) != 1)
+    {
+        /* EOF: stop polling stdin rather than spin on it. A newline is ignored by readers. */
+        s_uartInput = false;
+        return '\n';
+    }
+
+    return ch;
+}
+
+/*************************************************************************************************/
+int MXC_GPIO_Config(const mxc_gpio_cfg_t *cfg)
+{
+    return (cfg != NULL && cfg->port != NULL) ? E_NO_ERROR : E_BAD_PARAM;
+}
+
+/*************************************************************************************************/
+uint32_t MXC_GPIO_InGet(mxc_gpio_regs_t *port, uint32_t mask)
+{
+    (void)port;
+
+    return mask;
+}
+
+/*************************************************************************************************/
+void MXC_GPIO_RegisterCallback(const mxc_gpio_cfg_t *cfg, mxc_gpio_callback_fn callback,
+                               void *cbdata)
+{
+    (void)cfg;
+    (void)callback;
+    (void)cbdata;
+}
+
+/*************************************************************************************************/
+void MXC_GPIO_IntConfig(const mxc_gpio_cfg_t *cfg, mxc_gpio_int_pol_t pol)
+{
+    (void)cfg;
+    (void)pol;
+}
+
+/*************************************************************************************************/
+void MXC_GPIO_EnableInt(mxc_gpio_regs_t *port, uint32_t mask)
+{
+    (void)port;
+    (void)mask;
+}
+
+/*************************************************************************************************/
+void MXC_GPIO_Handler(unsigned int port)
+{
+    (void)port;
+}
+
+/*************************************************************************************************/
+int MXC_Delay(uint32_t us)
+{
+    usleep(us);
+    return E_NO_ERROR;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Linked in place of pthread_attr_setstack() (see host/Makefile): tasks keep the
+ *          default pthread stack.
+ */
+/*************************************************************************************************/
+int __wrap_pthread_attr_setstack(pthread_attr_t *pAttr, void *pStack, size_t size)
+{
+    (void)pAttr;
+    (void)pStack;
+    (void)size;
+
+    return 0;
+}
@@ -0,0 +1,17 @@
+/*************************************************************************************************/
+/*!
+ *  \file   uart.h
+ *
+ *  \brief  Host shim for the MSDK UART API. The console UART reads from stdin.
+ */
+/*************************************************************************************************/
+
+#ifndef HOST_SHIM_UART_H
+#define HOST_SHIM_UART_H
+
+#include "mxc_device.h"
+
+int MXC_UART_GetRXFIFOAvailable(mxc_uart_regs_t *uart);
+int MXC_UART_ReadCharacter(mxc_uart_regs_t *uart);
+
+#endif /* HOST_SHIM_UART_H */
@@ -0,0 +1,24 @@
+/*************************************************************************************************/
+/*!
+ *  \file   wsf_os.h
+ *
+ *  \brief  Host shim for the Cordio WSF OS types used by the ble_manager.h interface.
+ */
+/*************************************************************************************************/
+
+#ifndef HOST_SHIM_WSF_OS_H
+#define HOST_SHIM_WSF_OS_H
+
+#include "wsf_types.h"
+
+typedef uint8_t wsfHandlerId_t;
+typedef uint16_t wsfEventMask_t;
+
+typedef struct
+{
+    uint16_t param;
+    uint8_t event;
+    uint8_t status;
+} wsfMsgHdr_t;
+
+#endif /* HOST_SHIM_WSF_OS_H */
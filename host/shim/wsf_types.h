@@ -0,0 +1,24 @@
+/*************************************************************************************************/
+/*!
+ *  \file   wsf_types.h
+ *
+ *  \brief  Host shim for the Cordio WSF base types used by the ble_manager.h interface.
+ */
+/*************************************************************************************************/
+
+#ifndef HOST_SHIM_WSF_TYPES_H
+#define HOST_SHIM_WSF_TYPES_H
+
+#include <stdint.h>
+
+#ifndef TRUE
+#define TRUE 1
+#endif
+
+#ifndef FALSE
+#define FALSE 0
+#endif
+
+typedef uint8_t bool_t;
+
+#endif /* HOST_SHIM_WSF_TYPES_H */
@@ -0,0 +1,355 @@
+/*************************************************************************************************/
+/*!
+ *  \file   sim_ble.c
+ *
+ *  \brief  Simulated BLE link for the host build - FULLY STATIC ALLOCATION.
+ *
+ *  Link events call into the same modules, in the same order, as the DM/ATT callbacks in
+ *  comms/ble_manager.c, so BLE TX and the control task see the same sequence as on the
+ *  part.
+ */
+/*************************************************************************************************/
+
+#include "sim_ble.h"
+#include "ble_manager.h"
+#include "ble_tx.h"
+#include "cmd_parser.h"
+#include "protocol.h"
+#include "time_utils.h"
+#include "workout_control.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timers.h"
+#include <stdio.h>
+#include <string.h>
+
+/**************************************************************************************************
+  Macros
+**************************************************************************************************/
+
+#define SIM_BLE_CONN_ID 1
+#define SIM_BLE_NTF_HDR_LEN 3 /* ATT_VALUE_NTF_LEN: opcode + handle */
+
+/**************************************************************************************************
+  Static Memory for FreeRTOS Objects
+**************************************************************************************************/
+
+static StaticTimer_t s_connEventTimerBuffer;
+
+/**************************************************************************************************
+  Local Variables
+**************************************************************************************************/
+
+static TimerHandle_t s_connEventTimer = NULL;
+
+static volatile bool s_connected = false;
+static volatile bool s_notifyEnabled = false;
+static uint16_t s_mtu = SIM_BLE_DEFAULT_MTU;
+static uint8_t s_maxCredits = 1;
+static volatile uint8_t s_credits = 1;
+static bool s_echo = false;
+static SimBleNotifyHook_t s_notifyHook = NULL;
+
+static SimBleNotification_t s_log[SIM_BLE_LOG_LEN];
+static SimBleStats_t s_stats;
+
+/**************************************************************************************************
+  Local Functions
+**************************************************************************************************/
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Return all credits, reporting how many notifications were in flight.
+ */
+/*************************************************************************************************/
+static uint8_t creditReset(void)
+{
+    uint8_t outstanding;
+
+    taskENTER_CRITICAL();
+    outstanding = s_maxCredits - s_credits;
+    s_credits = s_maxCredits;
+    taskEXIT_CRITICAL();
+
+    return outstanding;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Connection event: every notification in flight is confirmed.
+ */
+/*************************************************************************************************/
+static void connEventCallback(TimerHandle_t xTimer)
+{
+    uint8_t confirmed;
+
+    (void)xTimer;
+
+    if (!s_connected)
+    {
+        return;
+    }
+
+    for (confirmed = creditReset(); confirmed > 0; confirmed--)
+    {
+        BleTx_OnTxComplete(true);
+    }
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Same dispatch as rxCmdHandler() in comms/ble_manager.c.
+ */
+/*************************************************************************************************/
+static void rxCmdHandler(const Cmd_t *pCmd, void *pCtx)
+{
+    (void)pCtx;
+
+    switch (pCmd->id)
+    {
+    case CMD_FMT_BIN:
+        Protocol_SetFormat(PROTOCOL_FMT_BINARY);
+        break;
+
+    case CMD_FMT_JSON:
+        Protocol_SetFormat(PROTOCOL_FMT_JSON);
+        break;
+
+    case CMD_TIME_SYNC:
+        BleTx_SendTimeSync(pCmd->arg, Time_GetMs64());
+        break;
+
+    case CMD_SYNC_SINCE:
+        BleTx_RequestResend(pCmd->arg);
+        break;
+
+    default:
+        WorkoutControl_SendCommand(pCmd);
+        break;
+    }
+}
+
+/*************************************************************************************************/
+static void echoNotification(const SimBleNotification_t *pNtf)
+{
+    uint16_t i;
+
+    printf("[SIM_BLE] %lu ms >> ", (unsigned long)pNtf->timeMs);
+
+    if (pNtf->len > 0 && pNtf->data[0] == PROTOCOL_FRAME_HDR)
+    {
+        for (i = 0; i < pNtf->len; i++)
+        {
+            printf("%02X", pNtf->data[i]);
+        }
+        printf("\n");
+    }
+    else
+    {
+        printf("%.*s\n", (int)pNtf->len, (const char *)pNtf->data);
+    }
+}
+
+/**************************************************************************************************
+  Public Functions - simulation control
+**************************************************************************************************/
+
+/*************************************************************************************************/
+bool SimBle_Init(uint8_t credits, uint16_t connIntervalMs)
+{
+    s_maxCredits = (credits > 0) ? credits : 1;
+    s_credits = s_maxCredits;
+
+    s_connEventTimer = xTimerCreateStatic(
+        "SIM_CE",
+        pdMS_TO_TICKS(connIntervalMs > 0 ? connIntervalMs : 1),
+        pdTRUE,
+        NULL,
+        connEventCallback,
+        &s_connEventTimerBuffer);
+
+    if (s_connEventTimer == NULL)
+    {
+        printf("[SIM_BLE] ERROR: Failed to create timer\n");
+        return false;
+    }
+
+    return true;
+}
+
+/*************************************************************************************************/
+void SimBle_Connect(uint16_t mtu)
+{
+    s_mtu = (mtu >= SIM_BLE_DEFAULT_MTU) ? mtu : SIM_BLE_DEFAULT_MTU;
+    s_notifyEnabled = false;
+    s_connected = true;
+    s_stats.connects++;
+    creditReset();
+
+    Protocol_SetFormat(PROTOCOL_FMT_JSON);
+    BleTx_OnLinkChange(true);
+    xTimerStart(s_connEventTimer, 0);
+
+    printf("[SIM_BLE] Connected (MTU %u)\n", (unsigned)s_mtu);
+}
+
+/*************************************************************************************************/
+void SimBle_EnableNotify(bool enable)
+{
+    s_notifyEnabled = enable;
+
+    if (enable && s_connected)
+    {
+        BleTx_OnLinkChange(true);
+    }
+}
+
+/*************************************************************************************************/
+void SimBle_Disconnect(void)
+{
+    s_connected = false;
+    s_notifyEnabled = false;
+    xTimerStop(s_connEventTimer, 0);
+
+    if (creditReset() > 0)
+    {
+        BleTx_OnTxComplete(false);
+    }
+
+    BleTx_OnLinkChange(false);
+
+    printf("[SIM_BLE] Disconnected\n");
+}
+
+/*************************************************************************************************/
+uint8_t SimBle_Write(const uint8_t *pData, uint16_t len)
+{
+    if (!s_connected || pData == NULL || len == 0 || len > CUSTOM_MAX_DATA_LEN)
+    {
+        return 0;
+    }
+
+    s_stats.writes++;
+    return CmdParser_Parse(pData, len, rxCmdHandler, NULL);
+}
+
+/*************************************************************************************************/
+void SimBle_SetEcho(bool echo)
+{
+    s_echo = echo;
+}
+
+/*************************************************************************************************/
+void SimBle_SetNotifyHook(SimBleNotifyHook_t hook)
+{
+    s_notifyHook = hook;
+}
+
+/*************************************************************************************************/
+bool SimBle_GetNotification(uint32_t index, SimBleNotification_t *pOut)
+{
+    bool kept;
+
+    taskENTER_CRITICAL();
+    kept = (index < s_stats.notifications && s_stats.notifications - index <= SIM_BLE_LOG_LEN);
+    if (kept && pOut != NULL)
+    {
+        *pOut = s_log[index % SIM_BLE_LOG_LEN];
+    }
+    taskEXIT_CRITICAL();
+
+    return kept;
+}
+
+/*************************************************************************************************/
+void SimBle_GetStats(SimBleStats_t *pStats)
+{
+    if (pStats != NULL)
+    {
+        *pStats = s_stats;
+    }
+}
+
+/**************************************************************************************************
+  Public Functions - ble_manager.h
+**************************************************************************************************/
+
+/*************************************************************************************************/
+bool_t DataSend(const uint8_t *pData, uint16_t len)
+{
+    SimBleNotification_t *pNtf;
+    bool_t sent = FALSE;
+
+    if (!s_connected || !s_notifyEnabled || pData == NULL || len == 0 ||
+        len > BLE_GetMaxPayload())
+    {
+        return FALSE;
+    }
+
+    taskENTER_CRITICAL();
+    if (s_credits > 0)
+    {
+        s_credits--;
+        pNtf = &s_log[s_stats.notifications % SIM_BLE_LOG_LEN];
+        pNtf->timeMs = Time_GetMs();
+        pNtf->len = len;
+        memcpy(pNtf->data, pData, len);
+        s_stats.notifications++;
+        s_stats.bytes += len;
+        sent = TRUE;
+    }
+    else
+    {
+        s_stats.noCredit++;
+    }
+    taskEXIT_CRITICAL();
+
+    if (sent && s_echo)
+    {
+        echoNotification(pNtf);
+    }
+    if (sent && s_notifyHook != NULL)
+    {
+        s_notifyHook(pNtf);
+    }
+
+    return sent;
+}
+
+/*************************************************************************************************/
+bool_t DataSendString(const char *pStr)
+{
+    return (pStr != NULL) ? DataSend((const uint8_t *)pStr, (uint16_t)strlen(pStr)) : FALSE;
+}
+
+/*************************************************************************************************/
+bool_t BLE_IsConnected(void)
+{
+    return s_connected ? TRUE : FALSE;
+}
+
+/*************************************************************************************************/
+bool_t BLE_IsNotifyEnabled(void)
+{
+    return (s_connected && s_notifyEnabled) ? TRUE : FALSE;
+}
+
+/*************************************************************************************************/
+uint8_t BLE_GetConnId(void)
+{
+    return s_connected ? SIM_BLE_CONN_ID : 0;
+}
+
+/*************************************************************************************************/
+uint16_t BLE_GetMaxPayload(void)
+{
+    uint16_t payload = s_mtu - SIM_BLE_NTF_HDR_LEN;
+
+    return (payload > CUSTOM_MAX_DATA_LEN) ? CUSTOM_MAX_DATA_LEN : payload;
+}
+
+/*************************************************************************************************/
+uint8_t BLE_GetTxCredits(void)
+{
+    return s_credits;
+}
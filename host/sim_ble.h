@@ -0,0 +1,147 @@
+/*************************************************************************************************/
+/*!
+ *  \file   sim_ble.h
+ *
+ *  \brief  Simulated BLE link for the host build.
+ *
+ *  Replaces comms/ble_manager.c and the Cordio stack. It implements the ble_manager.h API
+ *  on a model of one connection: DM connect/disconnect, the TX characteristic CCC, ATT MTU
+ *  and notification credits. Credits come back on a periodic "connection event" timer,
+ *  the way ATTS_HANDLE_VALUE_CNF does on the part. Every notification is recorded, and
+ *  writes to the RX characteristic go through the same command parser as the firmware.
+ */
+/*************************************************************************************************/
+
+#ifndef HOST_SIM_BLE_H
+#define HOST_SIM_BLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ble_uuid.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**************************************************************************************************
+  Constants
+**************************************************************************************************/
+
+#define SIM_BLE_LOG_LEN         64      /* Most recent notifications kept */
+#define SIM_BLE_DEFAULT_MTU     23      /* ATT default before an MTU exchange */
+
+/**************************************************************************************************
+  Data Types
+**************************************************************************************************/
+
+/*! One recorded notification */
+typedef struct
+{
+    uint32_t timeMs;        /* Time_GetMs() when handed to the "stack" */
+    uint16_t len;
+    uint8_t data[CUSTOM_MAX_DATA_LEN];
+} SimBleNotification_t;
+
+/*! Link counters since start */
+typedef struct
+{
+    uint32_t notifications; /* Notifications accepted */
+    uint32_t bytes;         /* Payload bytes accepted */
+    uint32_t noCredit;      /* DataSend() refused for lack of a credit */
+    uint32_t writes;        /* RX characteristic writes */
+    uint32_t connects;
+} SimBleStats_t;
+
+/*! Sees every notification as it is accepted, in the sending task */
+typedef void (*SimBleNotifyHook_t)(const SimBleNotification_t *pNtf);
+
+/**************************************************************************************************
+  Function Declarations
+**************************************************************************************************/
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Set up the link model. Call before the scheduler starts.
+ *
+ *  \param  credits         Notifications in flight at once (ATT_NUM_SIMUL_NTF).
+ *  \param  connIntervalMs  Connection interval; in-flight notifications complete each one.
+ *
+ *  \return true on success.
+ */
+/*************************************************************************************************/
+bool SimBle_Init(uint8_t credits, uint16_t connIntervalMs);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Central connects (DM_CONN_OPEN_IND) with the given ATT MTU.
+ */
+/*************************************************************************************************/
+void SimBle_Connect(uint16_t mtu);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Central writes the TX characteristic CCC.
+ */
+/*************************************************************************************************/
+void SimBle_EnableNotify(bool enable);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Link drops (DM_CONN_CLOSE_IND). In-flight notifications are lost.
+ */
+/*************************************************************************************************/
+void SimBle_Disconnect(void);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Central writes the RX characteristic.
+ *
+ *  \return Number of commands parsed.
+ */
+/*************************************************************************************************/
+uint8_t SimBle_Write(const uint8_t *pData, uint16_t len);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Print each notification to stdout as it is sent.
+ */
+/*************************************************************************************************/
+void SimBle_SetEcho(bool echo);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Pass each notification to a hook as it is sent (for consumers that must not miss
+ *          any, unlike the SIM_BLE_LOG_LEN record).
+ *
+ *  \param  hook    Called after the notification is recorded; NULL to remove.
+ */
+/*************************************************************************************************/
+void SimBle_SetNotifyHook(SimBleNotifyHook_t hook);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Get a recorded notification.
+ *
+ *  \param  index   Sequence number, 0 for the first notification since start. Only the
+ *                  last SIM_BLE_LOG_LEN are kept.
+ *  \param  pOut    Receives the notification.
+ *
+ *  \return false if index has not been sent yet or is no longer kept.
+ */
+/*************************************************************************************************/
+bool SimBle_GetNotification(uint32_t index, SimBleNotification_t *pOut);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Get link counters.
+ *
+ *  \param  pStats  Receives a copy of the counters.
+ */
+/*************************************************************************************************/
+void SimBle_GetStats(SimBleStats_t *pStats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HOST_SIM_BLE_H */
@@ -0,0 +1,91 @@
+/*************************************************************************************************/
+/*!
+ *  \file   sim_hw.h
+ *
+ *  \brief  Control interface for the simulated peripherals behind the host MXC shims, and
+ *          the virtual clock used by the replay build.
+ */
+/*************************************************************************************************/
+
+#ifndef HOST_SIM_HW_H
+#define HOST_SIM_HW_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**************************************************************************************************
+  Data Types
+**************************************************************************************************/
+
+/*! Simulated I2C target: handle one transaction, return an E_* code */
+typedef int (*SimI2cDevice_t)(void *pCtx, const uint8_t *pTx, unsigned int txLen,
+                              uint8_t *pRx, unsigned int rxLen);
+
+/*! Bus counters since start */
+typedef struct
+{
+    uint32_t transactions;  /* MXC_I2C_MasterTransaction() calls */
+    uint32_t nacks;         /* Transactions to an address with no device */
+    uint32_t bytes;         /* Bytes written plus bytes read */
+} SimI2cStats_t;
+
+/**************************************************************************************************
+  Function Declarations
+**************************************************************************************************/
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Attach a simulated device at a 7-bit address (on every I2C instance).
+ *
+ *  \param  addr     7-bit address.
+ *  \param  handler  Called for each transaction to addr.
+ *  \param  pCtx     Passed through to handler.
+ *
+ *  \return true if attached, false if the device table is full.
+ */
+/*************************************************************************************************/
+bool SimI2c_Attach(uint8_t addr, SimI2cDevice_t handler, void *pCtx);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Get bus counters.
+ *
+ *  \param  pStats  Receives a copy of the counters.
+ */
+/*************************************************************************************************/
+void SimI2c_GetStats(SimI2cStats_t *pStats);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Stop reading the console UART from stdin (for scripted runs).
+ */
+/*************************************************************************************************/
+void SimUart_DisableInput(void);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Read the virtual clock (Time_GetMs64() in builds with TIME_SOURCE_MS=SimClock_GetMs).
+ *
+ *  \return Virtual time in milliseconds.
+ */
+/*************************************************************************************************/
+uint64_t SimClock_GetMs(void);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Set the virtual clock. It only moves when this is called.
+ *
+ *  \param  ms      New virtual time in milliseconds.
+ */
+/*************************************************************************************************/
+void SimClock_SetMs(uint64_t ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HOST_SIM_HW_H */
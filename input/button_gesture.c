@@ -0,0 +1,259 @@
+/*************************************************************************************************/
+/*!
+ *  \file   button_gesture.c
+ *
+ *  \brief  Bit-parallel debouncer and table-driven gesture engine implementation.
+ */
+/*************************************************************************************************/
+
+#include "button_gesture.h"
+#include "log.h"
+#include <stddef.h>
+
+/**************************************************************************************************
+  Local Variables
+**************************************************************************************************/
+
+static const ButtonGestureMap_t *s_pMap = NULL;
+static uint8_t s_mapCount = 0;
+
+/* Debounced states and the vertical counter (bit n of ct0/ct1 = counter of line n; both
+ * set = idle) */
+static uint8_t s_state = 0;
+static uint8_t s_ct0 = 0xFF;
+static uint8_t s_ct1 = 0xFF;
+
+/* Lines that differed from their debounced state since the port was last quiet, and the
+ * sample time when they first did */
+static uint8_t s_armed = 0;
+static uint64_t s_edgeUs[BUTTON_GESTURE_LINES];
+
+/* Consecutive samples equal to the debounced state */
+static uint8_t s_quietSamples = BUTTON_DEBOUNCE_SAMPLES;
+
+/* Gesture state */
+static uint8_t s_longMask = 0;      /* Lines with a GESTURE_LONG entry */
+static uint8_t s_longPending = 0;   /* Held lines whose long press is not sent yet */
+static uint8_t s_doubleArmed = 0;   /* Lines whose last press can start a double press */
+static uint64_t s_pressUs[BUTTON_GESTURE_LINES];
+
+static const char *const s_kindNames[] = {"press", "release", "long", "double", "chord"};
+
+/**************************************************************************************************
+  Local Function Prototypes
+**************************************************************************************************/
+
+static void sendMatches(ButtonGestureKind_t kind, uint8_t line, uint64_t edgeUs);
+static void handleEdges(uint8_t toggled);
+
+/**************************************************************************************************
+  Public Functions
+**************************************************************************************************/
+
+/*************************************************************************************************/
+void ButtonGesture_Init(const ButtonGestureMap_t *pMap, uint8_t count, uint8_t pressed)
+{
+    uint8_t i;
+
+    s_pMap = pMap;
+    s_mapCount = (pMap != NULL) ? count : 0;
+
+    s_state = pressed;
+    s_ct0 = 0xFF;
+    s_ct1 = 0xFF;
+    s_armed = 0;
+    s_quietSamples = BUTTON_DEBOUNCE_SAMPLES;
+    s_longPending = 0;
+    s_doubleArmed = 0;
+
+    s_longMask = 0;
+    for (i = 0; i < s_mapCount; i++)
+    {
+        if (s_pMap[i].kind == GESTURE_LONG)
+        {
+            s_longMask |= s_pMap[i].mask;
+        }
+    }
+}
+
+/*************************************************************************************************/
+bool ButtonGesture_Sample(uint8_t pressed, uint64_t sampleUs)
+{
+    uint8_t delta = s_state ^ pressed;
+    uint8_t start = delta & (uint8_t)~s_armed;
+    uint8_t toggled;
+    uint8_t n;
+
+    /* Keep the first change of each line; later bounce does not move it */
+    for (n = 0; start != 0; n++, start >>= 1)
+    {
+        if (start & 1u)
+        {
+            s_edgeUs[n] = sampleUs;
+        }
+    }
+    s_armed |= delta;
+
+    /* Count differing lines down, reset the rest; a line toggles when its counter rolls over */
+    s_ct0 = (uint8_t)~(s_ct0 & delta);
+    s_ct1 = s_ct0 ^ (s_ct1 & delta);
+    toggled = delta & s_ct0 & s_ct1;
+    s_state ^= toggled;
+    s_armed &= (uint8_t)~toggled;
+
+    if (toggled != 0)
+    {
+        handleEdges(toggled);
+    }
+
+    /* One sample that matches can be mid-bounce; settled takes as many as a change does */
+    if (s_state != pressed)
+    {
+        s_quietSamples = 0;
+        return false;
+    }
+    if (s_quietSamples < BUTTON_DEBOUNCE_SAMPLES)
+    {
+        s_quietSamples++;
+    }
+    if (s_quietSamples < BUTTON_DEBOUNCE_SAMPLES)
+    {
+        return false;
+    }
+
+    /* Settled: lines that bounced back without changing state drop their edge */
+    s_armed = 0;
+    return true;
+}
+
+/*************************************************************************************************/
+void ButtonGesture_Tick(uint64_t nowUs)
+{
+    uint8_t n;
+
+    for (n = 0; n < BUTTON_GESTURE_LINES; n++)
+    {
+        if ((s_longPending & (1u << n)) && nowUs - s_pressUs[n] >= BUTTON_LONG_PRESS_US)
+        {
+            s_longPending &= (uint8_t)~(1u << n);
+            sendMatches(GESTURE_LONG, n, s_pressUs[n]);
+        }
+    }
+}
+
+/*************************************************************************************************/
+uint64_t ButtonGesture_NextDeadlineUs(void)
+{
+    uint64_t deadline = BUTTON_GESTURE_NO_DEADLINE;
+    uint8_t n;
+
+    for (n = 0; n < BUTTON_GESTURE_LINES; n++)
+    {
+        if ((s_longPending & (1u << n)) && s_pressUs[n] + BUTTON_LONG_PRESS_US < deadline)
+        {
+            deadline = s_pressUs[n] + BUTTON_LONG_PRESS_US;
+        }
+    }
+
+    return deadline;
+}
+
+/*************************************************************************************************/
+uint8_t ButtonGesture_GetPressed(void)
+{
+    return s_state;
+}
+
+/**************************************************************************************************
+  Local Functions
+**************************************************************************************************/
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Send the event of every single-line table entry of this kind that covers line.
+ */
+/*************************************************************************************************/
+static void sendMatches(ButtonGestureKind_t kind, uint8_t line, uint64_t edgeUs)
+{
+    uint8_t i;
+
+    for (i = 0; i < s_mapCount; i++)
+    {
+        if (s_pMap[i].kind == kind && (s_pMap[i].mask & (1u << line)))
+        {
+            LOG_INFO(LOG_MOD_INPUT, "[BTN] SW%d %s\n", line + 1, s_kindNames[kind]);
+            Button_SendEventAt(s_pMap[i].event, edgeUs);
+        }
+    }
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Match debounced edges against the gesture table.
+ *
+ *  \param  toggled     Lines that changed state in this sample.
+ */
+/*************************************************************************************************/
+static void handleEdges(uint8_t toggled)
+{
+    uint8_t pressedNow = toggled & s_state;
+    uint8_t n;
+    uint8_t i;
+
+    for (n = 0; n < BUTTON_GESTURE_LINES; n++)
+    {
+        uint8_t bit = (uint8_t)(1u << n);
+        uint64_t edgeUs = s_edgeUs[n];
+
+        if (!(toggled & bit))
+        {
+            continue;
+        }
+
+        if (!(pressedNow & bit))
+        {
+            s_longPending &= (uint8_t)~bit;
+            sendMatches(GESTURE_RELEASE, n, edgeUs);
+            continue;
+        }
+
+        sendMatches(GESTURE_PRESS, n, edgeUs);
+
+        /* A double press needs a fresh first press: a third press starts a new pair */
+        if ((s_doubleArmed & bit) && edgeUs - s_pressUs[n] <= BUTTON_DOUBLE_PRESS_US)
+        {
+            s_doubleArmed &= (uint8_t)~bit;
+            sendMatches(GESTURE_DOUBLE, n, edgeUs);
+        }
+        else
+        {
+            s_doubleArmed |= bit;
+        }
+
+        s_pressUs[n] = edgeUs;
+        s_longPending |= s_longMask & bit;
+    }
+
+    /* Chords once per sample, timed at the last of their lines to go down */
+    for (i = 0; i < s_mapCount; i++)
+    {
+        uint8_t mask = s_pMap[i].mask;
+        uint64_t lastUs = 0;
+
+        if (s_pMap[i].kind != GESTURE_CHORD || !(pressedNow & mask) || (s_state & mask) != mask)
+        {
+            continue;
+        }
+
+        for (n = 0; n < BUTTON_GESTURE_LINES; n++)
+        {
+            if ((pressedNow & mask & (1u << n)) && s_edgeUs[n] > lastUs)
+            {
+                lastUs = s_edgeUs[n];
+            }
+        }
+
+        LOG_INFO(LOG_MOD_INPUT, "[BTN] Chord 0x%02X\n", mask);
+        Button_SendEventAt(s_pMap[i].event, lastUs);
+    }
+}
@@ -0,0 +1,124 @@
+/*************************************************************************************************/
+/*!
+ *  \file   button_gesture.h
+ *
+ *  \brief  Bit-parallel debouncer and table-driven gesture engine for up to 8 inputs.
+ *
+ *  Raw samples go through a vertical counter: each line has a 2-bit counter spread across
+ *  two bytes, so all 8 lines debounce together in a handful of bitwise operations and a
+ *  bouncing line does not hold back the others. A line changes state after
+ *  BUTTON_DEBOUNCE_SAMPLES consecutive samples that differ from its debounced state.
+ *
+ *  Debounced edges are matched against a table of gestures (press, release, long press,
+ *  double press, chord); each match is sent with Button_SendEventAt(). Every event carries
+ *  the time of the sample in which its line first changed, so contact bounce does not
+ *  move it.
+ *
+ *  Single instance; call from one task only.
+ */
+/*************************************************************************************************/
+
+#ifndef INPUT_BUTTON_GESTURE_H
+#define INPUT_BUTTON_GESTURE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "buttons.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**************************************************************************************************
+  Constants
+**************************************************************************************************/
+
+#define BUTTON_GESTURE_LINES        8           /* Inputs, one bit each */
+#define BUTTON_DEBOUNCE_SAMPLES     4           /* Differing samples before a line changes */
+#define BUTTON_LONG_PRESS_US        1500000u    /* Hold time for GESTURE_LONG */
+#define BUTTON_DOUBLE_PRESS_US      400000u     /* Press-to-press time for GESTURE_DOUBLE */
+#define BUTTON_GESTURE_NO_DEADLINE  UINT64_MAX  /* ButtonGesture_NextDeadlineUs(): none due */
+
+/**************************************************************************************************
+  Type Definitions
+**************************************************************************************************/
+
+/*! Gesture kinds */
+typedef enum
+{
+    GESTURE_PRESS,      /*!< Line pressed */
+    GESTURE_RELEASE,    /*!< Line released */
+    GESTURE_LONG,       /*!< Line held for BUTTON_LONG_PRESS_US (once per press) */
+    GESTURE_DOUBLE,     /*!< Second press within BUTTON_DOUBLE_PRESS_US of the first */
+    GESTURE_CHORD       /*!< Every line of the mask held; sent when the last one goes down */
+} ButtonGestureKind_t;
+
+/*! Gesture table entry. PRESS, RELEASE, LONG and DOUBLE match any line in mask. */
+typedef struct
+{
+    uint8_t mask;               /*!< Line bits (bit n = input n) */
+    ButtonGestureKind_t kind;   /*!< Gesture */
+    ButtonEventType_t event;    /*!< Event sent on a match */
+} ButtonGestureMap_t;
+
+/**************************************************************************************************
+  Function Declarations
+**************************************************************************************************/
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Set the gesture table and the initial line states.
+ *
+ *  \param  pMap        Gesture table (kept by reference).
+ *  \param  count       Table entries.
+ *  \param  pressed     Lines held at start (bit set = pressed); they send no events.
+ */
+/*************************************************************************************************/
+void ButtonGesture_Init(const ButtonGestureMap_t *pMap, uint8_t count, uint8_t pressed);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Feed one raw sample of all lines.
+ *
+ *  \param  pressed     Raw line states (bit set = pressed).
+ *  \param  sampleUs    Time of the first change the sample can contain (Time_GetUs64()
+ *                      timebase), e.g. the interrupt edge that prompted the read.
+ *
+ *  \return true once every line has settled: BUTTON_DEBOUNCE_SAMPLES samples in a row equal
+ *          to the debounced state.
+ */
+/*************************************************************************************************/
+bool ButtonGesture_Sample(uint8_t pressed, uint64_t sampleUs);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Send the time-based gestures (long press) that are due.
+ *
+ *  \param  nowUs       Current time (Time_GetUs64() timebase).
+ */
+/*************************************************************************************************/
+void ButtonGesture_Tick(uint64_t nowUs);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Get when ButtonGesture_Tick() next has work.
+ *
+ *  \return Time in the Time_GetUs64() timebase, or BUTTON_GESTURE_NO_DEADLINE.
+ */
+/*************************************************************************************************/
+uint64_t ButtonGesture_NextDeadlineUs(void);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Get the debounced line states.
+ *
+ *  \return Bit set = pressed.
+ */
+/*************************************************************************************************/
+uint8_t ButtonGesture_GetPressed(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INPUT_BUTTON_GESTURE_H */
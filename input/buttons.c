@@ -24,7 +24,6 @@
   Macros
 **************************************************************************************************/
 
-#define BUTTON_QUEUE_LENGTH     8
 #define TEST_TASK_STACK_SIZE    256
 #define TEST_TASK_PRIORITY      (tskIDLE_PRIORITY + 1)
 
@@ -89,6 +88,12 @@ bool Button_Init(void)
 
 /*************************************************************************************************/
 bool Button_SendEvent(ButtonEventType_t type)
+{
+    return Button_SendEventAt(type, Time_GetUs64());
+}
+
+/*************************************************************************************************/
+bool Button_SendEventAt(ButtonEventType_t type, uint64_t timestamp_us)
 {
     if (g_buttonQueue == NULL)
     {
@@ -97,7 +102,8 @@ bool Button_SendEvent(ButtonEventType_t type)
     
     ButtonEvent_t event;
     event.type = type;
-    event.timestamp_ms = Time_GetMs();
+    event.timestamp_us = timestamp_us;
+    event.arg = 0;
     
     if (xQueueSend(g_buttonQueue, &event, 0) != pdTRUE)
     {
@@ -144,6 +150,7 @@ void Button_PrintHelp(void)
     printf("  l = LAP (record lap time)\n");
     printf("  x = STOP / PAUSE workout\n");
     printf("  m = MODE (cycle workout mode)\n");
+    printf("  r = RESET (end / clear workout)\n");
     printf("  ? = STATUS (print current state)\n");
     printf("  h = HELP (show this menu)\n");
     printf("========================================\n");
@@ -187,7 +194,7 @@ static void testInputTask(void *pvParameters)
     (void)pvParameters;
     int ch;
     
-    printf("[TEST] Ready for keyboard input (s/l/x/m/?/h)...\n");
+    printf("[TEST] Ready for keyboard input (s/l/x/m/r/?/h)...\n");
     
     while (1)
     {
@@ -224,6 +231,12 @@ static void testInputTask(void *pvParameters)
                     printf("\n[INPUT] -> MODE\n");
                     break;
                     
+                case 'r':
+                case 'R':
+                    eventType = BTN_RESET;
+                    printf("\n[INPUT] -> RESET\n");
+                    break;
+                    
                 case '?':
                     eventType = BTN_STATUS;
                     break;
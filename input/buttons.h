@@ -22,6 +22,12 @@
 extern "C" {
 #endif
 
+/**************************************************************************************************
+  Constants
+**************************************************************************************************/
+
+#define BUTTON_QUEUE_LENGTH     8   /*!< Depth of g_buttonQueue */
+
 /**************************************************************************************************
   Type Definitions
 **************************************************************************************************/
@@ -34,14 +40,18 @@ typedef enum
     BTN_LAP,           /*!< Record a lap */
     BTN_STOP,          /*!< Stop/Pause workout */
     BTN_MODE_NEXT,     /*!< Cycle to next workout mode (when idle) */
-    BTN_STATUS         /*!< Print current status (debug) */
+    BTN_STATUS,        /*!< Print current status (debug) */
+    BTN_RESET,         /*!< End a paused workout and clear a finished one */
+    BTN_MODE_SET,      /*!< Select workout mode arg (when idle); from the BLE mode command */
+    BTN_HR_DONE        /*!< End the recovery HR window now; from the BLE hr_done command */
 } ButtonEventType_t;
 
 /*! Button event structure - sent via queue to ControlTask */
 typedef struct
 {
     ButtonEventType_t type;     /*!< Which button event */
-    uint32_t timestamp_ms;      /*!< When button was pressed */
+    uint64_t timestamp_us;      /*!< When button was pressed (Time_GetUs64() timebase) */
+    uint8_t arg;                /*!< BTN_MODE_SET: WorkoutMode_t, otherwise 0 */
 } ButtonEvent_t;
 
 /**************************************************************************************************
@@ -77,6 +87,18 @@ bool Button_Init(void);
 /*************************************************************************************************/
 bool Button_SendEvent(ButtonEventType_t type);
 
+/*************************************************************************************************/
+/*!
+ *  \brief  Send a button event with the time the press was detected.
+ *
+ *  \param  type            Button event type.
+ *  \param  timestamp_us    Press time, e.g. Time_CaptureToUs64() of a stamp taken at the edge.
+ *
+ *  \return true if event was queued, false if queue full.
+ */
+/*************************************************************************************************/
+bool Button_SendEventAt(ButtonEventType_t type, uint64_t timestamp_us);
+
 /*************************************************************************************************/
 /*!
  *  \brief  Start the serial test input task.
@@ -86,6 +108,7 @@ bool Button_SendEvent(ButtonEventType_t type);
  *  - 'l' or 'L' = BTN_LAP  
  *  - 'x' or 'X' = BTN_STOP
  *  - 'm' or 'M' = BTN_MODE_NEXT
+ *  - 'r' or 'R' = BTN_RESET
  *  - '?' = BTN_STATUS (print current state)
  *
  *  \return true if task created, false otherwise.
@@ -0,0 +1,74 @@
+/*************************************************************************************************/
+/*!
+ *  \file   gpio_irq.c
+ *
+ *  \brief  GPIO port 0 interrupt implementation: one vector, per-pin MSDK callbacks.
+ */
+/*************************************************************************************************/
+
+#include "gpio_irq.h"
+#include "FreeRTOS.h"
+#include <stdio.h>
+
+/* Maxim SDK includes */
+#include "mxc_device.h"
+
+/**************************************************************************************************
+  Macros
+**************************************************************************************************/
+
+#define GPIO_IRQ_PORT           MXC_GPIO0
+#define GPIO_IRQ_IRQn           GPIO0_IRQn
+#define GPIO_IRQ_HANDLER        GPIO0_IRQHandler
+
+/* The pin callbacks wake tasks with the FromISR calls */
+#define GPIO_IRQ_PRIORITY       (configMAX_PRIORITIES - 1)
+
+/**************************************************************************************************
+  Local Variables
+**************************************************************************************************/
+
+static bool s_irqEnabled = false;
+
+/**************************************************************************************************
+  Public Functions
+**************************************************************************************************/
+
+/*************************************************************************************************/
+bool GpioIrq_Register(const mxc_gpio_cfg_t *pPin, mxc_gpio_int_pol_t pol,
+                      mxc_gpio_callback_fn callback, void *pCbData)
+{
+    if (pPin == NULL || pPin->port != GPIO_IRQ_PORT || callback == NULL)
+    {
+        return false;
+    }
+
+    if (MXC_GPIO_Config(pPin) != E_NO_ERROR)
+    {
+        printf("[GPIO] ERROR: Pin config failed (mask 0x%08lx)\n", (unsigned long)pPin->mask);
+        return false;
+    }
+
+    MXC_GPIO_RegisterCallback(pPin, callback, pCbData);
+    MXC_GPIO_IntConfig(pPin, pol);
+    MXC_GPIO_EnableInt(pPin->port, pPin->mask);
+
+    if (!s_irqEnabled)
+    {
+        NVIC_SetPriority(GPIO_IRQ_IRQn, GPIO_IRQ_PRIORITY);
+        NVIC_EnableIRQ(GPIO_IRQ_IRQn);
+        s_irqEnabled = true;
+    }
+
+    return true;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  GPIO port 0 interrupt: dispatches to the registered pin callbacks.
+ */
+/*************************************************************************************************/
+void GPIO_IRQ_HANDLER(void)
+{
+    MXC_GPIO_Handler(MXC_GPIO_GET_IDX(GPIO_IRQ_PORT));
+}
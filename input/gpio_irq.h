@@ -0,0 +1,53 @@
+/*************************************************************************************************/
+/*!
+ *  \file   gpio_irq.h
+ *
+ *  \brief  GPIO port 0 interrupt, shared by the MAX7325 and MAX30102 INT lines.
+ *
+ *  The port has one interrupt vector for all of its pins. This module owns it:
+ *  GPIO0_IRQHandler runs the MSDK pin dispatcher, which calls the callback registered for
+ *  each pin that has a pending edge. Drivers register their pin here instead of setting up
+ *  the vector themselves, so its priority is set in one place.
+ */
+/*************************************************************************************************/
+
+#ifndef INPUT_GPIO_IRQ_H
+#define INPUT_GPIO_IRQ_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "gpio.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**************************************************************************************************
+  Function Declarations
+**************************************************************************************************/
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Configure a port 0 pin as an interrupt input and register its callback.
+ *
+ *  The first registration sets the port's interrupt priority and enables it. Callbacks run
+ *  in ISR context, so they may only use the FromISR kernel calls. Call before the scheduler
+ *  starts.
+ *
+ *  \param  pPin        Pin configuration (port 0 only).
+ *  \param  pol         Edge or level that raises the interrupt.
+ *  \param  callback    Called from the interrupt for this pin.
+ *  \param  pCbData     Passed to the callback.
+ *
+ *  \return true if the pin is configured and its interrupt enabled.
+ */
+/*************************************************************************************************/
+bool GpioIrq_Register(const mxc_gpio_cfg_t *pPin, mxc_gpio_int_pol_t pol,
+                      mxc_gpio_callback_fn callback, void *pCbData);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INPUT_GPIO_IRQ_H */
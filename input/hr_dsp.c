@@ -0,0 +1,511 @@
+/*************************************************************************************************/
+/*!
+ *  \file   hr_dsp.c
+ *
+ *  \brief  Fixed-point heart rate pipeline implementation.
+ */
+/*************************************************************************************************/
+
+#include "hr_dsp.h"
+#include <stddef.h>
+#include <string.h>
+
+/**************************************************************************************************
+  Macros
+**************************************************************************************************/
+
+/* Baseline tracker: dc += (x - dc) / 128 per sample, kept in Q8 */
+#define HR_DSP_DC_SHIFT         7
+#define HR_DSP_DC_FRAC          8
+
+/* RBJ band-pass, f0 = 1.41 Hz (geometric centre of 0.5-4 Hz), 3 octaves, fs = 100 Hz.
+ * b1 is 0 and b2 is -b0; a0 is normalized to 1. Q28. */
+#define HR_DSP_BQ_SHIFT         28
+#define HR_DSP_BQ_B0            26602705
+#define HR_DSP_BQ_A1            (-481757323)
+#define HR_DSP_BQ_A2            215230046
+
+/* Filter transient after a reset before peaks count */
+#define HR_DSP_SETTLE_SAMPLES   (HR_DSP_SAMPLE_RATE_HZ * 3 / 2)
+
+/* Envelope of beat heights: decays by 1/512 per sample (half in 3.5 s) */
+#define HR_DSP_ENV_DECAY_SHIFT  9
+#define HR_DSP_ENV_GAIN_SHIFT   2
+
+/* Peak times and intervals are in samples, Q8. The refractory floor and the longest
+ * interval leave room for beat-to-beat variation at the ends of the BPM range. */
+#define HR_DSP_TIME_FRAC        8
+#define HR_DSP_MIN_INTERVAL     (HR_DSP_SAMPLE_RATE_HZ * 60 * 3 / 5 / HR_DSP_MAX_BPM)
+#define HR_DSP_MAX_INTERVAL_Q8  ((uint32_t)(HR_DSP_SAMPLE_RATE_HZ * 60 * 5 / 4 / HR_DSP_MIN_BPM) \
+                                 << HR_DSP_TIME_FRAC)
+#define HR_DSP_BPM_NUM_Q8       ((uint32_t)(HR_DSP_SAMPLE_RATE_HZ * 60) << HR_DSP_TIME_FRAC)
+
+/* SpO2 from the ratio of ratios R = (AC_red / DC_red) / (AC_ir / DC_ir), Q10, by Maxim's
+ * empirical curve for the MAX30102 reference design: -45.060 R^2 + 30.354 R + 94.845.
+ * Coefficients x1000. */
+#define HR_DSP_R_FRAC           10
+#define HR_DSP_SPO2_C2          (-45060)
+#define HR_DSP_SPO2_C1          30354
+#define HR_DSP_SPO2_C0          94845
+
+/**************************************************************************************************
+  Data Types
+**************************************************************************************************/
+
+/* Baseline tracker and band-pass state of one LED channel */
+typedef struct
+{
+    int32_t dcQ8;
+    int32_t x1, x2;
+    int32_t y1, y2;     /* y1 is the latest output */
+} HrDspChannel_t;
+
+/**************************************************************************************************
+  Local Variables
+**************************************************************************************************/
+
+static bool s_primed = false;
+static bool s_fingerPresent = false;
+
+/* Filters */
+static HrDspChannel_t s_ir;
+static HrDspChannel_t s_red;
+
+/* Pulse amplitude of each channel over the current beat: filter output extremes */
+static int32_t s_irMax, s_irMin;
+static int32_t s_redMax, s_redMin;
+
+/* Peak detector: the two previous inverted filter outputs, and the lowest output since the
+ * last beat; beat heights are taken from it so that baseline wander does not move them */
+static int32_t s_v1, s_v2;
+static int32_t s_trough;
+static uint32_t s_sampleIndex;
+static uint16_t s_settle;
+static int32_t s_envelope;
+static uint16_t s_refractory;
+static bool s_havePeak;
+static uint32_t s_lastPeakQ8;
+
+/* Beat intervals (ring, Q8 samples) */
+static uint32_t s_intervals[HR_DSP_INTERVALS];
+static uint8_t s_intervalCount;
+static uint8_t s_intervalNext;
+
+/* Ratio of ratios per beat (ring, Q10) */
+static uint32_t s_ratios[HR_DSP_INTERVALS];
+static uint8_t s_ratioCount;
+static uint8_t s_ratioNext;
+
+/* Output */
+static uint16_t s_bpm;
+static uint8_t s_confidence;
+static uint8_t s_spo2;
+static uint8_t s_spo2Quality;
+
+/**************************************************************************************************
+  Local Function Prototypes
+**************************************************************************************************/
+
+static void resetBeats(void);
+static void loseRhythm(void);
+static void resetFilters(int32_t red, int32_t ir);
+static int32_t filterSample(HrDspChannel_t *pCh, int32_t x);
+static uint32_t sortedMedian(const uint32_t *pValues, uint8_t count, uint32_t *pSorted);
+static void addPeak(int32_t prev, int32_t peak, int32_t next);
+static void updateRate(void);
+static void addRatio(void);
+static void processSample(int32_t red, int32_t ir);
+
+/**************************************************************************************************
+  Public Functions
+**************************************************************************************************/
+
+/*************************************************************************************************/
+void HrDsp_Init(void)
+{
+    s_primed = false;
+    s_fingerPresent = false;
+    s_sampleIndex = 0;
+    resetFilters(0, 0);
+    resetBeats();
+}
+
+/*************************************************************************************************/
+void HrDsp_Process(const PpgSample_t *pSamples, uint16_t count)
+{
+    uint16_t i;
+
+    if (pSamples == NULL)
+    {
+        return;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        processSample((int32_t)pSamples[i].red, (int32_t)pSamples[i].ir);
+    }
+}
+
+/*************************************************************************************************/
+void HrDsp_GetResult(HrDspResult_t *pResult)
+{
+    if (pResult == NULL)
+    {
+        return;
+    }
+
+    pResult->fingerPresent = s_fingerPresent;
+    pResult->bpm = s_fingerPresent ? s_bpm : 0;
+    pResult->confidence = s_fingerPresent ? s_confidence : 0;
+    pResult->valid = s_fingerPresent && pResult->bpm != 0 &&
+                     pResult->confidence >= HR_DSP_VALID_CONFIDENCE;
+    pResult->spo2 = s_fingerPresent ? s_spo2 : 0;
+    pResult->spo2Quality = s_fingerPresent ? s_spo2Quality : 0;
+}
+
+/**************************************************************************************************
+  Local Functions
+**************************************************************************************************/
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Forget all beats and wait for the filters to settle again.
+ */
+/*************************************************************************************************/
+static void resetBeats(void)
+{
+    s_settle = HR_DSP_SETTLE_SAMPLES;
+    s_envelope = 0;
+    s_trough = 0;
+    s_havePeak = false;
+    loseRhythm();
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Drop the interval history; the next beat starts a new one.
+ */
+/*************************************************************************************************/
+static void loseRhythm(void)
+{
+    s_intervalCount = 0;
+    s_intervalNext = 0;
+    s_ratioCount = 0;
+    s_ratioNext = 0;
+    s_refractory = HR_DSP_MIN_INTERVAL;
+    s_bpm = 0;
+    s_confidence = 0;
+    s_spo2 = 0;
+    s_spo2Quality = 0;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Start the filters at rest on baselines of red and ir.
+ */
+/*************************************************************************************************/
+static void resetFilters(int32_t red, int32_t ir)
+{
+    memset(&s_ir, 0, sizeof(s_ir));
+    memset(&s_red, 0, sizeof(s_red));
+    s_ir.dcQ8 = ir << HR_DSP_DC_FRAC;
+    s_red.dcQ8 = red << HR_DSP_DC_FRAC;
+    s_irMax = s_irMin = 0;
+    s_redMax = s_redMin = 0;
+    s_v1 = s_v2 = 0;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  DC removal and band-pass for one sample of one channel.
+ *
+ *  \return Band-passed sample.
+ */
+/*************************************************************************************************/
+static int32_t filterSample(HrDspChannel_t *pCh, int32_t x)
+{
+    int32_t ac;
+    int32_t y;
+    int64_t acc;
+
+    /* 1. DC removal */
+    ac = x - (pCh->dcQ8 >> HR_DSP_DC_FRAC);
+    pCh->dcQ8 += ((x << HR_DSP_DC_FRAC) - pCh->dcQ8) >> HR_DSP_DC_SHIFT;
+
+    /* 2. Band-pass biquad, direct form I */
+    acc = (int64_t)HR_DSP_BQ_B0 * (ac - pCh->x2)
+          - (int64_t)HR_DSP_BQ_A1 * pCh->y1
+          - (int64_t)HR_DSP_BQ_A2 * pCh->y2;
+    y = (int32_t)((acc + (1 << (HR_DSP_BQ_SHIFT - 1))) >> HR_DSP_BQ_SHIFT);
+    pCh->x2 = pCh->x1;
+    pCh->x1 = ac;
+    pCh->y2 = pCh->y1;
+    pCh->y1 = y;
+
+    return y;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Sort a short history (insertion sort) and take its median.
+ *
+ *  \param  pValues     History, any order.
+ *  \param  count       Entries, at most HR_DSP_INTERVALS.
+ *  \param  pSorted     Filled with the sorted history.
+ *
+ *  \return The median (upper one for an even count).
+ */
+/*************************************************************************************************/
+static uint32_t sortedMedian(const uint32_t *pValues, uint8_t count, uint32_t *pSorted)
+{
+    uint8_t i;
+    uint8_t j;
+
+    for (i = 0; i < count; i++)
+    {
+        uint32_t v = pValues[i];
+
+        for (j = i; j > 0 && pSorted[j - 1] > v; j--)
+        {
+            pSorted[j] = pSorted[j - 1];
+        }
+        pSorted[j] = v;
+    }
+
+    return pSorted[count / 2];
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Record a beat at the sample before the current one.
+ *
+ *  \param  prev        Inverted filter output two samples ago.
+ *  \param  peak        The local maximum (previous sample).
+ *  \param  next        The current sample.
+ */
+/*************************************************************************************************/
+static void addPeak(int32_t prev, int32_t peak, int32_t next)
+{
+    /* Vertex of the parabola through the three points, within +-1/2 sample; the
+     * denominator is negative because peak is a strict maximum on its left */
+    int32_t offsetQ8 = (prev - next) * (1 << (HR_DSP_TIME_FRAC - 1)) / (prev - 2 * peak + next);
+    uint32_t peakQ8 = ((s_sampleIndex - 1) << HR_DSP_TIME_FRAC) + (uint32_t)offsetQ8;
+    uint32_t interval = peakQ8 - s_lastPeakQ8;
+    int32_t height = peak - s_trough;
+
+    s_envelope = (s_envelope == 0) ? height
+                                   : s_envelope + ((height - s_envelope) >> HR_DSP_ENV_GAIN_SHIFT);
+    s_trough = next;
+
+    if (s_havePeak)
+    {
+        if (interval <= HR_DSP_MAX_INTERVAL_Q8)
+        {
+            s_intervals[s_intervalNext] = interval;
+            s_intervalNext = (s_intervalNext + 1) % HR_DSP_INTERVALS;
+            if (s_intervalCount < HR_DSP_INTERVALS)
+            {
+                s_intervalCount++;
+            }
+            updateRate();
+            addRatio();
+        }
+        else
+        {
+            /* Too long for a single beat: the history no longer describes this rhythm */
+            loseRhythm();
+        }
+    }
+
+    s_havePeak = true;
+    s_lastPeakQ8 = peakQ8;
+
+    /* The next beat's pulse amplitude starts here */
+    s_irMax = s_irMin = s_ir.y1;
+    s_redMax = s_redMin = s_red.y1;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Derive BPM, confidence and the refractory period from the interval history.
+ */
+/*************************************************************************************************/
+static void updateRate(void)
+{
+    uint32_t sorted[HR_DSP_INTERVALS];
+    uint32_t median;
+    uint32_t spread = 0;
+    int32_t confidence;
+    uint8_t i;
+
+    median = sortedMedian(s_intervals, s_intervalCount, sorted);
+
+    if (s_intervalCount < HR_DSP_MIN_INTERVALS)
+    {
+        s_bpm = 0;
+        s_confidence = 0;
+        return;
+    }
+
+    /* Blanks the diastolic wave once the rhythm is known, but not a beat that comes early */
+    s_refractory = (uint16_t)((median * 3 / 5) >> HR_DSP_TIME_FRAC);
+    if (s_refractory < HR_DSP_MIN_INTERVAL)
+    {
+        s_refractory = HR_DSP_MIN_INTERVAL;
+    }
+
+    for (i = 0; i < s_intervalCount; i++)
+    {
+        spread += (sorted[i] > median) ? sorted[i] - median : median - sorted[i];
+    }
+
+    /* 100 for a steady rhythm, 0 once the mean deviation reaches half the median; a
+     * short history caps it in proportion */
+    confidence = 100 - (int32_t)((spread * 200u) / (median * s_intervalCount));
+    if (confidence < 0)
+    {
+        confidence = 0;
+    }
+
+    s_confidence = (uint8_t)(confidence * s_intervalCount / HR_DSP_INTERVALS);
+    s_bpm = (uint16_t)((HR_DSP_BPM_NUM_Q8 + median / 2) / median);
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Take the ratio of ratios of the beat that just ended and update SpO2.
+ *
+ *  AC is each channel's band-passed peak-to-peak over the beat, DC its baseline tracker;
+ *  both come from the single pass that feeds the beat detector. SpO2 uses the median R
+ *  of the last HR_DSP_INTERVALS beats. Its quality falls with the spread of those R
+ *  values and is capped by the heart rate confidence, since R is only as good as the
+ *  beats it is measured over.
+ */
+/*************************************************************************************************/
+static void addRatio(void)
+{
+    uint32_t sorted[HR_DSP_INTERVALS];
+    int32_t acIr = s_irMax - s_irMin;
+    int32_t acRed = s_redMax - s_redMin;
+    int32_t dcIr = s_ir.dcQ8 >> HR_DSP_DC_FRAC;
+    int32_t dcRed = s_red.dcQ8 >> HR_DSP_DC_FRAC;
+    uint64_t ratio;
+    uint32_t median;
+    uint32_t spread = 0;
+    int64_t spo2x1000;
+    int32_t quality;
+    uint8_t i;
+
+    if (acIr <= 0 || acRed <= 0 || dcIr <= 0 || dcRed <= 0)
+    {
+        return;
+    }
+
+    ratio = (((uint64_t)acRed * (uint32_t)dcIr) << HR_DSP_R_FRAC) /
+            ((uint64_t)acIr * (uint32_t)dcRed);
+
+    s_ratios[s_ratioNext] = (ratio > UINT16_MAX) ? UINT16_MAX : (uint32_t)ratio;
+    s_ratioNext = (s_ratioNext + 1) % HR_DSP_INTERVALS;
+    if (s_ratioCount < HR_DSP_INTERVALS)
+    {
+        s_ratioCount++;
+    }
+
+    if (s_ratioCount < HR_DSP_MIN_INTERVALS)
+    {
+        s_spo2 = 0;
+        s_spo2Quality = 0;
+        return;
+    }
+
+    median = sortedMedian(s_ratios, s_ratioCount, sorted);
+    for (i = 0; i < s_ratioCount; i++)
+    {
+        spread += (sorted[i] > median) ? sorted[i] - median : median - sorted[i];
+    }
+
+    /* R holds much steadier than the beat interval: 100 for a steady R, 0 once the mean
+     * deviation reaches a quarter of the median */
+    quality = 100 - (int32_t)((spread * 400u) / (median * s_ratioCount));
+    quality = (quality < 0) ? 0 : quality * s_ratioCount / HR_DSP_INTERVALS;
+    s_spo2Quality = (uint8_t)((quality < s_confidence) ? quality : s_confidence);
+
+    spo2x1000 = (((int64_t)HR_DSP_SPO2_C2 * median * median) >> (2 * HR_DSP_R_FRAC)) +
+                (((int64_t)HR_DSP_SPO2_C1 * median) >> HR_DSP_R_FRAC) + HR_DSP_SPO2_C0;
+    spo2x1000 = (spo2x1000 + 500) / 1000;
+    s_spo2 = (uint8_t)((spo2x1000 < 0) ? 0 : (spo2x1000 > 100) ? 100 : spo2x1000);
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Run one sample through the pipeline.
+ */
+/*************************************************************************************************/
+static void processSample(int32_t red, int32_t ir)
+{
+    bool finger;
+    int32_t y;
+    int32_t v;
+
+    if (!s_primed)
+    {
+        s_primed = true;
+        resetFilters(red, ir);
+    }
+
+    /* Finger detection on the baseline; placing a finger is a step the filters would
+     * ring on for seconds, so they restart from it */
+    finger = (s_ir.dcQ8 >> HR_DSP_DC_FRAC) > HR_DSP_FINGER_THRESHOLD;
+    if (finger != s_fingerPresent)
+    {
+        s_fingerPresent = finger;
+        if (finger)
+        {
+            resetFilters(red, ir);
+        }
+        resetBeats();
+    }
+
+    /* 1-2. DC removal and band-pass, both channels */
+    y = filterSample(&s_ir, ir);
+    (void)filterSample(&s_red, red);
+
+    s_irMax = (y > s_irMax) ? y : s_irMax;
+    s_irMin = (y < s_irMin) ? y : s_irMin;
+    s_redMax = (s_red.y1 > s_redMax) ? s_red.y1 : s_redMax;
+    s_redMin = (s_red.y1 < s_redMin) ? s_red.y1 : s_redMin;
+
+    /* 3. Peaks of the inverted signal: more blood, less reflected IR. A beat must rise
+     * 5/8 of the usual beat height from the last trough, and clear a quarter of it above
+     * the filter's zero line, which the bumps in the filter's own undershoot do not */
+    v = -y;
+    s_sampleIndex++;
+
+    if (s_settle > 0)
+    {
+        s_settle--;
+    }
+    else if (s_v1 > s_v2 && s_v1 >= v && s_v1 - s_trough > ((s_envelope * 5) >> 3) &&
+             s_v1 > (s_envelope >> 2) &&
+             (!s_havePeak || ((s_sampleIndex - 1) << HR_DSP_TIME_FRAC) - s_lastPeakQ8 >=
+                             ((uint32_t)s_refractory << HR_DSP_TIME_FRAC)))
+    {
+        addPeak(s_v2, s_v1, v);
+    }
+
+    s_envelope -= s_envelope >> HR_DSP_ENV_DECAY_SHIFT;
+    if (v < s_trough)
+    {
+        s_trough = v;
+    }
+
+    /* No beat for longer than the slowest rate: the rhythm is lost */
+    if (s_havePeak && (s_sampleIndex << HR_DSP_TIME_FRAC) - s_lastPeakQ8 > HR_DSP_MAX_INTERVAL_Q8)
+    {
+        s_havePeak = false;
+        loseRhythm();
+    }
+
+    s_v2 = s_v1;
+    s_v1 = v;
+}
@@ -0,0 +1,109 @@
+/*************************************************************************************************/
+/*!
+ *  \file   hr_dsp.h
+ *
+ *  \brief  Fixed-point heart rate and SpO2 pipeline for 100 Hz PPG samples.
+ *
+ *  Both channels go through, one sample at a time:
+ *  1. DC removal: a one-pole tracker of the baseline (time constant 1.28 s) is subtracted.
+ *  2. Band-pass: one biquad, 0.5-4 Hz, Q28 coefficients, 64-bit accumulator.
+ *  The IR output then goes through:
+ *  3. Peak detection: local maxima of the inverted signal (blood absorbs IR, so a beat is
+ *     a dip) that rise 5/8 of a decaying envelope of recent beat heights above the last
+ *     trough, outside a refractory period of 60% of the current beat interval. Peaks are
+ *     placed to 1/256 sample by a parabola through the three samples around them.
+ *  4. Beat intervals: the median of the last HR_DSP_INTERVALS gives the BPM.
+ *  5. Confidence: from the spread of those intervals around their median.
+ *  6. SpO2: each beat's ratio of ratios R = (AC_red / DC_red) / (AC_ir / DC_ir), AC being
+ *     the band-passed peak-to-peak over the beat and DC the baseline of step 1; the median
+ *     R of the last HR_DSP_INTERVALS beats is mapped by Maxim's empirical MAX30102 curve,
+ *     which needs calibrating against a reference oximeter for clinical use. Its quality
+ *     comes from the spread of R and is capped by the confidence of step 5.
+ *
+ *  The per-sample path has no loops and no divisions; a detected beat adds two sorts of
+ *  HR_DSP_INTERVALS values, four 32-bit divisions and two 64-bit ones. Integer only, so it
+ *  costs the same with or without the FPU.
+ *
+ *  Single instance; call from one task only.
+ */
+/*************************************************************************************************/
+
+#ifndef INPUT_HR_DSP_H
+#define INPUT_HR_DSP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**************************************************************************************************
+  Constants
+**************************************************************************************************/
+
+#define HR_DSP_SAMPLE_RATE_HZ       100     /* Input rate the filter is designed for */
+#define HR_DSP_INTERVALS            5       /* Beat intervals in the median */
+#define HR_DSP_MIN_INTERVALS        3       /* Intervals needed before a BPM is reported */
+#define HR_DSP_MIN_BPM              30
+#define HR_DSP_MAX_BPM              220
+#define HR_DSP_FINGER_THRESHOLD     50000   /* IR baseline (ADC counts) with a finger on */
+#define HR_DSP_VALID_CONFIDENCE     50      /* Confidence at which a result is valid */
+
+/**************************************************************************************************
+  Type Definitions
+**************************************************************************************************/
+
+/*! One FIFO entry, 18-bit ADC counts */
+typedef struct
+{
+    uint32_t red;
+    uint32_t ir;
+} PpgSample_t;
+
+/*! Pipeline output */
+typedef struct
+{
+    uint16_t bpm;           /*!< Median-interval heart rate, 0 until enough beats */
+    uint8_t confidence;     /*!< 0-100 */
+    bool fingerPresent;     /*!< IR baseline above HR_DSP_FINGER_THRESHOLD */
+    bool valid;             /*!< Finger present and confidence >= HR_DSP_VALID_CONFIDENCE */
+    uint8_t spo2;           /*!< Percent, 0 until enough beats */
+    uint8_t spo2Quality;    /*!< 0-100, at most confidence */
+} HrDspResult_t;
+
+/**************************************************************************************************
+  Function Declarations
+**************************************************************************************************/
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Clear the filters and the beat history (start of a measurement).
+ */
+/*************************************************************************************************/
+void HrDsp_Init(void);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Run consecutive samples through the pipeline.
+ *
+ *  \param  pSamples    Samples, oldest first, at HR_DSP_SAMPLE_RATE_HZ.
+ *  \param  count       Number of samples.
+ */
+/*************************************************************************************************/
+void HrDsp_Process(const PpgSample_t *pSamples, uint16_t count);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Get the result as of the last sample processed.
+ *
+ *  \param  pResult     Filled in.
+ */
+/*************************************************************************************************/
+void HrDsp_GetResult(HrDspResult_t *pResult);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INPUT_HR_DSP_H */
@@ -0,0 +1,223 @@
+/*************************************************************************************************/
+/*!
+ *  \file   i2c_bus.c
+ *
+ *  \brief  Shared I2C bus implementation: mutex-serialized, interrupt-driven transfers.
+ */
+/*************************************************************************************************/
+
+#include "i2c_bus.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include <stdio.h>
+
+/* Maxim SDK includes */
+#include "mxc_device.h"
+#include "i2c.h"
+
+/**************************************************************************************************
+  Macros
+**************************************************************************************************/
+
+/* MXC_I2C2 on P0.10 (SCL) / P0.11 (SDA), with the JP21/JP22 pull-ups */
+#define I2C_BUS_INSTANCE        MXC_I2C2
+#define I2C_BUS_IRQn            I2C2_IRQn
+#define I2C_BUS_IRQ_HANDLER     I2C2_IRQHandler
+
+/**************************************************************************************************
+  Local Variables
+**************************************************************************************************/
+
+static StaticSemaphore_t s_busMutexBuffer;
+static SemaphoreHandle_t s_busMutex = NULL;
+
+/* Given by the I2C interrupt when the transfer in progress ends */
+static StaticSemaphore_t s_doneSemBuffer;
+static SemaphoreHandle_t s_doneSem = NULL;
+
+static bool s_initialized = false;
+static volatile bool s_busy = false;
+static volatile int s_doneResult = E_NO_ERROR;
+
+/* Written under the bus mutex */
+static I2cBusStats_t s_stats;
+
+/**************************************************************************************************
+  Local Function Prototypes
+**************************************************************************************************/
+
+static void transferDone(mxc_i2c_req_t *req, int result);
+static void countTransfer(const mxc_i2c_req_t *pReq, int result);
+
+/**************************************************************************************************
+  Public Functions
+**************************************************************************************************/
+
+/*************************************************************************************************/
+bool I2cBus_Init(void)
+{
+    int result;
+
+    if (s_initialized)
+    {
+        return true;
+    }
+
+    /* Shutdown first in case it was already initialized */
+    MXC_I2C_Shutdown(I2C_BUS_INSTANCE);
+
+    result = MXC_I2C_Init(I2C_BUS_INSTANCE, 1, 0); /* master = 1, slave_addr = 0 */
+    if (result != E_NO_ERROR)
+    {
+        printf("[I2C] ERROR: I2C2 init failed (%d)\n", result);
+        return false;
+    }
+
+    /* Returns the frequency actually set, or an error code */
+    result = MXC_I2C_SetFrequency(I2C_BUS_INSTANCE, I2C_BUS_FREQ_HZ);
+    if (result <= 0)
+    {
+        printf("[I2C] ERROR: Cannot run I2C2 at %d Hz (%d)\n", I2C_BUS_FREQ_HZ, result);
+        return false;
+    }
+
+    s_busMutex = xSemaphoreCreateMutexStatic(&s_busMutexBuffer);
+    s_doneSem = xSemaphoreCreateBinaryStatic(&s_doneSemBuffer);
+
+    NVIC_SetPriority(I2C_BUS_IRQn, configMAX_PRIORITIES - 1);
+    NVIC_EnableIRQ(I2C_BUS_IRQn);
+
+    s_initialized = true;
+
+    printf("[I2C] I2C2 at %d kHz (SCL=P0.10, SDA=P0.11)\n", result / 1000);
+    return true;
+}
+
+/*************************************************************************************************/
+int I2cBus_Transfer(uint8_t addr, const uint8_t *pTx, unsigned int txLen, uint8_t *pRx,
+                    unsigned int rxLen)
+{
+    mxc_i2c_req_t req = {0};
+    int result;
+
+    if (!s_initialized)
+    {
+        return E_UNINITIALIZED;
+    }
+
+    req.i2c = I2C_BUS_INSTANCE;
+    req.addr = addr;
+    req.tx_buf = (unsigned char *)pTx; /* Only read from */
+    req.tx_len = txLen;
+    req.rx_buf = pRx;
+    req.rx_len = rxLen;
+    req.restart = 1;
+    req.callback = transferDone;
+
+    /* Single-threaded until the scheduler starts: nothing to collide with or to run */
+    if (xTaskGetSchedulerState() == taskSCHEDULER_NOT_STARTED)
+    {
+        req.callback = NULL;
+        result = MXC_I2C_MasterTransaction(&req);
+        countTransfer(&req, result);
+        return result;
+    }
+
+    if (xSemaphoreTake(s_busMutex, 0) != pdTRUE)
+    {
+        xSemaphoreTake(s_busMutex, portMAX_DELAY);
+        s_stats.waits++;
+    }
+
+    /* Drop a completion left over from an aborted transfer */
+    (void)xSemaphoreTake(s_doneSem, 0);
+
+    s_busy = true;
+    result = MXC_I2C_MasterTransactionAsync(&req);
+    if (result == E_NO_ERROR)
+    {
+        if (xSemaphoreTake(s_doneSem, pdMS_TO_TICKS(I2C_BUS_TIMEOUT_MS)) == pdTRUE)
+        {
+            result = s_doneResult;
+        }
+        else
+        {
+            /* req is on this stack: the driver must let go of it before we return */
+            MXC_I2C_AbortAsync(&req);
+            s_stats.timeouts++;
+            result = E_TIME_OUT;
+        }
+    }
+    s_busy = false;
+
+    countTransfer(&req, result);
+    xSemaphoreGive(s_busMutex);
+
+    return result;
+}
+
+/*************************************************************************************************/
+bool I2cBus_IsBusy(void)
+{
+    return s_busy;
+}
+
+/*************************************************************************************************/
+void I2cBus_GetStats(I2cBusStats_t *pStats)
+{
+    if (pStats != NULL)
+    {
+        taskENTER_CRITICAL();
+        *pStats = s_stats;
+        taskEXIT_CRITICAL();
+    }
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  I2C2 interrupt: advances the transfer in progress.
+ */
+/*************************************************************************************************/
+void I2C_BUS_IRQ_HANDLER(void)
+{
+    MXC_I2C_AsyncHandler(I2C_BUS_INSTANCE);
+}
+
+/**************************************************************************************************
+  Local Functions
+**************************************************************************************************/
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Transfer complete (ISR context): wake the task that started it.
+ */
+/*************************************************************************************************/
+static void transferDone(mxc_i2c_req_t *req, int result)
+{
+    BaseType_t woken = pdFALSE;
+
+    (void)req;
+
+    s_doneResult = result;
+    xSemaphoreGiveFromISR(s_doneSem, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Update the counters for a finished transfer (bus mutex held).
+ */
+/*************************************************************************************************/
+static void countTransfer(const mxc_i2c_req_t *pReq, int result)
+{
+    s_stats.transfers++;
+    if (result == E_NO_ERROR)
+    {
+        s_stats.bytes += pReq->tx_len + pReq->rx_len;
+    }
+    else
+    {
+        s_stats.errors++;
+    }
+}
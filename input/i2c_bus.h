@@ -0,0 +1,107 @@
+/*************************************************************************************************/
+/*!
+ *  \file   i2c_bus.h
+ *
+ *  \brief  Shared I2C bus for the MAX7325 button expander and the MAX30102 PPG sensor.
+ *
+ *  Both devices sit on MXC_I2C2 and are driven from different tasks. Every transfer goes
+ *  through I2cBus_Transfer(), which:
+ *  - takes the bus mutex, so one transfer runs at a time (and a low-priority holder runs
+ *    at the priority of the task waiting for it);
+ *  - starts the transfer on the interrupt-driven MSDK driver;
+ *  - blocks the caller until the I2C interrupt reports completion.
+ *  The CPU runs other tasks, or sleeps in the idle task, for the whole transfer instead of
+ *  polling the controller FIFO.
+ *
+ *  Before the scheduler starts there is no other task to collide with or to run, so
+ *  transfers are made blocking.
+ */
+/*************************************************************************************************/
+
+#ifndef INPUT_I2C_BUS_H
+#define INPUT_I2C_BUS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**************************************************************************************************
+  Constants
+**************************************************************************************************/
+
+#define I2C_BUS_FREQ_HZ         400000  /* Fast mode; both devices support it */
+#define I2C_BUS_TIMEOUT_MS      25      /* A full FIFO burst (193 bytes) takes 17 ms at 100 kHz */
+
+/**************************************************************************************************
+  Type Definitions
+**************************************************************************************************/
+
+/*! Bus counters since I2cBus_Init() */
+typedef struct
+{
+    uint32_t transfers;     /*!< Transfers started */
+    uint32_t errors;        /*!< Transfers that failed (NACK, bus error or timeout) */
+    uint32_t timeouts;      /*!< Transfers aborted after I2C_BUS_TIMEOUT_MS */
+    uint32_t waits;         /*!< Transfers that waited for another one to finish */
+    uint32_t bytes;         /*!< Bytes written plus bytes read */
+} I2cBusStats_t;
+
+/**************************************************************************************************
+  Function Declarations
+**************************************************************************************************/
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Initialize the I2C controller at I2C_BUS_FREQ_HZ and enable its interrupt.
+ *
+ *  Every driver on the bus calls this; only the first call does anything.
+ *
+ *  \return true if the bus is ready.
+ */
+/*************************************************************************************************/
+bool I2cBus_Init(void);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Write then read a device, with a repeated start between the two.
+ *
+ *  Blocks the calling task until the transfer ends; not for ISRs.
+ *
+ *  \param  addr    7-bit device address.
+ *  \param  pTx     Bytes to write (NULL if txLen is 0).
+ *  \param  txLen   Bytes to write.
+ *  \param  pRx     Receives the bytes read (NULL if rxLen is 0).
+ *  \param  rxLen   Bytes to read.
+ *
+ *  \return E_NO_ERROR, E_TIME_OUT after I2C_BUS_TIMEOUT_MS, or the driver's error code.
+ */
+/*************************************************************************************************/
+int I2cBus_Transfer(uint8_t addr, const uint8_t *pTx, unsigned int txLen, uint8_t *pRx,
+                    unsigned int rxLen);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Check for a transfer in progress (the controller must stay clocked).
+ *
+ *  \return true while a transfer runs.
+ */
+/*************************************************************************************************/
+bool I2cBus_IsBusy(void);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Get the bus counters.
+ *
+ *  \param  pStats  Receives a copy of the counters.
+ */
+/*************************************************************************************************/
+void I2cBus_GetStats(I2cBusStats_t *pStats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INPUT_I2C_BUS_H */
@@ -8,7 +8,11 @@
 
 #include "max7325.h"
 #include "buttons.h"
+#include "button_gesture.h"
+#include "i2c_bus.h"
+#include "gpio_irq.h"
 #include "time_utils.h"
+#include "log.h"
 #include "FreeRTOS.h"
 #include "task.h"
 #include <stdio.h>
@@ -16,46 +20,68 @@
 /* Maxim SDK includes */
 #include "mxc_device.h"
 #include "mxc_delay.h"
-#include "i2c.h"
 #include "gpio.h"
+#include "lp.h"
 
 /**************************************************************************************************
   Macros
 **************************************************************************************************/
 
-#define POLLING_TASK_STACK_SIZE 224
-#define POLLING_TASK_PRIORITY (tskIDLE_PRIORITY + 2)
-#define POLLING_INTERVAL_MS 50 /* Poll every 50ms */
-#define DEBOUNCE_COUNT 2       /* Require 2 consecutive reads for valid press */
+#define INPUT_TASK_STACK_SIZE 224
+#define INPUT_TASK_PRIORITY (tskIDLE_PRIORITY + 2)
+#define DEBOUNCE_SAMPLE_MS 2 /* Re-read interval while the port settles after an INT edge */
 
-/* I2C configuration */
-#define I2C_FREQ 100000 /* 100 kHz I2C */
+/* MAX7325 INT (open-drain, active low, released by a port read) on a GPIO wake input */
+#define MAX7325_INT_PORT MXC_GPIO0
+#define MAX7325_INT_PIN MXC_GPIO_PIN_19
 
 /**************************************************************************************************
   Static Memory for FreeRTOS Objects
 **************************************************************************************************/
 
 /* Static task storage */
-static StaticTask_t s_pollingTaskBuffer;
-static StackType_t s_pollingTaskStack[POLLING_TASK_STACK_SIZE];
+static StaticTask_t s_inputTaskBuffer;
+static StackType_t s_inputTaskStack[INPUT_TASK_STACK_SIZE];
 
 /**************************************************************************************************
   Local Variables
 **************************************************************************************************/
 
-static mxc_i2c_regs_t *s_i2c = NULL;
-static TaskHandle_t s_pollingTaskHandle = NULL;
+static TaskHandle_t s_inputTaskHandle = NULL;
 static bool s_initialized = false;
 
-/* Previous button states for edge detection */
-static uint8_t s_prevState = 0xFF; /* All high = not pressed (active low) */
+static mxc_gpio_cfg_t s_intPin = {
+    .port = MAX7325_INT_PORT,
+    .mask = MAX7325_INT_PIN,
+    .func = MXC_GPIO_FUNC_IN,
+    .pad = MXC_GPIO_PAD_PULL_UP,
+    .vssel = MXC_GPIO_VSSEL_VDDIOH,
+};
+
+/* Button gestures (SW1-SW8 are lines 0-7). SW6-SW8 are debounced but have no events yet. */
+static const ButtonGestureMap_t s_gestureMap[] = {
+    {MAX7325_SW1_MASK, GESTURE_PRESS, BTN_START},
+    {MAX7325_SW2_MASK, GESTURE_PRESS, BTN_LAP},
+    {MAX7325_SW3_MASK, GESTURE_PRESS, BTN_STOP},
+    {MAX7325_SW3_MASK, GESTURE_LONG, BTN_RESET},
+    {MAX7325_SW4_MASK, GESTURE_PRESS, BTN_MODE_NEXT},
+    {MAX7325_SW5_MASK, GESTURE_PRESS, BTN_STATUS},
+};
+
+/* Capture stamp of the first INT edge since the last port read; the ISR only takes a new
+ * one while s_stampNext is set, so contact bounce does not move it */
+static volatile uint32_t s_intStamp = 0;
+static volatile bool s_stampNext = true;
 
 /**************************************************************************************************
   Local Function Prototypes
 **************************************************************************************************/
 
-static void pollingTask(void *pvParameters);
-static void processButtonChange(uint8_t current, uint8_t previous);
+static void inputTask(void *pvParameters);
+static void intCallback(void *pCbData);
+static bool intAsserted(void);
+static uint8_t readPressed(uint64_t *pSampleUs);
+static TickType_t ticksUntil(uint64_t deadlineUs);
 
 /**************************************************************************************************
   Public Functions
@@ -66,38 +92,16 @@ bool Max7325_Init(void)
 {
     int result;
 
-    /* Use MXC_I2C2 with pins P0.10 (SCL) / P0.11 (SDA) */
-    s_i2c = MXC_I2C2;
-
-    /* Shutdown first in case it was already initialized */
-    MXC_I2C_Shutdown(s_i2c);
-
-    /* Initialize I2C as master */
-    result = MXC_I2C_Init(s_i2c, 1, 0); /* master = 1, slave_addr = 0 */
-    if (result != E_NO_ERROR)
+    /* Shared with the HR sensor (i2c_bus.h) */
+    if (!I2cBus_Init())
     {
-        printf("[MAX7325] ERROR: I2C init failed (%d)\n", result);
         return false;
     }
 
-    /* Set I2C frequency */
-    MXC_I2C_SetFrequency(s_i2c, I2C_FREQ);
-
-    printf("[MAX7325] I2C2 initialized (SCL=P0.10, SDA=P0.11)\n");
-
     /* Configure P0-P7 as inputs by writing 0xFF (per datasheet Table 2) */
     uint8_t config_mask = 0xFF;
-    mxc_i2c_req_t req = {0};
-    req.i2c = s_i2c;
-    req.addr = MAX7325_INPUT_ADDR;
-    req.tx_buf = &config_mask;
-    req.tx_len = 1;
-    req.rx_buf = NULL;
-    req.rx_len = 0;
-    req.restart = 1;
-    req.callback = NULL;
-
-    result = MXC_I2C_MasterTransaction(&req);
+
+    result = I2cBus_Transfer(MAX7325_INPUT_ADDR, &config_mask, 1, NULL, 0);
     if (result != E_NO_ERROR)
     {
         printf("[MAX7325] ERROR: Failed to configure inputs (%d)\n", result);
@@ -108,9 +112,8 @@ bool Max7325_Init(void)
     printf("[MAX7325] Configured P0-P7 as inputs\n");
 
     s_initialized = true;
-    s_prevState = 0xFF; /* Assume all released initially */
 
-    printf("[MAX7325] Ready! SW1=START, SW2=LAP, SW3=STOP, SW4=MODE\n");
+    printf("[MAX7325] Ready! SW1=START, SW2=LAP, SW3=STOP (hold=RESET), SW4=MODE, SW5=STATUS\n");
 
     return true;
 }
@@ -138,7 +141,7 @@ bool Max7325_ReadButtons(Max7325ButtonState_t *state)
 /*************************************************************************************************/
 uint8_t Max7325_ReadRaw(void)
 {
-    if (!s_initialized || s_i2c == NULL)
+    if (!s_initialized)
     {
         return 0xFF;
     }
@@ -146,17 +149,8 @@ uint8_t Max7325_ReadRaw(void)
     int result;
     uint8_t raw[2] = {0xFF, 0x00}; /* [0]=port levels, [1]=transition flags */
 
-    mxc_i2c_req_t req = {0};
-    req.i2c = s_i2c;
-    req.addr = MAX7325_INPUT_ADDR;
-    req.tx_buf = NULL;
-    req.tx_len = 0;
-    req.rx_buf = raw;
-    req.rx_len = 2;  /* Read 2 bytes per datasheet */
-    req.restart = 1; /* Use restart condition */
-    req.callback = NULL;
-
-    result = MXC_I2C_MasterTransaction(&req);
+    /* Read 2 bytes per datasheet */
+    result = I2cBus_Transfer(MAX7325_INPUT_ADDR, NULL, 0, raw, sizeof(raw));
 
     if (result != E_NO_ERROR)
     {
@@ -175,31 +169,39 @@ bool Max7325_IsButtonPressed(uint8_t mask)
 }
 
 /*************************************************************************************************/
-bool Max7325_StartPollingTask(void)
+bool Max7325_StartInputTask(void)
 {
     if (!s_initialized)
     {
-        printf("[MAX7325] ERROR: Not initialized, cannot start polling\n");
+        printf("[MAX7325] ERROR: Not initialized, cannot start input task\n");
         return false;
     }
 
     /* Create task using STATIC allocation */
-    s_pollingTaskHandle = xTaskCreateStatic(
-        pollingTask,
-        "BtnPoll",
-        POLLING_TASK_STACK_SIZE,
+    s_inputTaskHandle = xTaskCreateStatic(
+        inputTask,
+        "BtnIn",
+        INPUT_TASK_STACK_SIZE,
         NULL,
-        POLLING_TASK_PRIORITY,
-        s_pollingTaskStack,
-        &s_pollingTaskBuffer);
+        INPUT_TASK_PRIORITY,
+        s_inputTaskStack,
+        &s_inputTaskBuffer);
 
-    if (s_pollingTaskHandle == NULL)
+    if (s_inputTaskHandle == NULL)
     {
-        printf("[MAX7325] ERROR: Failed to create polling task\n");
+        printf("[MAX7325] ERROR: Failed to create input task\n");
         return false;
     }
 
-    printf("[MAX7325] Button polling task started\n");
+    /* INT edges wake the task, and the MCU from sleep and standby */
+    if (!GpioIrq_Register(&s_intPin, MXC_GPIO_INT_FALLING, intCallback, NULL))
+    {
+        printf("[MAX7325] ERROR: INT pin config failed\n");
+        return false;
+    }
+    MXC_LP_EnableGPIOWakeup(&s_intPin);
+
+    printf("[MAX7325] Button input task started (INT wake)\n");
     return true;
 }
 
@@ -209,105 +211,135 @@ bool Max7325_StartPollingTask(void)
 
 /*************************************************************************************************/
 /*!
- *  \brief  Button polling task.
+ *  \brief  MAX7325 INT edge (ISR context): stamp it and wake the input task.
  */
 /*************************************************************************************************/
-static void pollingTask(void *pvParameters)
+static void intCallback(void *pCbData)
 {
-    (void)pvParameters;
-    uint8_t currentState;
-    uint8_t stableState = 0xFF;
-    uint8_t readCount = 0;
-    uint8_t lastRead = 0xFF;
+    BaseType_t woken = pdFALSE;
 
-    printf("[MAX7325] Button polling active\n");
+    (void)pCbData;
 
-    while (1)
+    if (s_stampNext)
     {
-        /* Read current button state */
-        currentState = Max7325_ReadRaw();
+        s_intStamp = Time_Capture();
+        s_stampNext = false;
+    }
 
-        /* Simple debouncing: require same reading twice */
-        if (currentState == lastRead)
-        {
-            readCount++;
-            if (readCount >= DEBOUNCE_COUNT)
-            {
-                /* State is stable */
-                if (currentState != stableState)
-                {
-                    /* State changed - process it */
-                    processButtonChange(currentState, stableState);
-                    stableState = currentState;
-                }
-                readCount = DEBOUNCE_COUNT; /* Cap at max */
-            }
-        }
-        else
-        {
-            readCount = 0;
-        }
-        lastRead = currentState;
+    vTaskNotifyGiveFromISR(s_inputTaskHandle, &woken);
+    portYIELD_FROM_ISR(woken);
+}
 
-        /* Wait before next poll */
-        vTaskDelay(pdMS_TO_TICKS(POLLING_INTERVAL_MS));
-    }
+/*************************************************************************************************/
+/*!
+ *  \brief  Check the INT line (low while the port differs from the last read).
+ */
+/*************************************************************************************************/
+static bool intAsserted(void)
+{
+    return MXC_GPIO_InGet(s_intPin.port, s_intPin.mask) == 0;
 }
 
 /*************************************************************************************************/
 /*!
- *  \brief  Process button state change and send events.
+ *  \brief  Read the port as pressed bits, with the time of the first change it can show.
+ *
+ *  \param  pSampleUs   Receives the first INT edge since the previous read, or now if there
+ *                      was none. Converted at once: the capture timer stops in standby.
+ *
+ *  \return Pressed lines (bit set = pressed; the port is active low).
  */
 /*************************************************************************************************/
-static void processButtonChange(uint8_t current, uint8_t previous)
+static uint8_t readPressed(uint64_t *pSampleUs)
 {
-    /* Check each button for press (transition from high to low = released to pressed)
-     * Active LOW: bit=1 means released, bit=0 means pressed
-     * We want to detect when button goes from released (1) to pressed (0)
-     */
+    uint8_t pressed;
+    uint32_t stamp;
+    bool edgeSeen;
 
-    /* SW1 - START button */
-    if ((previous & MAX7325_SW1_MASK) && !(current & MAX7325_SW1_MASK))
-    {
-        printf("[MAX7325] SW1 (START) pressed\n");
-        Button_SendEvent(BTN_START);
-    }
+    /* Take the edge before the read: an edge after this point is either in this read
+     * (and timed by it, microseconds late at most) or stamped for the next one */
+    taskENTER_CRITICAL();
+    stamp = s_intStamp;
+    edgeSeen = !s_stampNext;
+    s_stampNext = true;
+    taskEXIT_CRITICAL();
 
-    /* SW2 - LAP button */
-    if ((previous & MAX7325_SW2_MASK) && !(current & MAX7325_SW2_MASK))
-    {
-        printf("[MAX7325] SW2 (LAP) pressed\n");
-        Button_SendEvent(BTN_LAP);
-    }
+    pressed = (uint8_t)~Max7325_ReadRaw();
+
+    *pSampleUs = edgeSeen ? Time_CaptureToUs64(stamp) : Time_GetUs64();
+
+    return pressed;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Ticks to wait for a gesture deadline (portMAX_DELAY if there is none).
+ */
+/*************************************************************************************************/
+static TickType_t ticksUntil(uint64_t deadlineUs)
+{
+    uint64_t nowUs = Time_GetUs64();
 
-    /* SW3 - STOP button */
-    if ((previous & MAX7325_SW3_MASK) && !(current & MAX7325_SW3_MASK))
+    if (deadlineUs == BUTTON_GESTURE_NO_DEADLINE)
     {
-        printf("[MAX7325] SW3 (STOP) pressed\n");
-        Button_SendEvent(BTN_STOP);
+        return portMAX_DELAY;
     }
-
-    /* SW4 - MODE button */
-    if ((previous & MAX7325_SW4_MASK) && !(current & MAX7325_SW4_MASK))
+    if (deadlineUs <= nowUs)
     {
-        printf("[MAX7325] SW4 (MODE) pressed\n");
-        Button_SendEvent(BTN_MODE_NEXT);
+        return 0;
     }
 
-/* Optional: debug print for any other button changes */
-#if 0
-    if ((previous & MAX7325_SW4_MASK) && !(current & MAX7325_SW4_MASK))
+    /* Round up so the wait never ends before the deadline */
+    return pdMS_TO_TICKS((uint32_t)((deadlineUs - nowUs + 999u) / 1000u)) + 1;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Button input task.
+ *
+ *  Sleeps until the MAX7325 INT line reports a port change or a gesture (long press) is
+ *  due. After an edge it samples the port every DEBOUNCE_SAMPLE_MS until every line has
+ *  settled (see button_gesture.h). No I2C traffic while idle.
+ */
+/*************************************************************************************************/
+static void inputTask(void *pvParameters)
+{
+    (void)pvParameters;
+    uint64_t sampleUs;
+    uint8_t pressed;
+
+    /* Reading the port releases INT and sets the reference for the next change */
+    pressed = readPressed(&sampleUs);
+    ButtonGesture_Init(s_gestureMap, sizeof(s_gestureMap) / sizeof(s_gestureMap[0]), pressed);
+
+    printf("[MAX7325] Button input active\n");
+
+    while (1)
     {
-        printf("[MAX7325] SW4 pressed\n");
+        /* Drop wake-ups left over from the last burst, then sleep unless INT is still low */
+        (void)ulTaskNotifyTake(pdTRUE, 0);
+        if (!intAsserted() &&
+            ulTaskNotifyTake(pdTRUE, ticksUntil(ButtonGesture_NextDeadlineUs())) == 0)
+        {
+            /* Timed out: a gesture deadline, not an edge */
+            ButtonGesture_Tick(Time_GetUs64());
+            continue;
+        }
+
+        /* Burst: sample until every line settles */
+        while (!ButtonGesture_Sample(readPressed(&sampleUs), sampleUs))
+        {
+            vTaskDelay(pdMS_TO_TICKS(DEBOUNCE_SAMPLE_MS));
+        }
+
+        ButtonGesture_Tick(Time_GetUs64());
     }
-    /* ... etc for SW5-SW8 ... */
-#endif
 }
 
 /*************************************************************************************************/
 void Max7325_ScanI2C(void)
 {
-    if (s_i2c == NULL)
+    if (!I2cBus_Init())
     {
         printf("[MAX7325] I2C not initialized, cannot scan\n");
         return;
@@ -330,17 +362,7 @@ void Max7325_ScanI2C(void)
         fflush(stdout);
 
         /* Use transaction-based probe with restart (per working example) */
-        mxc_i2c_req_t req = {0};
-        req.i2c = s_i2c;
-        req.addr = addr;
-        req.tx_buf = NULL;
-        req.tx_len = 0;
-        req.rx_buf = data;
-        req.rx_len = 2;
-        req.restart = 1;
-        req.callback = NULL;
-
-        int result = MXC_I2C_MasterTransaction(&req);
+        int result = I2cBus_Transfer(addr, NULL, 0, data, sizeof(data));
 
         if (result == E_NO_ERROR)
         {
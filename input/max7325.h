@@ -7,10 +7,15 @@
  *  The MAX7325 provides 8 I/O ports (P0-P7) which are connected to
  *  switches SW1-SW8 on the expansion board.
  *
- *  Button mapping:
+ *  Button mapping (gesture table in max7325.c):
  *  - SW1 (P0) = START
  *  - SW2 (P1) = LAP
- *  - SW3 (P2) = STOP
+ *  - SW3 (P2) = STOP, held = RESET
+ *  - SW4 (P3) = MODE
+ *  - SW5 (P4) = STATUS
+ *
+ *  The INT output must be wired to the MCU (P0.19 by default, see max7325.c): the port is
+ *  only read after INT reports a change.
  */
 /*************************************************************************************************/
 
@@ -114,15 +119,16 @@ bool Max7325_IsButtonPressed(uint8_t mask);
 
 /*************************************************************************************************/
 /*!
- *  \brief  Start the button polling task.
+ *  \brief  Start the button input task.
  *
- *  Creates a FreeRTOS task that polls the MAX7325 and sends
+ *  Creates a FreeRTOS task that sleeps until the MAX7325 INT output (wired to a GPIO
+ *  wake input, see max7325.c) signals a port change, debounces the port and sends
  *  button events to the control task queue.
  *
- *  \return true if task created successfully.
+ *  \return true if task created and the INT interrupt enabled.
  */
 /*************************************************************************************************/
-bool Max7325_StartPollingTask(void);
+bool Max7325_StartInputTask(void);
 
 /*************************************************************************************************/
 /*!
@@ -4,13 +4,15 @@
  *
  *  \brief  Heart Rate Sensor Task Implementation for CS4447 Embedded Systems Project.
  *
- *  This module implements periodic heart rate sampling from the MAX I/O expansion board.
+ *  This module implements interrupt-driven PPG acquisition from the MAX I/O expansion board.
  *
  *  REAL-TIME DESIGN:
  *  -----------------
- *  - Uses vTaskDelayUntil() for precise 100ms sampling period
- *  - Never blocks on I2C indefinitely (uses timeout)
- *  - Sends samples to control task via queue (non-blocking)
+ *  - Sleeps until the MAX30102 FIFO almost-full interrupt, no periodic polling
+ *  - Two I2C reads per block: status + pointers, then the whole FIFO
+ *  - A timeout drains the FIFO anyway if an interrupt is ever missed
+ *  - Sends one frame per block through a message buffer (non-blocking; when it is
+ *    full the oldest frame makes room, so the stream keeps the latest second)
  *  - Graceful handling of sensor errors
  *
  *  SENSOR INTERFACE:
@@ -18,19 +20,24 @@
  *  The MAX I/O expansion board includes a heart rate sensor (e.g., MAX30102).
  *  Communication is via I2C. This implementation provides:
  *  - Initialization and configuration
- *  - Periodic sampling at a fixed rate
+ *  - Block reads of every sample the sensor takes
  *  - Validation and confidence estimation
+ *  - SpO2 from the same filtered blocks
  *
  *  For testing without hardware, enable SENSOR_SIMULATE_DATA to use synthetic data.
  */
 /*************************************************************************************************/
 
 #include "sensor_task.h"
-#include "control_task.h"
+#include "i2c_bus.h"
+#include "gpio_irq.h"
 #include "time_utils.h"
+#include "log.h"
 #include "FreeRTOS.h"
 #include "task.h"
-#include "queue.h"
+#include "message_buffer.h"
+#include "semphr.h"
+#include <stddef.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -38,7 +45,7 @@
 /* Maxim SDK includes */
 #include "mxc_device.h"
 #include "mxc_delay.h"
-#include "i2c.h"
+#include "gpio.h"
 
 /**************************************************************************************************
   Compile-time Configuration
@@ -52,8 +59,12 @@
  * - Testing the control loop without hardware
  * - Debugging state machine transitions
  * - Oral exam demonstrations
+ *
+ * Set from the build (project.mk SENSOR_SIMULATE, always 1 in the host build).
  */
-#define SENSOR_SIMULATE_DATA        1
+#ifndef SENSOR_SIMULATE_DATA
+#define SENSOR_SIMULATE_DATA        0
+#endif
 
 /**************************************************************************************************
   Macros
@@ -71,18 +82,16 @@
 
 #define SENSOR_TASK_STACK_SIZE      256     /*!< Stack size in words */
 
-/* I2C Configuration */
-#define SENSOR_I2C_INSTANCE         MXC_I2C2
-#define SENSOR_I2C_FREQ             100000  /*!< 100 kHz I2C */
-
 /* MAX30102 Heart Rate Sensor (typical) */
 #define MAX30102_I2C_ADDR           0x57    /*!< 7-bit I2C address */
 #define MAX30102_REG_INTR_STATUS_1  0x00
 #define MAX30102_REG_INTR_STATUS_2  0x01
 #define MAX30102_REG_INTR_ENABLE_1  0x02
 #define MAX30102_REG_FIFO_WR_PTR    0x04
+#define MAX30102_REG_OVF_COUNTER    0x05
 #define MAX30102_REG_FIFO_RD_PTR    0x06
 #define MAX30102_REG_FIFO_DATA      0x07
+#define MAX30102_REG_FIFO_CONFIG    0x08
 #define MAX30102_REG_MODE_CONFIG    0x09
 #define MAX30102_REG_SPO2_CONFIG    0x0A
 #define MAX30102_REG_LED1_PA        0x0C
@@ -91,6 +100,47 @@
 
 #define MAX30102_PART_ID_VALUE      0x15    /*!< Expected part ID */
 
+/* Register values */
+#define MAX30102_INTR_A_FULL        0x80    /*!< INTR_STATUS_1 / INTR_ENABLE_1: FIFO almost full */
+#define MAX30102_MODE_SHDN          0x80    /*!< MODE_CONFIG: shutdown */
+#define MAX30102_MODE_RESET         0x40    /*!< MODE_CONFIG: reset */
+#define MAX30102_MODE_SPO2          0x03    /*!< MODE_CONFIG: red + IR */
+#define MAX30102_SPO2_CONFIG        0x2F    /*!< 4096 nA range, 400 samples/s, 411 us (18 bit) */
+#define MAX30102_SMP_AVE_4          0x40    /*!< FIFO_CONFIG: average 4 conversions per entry */
+#define MAX30102_SAMPLE_BYTES       6       /*!< FIFO entry: 3 bytes red, 3 bytes IR */
+#define MAX30102_SAMPLE_MASK        0x3FFFF /*!< 18-bit ADC counts */
+
+/* Status through the read pointer in one read: STATUS_1, STATUS_2, ENABLE_1, ENABLE_2,
+ * WR_PTR, OVF_COUNTER, RD_PTR */
+#define MAX30102_STATUS_READ_LEN    7
+
+/* MAX30102 INT (open-drain, active low) on a GPIO input, dispatched by gpio_irq.c */
+#define SENSOR_INT_PORT             MXC_GPIO0
+#define SENSOR_INT_PIN              MXC_GPIO_PIN_20
+
+#define SENSOR_SAMPLE_PERIOD_US     (1000000u / SENSOR_SAMPLE_RATE_HZ)
+
+#if SENSOR_SAMPLE_RATE_HZ != HR_DSP_SAMPLE_RATE_HZ
+#error "hr_dsp.c filter coefficients are designed for HR_DSP_SAMPLE_RATE_HZ"
+#endif
+
+/* Drain the FIFO anyway if no interrupt arrives; 250 ms is still short of the 320 ms it
+ * takes to fill from empty, so a missed edge loses no samples */
+#define SENSOR_FIFO_TIMEOUT_MS      250
+
+/* Pipeline time allowed per block. The burst read takes about 3 ms of the 150 ms left
+ * after the interrupt; 2 ms keeps the DSP to about 1% of the 170 ms block period. */
+#define SENSOR_DSP_BUDGET_US        2000
+
+/* A frame on the stream: the fixed part, then block.count samples */
+#define SENSOR_FRAME_HEADER_BYTES   offsetof(SensorFrame_t, block.samples)
+
+/* A message buffer stores a length word with each message */
+#define SENSOR_STREAM_BYTES         (SENSOR_STREAM_FRAMES * (sizeof(SensorFrame_t) + sizeof(size_t)))
+
+/* At most one "stream full" warning per interval; the drops in between are counted in it */
+#define SENSOR_DROP_WARN_INTERVAL_US 1000000u
+
 /* Idle check interval when not measuring */
 #define IDLE_CHECK_INTERVAL_MS      100
 
@@ -102,14 +152,39 @@
 static StaticTask_t s_sensorTaskBuffer;
 static StackType_t s_sensorTaskStack[SENSOR_TASK_STACK_SIZE];
 
+/* Sensor stream storage (one byte more than it can hold, as stream buffers need) */
+static StaticMessageBuffer_t s_streamBuffer;
+static uint8_t s_streamStorage[SENSOR_STREAM_BYTES + 1];
+
+/* Held by whoever reads the stream: the consumer, or the sensor task discarding a frame */
+static StaticSemaphore_t s_streamLockBuffer;
+
 /**************************************************************************************************
   Local Variables
 **************************************************************************************************/
 
 static TaskHandle_t s_sensorTaskHandle = NULL;
-static mxc_i2c_regs_t *s_i2c = NULL;
+static MessageBufferHandle_t s_stream = NULL;
+static SemaphoreHandle_t s_streamLock = NULL;
+
+/* Given after every frame sent, see SensorTask_SetFrameSignal() */
+static SemaphoreHandle_t s_frameSignal = NULL;
 static bool s_initialized = false;
 
+/* Written by the sensor task in critical sections */
+static SensorStreamStats_t s_streamStats;
+
+/* One frame, filled in place by the FIFO read and the pipeline and sent from there (too
+ * large for the task stack) */
+static SensorFrame_t s_frame;
+
+/* Where the oldest frame goes when it is discarded to make room */
+static SensorFrame_t s_discarded;
+
+/* Stream-full warnings: time of the last one, frames dropped since */
+static uint64_t s_dropWarnUs;
+static uint32_t s_dropsSinceWarn;
+
 /*!
  * \brief Measurement active flag
  *
@@ -122,6 +197,19 @@ static volatile bool s_measurementActive = false;
 /* Simulation state (when SENSOR_SIMULATE_DATA is enabled) */
 #if SENSOR_SIMULATE_DATA
 static uint8_t s_simSampleCount = 0;
+#else
+static mxc_gpio_cfg_t s_intPin = {
+    .port = SENSOR_INT_PORT,
+    .mask = SENSOR_INT_PIN,
+    .func = MXC_GPIO_FUNC_IN,
+    .pad = MXC_GPIO_PAD_PULL_UP,
+    .vssel = MXC_GPIO_VSSEL_VDDIOH,
+};
+
+static uint8_t s_fifoRaw[SENSOR_FIFO_DEPTH * MAX30102_SAMPLE_BYTES];
+
+/* Longest pipeline run for one block this measurement */
+static uint32_t s_dspWorstUs;
 #endif
 
 /**************************************************************************************************
@@ -129,12 +217,19 @@ static uint8_t s_simSampleCount = 0;
 **************************************************************************************************/
 
 static bool sensorHardwareInit(void);
-static bool sensorReadSample(HrSample_t *pSample);
 static bool sensorWriteReg(uint8_t reg, uint8_t value);
 static bool sensorReadReg(uint8_t reg, uint8_t *pValue);
+static void sendFrame(const SensorFrame_t *pFrame);
 
 #if SENSOR_SIMULATE_DATA
 static void sensorSimulateSample(HrSample_t *pSample);
+#else
+static bool sensorReadRegs(uint8_t reg, uint8_t *pData, unsigned int len);
+static void sensorStartAcquisition(void);
+static void sensorStopAcquisition(void);
+static bool sensorReadBlock(PpgBlock_t *pBlock);
+static void sensorEstimateHr(const PpgBlock_t *pBlock, HrSample_t *pSample);
+static void sensorIntCallback(void *pCbData);
 #endif
 
 /**************************************************************************************************
@@ -146,6 +241,19 @@ bool SensorTask_Init(void)
 {
     printf("[SENSOR] Initializing sensor task module...\n");
 
+    /* Create the sensor stream using STATIC allocation */
+    s_stream = xMessageBufferCreateStatic(
+        SENSOR_STREAM_BYTES,
+        s_streamStorage,
+        &s_streamBuffer);
+    s_streamLock = xSemaphoreCreateMutexStatic(&s_streamLockBuffer);
+
+    if (s_stream == NULL || s_streamLock == NULL)
+    {
+        printf("[SENSOR] ERROR: Failed to create sensor stream\n");
+        return false;
+    }
+
 #if SENSOR_SIMULATE_DATA
     printf("[SENSOR] *** SIMULATION MODE ENABLED ***\n");
     printf("[SENSOR] Using synthetic HR data for testing\n");
@@ -163,12 +271,23 @@ bool SensorTask_Init(void)
     s_measurementActive = false;
 
     printf("[SENSOR] Sensor task module initialized\n");
+#if SENSOR_SIMULATE_DATA
     printf("[SENSOR]   - Sampling interval: %d ms\n", HR_SAMPLE_INTERVAL_MS);
+#else
+    printf("[SENSOR]   - PPG rate: %d Hz, %d samples per FIFO burst\n",
+           SENSOR_SAMPLE_RATE_HZ, SENSOR_FIFO_BLOCK_SAMPLES);
+#endif
     printf("[SENSOR]   - Task Priority: %d (< control task)\n", SENSOR_TASK_PRIORITY);
 
     return true;
 }
 
+/*************************************************************************************************/
+void SensorTask_SetFrameSignal(SemaphoreHandle_t sem)
+{
+    s_frameSignal = sem;
+}
+
 /*************************************************************************************************/
 bool SensorTask_Start(void)
 {
@@ -188,6 +307,15 @@ bool SensorTask_Start(void)
         return false;
     }
 
+#if !SENSOR_SIMULATE_DATA
+    /* FIFO almost-full edges wake the task */
+    if (!GpioIrq_Register(&s_intPin, MXC_GPIO_INT_FALLING, sensorIntCallback, NULL))
+    {
+        printf("[SENSOR] ERROR: INT pin config failed\n");
+        return false;
+    }
+#endif
+
     printf("[SENSOR] HR sensor task started\n");
     return true;
 }
@@ -215,6 +343,12 @@ void SensorTask_StopHrMeasurement(void)
 {
     printf("[SENSOR] HR measurement DISABLED\n");
     s_measurementActive = false;
+
+    /* Wake the task so it shuts the sensor down now, not at the next FIFO interrupt */
+    if (s_sensorTaskHandle != NULL)
+    {
+        xTaskNotifyGive(s_sensorTaskHandle);
+    }
 }
 
 /*************************************************************************************************/
@@ -223,29 +357,95 @@ bool SensorTask_IsMeasuring(void)
     return s_measurementActive;
 }
 
+/*************************************************************************************************/
+bool SensorTask_ReceiveFrame(SensorFrame_t *pFrame, TickType_t wait)
+{
+    size_t len;
+
+    if (s_stream == NULL || pFrame == NULL)
+    {
+        return false;
+    }
+
+    /* The sensor task only holds the lock while it discards a frame, so this rarely waits */
+    if (xSemaphoreTake(s_streamLock, wait) != pdTRUE)
+    {
+        return false;
+    }
+
+    len = xMessageBufferReceive(s_stream, pFrame, sizeof(*pFrame), wait);
+    xSemaphoreGive(s_streamLock);
+
+    return len > 0;
+}
+
+/*************************************************************************************************/
+void SensorTask_FrameIterInit(SensorFrameIter_t *pIter, const SensorFrame_t *pFrame)
+{
+    pIter->pFrame = pFrame;
+    pIter->next = 0;
+}
+
+/*************************************************************************************************/
+bool SensorTask_FrameIterNext(SensorFrameIter_t *pIter, PpgSample_t *pSample, uint64_t *pTimeUs)
+{
+    const PpgBlock_t *pBlock = &pIter->pFrame->block;
+
+    if (pIter->next >= pBlock->count)
+    {
+        return false;
+    }
+
+    *pSample = pBlock->samples[pIter->next];
+    if (pTimeUs != NULL)
+    {
+        *pTimeUs = pBlock->first_us + (uint64_t)pIter->next * SENSOR_SAMPLE_PERIOD_US;
+    }
+    pIter->next++;
+
+    return true;
+}
+
+/*************************************************************************************************/
+void SensorTask_GetStreamStats(SensorStreamStats_t *pStats)
+{
+    if (pStats != NULL)
+    {
+        taskENTER_CRITICAL();
+        *pStats = s_streamStats;
+        taskEXIT_CRITICAL();
+    }
+}
+
 /*************************************************************************************************/
 /*!
  *  \brief  Sensor Task Main Loop
  *
- *  REAL-TIME PERIODIC SAMPLING:
- *  ----------------------------
- *  Uses vTaskDelayUntil() to achieve precise 100ms sampling period.
- *  This is critical for consistent HR measurement.
+ *  INTERRUPT-DRIVEN ACQUISITION:
+ *  -----------------------------
+ *  The sensor paces itself; the task only wakes when its FIFO holds
+ *  SENSOR_FIFO_BLOCK_SAMPLES and reads all of them in one burst. No sample
+ *  the sensor takes is lost as long as each burst starts within the 15
+ *  sample periods of FIFO space left after the interrupt.
  *
  *  LOOP STRUCTURE:
  *  ---------------
- *  1. If measurement active: sample sensor, send to queue
- *  2. If measurement inactive: sleep briefly, check again
- *  3. Use vTaskDelayUntil for precise timing during active sampling
+ *  1. If measurement inactive: sensor shut down, sleep until enabled
+ *  2. If measurement active: wait for the FIFO interrupt, read the block,
+ *     run it through the pipeline and send it with the estimate as one frame
  */
 /*************************************************************************************************/
 void SensorTask_Run(void *pvParameters)
 {
     (void)pvParameters;
 
-    HrSample_t sample;
-    TickType_t xLastWakeTime;
-    const TickType_t xSamplePeriod = pdMS_TO_TICKS(HR_SAMPLE_INTERVAL_MS);
+    SensorStreamStats_t startStats;
+    SensorStreamStats_t endStats;
+    uint64_t startUs;
+    uint32_t elapsedMs;
+#if !SENSOR_SIMULATE_DATA
+    I2cBusStats_t busStats;
+#endif
 
     printf("[SENSOR] ========================================\n");
     printf("[SENSOR]  HR SENSOR TASK ACTIVE\n");
@@ -266,54 +466,84 @@ void SensorTask_Run(void *pvParameters)
             ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(IDLE_CHECK_INTERVAL_MS));
         }
 
+        SensorTask_GetStreamStats(&startStats);
+        startUs = Time_GetUs64();
+
+#if SENSOR_SIMULATE_DATA
         /*
-         * MEASUREMENT STATE: Sample at fixed period
-         *
-         * Initialize the wake time for vTaskDelayUntil().
-         * This gives us precise periodic sampling regardless of
-         * how long each sample takes to acquire.
+         * SIMULATION: synthetic HR samples at a fixed period
+         */
+        LOG_INFO(LOG_MOD_SENSOR, "[SENSOR] Starting simulated sampling (%d ms period)\n",
+                 HR_SAMPLE_INTERVAL_MS);
+        TickType_t xLastWakeTime = xTaskGetTickCount();
+
+        s_frame.block.count = 0;
+        s_frame.block.lost = 0;
+
+        while (s_measurementActive)
+        {
+            sensorSimulateSample(&s_frame.estimate);
+            sendFrame(&s_frame);
+            vTaskDelayUntil(&xLastWakeTime, pdMS_TO_TICKS(HR_SAMPLE_INTERVAL_MS));
+        }
+#else
+        /*
+         * MEASUREMENT STATE: one FIFO burst per almost-full interrupt
          */
-        printf("[SENSOR] Starting periodic sampling (%d ms period)\n", HR_SAMPLE_INTERVAL_MS);
-        xLastWakeTime = xTaskGetTickCount();
+        LOG_INFO(LOG_MOD_SENSOR, "[SENSOR] Starting FIFO acquisition (%d Hz)\n",
+                 SENSOR_SAMPLE_RATE_HZ);
+        sensorStartAcquisition();
 
         while (s_measurementActive)
         {
-            /* Read sample from sensor (or simulate) */
-            if (sensorReadSample(&sample))
+            /* A timeout still drains the FIFO, so a missed edge costs one late block */
+            (void)ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(SENSOR_FIFO_TIMEOUT_MS));
+
+            if (!s_measurementActive)
             {
-                /*
-                 * SEND SAMPLE TO CONTROL TASK
-                 *
-                 * Non-blocking send - if queue is full, drop the sample.
-                 * This is acceptable because:
-                 * 1. Control task processes samples fast (high priority)
-                 * 2. We'll get another sample in 100ms
-                 * 3. Never want sensor task to block on queue
-                 */
-                if (g_hrSampleQueue != NULL)
-                {
-                    if (xQueueSend(g_hrSampleQueue, &sample, 0) != pdTRUE)
-                    {
-                        printf("[SENSOR] WARNING: Queue full, sample dropped\n");
-                    }
-                }
+                break;
             }
-            else
+
+            if (!sensorReadBlock(&s_frame.block))
+            {
+                LOG_WARN(LOG_MOD_SENSOR, "[SENSOR] FIFO read failed\n");
+                continue;
+            }
+
+            if (s_frame.block.lost > 0)
             {
-                printf("[SENSOR] Sample read failed\n");
+                LOG_WARN(LOG_MOD_SENSOR, "[SENSOR] FIFO overflow, %d samples lost\n",
+                         s_frame.block.lost);
+                taskENTER_CRITICAL();
+                s_streamStats.lostSamples += s_frame.block.lost;
+                taskEXIT_CRITICAL();
             }
 
-            /*
-             * PRECISE TIMING: vTaskDelayUntil()
-             *
-             * This delays until exactly xSamplePeriod ticks after
-             * xLastWakeTime, compensating for any time spent processing.
-             * Result: consistent 100ms sample period.
-             */
-            vTaskDelayUntil(&xLastWakeTime, xSamplePeriod);
+            if (s_frame.block.count > 0)
+            {
+                sensorEstimateHr(&s_frame.block, &s_frame.estimate);
+                sendFrame(&s_frame);
+            }
         }
 
-        printf("[SENSOR] Periodic sampling stopped\n");
+        sensorStopAcquisition();
+        LOG_INFO(LOG_MOD_SENSOR, "[SENSOR] Pipeline worst case %d us per block (budget %d)\n",
+                 (int)s_dspWorstUs, SENSOR_DSP_BUDGET_US);
+
+        I2cBus_GetStats(&busStats);
+        LOG_INFO(LOG_MOD_SENSOR, "[SENSOR] I2C since boot: %d transfers, %d waited, %d failed\n",
+                 (int)busStats.transfers, (int)busStats.waits, (int)busStats.errors);
+#endif
+
+        /* Throughput of this measurement */
+        SensorTask_GetStreamStats(&endStats);
+        elapsedMs = (uint32_t)((Time_GetUs64() - startUs) / 1000u);
+        LOG_INFO(LOG_MOD_SENSOR, "[SENSOR] Stream: %d frames, %d samples in %d ms, %d dropped\n",
+                 (int)(endStats.frames - startStats.frames),
+                 (int)(endStats.samples - startStats.samples), (int)elapsedMs,
+                 (int)(endStats.droppedFrames - startStats.droppedFrames));
+
+        LOG_INFO(LOG_MOD_SENSOR, "[SENSOR] Sampling stopped\n");
     }
 }
 
@@ -335,13 +565,11 @@ static bool sensorHardwareInit(void)
 #if SENSOR_SIMULATE_DATA
     return true;
 #else
-    int result;
-
-    /* Use same I2C instance as MAX7325 (shared bus) */
-    s_i2c = SENSOR_I2C_INSTANCE;
-
-    /* Note: I2C is already initialized by MAX7325 driver.
-     * We just verify communication with the HR sensor. */
+    /* Shared with the MAX7325 (i2c_bus.h); whichever driver starts first sets it up */
+    if (!I2cBus_Init())
+    {
+        return false;
+    }
 
     /* Verify sensor presence by reading part ID */
     uint8_t partId = 0;
@@ -362,22 +590,23 @@ static bool sensorHardwareInit(void)
         printf("[SENSOR] MAX30102 detected (ID: 0x%02X)\n", partId);
     }
 
-    /* Configure sensor for HR mode */
     /* Reset sensor */
-    sensorWriteReg(MAX30102_REG_MODE_CONFIG, 0x40);
+    sensorWriteReg(MAX30102_REG_MODE_CONFIG, MAX30102_MODE_RESET);
     MXC_Delay(MXC_DELAY_MSEC(100));
 
-    /* Mode: HR only (0x02) */
-    sensorWriteReg(MAX30102_REG_MODE_CONFIG, 0x02);
-
-    /* SPO2 config: 400 samples/sec, 18-bit resolution */
-    sensorWriteReg(MAX30102_REG_SPO2_CONFIG, 0x27);
+    /* 400 conversions/s averaged 4:1 into the FIFO; A_FULL with 15 entries still free */
+    sensorWriteReg(MAX30102_REG_SPO2_CONFIG, MAX30102_SPO2_CONFIG);
+    sensorWriteReg(MAX30102_REG_FIFO_CONFIG,
+                   MAX30102_SMP_AVE_4 | (SENSOR_FIFO_DEPTH - SENSOR_FIFO_BLOCK_SAMPLES));
 
     /* LED pulse amplitude */
     sensorWriteReg(MAX30102_REG_LED1_PA, 0x24);  /* Red LED */
     sensorWriteReg(MAX30102_REG_LED2_PA, 0x24);  /* IR LED */
 
-    printf("[SENSOR] MAX30102 configured for HR mode\n");
+    /* Stay shut down until a measurement starts */
+    sensorWriteReg(MAX30102_REG_MODE_CONFIG, MAX30102_MODE_SHDN | MAX30102_MODE_SPO2);
+
+    printf("[SENSOR] MAX30102 configured for red + IR at %d Hz\n", SENSOR_SAMPLE_RATE_HZ);
 
     return true;
 #endif
@@ -385,89 +614,85 @@ static bool sensorHardwareInit(void)
 
 /*************************************************************************************************/
 /*!
- *  \brief  Read a sample from the sensor.
+ *  \brief  Send a frame to the sensor stream without blocking.
  *
- *  \param  pSample     Pointer to sample structure to fill.
- *
- *  \return true if sample obtained, false on error.
+ *  Only the samples read go on the stream, as one message: the consumer wakes once for the
+ *  whole block. If the stream is full the oldest frames are discarded to make room, so a
+ *  stream nobody reads keeps the latest blocks instead of refusing every new one. If the
+ *  consumer is reading at that moment the new frame is dropped instead. Either way the
+ *  frame is counted; the sensor task must never block on the stream, or the FIFO would
+ *  overflow instead.
  */
 /*************************************************************************************************/
-static bool sensorReadSample(HrSample_t *pSample)
+static void sendFrame(const SensorFrame_t *pFrame)
 {
-    if (pSample == NULL)
+    size_t len = SENSOR_FRAME_HEADER_BYTES + pFrame->block.count * sizeof(PpgSample_t);
+    uint32_t dropped = 0;
+    uint32_t droppedSamples = 0;
+    size_t discardedLen;
+    bool sent;
+    uint64_t nowUs;
+
+    if (s_stream == NULL)
     {
-        return false;
+        return;
     }
 
-#if SENSOR_SIMULATE_DATA
-    /* Use simulated data */
-    sensorSimulateSample(pSample);
-    return true;
-#else
-    /* Read actual sensor data */
-    uint8_t fifoData[6];  /* 3 bytes IR, 3 bytes Red */
-    uint32_t irValue = 0;
-    uint32_t redValue = 0;
-
-    /* Read FIFO data */
-    /* TODO: Implement actual FIFO read sequence for MAX30102 */
-    /* This is a simplified placeholder */
+    sent = (xMessageBufferSend(s_stream, pFrame, len, 0) == len);
 
-    mxc_i2c_req_t req = {0};
-    req.i2c = s_i2c;
-    req.addr = MAX30102_I2C_ADDR;
+    if (!sent && xSemaphoreTake(s_streamLock, 0) == pdTRUE)
+    {
+        while (!sent)
+        {
+            discardedLen = xMessageBufferReceive(s_stream, &s_discarded, sizeof(s_discarded), 0);
+            if (discardedLen == 0)
+            {
+                break;
+            }
 
-    uint8_t regAddr = MAX30102_REG_FIFO_DATA;
-    req.tx_buf = &regAddr;
-    req.tx_len = 1;
-    req.rx_buf = fifoData;
-    req.rx_len = 6;
-    req.restart = 1;
-    req.callback = NULL;
+            dropped++;
+            droppedSamples += s_discarded.block.count;
+            sent = (xMessageBufferSend(s_stream, pFrame, len, 0) == len);
+        }
+        xSemaphoreGive(s_streamLock);
+    }
 
-    if (MXC_I2C_MasterTransaction(&req) != E_NO_ERROR)
+    if (!sent)
     {
-        pSample->valid = false;
-        return false;
+        dropped++;
+        droppedSamples += pFrame->block.count;
     }
 
-    /* Extract 18-bit values */
-    irValue = ((uint32_t)fifoData[0] << 16) | ((uint32_t)fifoData[1] << 8) | fifoData[2];
-    irValue &= 0x3FFFF;  /* 18 bits */
-
-    redValue = ((uint32_t)fifoData[3] << 16) | ((uint32_t)fifoData[4] << 8) | fifoData[5];
-    redValue &= 0x3FFFF;  /* 18 bits */
-
-    /*
-     * HEART RATE CALCULATION
-     *
-     * In a real implementation, you would:
-     * 1. Buffer multiple IR/Red samples
-     * 2. Apply signal processing (filtering, peak detection)
-     * 3. Calculate beat-to-beat intervals
-     * 4. Convert to BPM
-     *
-     * For this project, we use a simplified approach with placeholder values.
-     */
-
-    /* Simplified HR estimation (placeholder) */
-    if (irValue > 50000)  /* Finger present */
+    taskENTER_CRITICAL();
+    if (sent)
     {
-        pSample->bpm = 70 + (irValue % 30);  /* 70-100 BPM range */
-        pSample->confidence = 80;
-        pSample->valid = true;
+        s_streamStats.frames++;
+        s_streamStats.samples += pFrame->block.count;
     }
-    else
+    s_streamStats.droppedFrames += dropped;
+    s_streamStats.droppedSamples += droppedSamples;
+    taskEXIT_CRITICAL();
+
+    if (sent && s_frameSignal != NULL)
     {
-        pSample->bpm = 0;
-        pSample->confidence = 0;
-        pSample->valid = false;
+        xSemaphoreGive(s_frameSignal);
     }
 
-    pSample->timestamp_ms = Time_GetMs();
+    if (dropped == 0)
+    {
+        return;
+    }
 
-    return true;
-#endif
+    /* An unread stream drops a frame per block; one line a second says as much */
+    s_dropsSinceWarn += dropped;
+    nowUs = Time_GetUs64();
+    if (s_dropWarnUs == 0 || nowUs - s_dropWarnUs >= SENSOR_DROP_WARN_INTERVAL_US)
+    {
+        LOG_WARN(LOG_MOD_SENSOR, "[SENSOR] Stream full, %d frames dropped (oldest first)\n",
+                 (int)s_dropsSinceWarn);
+        s_dropWarnUs = nowUs;
+        s_dropsSinceWarn = 0;
+    }
 }
 
 /*************************************************************************************************/
@@ -480,24 +705,9 @@ static bool sensorWriteReg(uint8_t reg, uint8_t value)
 #if SENSOR_SIMULATE_DATA
     return true;
 #else
-    if (s_i2c == NULL)
-    {
-        return false;
-    }
-
     uint8_t txData[2] = {reg, value};
 
-    mxc_i2c_req_t req = {0};
-    req.i2c = s_i2c;
-    req.addr = MAX30102_I2C_ADDR;
-    req.tx_buf = txData;
-    req.tx_len = 2;
-    req.rx_buf = NULL;
-    req.rx_len = 0;
-    req.restart = 1;
-    req.callback = NULL;
-
-    return (MXC_I2C_MasterTransaction(&req) == E_NO_ERROR);
+    return (I2cBus_Transfer(MAX30102_I2C_ADDR, txData, sizeof(txData), NULL, 0) == E_NO_ERROR);
 #endif
 }
 
@@ -515,25 +725,196 @@ static bool sensorReadReg(uint8_t reg, uint8_t *pValue)
     }
     return true;
 #else
-    if (s_i2c == NULL || pValue == NULL)
+    if (pValue == NULL)
     {
         return false;
     }
 
-    mxc_i2c_req_t req = {0};
-    req.i2c = s_i2c;
-    req.addr = MAX30102_I2C_ADDR;
-    req.tx_buf = &reg;
-    req.tx_len = 1;
-    req.rx_buf = pValue;
-    req.rx_len = 1;
-    req.restart = 1;
-    req.callback = NULL;
-
-    return (MXC_I2C_MasterTransaction(&req) == E_NO_ERROR);
+    return (I2cBus_Transfer(MAX30102_I2C_ADDR, &reg, 1, pValue, 1) == E_NO_ERROR);
 #endif
 }
 
+#if !SENSOR_SIMULATE_DATA
+/*************************************************************************************************/
+/*!
+ *  \brief  Read consecutive sensor registers in one transaction.
+ *
+ *  The register pointer does not advance inside FIFO_DATA, so a read from there returns
+ *  consecutive FIFO bytes instead.
+ */
+/*************************************************************************************************/
+static bool sensorReadRegs(uint8_t reg, uint8_t *pData, unsigned int len)
+{
+    if (pData == NULL)
+    {
+        return false;
+    }
+
+    return (I2cBus_Transfer(MAX30102_I2C_ADDR, &reg, 1, pData, len) == E_NO_ERROR);
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Empty the FIFO, enable the almost-full interrupt and leave shutdown.
+ */
+/*************************************************************************************************/
+static void sensorStartAcquisition(void)
+{
+    uint8_t status[2];
+
+    sensorWriteReg(MAX30102_REG_FIFO_WR_PTR, 0);
+    sensorWriteReg(MAX30102_REG_OVF_COUNTER, 0);
+    sensorWriteReg(MAX30102_REG_FIFO_RD_PTR, 0);
+    sensorWriteReg(MAX30102_REG_INTR_ENABLE_1, MAX30102_INTR_A_FULL);
+
+    HrDsp_Init();
+    s_dspWorstUs = 0;
+
+    /* Clear a stale interrupt so the first almost-full produces a falling edge */
+    sensorReadRegs(MAX30102_REG_INTR_STATUS_1, status, sizeof(status));
+    (void)ulTaskNotifyTake(pdTRUE, 0);
+
+    sensorWriteReg(MAX30102_REG_MODE_CONFIG, MAX30102_MODE_SPO2);
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Shut the sensor down (LEDs off, FIFO kept) and mask its interrupt.
+ */
+/*************************************************************************************************/
+static void sensorStopAcquisition(void)
+{
+    sensorWriteReg(MAX30102_REG_MODE_CONFIG, MAX30102_MODE_SHDN | MAX30102_MODE_SPO2);
+    sensorWriteReg(MAX30102_REG_INTR_ENABLE_1, 0);
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Read every sample in the FIFO.
+ *
+ *  One read of the status and pointer registers (which also clears the interrupt), then
+ *  one burst of count * 6 bytes from FIFO_DATA. The FIFO keeps filling meanwhile; samples
+ *  that arrive after the pointer read are left for the next block.
+ *
+ *  \param  pBlock      Block to fill.
+ *
+ *  \return true if both transactions succeeded.
+ */
+/*************************************************************************************************/
+static bool sensorReadBlock(PpgBlock_t *pBlock)
+{
+    uint8_t regs[MAX30102_STATUS_READ_LEN];
+    uint64_t readUs;
+    uint8_t count;
+    uint8_t i;
+
+    if (!sensorReadRegs(MAX30102_REG_INTR_STATUS_1, regs, sizeof(regs)))
+    {
+        return false;
+    }
+    readUs = Time_GetUs64();
+
+    /* WR_PTR == RD_PTR is empty unless the FIFO overflowed, in which case it is full */
+    count = (uint8_t)((regs[4] - regs[6]) & (SENSOR_FIFO_DEPTH - 1));
+    pBlock->lost = regs[5];
+    if (pBlock->lost > 0)
+    {
+        count = SENSOR_FIFO_DEPTH;
+    }
+    pBlock->count = count;
+
+    if (count == 0)
+    {
+        return true;
+    }
+
+    if (!sensorReadRegs(MAX30102_REG_FIFO_DATA, s_fifoRaw, count * MAX30102_SAMPLE_BYTES))
+    {
+        pBlock->count = 0;
+        return false;
+    }
+
+    /* The newest sample was taken at most one period before the pointer read */
+    pBlock->first_us = readUs - (uint64_t)(count - 1) * SENSOR_SAMPLE_PERIOD_US;
+
+    for (i = 0; i < count; i++)
+    {
+        const uint8_t *p = &s_fifoRaw[i * MAX30102_SAMPLE_BYTES];
+
+        pBlock->samples[i].red = (((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2])
+                                 & MAX30102_SAMPLE_MASK;
+        pBlock->samples[i].ir = (((uint32_t)p[3] << 16) | ((uint32_t)p[4] << 8) | p[5])
+                                & MAX30102_SAMPLE_MASK;
+    }
+
+    return true;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Run a block through the heart rate and SpO2 pipeline (hr_dsp.h) and take its
+ *          result.
+ *
+ *  The pipeline needs every sample in order; after an overflow it starts over rather
+ *  than measure a beat interval across the gap. Each run is timed against
+ *  SENSOR_DSP_BUDGET_US.
+ */
+/*************************************************************************************************/
+static void sensorEstimateHr(const PpgBlock_t *pBlock, HrSample_t *pSample)
+{
+    HrDspResult_t result;
+    uint64_t startUs = Time_GetUs64();
+    uint32_t elapsedUs;
+
+    if (pBlock->lost > 0)
+    {
+        HrDsp_Init();
+    }
+
+    HrDsp_Process(pBlock->samples, pBlock->count);
+    HrDsp_GetResult(&result);
+
+    elapsedUs = (uint32_t)(Time_GetUs64() - startUs);
+    if (elapsedUs > s_dspWorstUs)
+    {
+        s_dspWorstUs = elapsedUs;
+        if (elapsedUs > SENSOR_DSP_BUDGET_US)
+        {
+            LOG_WARN(LOG_MOD_SENSOR, "[SENSOR] Pipeline took %d us for %d samples\n",
+                     (int)elapsedUs, pBlock->count);
+        }
+    }
+
+    pSample->bpm = result.bpm;
+    pSample->confidence = result.confidence;
+    pSample->valid = result.valid;
+    pSample->spo2 = result.spo2;
+    pSample->spo2_quality = result.spo2Quality;
+
+    /* Stamp at the newest sample of the block */
+    pSample->timestamp_ms = (pBlock->first_us +
+                             (uint64_t)(pBlock->count - 1) * SENSOR_SAMPLE_PERIOD_US) / 1000u;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  MAX30102 INT falling edge (ISR context): wake the sensor task.
+ */
+/*************************************************************************************************/
+static void sensorIntCallback(void *pCbData)
+{
+    BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+    (void)pCbData;
+
+    if (s_sensorTaskHandle != NULL)
+    {
+        vTaskNotifyGiveFromISR(s_sensorTaskHandle, &xHigherPriorityTaskWoken);
+    }
+    portYIELD_FROM_ISR(xHigherPriorityTaskWoken);
+}
+#endif
+
 #if SENSOR_SIMULATE_DATA
 /*************************************************************************************************/
 /*!
@@ -571,10 +952,14 @@ static void sensorSimulateSample(HrSample_t *pSample)
         pSample->valid = true;
     }
 
-    pSample->timestamp_ms = Time_GetMs();
+    /* SpO2 96-98%, never more trusted than the rate */
+    pSample->spo2 = 97 + (s_simSampleCount % 3) - 1;
+    pSample->spo2_quality = pSample->confidence;
+
+    pSample->timestamp_ms = Time_GetMs64();
 
-    printf("[SENSOR] SIM Sample #%d: %d BPM, %d%% conf, %s\n",
-           s_simSampleCount, pSample->bpm, pSample->confidence,
-           pSample->valid ? "VALID" : "invalid");
+    LOG_DEBUG(LOG_MOD_SENSOR, "[SENSOR] SIM Sample #%d: %d BPM, %d%% conf, %s\n",
+              s_simSampleCount, pSample->bpm, pSample->confidence,
+              pSample->valid ? "VALID" : "invalid");
 }
 #endif
@@ -4,27 +4,35 @@
  *
  *  \brief  Heart Rate Sensor Task Interface for CS4447 Embedded Systems Project.
  *
- *  This module implements a periodic sensor sampling task that:
- *  - Reads heart rate data from the MAX I/O expansion board sensor
- *  - Sends HR samples to the control task via a FreeRTOS queue
- *  - Operates at a fixed sampling interval (100ms by default)
+ *  This module implements an interrupt-driven sensor acquisition task that:
+ *  - Collects every PPG sample (red and IR) the MAX30102 produces
+ *  - Reads them in blocks, one burst per FIFO almost-full interrupt
+ *  - Sends one frame per block (HR and SpO2 estimate plus the PPG samples)
+ *    through a FreeRTOS message buffer
  *
  *  SENSOR TASK DESIGN:
  *  -------------------
- *  The sensor task runs at a fixed period using vTaskDelayUntil() for
- *  precise timing. It only actively samples when HR measurement is enabled
- *  by the control task.
+ *  The sensor samples on its own clock (SENSOR_SAMPLE_RATE_HZ) into its
+ *  32-entry FIFO. When SENSOR_FIFO_BLOCK_SAMPLES are unread it pulls its INT
+ *  line low; the GPIO interrupt wakes the task, which reads the FIFO pointers
+ *  and then all pending samples in one I2C transaction. The task sleeps
+ *  between interrupts and only runs while HR measurement is enabled by the
+ *  control task.
  *
  *  PRIORITY JUSTIFICATION:
  *  -----------------------
  *  Sensor Task Priority: tskIDLE_PRIORITY + 2
  *  - Lower than control task (priority +3) to avoid blocking state transitions
- *  - Higher than BLE task (priority +1) because sampling must be consistent
- *  - Deterministic sampling interval is maintained by vTaskDelayUntil()
+ *  - Higher than BLE task (priority +1) because the FIFO must be drained
+ *    before it overflows (about 150 ms of headroom after the interrupt)
  *
  *  INTER-TASK COMMUNICATION:
  *  -------------------------
- *  - Sends HrSample_t structs to control task via g_hrSampleQueue
+ *  - Writes one SensorFrame_t per block of PPG samples to a message buffer;
+ *    the consumer task takes them with SensorTask_ReceiveFrame(), so it wakes
+ *    once per block, and walks the samples with SensorTask_FrameIterNext().
+ *    A full stream drops its oldest frame, so a late or absent consumer costs
+ *    old blocks, never the sensor task's time
  *  - Control task calls SensorTask_StartHrMeasurement() to enable sampling
  *  - Control task calls SensorTask_StopHrMeasurement() to disable sampling
  *
@@ -32,7 +40,9 @@
  *  -------------------
  *  The sensor communicates via I2C on the MAX I/O expansion board.
  *  Specific sensor model: MAX30102 (or similar pulse oximeter/HR sensor)
- *  I2C address and register map defined in implementation file.
+ *  I2C address and register map defined in implementation file. Its INT
+ *  output (open-drain, active low) must be wired to the MCU (P0.20 by
+ *  default, see sensor_task.c).
  */
 /*************************************************************************************************/
 
@@ -41,6 +51,9 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "hr_dsp.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -51,16 +64,94 @@ extern "C" {
 **************************************************************************************************/
 
 /*!
- * HR SAMPLING INTERVAL: 100ms (10 Hz)
+ * HR_SENSOR_ENABLE: Tasks_Init() starts the sensor task (project.mk HR_SENSOR)
+ */
+#ifndef HR_SENSOR_ENABLE
+#define HR_SENSOR_ENABLE            1
+#endif
+
+/*!
+ * PPG SAMPLE RATE: 100 Hz into the FIFO
  *
  * JUSTIFICATION:
- * - Fast enough to capture pulse variations
- * - Slow enough to not overwhelm the sensor or queues
- * - Matches typical HR sensor output rate
- * - 10 samples = 1 second of measurement time
+ * - The ADC runs at 400 samples/s and averages 4 conversions per FIFO
+ *   entry, so every conversion is used and the noise is halved
+ * - 100 Hz resolves the pulse waveform well beyond 240 BPM
+ * - Keeps the shared 400 kHz I2C bus under 2% busy
+ */
+#define SENSOR_SAMPLE_RATE_HZ       100
+
+/*!
+ * FIFO BLOCK: 17 samples per almost-full interrupt (170 ms at 100 Hz)
+ *
+ * The MAX30102 interrupts when 15 free entries remain (the largest
+ * FIFO_A_FULL setting), leaving 15 sample periods to drain it.
+ */
+#define SENSOR_FIFO_DEPTH           32
+#define SENSOR_FIFO_BLOCK_SAMPLES   17
+
+/*!
+ * SIMULATED HR INTERVAL: 100ms (10 Hz), SENSOR_SIMULATE_DATA builds only
  */
 #define HR_SAMPLE_INTERVAL_MS       100
 
+/*!
+ * SENSOR STREAM: room for 4 full-FIFO frames
+ *
+ * Frames only carry the samples read, so at 17 samples per block the
+ * stream holds about 6 blocks (1 s) while the consumer is busy. Older
+ * blocks are discarded to make room for new ones.
+ */
+#define SENSOR_STREAM_FRAMES        4
+
+/**************************************************************************************************
+  Type Definitions
+**************************************************************************************************/
+
+/*! Samples read in one FIFO burst, oldest first */
+typedef struct
+{
+    uint64_t first_us;          /*!< Time of samples[0] (Time_GetUs64() timebase) */
+    uint8_t count;              /*!< Valid entries in samples */
+    uint8_t lost;               /*!< Samples the FIFO overwrote before this burst */
+    PpgSample_t samples[SENSOR_FIFO_DEPTH];
+} PpgBlock_t;
+
+/*! Heart rate estimate sent to the control task */
+typedef struct
+{
+    uint64_t timestamp_ms;      /*!< Time of the newest sample used (Time_GetMs64() timebase) */
+    uint16_t bpm;               /*!< Beats per minute, 0 if not valid */
+    uint8_t confidence;         /*!< 0-100 % */
+    bool valid;                 /*!< Finger present and estimate usable */
+    uint8_t spo2;               /*!< Oxygen saturation %, 0 if not yet known */
+    uint8_t spo2_quality;       /*!< 0-100, never above confidence */
+} HrSample_t;
+
+/*! One block of sensor output: the estimate and the PPG samples it was made from */
+typedef struct
+{
+    HrSample_t estimate;        /*!< As of the newest sample of block */
+    PpgBlock_t block;           /*!< Only block.count samples are sent (none when simulated) */
+} SensorFrame_t;
+
+/*! Walks the samples of a received frame, see SensorTask_FrameIterInit() */
+typedef struct
+{
+    const SensorFrame_t *pFrame;
+    uint8_t next;
+} SensorFrameIter_t;
+
+/*! Sensor stream counters since SensorTask_Init() */
+typedef struct
+{
+    uint32_t frames;            /*!< Frames sent */
+    uint32_t samples;           /*!< PPG samples in the frames sent */
+    uint32_t droppedFrames;     /*!< Frames discarded from a full stream, oldest first */
+    uint32_t droppedSamples;    /*!< PPG samples in the discarded frames */
+    uint32_t lostSamples;       /*!< Samples the sensor FIFO overwrote before they were read */
+} SensorStreamStats_t;
+
 /**************************************************************************************************
   Function Declarations
 **************************************************************************************************/
@@ -77,6 +168,19 @@ extern "C" {
 /*************************************************************************************************/
 bool SensorTask_Init(void);
 
+/*************************************************************************************************/
+/*!
+ *  \brief  Have the sensor task give a semaphore after each frame it sends.
+ *
+ *  A message buffer cannot join a queue set, so a consumer that waits on one adds a binary
+ *  semaphore to the set instead and drains the stream with SensorTask_ReceiveFrame(..., 0)
+ *  each time it is given. Call before SensorTask_Start().
+ *
+ *  \param  sem         Binary semaphore, or NULL to stop signalling.
+ */
+/*************************************************************************************************/
+void SensorTask_SetFrameSignal(SemaphoreHandle_t sem);
+
 /*************************************************************************************************/
 /*!
  *  \brief  Start the sensor task.
@@ -93,7 +197,7 @@ bool SensorTask_Start(void);
  *  \brief  Enable HR measurement.
  *
  *  Called by control task when entering HR_MEASUREMENT state.
- *  Wakes up the sensor and begins periodic sampling.
+ *  Wakes up the sensor and begins interrupt-driven acquisition.
  *
  *  Thread-safe - can be called from any task.
  */
@@ -121,18 +225,66 @@ void SensorTask_StopHrMeasurement(void);
 /*************************************************************************************************/
 bool SensorTask_IsMeasuring(void);
 
+/*************************************************************************************************/
+/*!
+ *  \brief  Take the next frame from the sensor stream.
+ *
+ *  Frames arrive one per FIFO block, so the consumer wakes once per block. The stream has
+ *  one reader: call from one task only. If the consumer falls more than about 1 s behind,
+ *  the oldest frames have been discarded (SensorStreamStats_t.droppedFrames).
+ *
+ *  \param  pFrame      Receives the frame; only pFrame->block.count samples are valid.
+ *  \param  wait        Ticks to wait for a frame.
+ *
+ *  \return true if a frame was received.
+ */
+/*************************************************************************************************/
+bool SensorTask_ReceiveFrame(SensorFrame_t *pFrame, TickType_t wait);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Start walking the PPG samples of a frame, oldest first.
+ *
+ *  \param  pIter       Iterator to set up.
+ *  \param  pFrame      Frame from SensorTask_ReceiveFrame(); must outlive the iterator.
+ */
+/*************************************************************************************************/
+void SensorTask_FrameIterInit(SensorFrameIter_t *pIter, const SensorFrame_t *pFrame);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Get the next PPG sample of a frame.
+ *
+ *  \param  pIter       Iterator.
+ *  \param  pSample     Receives the sample.
+ *  \param  pTimeUs     Receives its time (Time_GetUs64() timebase); may be NULL.
+ *
+ *  \return false once every sample has been returned.
+ */
+/*************************************************************************************************/
+bool SensorTask_FrameIterNext(SensorFrameIter_t *pIter, PpgSample_t *pSample, uint64_t *pTimeUs);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Get the sensor stream counters.
+ *
+ *  \param  pStats      Receives a copy of the counters.
+ */
+/*************************************************************************************************/
+void SensorTask_GetStreamStats(SensorStreamStats_t *pStats);
+
 /*************************************************************************************************/
 /*!
  *  \brief  The sensor task function (do not call directly).
  *
- *  This is the FreeRTOS task entry point. It implements periodic
- *  sampling using vTaskDelayUntil() for precise timing.
+ *  This is the FreeRTOS task entry point. It sleeps until the sensor's
+ *  FIFO almost-full interrupt and then reads the whole FIFO in one burst.
  *
  *  TASK BEHAVIOR:
  *  --------------
- *  - When measurement disabled: sleeps, checking periodically
- *  - When measurement enabled: samples at HR_SAMPLE_INTERVAL_MS
- *  - Sends samples to g_hrSampleQueue for control task
+ *  - When measurement disabled: sensor shut down, task blocked
+ *  - When measurement enabled: one FIFO burst per interrupt
+ *  - Sends one frame per block to the sensor stream
  *  - Handles sensor errors gracefully (marks samples invalid)
  *
  *  \param  pvParameters    FreeRTOS task parameter (unused).
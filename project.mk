@@ -44,6 +44,37 @@ INIT_CENTRAL = 0
 # Set to 2 to enable verbose messages
 TRACE = 1
 
+# Tokenized logging (utils/log.h)
+# Set to 0 for plain text log output
+# Set to 1 to send LOG_* messages as binary records; decode them on the host with
+#   tools/trace_decode.py build/max_firmware.elf <capture>
+LOG_TOKENIZED ?= 0
+PROJ_CFLAGS += -DLOG_TOKENIZED=$(LOG_TOKENIZED)
+ifeq ($(LOG_TOKENIZED),1)
+PROJ_LDFLAGS += $(abspath utils/log_tokens.ld)
+endif
+
+# Microbenchmarks (bench/bench.h)
+# Set to 1 to run them at boot, before the tasks start, and print a JSON report.
+# The benchmarks clear the offline event log; do not flash a bench build on a
+# device whose stored events are still needed.
+BENCH ?= 0
+PROJ_CFLAGS += -DBENCH_ENABLE=$(BENCH)
+ifeq ($(BENCH),1)
+VPATH += bench
+IPATH += bench
+SRCS += bench.c
+endif
+
+# HR sensor (input/sensor_task.h)
+# Set HR_SENSOR to 0 for boards without the MAX30102; the sensor task is then not
+# started and laps skip the recovery heart rate window.
+# Set SENSOR_SIMULATE to 1 to feed synthetic HR data instead of reading the sensor.
+HR_SENSOR ?= 1
+SENSOR_SIMULATE ?= 0
+PROJ_CFLAGS += -DHR_SENSOR_ENABLE=$(HR_SENSOR)
+PROJ_CFLAGS += -DSENSOR_SIMULATE_DATA=$(SENSOR_SIMULATE)
+
 # **********************************************************
 # Source Paths - Add all module directories
 # **********************************************************
@@ -89,6 +120,7 @@ SRCS += ble_manager.c
 SRCS += ble_stack.c
 SRCS += svc_custom.c
 SRCS += protocol.c
+SRCS += cmd_parser.c
 SRCS += ble_tx.c
 
 # Workout sources
@@ -98,9 +130,15 @@ SRCS += workout_control.c
 # Input sources
 SRCS += buttons.c
 SRCS += max7325.c
+SRCS += i2c_bus.c
+SRCS += gpio_irq.c
+SRCS += button_gesture.c
+SRCS += hr_dsp.c
 
 # Storage sources
 SRCS += buffer.c
+SRCS += event_log.c
+SRCS += flash_port_mxc.c
 
 # RTOS sources
 SRCS += tasks.c
@@ -108,5 +146,7 @@ SRCS += freertos_tickless.c
 
 # Utils sources
 SRCS += time_utils.c
+SRCS += time_port_mxc.c
+SRCS += log.c
 
-SRCS += control_task.c
\ No newline at end of file
+SRCS += sensor_task.c
\ No newline at end of file
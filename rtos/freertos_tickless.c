@@ -36,6 +36,9 @@
 #include "FreeRTOSConfig.h"
 #include "task.h"
 
+/* Shared I2C bus */
+#include "i2c_bus.h"
+
 /* Bluetooth Cordio library */
 #include "pal_timer.h"
 #include "pal_uart.h"
@@ -75,6 +78,11 @@ int freertos_permit_tickless(void)
         return E_BUSY;
     }
 
+    /* An I2C transfer in progress would stop with the peripheral clocks */
+    if (I2cBus_IsBusy()) {
+        return E_BUSY;
+    }
+
     return E_NO_ERROR;
 }
 
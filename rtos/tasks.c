@@ -8,9 +8,11 @@
 
 #include "tasks.h"
 #include "buttons.h"
+#include "sensor_task.h"
 #include "workout_control.h"
 #include "ble_tx.h"
 #include "buffer.h"
+#include "log.h"
 #include "FreeRTOS.h"
 #include "task.h"
 #include <stdio.h>
@@ -24,6 +26,14 @@ bool Tasks_Init(bool enableTestInput)
 {
     printf("[TASKS] Initializing application tasks...\n");
 
+    /* Deferred logger first, so every module can log from here on */
+    Log_Init();
+    if (!Log_StartTask())
+    {
+        printf("[TASKS] ERROR: Log task creation failed\n");
+        return false;
+    }
+
     /* Initialize offline event buffer */
     Buffer_Init();
 
@@ -41,8 +51,12 @@ bool Tasks_Init(bool enableTestInput)
         return false;
     }
 
-    /* Initialize workout control */
-    WorkoutControl_Init();
+    /* Initialize workout control (joins the button queue to its queue set) */
+    if (!WorkoutControl_Init())
+    {
+        printf("[TASKS] ERROR: Workout control init failed\n");
+        return false;
+    }
 
     /* Start the control task */
     if (!WorkoutControl_StartTask())
@@ -51,6 +65,15 @@ bool Tasks_Init(bool enableTestInput)
         return false;
     }
 
+#if HR_SENSOR_ENABLE
+    /* HR sensor task idles until the control task opens a measurement window */
+    if (!SensorTask_Init() || !SensorTask_Start())
+    {
+        printf("[TASKS] ERROR: HR sensor task creation failed\n");
+        return false;
+    }
+#endif
+
     /* Start BLE TX task */
     if (!BleTx_StartTask())
     {
@@ -27,6 +27,7 @@ extern "C" {
  *  \brief  Initialize all application tasks.
  *
  *  Creates:
+ *  - LogTask: Prints deferred log messages at idle priority
  *  - ControlTask: Handles workout state machine
  *  - TestInputTask: Reads keyboard for testing (optional)
  *
@@ -2,29 +2,107 @@
 /*!
  *  \file   buffer.c
  *
- *  \brief  Circular buffer implementation for offline event storage.
+ *  \brief  Offline event storage on top of the persistent flash event log.
+ *
+ *  Status updates only describe the current state, so they never enter the log: the
+ *  newest one is kept in a single RAM slot and delivered after the logged backlog. The
+ *  slot is shared between the pushing and popping tasks through a sequence counter
+ *  (odd while being written), so neither side blocks.
  */
 /*************************************************************************************************/
 
 #include "buffer.h"
-#include <string.h>
+#include "event_log.h"
+#include <stdatomic.h>
 #include <stdio.h>
+#include <string.h>
+
+/**************************************************************************************************
+  Data Types
+**************************************************************************************************/
+
+/*! What happens to an event when space runs short */
+typedef enum
+{
+    BUFFER_CLASS_KEEP,      /* Logged; never evicted by other events */
+    BUFFER_CLASS_LATEST     /* Only the newest one is kept */
+} BufferClass_t;
 
 /**************************************************************************************************
   Local Variables
 **************************************************************************************************/
 
-/*! Circular buffer for events */
-static WorkoutEvent_t s_buffer[BUFFER_MAX_EVENTS];
+/*! Latest status update and its sequence counter (written by the pushing side) */
+static WorkoutEvent_t s_status;
+static atomic_uint_fast32_t s_statusSeq;
+
+/*! Status sequence last delivered (popping side) and the copy handed out by a peek */
+static atomic_uint_fast32_t s_statusSent;
+static uint32_t s_statusPeekSeq = 0;
+static WorkoutEvent_t s_statusCopy;
+
+/*! Log events and status slot covered by the last peek (popping side) */
+static uint16_t s_peekLogCount = 0;
+static bool s_peekStatus = false;
+
+/*! Counters (statusCollapsed written by the pushing side) */
+static uint32_t s_statusCollapsed = 0;
+
+/**************************************************************************************************
+  Local Functions
+**************************************************************************************************/
+
+/*************************************************************************************************/
+static BufferClass_t eventClass(EventType_t type)
+{
+    return (type == EVENT_STATUS_UPDATE) ? BUFFER_CLASS_LATEST : BUFFER_CLASS_KEEP;
+}
+
+/*************************************************************************************************/
+static void statusStore(const WorkoutEvent_t *pEvent)
+{
+    uint32_t seq = atomic_load_explicit(&s_statusSeq, memory_order_relaxed);
+
+    /* An undelivered status is replaced rather than queued */
+    if (seq != 0 && seq != atomic_load_explicit(&s_statusSent, memory_order_relaxed))
+    {
+        s_statusCollapsed++;
+    }
+
+    atomic_store_explicit(&s_statusSeq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memcpy(&s_status, pEvent, sizeof(WorkoutEvent_t));
+    atomic_store_explicit(&s_statusSeq, seq + 2, memory_order_release);
+}
 
-/*! Buffer head (next write position) */
-static uint8_t s_head = 0;
+/*************************************************************************************************/
+static bool statusLoad(void)
+{
+    uint32_t seq;
+
+    do
+    {
+        seq = atomic_load_explicit(&s_statusSeq, memory_order_acquire);
+        if (seq == atomic_load_explicit(&s_statusSent, memory_order_relaxed))
+        {
+            return false;
+        }
+
+        memcpy(&s_statusCopy, &s_status, sizeof(WorkoutEvent_t));
+        atomic_thread_fence(memory_order_acquire);
+    } while ((seq & 1) != 0 || seq != atomic_load_explicit(&s_statusSeq, memory_order_relaxed));
+
+    s_statusPeekSeq = seq;
+    return true;
+}
 
-/*! Buffer tail (next read position) */
-static uint8_t s_tail = 0;
+/*************************************************************************************************/
+static bool statusPending(void)
+{
+    uint32_t seq = atomic_load_explicit(&s_statusSeq, memory_order_acquire);
 
-/*! Number of events in buffer */
-static uint8_t s_count = 0;
+    return ((seq & ~1UL) != atomic_load_explicit(&s_statusSent, memory_order_relaxed) && seq != 0);
+}
 
 /**************************************************************************************************
   Public Functions
@@ -33,82 +111,159 @@ static uint8_t s_count = 0;
 /*************************************************************************************************/
 void Buffer_Init(void)
 {
-    s_head = 0;
-    s_tail = 0;
-    s_count = 0;
-    memset(s_buffer, 0, sizeof(s_buffer));
-    
-    printf("[BUFFER] Initialized (%d event capacity)\n", BUFFER_MAX_EVENTS);
+    EventLog_Init();
+
+    atomic_store(&s_statusSeq, 0);
+    atomic_store(&s_statusSent, 0);
+    s_statusCollapsed = 0;
+    s_peekLogCount = 0;
+    s_peekStatus = false;
+
+    printf("[BUFFER] Initialized (%d event capacity, %u recovered)\n",
+           BUFFER_MAX_EVENTS, Buffer_GetCount());
 }
 
 /*************************************************************************************************/
 bool Buffer_Push(const WorkoutEvent_t *pEvent)
 {
-    bool overflow = false;
-    
+    bool stored;
+
     if (pEvent == NULL)
     {
         return false;
     }
-    
-    /* Check if buffer is full */
-    if (s_count >= BUFFER_MAX_EVENTS)
+
+    if (eventClass(pEvent->type) == BUFFER_CLASS_LATEST)
     {
-        /* Overwrite oldest event (move tail forward) */
-        s_tail = (s_tail + 1) % BUFFER_MAX_EVENTS;
-        overflow = true;
-        printf("[BUFFER] WARNING: Buffer full, oldest event overwritten\n");
+        statusStore(pEvent);
+        return true;
     }
-    else
+
+    stored = EventLog_Append(pEvent);
+
+    /* Don't leave the end of a session sitting in RAM */
+    if (pEvent->type == EVENT_WORKOUT_DONE || pEvent->type == EVENT_WORKOUT_STOP)
     {
-        s_count++;
+        EventLog_Sync();
     }
-    
-    /* Copy event to buffer */
-    memcpy(&s_buffer[s_head], pEvent, sizeof(WorkoutEvent_t));
-    
-    /* Move head forward */
-    s_head = (s_head + 1) % BUFFER_MAX_EVENTS;
-    
-    return !overflow;
+
+    return stored;
 }
 
 /*************************************************************************************************/
 bool Buffer_Pop(WorkoutEvent_t *pEvent)
 {
-    if (pEvent == NULL || s_count == 0)
+    const WorkoutEvent_t *pOldest;
+
+    if (pEvent == NULL || (pOldest = Buffer_Peek()) == NULL)
     {
         return false;
     }
-    
-    /* Copy event from buffer */
-    memcpy(pEvent, &s_buffer[s_tail], sizeof(WorkoutEvent_t));
-    
-    /* Move tail forward */
-    s_tail = (s_tail + 1) % BUFFER_MAX_EVENTS;
-    s_count--;
-    
+
+    memcpy(pEvent, pOldest, sizeof(WorkoutEvent_t));
+    Buffer_Commit(1);
+
     return true;
 }
 
 /*************************************************************************************************/
-uint8_t Buffer_GetCount(void)
+const WorkoutEvent_t *Buffer_Peek(void)
 {
-    return s_count;
+    const WorkoutEvent_t *pEvent;
+
+    return (Buffer_PeekSpan(&pEvent, 1) == 1) ? pEvent : NULL;
+}
+
+/*************************************************************************************************/
+uint16_t Buffer_PeekSpan(const WorkoutEvent_t **ppEvents, uint16_t max)
+{
+    uint16_t count;
+
+    if (ppEvents == NULL || max == 0)
+    {
+        return 0;
+    }
+
+    count = EventLog_PeekSpan(ppEvents, max);
+    s_peekLogCount = count;
+    s_peekStatus = false;
+
+    /* The status slot is the newest state, so it goes out once the log is drained */
+    if (count < max && count == EventLog_Count() && statusLoad())
+    {
+        ppEvents[count++] = &s_statusCopy;
+        s_peekStatus = true;
+    }
+
+    return count;
+}
+
+/*************************************************************************************************/
+void Buffer_Commit(uint16_t count)
+{
+    if (count > s_peekLogCount)
+    {
+        if (s_peekStatus)
+        {
+            atomic_store_explicit(&s_statusSent, s_statusPeekSeq, memory_order_relaxed);
+        }
+        count = s_peekLogCount;
+    }
+
+    EventLog_Commit(count);
+    s_peekLogCount = 0;
+    s_peekStatus = false;
+}
+
+/*************************************************************************************************/
+uint32_t Buffer_Rewind(uint64_t sinceMs)
+{
+    s_peekLogCount = 0;
+    s_peekStatus = false;
+
+    return EventLog_Rewind(sinceMs);
+}
+
+/*************************************************************************************************/
+uint16_t Buffer_GetCount(void)
+{
+    /* Never more than EVENT_LOG_SLOTS + 1, so this fits */
+    return (uint16_t)(EventLog_Count() + (statusPending() ? 1 : 0));
 }
 
 /*************************************************************************************************/
 bool Buffer_IsEmpty(void)
 {
-    return (s_count == 0);
+    return (Buffer_GetCount() == 0);
 }
 
 /*************************************************************************************************/
 void Buffer_Clear(void)
 {
-    s_head = 0;
-    s_tail = 0;
-    s_count = 0;
-    
+    EventLog_Clear();
+
+    atomic_store_explicit(&s_statusSent,
+                          atomic_load_explicit(&s_statusSeq, memory_order_acquire) & ~1UL,
+                          memory_order_relaxed);
+    s_peekLogCount = 0;
+    s_peekStatus = false;
+
     printf("[BUFFER] Cleared\n");
 }
+
+/*************************************************************************************************/
+void Buffer_GetStats(BufferStats_t *pStats)
+{
+    EventLogStats_t log;
+
+    if (pStats == NULL)
+    {
+        return;
+    }
+
+    EventLog_GetStats(&log);
+
+    pStats->stored = log.appended;
+    pStats->dropped = log.dropped;
+    pStats->statusCollapsed = s_statusCollapsed;
+}
@@ -2,10 +2,19 @@
 /*!
  *  \file   buffer.h
  *
- *  \brief  Circular buffer for offline workout event storage.
+ *  \brief  Offline workout event storage.
  *
- *  This module provides a RAM-based circular buffer for storing workout events
- *  when BLE is disconnected. Events are flushed when connection is restored.
+ *  Stores workout events while BLE is disconnected and hands them back in order
+ *  when the connection is restored. Events are kept in the persistent flash event
+ *  log (event_log.h), so they survive a reset.
+ *
+ *  Events are kept according to their class: workout start/stop/done and lap events
+ *  are logged and never evicted, while status updates only describe the current state
+ *  and collapse into a single slot holding the newest one (not persisted). When the log
+ *  is full, new logged events are dropped and counted.
+ *
+ *  Buffer_Push may be called from one task while Buffer_Pop runs in another; neither
+ *  side takes a lock. Peek, Commit, Rewind and Clear belong to the popping side.
  */
 /*************************************************************************************************/
 
@@ -15,6 +24,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "workout_types.h"
+#include "event_log.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -24,7 +34,19 @@ extern "C" {
   Constants
 **************************************************************************************************/
 
-#define BUFFER_MAX_EVENTS   16  /* Maximum events to buffer offline */
+#define BUFFER_MAX_EVENTS   EVENT_LOG_CAPACITY  /* Events retained offline */
+
+/**************************************************************************************************
+  Data Types
+**************************************************************************************************/
+
+/*! Buffer counters since boot */
+typedef struct
+{
+    uint32_t stored;            /* Events written to the log */
+    uint32_t dropped;           /* Logged-class events refused because the log was full */
+    uint32_t statusCollapsed;   /* Undelivered status updates replaced by a newer one */
+} BufferStats_t;
 
 /**************************************************************************************************
   Function Declarations
@@ -43,7 +65,7 @@ void Buffer_Init(void);
  *
  *  \param  pEvent  Pointer to event to store.
  *
- *  \return true if stored, false if buffer full (oldest event overwritten).
+ *  \return true if stored, false if the buffer was full (event dropped).
  */
 /*************************************************************************************************/
 bool Buffer_Push(const WorkoutEvent_t *pEvent);
@@ -59,6 +81,52 @@ bool Buffer_Push(const WorkoutEvent_t *pEvent);
 /*************************************************************************************************/
 bool Buffer_Pop(WorkoutEvent_t *pEvent);
 
+/*************************************************************************************************/
+/*!
+ *  \brief  Get the oldest event without removing it.
+ *
+ *  The pointer refers to the stored copy (no memcpy) and stays valid until the next
+ *  Buffer_Peek(), Buffer_PeekSpan() or Buffer_Commit() call.
+ *
+ *  \return Oldest event, or NULL if buffer empty.
+ */
+/*************************************************************************************************/
+const WorkoutEvent_t *Buffer_Peek(void);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Get up to max of the oldest events without removing them.
+ *
+ *  Same lifetime rules as Buffer_Peek().
+ *
+ *  \param  ppEvents  Receives the event pointers, oldest first.
+ *  \param  max       Capacity of ppEvents.
+ *
+ *  \return Number of events returned.
+ */
+/*************************************************************************************************/
+uint16_t Buffer_PeekSpan(const WorkoutEvent_t **ppEvents, uint16_t max);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Remove the oldest events once they have been delivered.
+ *
+ *  \param  count  Number of peeked events to remove.
+ */
+/*************************************************************************************************/
+void Buffer_Commit(uint16_t count);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Queue already delivered events for sending again.
+ *
+ *  \param  sinceMs  Oldest event timestamp to resend (see EventLog_Rewind()).
+ *
+ *  \return Number of events requeued.
+ */
+/*************************************************************************************************/
+uint32_t Buffer_Rewind(uint64_t sinceMs);
+
 /*************************************************************************************************/
 /*!
  *  \brief  Get the number of events currently buffered.
@@ -66,7 +134,7 @@ bool Buffer_Pop(WorkoutEvent_t *pEvent);
  *  \return Number of buffered events.
  */
 /*************************************************************************************************/
-uint8_t Buffer_GetCount(void);
+uint16_t Buffer_GetCount(void);
 
 /*************************************************************************************************/
 /*!
@@ -84,6 +152,15 @@ bool Buffer_IsEmpty(void);
 /*************************************************************************************************/
 void Buffer_Clear(void);
 
+/*************************************************************************************************/
+/*!
+ *  \brief  Get buffer counters.
+ *
+ *  \param  pStats  Receives a copy of the counters.
+ */
+/*************************************************************************************************/
+void Buffer_GetStats(BufferStats_t *pStats);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,652 @@
+/*************************************************************************************************/
+/*!
+ *  \file   event_log.c
+ *
+ *  \brief  Persistent flash event log implementation.
+ *
+ *  Record sequence number N always lives in slot (N % EVENT_LOG_SLOTS), so a slot holding
+ *  a record whose sequence does not map back to it is stale. Checkpoints are 16-byte
+ *  entries appended to one of two checkpoint pages; the valid one with the highest epoch
+ *  holds the first unread sequence number. When the current page is full the other one is
+ *  erased and written next, so the newest checkpoint is never the one being erased.
+ *
+ *  Concurrency: one producer context (Append, Sync) and one consumer context (PeekSpan,
+ *  Commit, Rewind, Clear) may run in different tasks without locking. The producer owns s_head,
+ *  s_flushed, the staging area and the record pages; the consumer owns s_tail and the
+ *  checkpoint page. Each side only reads the other's index through an acquire load, and
+ *  the producer never erases a page the consumer has not finished with.
+ */
+/*************************************************************************************************/
+
+#include "event_log.h"
+#include <stddef.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <stdio.h>
+
+/**************************************************************************************************
+  Macros
+**************************************************************************************************/
+
+#define EVENT_LOG_REC_MAGIC         0xA6    /* Marks a programmed event record (64-bit timestamp layout) */
+#define EVENT_LOG_CKPT_MAGIC        0x324B4843UL    /* "CHK2" (epoch layout) */
+#define EVENT_LOG_CKPT_SIZE         16
+#define EVENT_LOG_CKPT_ENTRIES      (FLASH_PORT_PAGE_SIZE / EVENT_LOG_CKPT_SIZE)
+#define EVENT_LOG_CKPT_OFFSET(page) ((EVENT_LOG_DATA_PAGES + (uint32_t)(page)) * FLASH_PORT_PAGE_SIZE)
+
+#define EVENT_LOG_SLOT_MASK         (EVENT_LOG_SLOTS - 1)
+
+#define EVENT_LOG_CRC_INIT          0xFFFF
+
+/**************************************************************************************************
+  Data Types
+**************************************************************************************************/
+
+/*! One record as stored in flash */
+typedef struct
+{
+    uint32_t seq;           /* Sequence number */
+    uint16_t crc;           /* CRC-16/CCITT over every other byte of the record */
+    uint8_t magic;          /* EVENT_LOG_REC_MAGIC */
+    uint8_t reserved;
+    WorkoutEvent_t event;
+} EventLogRecord_t;
+
+/*! One checkpoint as stored in flash */
+typedef struct
+{
+    uint32_t magic;         /* EVENT_LOG_CKPT_MAGIC */
+    uint32_t tail;          /* First unread sequence number */
+    uint32_t epoch;         /* One more than the previous checkpoint's, across both pages */
+    uint32_t check;         /* ~(tail ^ epoch) */
+} EventLogCkpt_t;
+
+_Static_assert(sizeof(EventLogRecord_t) == EVENT_LOG_RECORD_SIZE, "event log record size");
+_Static_assert(sizeof(EventLogCkpt_t) == EVENT_LOG_CKPT_SIZE, "event log checkpoint size");
+_Static_assert((EVENT_LOG_RECORD_SIZE % FLASH_PORT_WRITE_ALIGN) == 0, "record alignment");
+_Static_assert(EVENT_LOG_DATA_PAGES >= 2, "event log needs at least two record pages");
+_Static_assert(EVENT_LOG_CKPT_PAGES == 2, "checkpoint pages are used in turn");
+_Static_assert((EVENT_LOG_SLOTS & EVENT_LOG_SLOT_MASK) == 0, "slot count must be a power of two");
+
+/**************************************************************************************************
+  Local Variables
+**************************************************************************************************/
+
+static bool s_ready = false;
+
+/*! Next sequence number to append (written by the producer only) */
+static atomic_uint_fast32_t s_head;
+
+/*! Oldest unread sequence number (written by the consumer only) */
+static atomic_uint_fast32_t s_tail;
+
+/*! First sequence number still in s_stage, everything below is in flash (producer) */
+static atomic_uint_fast32_t s_flushed;
+
+/*! Records appended but not yet programmed (producer) */
+static EventLogRecord_t s_stage[EVENT_LOG_BATCH];
+
+/*! Copies of staged records handed out by EventLog_PeekSpan() (consumer) */
+static EventLogRecord_t s_peekCopy[EVENT_LOG_BATCH];
+
+/*! Tail and epoch of the last checkpoint written, the page in use and its next free entry
+ *  (consumer) */
+static uint32_t s_ckptTail = 0;
+static uint32_t s_ckptEpoch = 0;
+static uint8_t s_ckptPage = 0;
+static uint16_t s_ckptIndex = 0;
+
+/*! Counters, each written from one side only except the flash ones */
+static uint32_t s_appended;
+static uint32_t s_dropped;
+static uint32_t s_corrupt;
+static atomic_uint_fast32_t s_pageErases;
+static atomic_uint_fast32_t s_flashErrors;
+
+/*! CRC-16/CCITT nibble table */
+static const uint16_t s_crcTable[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+/**************************************************************************************************
+  Local Functions
+**************************************************************************************************/
+
+/*************************************************************************************************/
+static uint16_t crc16(uint16_t crc, const uint8_t *pData, uint32_t len)
+{
+    while (len--)
+    {
+        crc = (uint16_t)((crc << 4) ^ s_crcTable[((crc >> 12) ^ (*pData >> 4)) & 0x0F]);
+        crc = (uint16_t)((crc << 4) ^ s_crcTable[((crc >> 12) ^ (*pData & 0x0F)) & 0x0F]);
+        pData++;
+    }
+
+    return crc;
+}
+
+/*************************************************************************************************/
+static uint16_t recordCrc(const EventLogRecord_t *pRec)
+{
+    const uint8_t *pBytes = (const uint8_t *)pRec;
+    uint16_t crc;
+
+    /* Everything except the crc field itself */
+    crc = crc16(EVENT_LOG_CRC_INIT, pBytes, offsetof(EventLogRecord_t, crc));
+    return crc16(crc, pBytes + offsetof(EventLogRecord_t, magic),
+                 sizeof(EventLogRecord_t) - offsetof(EventLogRecord_t, magic));
+}
+
+/*************************************************************************************************/
+static bool recordValid(const EventLogRecord_t *pRec, uint32_t seq)
+{
+    return (pRec->magic == EVENT_LOG_REC_MAGIC && pRec->seq == seq && pRec->crc == recordCrc(pRec));
+}
+
+/*************************************************************************************************/
+static const EventLogRecord_t *flashRecord(uint32_t slot)
+{
+    return (const EventLogRecord_t *)FlashPort_Map((slot & EVENT_LOG_SLOT_MASK) * EVENT_LOG_RECORD_SIZE);
+}
+
+/*************************************************************************************************/
+static bool isErased(const void *pData, uint32_t len)
+{
+    const uint8_t *pBytes = (const uint8_t *)pData;
+
+    while (len--)
+    {
+        if (*pBytes++ != 0xFF)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/*************************************************************************************************/
+static bool erasePage(uint32_t offset)
+{
+    atomic_fetch_add_explicit(&s_pageErases, 1, memory_order_relaxed);
+
+    if (!FlashPort_Erase(offset))
+    {
+        atomic_fetch_add_explicit(&s_flashErrors, 1, memory_order_relaxed);
+        return false;
+    }
+
+    return true;
+}
+
+/*************************************************************************************************/
+static const EventLogCkpt_t *flashCheckpoint(uint8_t page, uint16_t index)
+{
+    return (const EventLogCkpt_t *)FlashPort_Map(EVENT_LOG_CKPT_OFFSET(page) +
+                                                 (uint32_t)index * EVENT_LOG_CKPT_SIZE);
+}
+
+/*************************************************************************************************/
+static void writeCheckpoint(uint32_t tail)
+{
+    EventLogCkpt_t ckpt;
+
+    if (tail == s_ckptTail)
+    {
+        return;
+    }
+
+    /* The full page keeps the newest checkpoint until an entry in the other page replaces it,
+     * so a reset between this erase and the write below loses nothing */
+    if (s_ckptIndex >= EVENT_LOG_CKPT_ENTRIES)
+    {
+        s_ckptPage ^= 1;
+        erasePage(EVENT_LOG_CKPT_OFFSET(s_ckptPage));
+        s_ckptIndex = 0;
+    }
+
+    s_ckptEpoch++;
+    ckpt.magic = EVENT_LOG_CKPT_MAGIC;
+    ckpt.tail = tail;
+    ckpt.epoch = s_ckptEpoch;
+    ckpt.check = ~(tail ^ s_ckptEpoch);
+
+    if (!FlashPort_Write(EVENT_LOG_CKPT_OFFSET(s_ckptPage) +
+                         (uint32_t)s_ckptIndex * EVENT_LOG_CKPT_SIZE, &ckpt, sizeof(ckpt)))
+    {
+        atomic_fetch_add_explicit(&s_flashErrors, 1, memory_order_relaxed);
+    }
+
+    s_ckptIndex++;
+    s_ckptTail = tail;
+}
+
+/*************************************************************************************************/
+static void checkpoint(uint32_t tail)
+{
+    uint32_t flushed = atomic_load_explicit(&s_flushed, memory_order_acquire);
+
+    /* Staged records do not survive a reset, so never checkpoint past them */
+    writeCheckpoint(((int32_t)(flushed - tail) > 0) ? tail : flushed);
+}
+
+/*************************************************************************************************/
+static void flushStage(uint32_t head, uint32_t flushed)
+{
+    uint32_t count = head - flushed;
+    uint32_t done = 0;
+    uint32_t slot;
+    uint32_t run;
+
+    /* Program contiguous runs, erasing each page as the head enters it */
+    while (done < count)
+    {
+        slot = (flushed + done) & EVENT_LOG_SLOT_MASK;
+
+        if ((slot % EVENT_LOG_SLOTS_PER_PAGE) == 0)
+        {
+            erasePage(slot * EVENT_LOG_RECORD_SIZE);
+        }
+
+        run = EVENT_LOG_SLOTS_PER_PAGE - (slot % EVENT_LOG_SLOTS_PER_PAGE);
+        if (run > count - done)
+        {
+            run = count - done;
+        }
+
+        if (!FlashPort_Write(slot * EVENT_LOG_RECORD_SIZE, &s_stage[done],
+                             run * EVENT_LOG_RECORD_SIZE))
+        {
+            atomic_fetch_add_explicit(&s_flashErrors, 1, memory_order_relaxed);
+        }
+
+        done += run;
+    }
+
+    /* Release: the records programmed above are visible to whoever sees the new index.
+     * Fence: the index is published before the staging area is reused; pairs with the
+     * fence in readRecord() */
+    atomic_store_explicit(&s_flushed, head, memory_order_release);
+    atomic_thread_fence(memory_order_release);
+}
+
+/*************************************************************************************************/
+static bool readRecord(uint32_t seq, EventLogRecord_t *pRec)
+{
+    const EventLogRecord_t *pSrc;
+    uint32_t flushed;
+
+    /* Seqlock-style read: a staged copy is only trusted if no flush ran meanwhile */
+    do
+    {
+        flushed = atomic_load_explicit(&s_flushed, memory_order_acquire);
+        pSrc = ((int32_t)(seq - flushed) >= 0) ? &s_stage[seq - flushed] : flashRecord(seq);
+        memcpy(pRec, pSrc, sizeof(*pRec));
+        atomic_thread_fence(memory_order_acquire);
+    } while (flushed != atomic_load_explicit(&s_flushed, memory_order_relaxed));
+
+    return recordValid(pRec, seq);
+}
+
+/*************************************************************************************************/
+static uint32_t loadCheckpoint(void)
+{
+    const EventLogCkpt_t *pCkpt;
+    uint32_t tail = 0;
+    bool found = false;
+    uint16_t newest = 0;
+    uint8_t page;
+    uint16_t i;
+
+    s_ckptPage = 0;
+    s_ckptEpoch = 0;
+
+    /* Entries are appended in order, so each page ends at its first erased entry */
+    for (page = 0; page < EVENT_LOG_CKPT_PAGES; page++)
+    {
+        for (i = 0; i < EVENT_LOG_CKPT_ENTRIES; i++)
+        {
+            pCkpt = flashCheckpoint(page, i);
+
+            if (isErased(pCkpt, sizeof(*pCkpt)))
+            {
+                break;
+            }
+
+            /* Entries torn by a reset are skipped, the previous one still stands */
+            if (pCkpt->magic != EVENT_LOG_CKPT_MAGIC || pCkpt->check != ~(pCkpt->tail ^ pCkpt->epoch))
+            {
+                continue;
+            }
+
+            if (!found || (int32_t)(pCkpt->epoch - s_ckptEpoch) > 0)
+            {
+                tail = pCkpt->tail;
+                s_ckptEpoch = pCkpt->epoch;
+                s_ckptPage = page;
+                newest = i;
+                found = true;
+            }
+        }
+    }
+
+    /* Carry on in the newest entry's page, after anything a torn write left behind it */
+    for (i = found ? newest + 1 : 0; i < EVENT_LOG_CKPT_ENTRIES; i++)
+    {
+        if (isErased(flashCheckpoint(s_ckptPage, i), EVENT_LOG_CKPT_SIZE))
+        {
+            break;
+        }
+    }
+    s_ckptIndex = i;
+
+    return tail;
+}
+
+/**************************************************************************************************
+  Public Functions
+**************************************************************************************************/
+
+/*************************************************************************************************/
+bool EventLog_Init(void)
+{
+    const EventLogRecord_t *pRec;
+    uint32_t minSeq = 0;
+    uint32_t maxSeq = 0;
+    uint32_t ckptTail;
+    uint32_t head;
+    uint32_t tail;
+    bool found = false;
+    uint32_t slot;
+
+    s_appended = 0;
+    s_dropped = 0;
+    s_corrupt = 0;
+    atomic_store(&s_pageErases, 0);
+    atomic_store(&s_flashErrors, 0);
+
+    s_ready = FlashPort_Init();
+
+    if (!s_ready)
+    {
+        printf("[LOG] ERROR: Flash unavailable, offline events will be dropped\n");
+        return false;
+    }
+
+    /* Find the newest and oldest surviving records */
+    for (slot = 0; slot < EVENT_LOG_SLOTS; slot++)
+    {
+        pRec = flashRecord(slot);
+
+        if (pRec->magic != EVENT_LOG_REC_MAGIC || (pRec->seq & EVENT_LOG_SLOT_MASK) != slot ||
+            !recordValid(pRec, pRec->seq))
+        {
+            continue;
+        }
+
+        if (!found || pRec->seq < minSeq)
+        {
+            minSeq = pRec->seq;
+        }
+        if (!found || pRec->seq > maxSeq)
+        {
+            maxSeq = pRec->seq;
+        }
+        found = true;
+    }
+
+    ckptTail = loadCheckpoint();
+
+    head = (found && maxSeq + 1 > ckptTail) ? maxSeq + 1 : ckptTail;
+    tail = (found && minSeq > ckptTail) ? minSeq : ckptTail;
+
+    /* A write torn by a reset leaves a programmed but invalid slot - skip to clean flash */
+    while ((head % EVENT_LOG_SLOTS_PER_PAGE) != 0 &&
+           !isErased(flashRecord(head), EVENT_LOG_RECORD_SIZE))
+    {
+        head++;
+    }
+
+    atomic_store(&s_head, head);
+    atomic_store(&s_tail, tail);
+    atomic_store(&s_flushed, head);
+    s_ckptTail = ckptTail;
+
+    printf("[LOG] Mounted: %lu unread event(s), capacity %d\n",
+           (unsigned long)(head - tail), EVENT_LOG_CAPACITY);
+
+    return true;
+}
+
+/*************************************************************************************************/
+bool EventLog_Append(const WorkoutEvent_t *pEvent)
+{
+    EventLogRecord_t *pRec;
+    uint32_t head;
+    uint32_t flushed;
+    uint32_t tail;
+
+    if (!s_ready || pEvent == NULL)
+    {
+        return false;
+    }
+
+    head = atomic_load_explicit(&s_head, memory_order_relaxed);
+    flushed = atomic_load_explicit(&s_flushed, memory_order_relaxed);
+
+    /* Entering a page erases it at the next flush - only allowed once it has been read */
+    if ((head % EVENT_LOG_SLOTS_PER_PAGE) == 0)
+    {
+        tail = atomic_load_explicit(&s_tail, memory_order_acquire);
+
+        if (head - tail > EVENT_LOG_SLOTS - EVENT_LOG_SLOTS_PER_PAGE)
+        {
+            if (s_dropped++ == 0)
+            {
+                printf("[LOG] WARNING: Log full, dropping new events\n");
+            }
+            return false;
+        }
+    }
+
+    pRec = &s_stage[head - flushed];
+    memset(pRec, 0xFF, sizeof(*pRec));
+    pRec->seq = head;
+    pRec->magic = EVENT_LOG_REC_MAGIC;
+    memcpy(&pRec->event, pEvent, sizeof(WorkoutEvent_t));
+    pRec->crc = recordCrc(pRec);
+
+    head++;
+    s_appended++;
+
+    /* Record contents must be visible before the consumer sees the new head */
+    atomic_store_explicit(&s_head, head, memory_order_release);
+
+    if (head - flushed >= EVENT_LOG_BATCH)
+    {
+        flushStage(head, flushed);
+    }
+
+    return true;
+}
+
+/*************************************************************************************************/
+void EventLog_Sync(void)
+{
+    uint32_t head;
+    uint32_t flushed;
+
+    if (!s_ready)
+    {
+        return;
+    }
+
+    head = atomic_load_explicit(&s_head, memory_order_relaxed);
+    flushed = atomic_load_explicit(&s_flushed, memory_order_relaxed);
+
+    if (head != flushed)
+    {
+        flushStage(head, flushed);
+    }
+}
+
+/*************************************************************************************************/
+uint16_t EventLog_PeekSpan(const WorkoutEvent_t **ppEvents, uint16_t max)
+{
+    const EventLogRecord_t *pRec;
+    EventLogRecord_t *pCopy;
+    uint32_t tail;
+    uint32_t head;
+    uint32_t seq;
+    uint16_t count = 0;
+
+    if (!s_ready || ppEvents == NULL)
+    {
+        return 0;
+    }
+
+    tail = atomic_load_explicit(&s_tail, memory_order_relaxed);
+    head = atomic_load_explicit(&s_head, memory_order_acquire);
+
+    for (seq = tail; seq != head && count < max; seq++)
+    {
+        if ((int32_t)(seq - atomic_load_explicit(&s_flushed, memory_order_acquire)) < 0)
+        {
+            /* In flash, and the producer won't erase it before we commit - use it in place */
+            pRec = flashRecord(seq);
+            if (recordValid(pRec, seq))
+            {
+                ppEvents[count++] = &pRec->event;
+                continue;
+            }
+        }
+        else
+        {
+            /* Still staged: the producer may reuse the slot, so take a private copy */
+            pCopy = &s_peekCopy[seq % EVENT_LOG_BATCH];
+            if (readRecord(seq, pCopy))
+            {
+                ppEvents[count++] = &pCopy->event;
+                continue;
+            }
+        }
+
+        /* Corrupt record: skip it if it leads the span, otherwise end the span before it */
+        if (count > 0)
+        {
+            break;
+        }
+
+        s_corrupt++;
+        tail = seq + 1;
+        atomic_store_explicit(&s_tail, tail, memory_order_release);
+    }
+
+    return count;
+}
+
+/*************************************************************************************************/
+void EventLog_Commit(uint16_t count)
+{
+    uint32_t tail;
+    uint32_t head;
+
+    if (!s_ready || count == 0)
+    {
+        return;
+    }
+
+    tail = atomic_load_explicit(&s_tail, memory_order_relaxed);
+    head = atomic_load_explicit(&s_head, memory_order_acquire);
+
+    if (count > head - tail)
+    {
+        count = (uint16_t)(head - tail);
+    }
+
+    /* Release: the producer may erase these slots as soon as it sees this */
+    tail += count;
+    atomic_store_explicit(&s_tail, tail, memory_order_release);
+
+    /* Persist progress every batch, and once the backlog is drained */
+    if (tail == head || tail - s_ckptTail >= EVENT_LOG_BATCH)
+    {
+        checkpoint(tail);
+    }
+}
+
+/*************************************************************************************************/
+uint32_t EventLog_Rewind(uint64_t sinceMs)
+{
+    EventLogRecord_t rec;
+    uint32_t tail;
+    uint32_t head;
+    uint32_t floor = 0;
+    uint32_t seq;
+
+    if (!s_ready)
+    {
+        return 0;
+    }
+
+    tail = atomic_load_explicit(&s_tail, memory_order_relaxed);
+    head = atomic_load_explicit(&s_head, memory_order_acquire);
+
+    /* The producer may already have checked the old tail before entering its next page */
+    if (head > EVENT_LOG_SLOTS - 2 * EVENT_LOG_SLOTS_PER_PAGE)
+    {
+        floor = head - (EVENT_LOG_SLOTS - 2 * EVENT_LOG_SLOTS_PER_PAGE);
+    }
+
+    for (seq = tail; seq > floor; seq--)
+    {
+        if (!readRecord(seq - 1, &rec) || rec.event.timestamp_ms < sinceMs)
+        {
+            break;
+        }
+    }
+
+    if (seq != tail)
+    {
+        atomic_store_explicit(&s_tail, seq, memory_order_release);
+    }
+
+    return tail - seq;
+}
+
+/*************************************************************************************************/
+uint32_t EventLog_Count(void)
+{
+    uint32_t tail = atomic_load_explicit(&s_tail, memory_order_acquire);
+
+    return atomic_load_explicit(&s_head, memory_order_acquire) - tail;
+}
+
+/*************************************************************************************************/
+void EventLog_Clear(void)
+{
+    uint32_t head;
+
+    if (!s_ready)
+    {
+        return;
+    }
+
+    head = atomic_load_explicit(&s_head, memory_order_acquire);
+    atomic_store_explicit(&s_tail, head, memory_order_release);
+    checkpoint(head);
+}
+
+/*************************************************************************************************/
+void EventLog_GetStats(EventLogStats_t *pStats)
+{
+    if (pStats != NULL)
+    {
+        pStats->appended = s_appended;
+        pStats->dropped = s_dropped;
+        pStats->corrupt = s_corrupt;
+        pStats->pageErases = atomic_load(&s_pageErases);
+        pStats->flashErrors = atomic_load(&s_flashErrors);
+    }
+}
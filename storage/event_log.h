@@ -0,0 +1,166 @@
+/*************************************************************************************************/
+/*!
+ *  \file   event_log.h
+ *
+ *  \brief  Persistent, append-only workout event log in internal flash.
+ *
+ *  Events are stored as fixed 32-byte CRC-protected records in a ring of flash pages.
+ *  Record sequence numbers increase monotonically and map directly to a slot, so the
+ *  log recovers its head and tail after a reset by scanning the pages once. Records are
+ *  staged in RAM and programmed EVENT_LOG_BATCH at a time; a page is erased only when
+ *  the head wraps into it, and only once every record in it has been read. When the log
+ *  is full new events are dropped, so the reader never loses data it has not seen.
+ *
+ *  The log is a single-producer/single-consumer structure: Append and Sync may be called
+ *  from one task while PeekSpan, Commit, Rewind and Clear run in another, with no locking.
+ *
+ *  Read progress is persisted as checkpoints in two dedicated pages used in turn, so a
+ *  reset while one is being erased still finds the last checkpoint in the other. Delivery
+ *  across a reset is at-least-once: up to EVENT_LOG_BATCH events may be sent twice.
+ */
+/*************************************************************************************************/
+
+#ifndef STORAGE_EVENT_LOG_H
+#define STORAGE_EVENT_LOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "workout_types.h"
+#include "flash_port.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**************************************************************************************************
+  Constants
+**************************************************************************************************/
+
+#define EVENT_LOG_RECORD_SIZE       32      /* Bytes per record in flash */
+#define EVENT_LOG_BATCH             8       /* Records staged in RAM per flash write */
+
+/* Last two pages of the region hold checkpoints, the rest hold records */
+#define EVENT_LOG_CKPT_PAGES        2
+#define EVENT_LOG_DATA_PAGES        (FLASH_PORT_REGION_PAGES - EVENT_LOG_CKPT_PAGES)
+#define EVENT_LOG_SLOTS_PER_PAGE    (FLASH_PORT_PAGE_SIZE / EVENT_LOG_RECORD_SIZE)
+#define EVENT_LOG_SLOTS             (EVENT_LOG_DATA_PAGES * EVENT_LOG_SLOTS_PER_PAGE)
+
+/* Unread events the log can always accept (the page ahead of the head must be free) */
+#define EVENT_LOG_CAPACITY          (EVENT_LOG_SLOTS - EVENT_LOG_SLOTS_PER_PAGE)
+
+/**************************************************************************************************
+  Data Types
+**************************************************************************************************/
+
+/*! Log counters since boot */
+typedef struct
+{
+    uint32_t appended;      /* Events accepted */
+    uint32_t dropped;       /* Events refused because the log was full */
+    uint32_t corrupt;       /* Records skipped on read (bad CRC or interrupted write) */
+    uint32_t pageErases;    /* Record and checkpoint page erases */
+    uint32_t flashErrors;   /* Failed erase or program operations */
+} EventLogStats_t;
+
+/**************************************************************************************************
+  Function Declarations
+**************************************************************************************************/
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Mount the log, recovering unread events left from before the last reset.
+ *
+ *  \return true if the flash region is usable.
+ */
+/*************************************************************************************************/
+bool EventLog_Init(void);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Append an event.
+ *
+ *  \param  pEvent  Event to store.
+ *
+ *  \return true if stored, false if the log is full (event dropped).
+ */
+/*************************************************************************************************/
+bool EventLog_Append(const WorkoutEvent_t *pEvent);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Program staged records to flash now (producer side).
+ */
+/*************************************************************************************************/
+void EventLog_Sync(void);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Look at the oldest unread events without consuming them.
+ *
+ *  Events already programmed are returned in place (pointers into memory-mapped flash);
+ *  only events still staged in RAM are copied. Corrupt records at the front of the log
+ *  are skipped. The pointers stay valid until the next EventLog_PeekSpan() or
+ *  EventLog_Commit() call.
+ *
+ *  \param  ppEvents  Receives up to max event pointers, oldest first.
+ *  \param  max       Capacity of ppEvents.
+ *
+ *  \return Number of events returned.
+ */
+/*************************************************************************************************/
+uint16_t EventLog_PeekSpan(const WorkoutEvent_t **ppEvents, uint16_t max);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Retire the oldest unread events once they have been delivered.
+ *
+ *  \param  count  Number of events to retire (as returned by EventLog_PeekSpan()).
+ */
+/*************************************************************************************************/
+void EventLog_Commit(uint16_t count);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Mark already delivered events as unread again so they are sent once more.
+ *
+ *  Walks back from the oldest unread event while the delivered records are still in
+ *  flash and have timestamp_ms >= sinceMs. Records in the page the producer may erase
+ *  next are never rewound into.
+ *
+ *  \param  sinceMs  Oldest event timestamp to resend.
+ *
+ *  \return Number of events made unread.
+ */
+/*************************************************************************************************/
+uint32_t EventLog_Rewind(uint64_t sinceMs);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Get the number of unread events.
+ *
+ *  \return Unread event count.
+ */
+/*************************************************************************************************/
+uint32_t EventLog_Count(void);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Mark every stored event as read.
+ */
+/*************************************************************************************************/
+void EventLog_Clear(void);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Get log counters.
+ *
+ *  \param  pStats  Receives a copy of the counters.
+ */
+/*************************************************************************************************/
+void EventLog_GetStats(EventLogStats_t *pStats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STORAGE_EVENT_LOG_H */
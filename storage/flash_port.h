@@ -0,0 +1,91 @@
+/*************************************************************************************************/
+/*!
+ *  \file   flash_port.h
+ *
+ *  \brief  Raw flash region used by the persistent event log.
+ *
+ *  The region is a run of erasable pages addressed by byte offset from its start. The
+ *  target implementation (flash_port_mxc.c) maps it onto internal flash near the top of
+ *  the MAX32655 array; the host implementation (flash_port_sim.c) backs it with RAM and
+ *  reproduces NOR semantics (erase to 0xFF, programming can only clear bits).
+ */
+/*************************************************************************************************/
+
+#ifndef STORAGE_FLASH_PORT_H
+#define STORAGE_FLASH_PORT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**************************************************************************************************
+  Constants
+**************************************************************************************************/
+
+#define FLASH_PORT_PAGE_SIZE        8192    /* Erase unit (MAX32655 flash page) */
+#define FLASH_PORT_WRITE_ALIGN      16      /* Program unit (128-bit flash word) */
+
+#ifndef FLASH_PORT_REGION_PAGES
+#define FLASH_PORT_REGION_PAGES     10      /* 8 log pages + 2 checkpoint pages */
+#endif
+
+#define FLASH_PORT_REGION_SIZE      (FLASH_PORT_PAGE_SIZE * FLASH_PORT_REGION_PAGES)
+
+/**************************************************************************************************
+  Function Declarations
+**************************************************************************************************/
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Prepare the flash region for use.
+ *
+ *  \return true if the region is usable.
+ */
+/*************************************************************************************************/
+bool FlashPort_Init(void);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Erase one page of the region to 0xFF.
+ *
+ *  \param  offset  Page-aligned byte offset within the region.
+ *
+ *  \return true if erased.
+ */
+/*************************************************************************************************/
+bool FlashPort_Erase(uint32_t offset);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Program bytes into previously erased flash.
+ *
+ *  \param  offset  Byte offset within the region (FLASH_PORT_WRITE_ALIGN aligned).
+ *  \param  pData   Data to program.
+ *  \param  len     Number of bytes (multiple of FLASH_PORT_WRITE_ALIGN, within one page).
+ *
+ *  \return true if programmed.
+ */
+/*************************************************************************************************/
+bool FlashPort_Write(uint32_t offset, const void *pData, uint32_t len);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Get a read pointer into the region.
+ *
+ *  Flash is memory mapped, so reads need no copy.
+ *
+ *  \param  offset  Byte offset within the region.
+ *
+ *  \return Pointer to the data at offset.
+ */
+/*************************************************************************************************/
+const void *FlashPort_Map(uint32_t offset);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STORAGE_FLASH_PORT_H */
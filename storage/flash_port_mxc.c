@@ -0,0 +1,146 @@
+/*************************************************************************************************/
+/*!
+ *  \file   flash_port_mxc.c
+ *
+ *  \brief  Flash region implementation for the MAX32655 internal flash controller.
+ *
+ *  The region sits directly below FLASH_PORT_RESERVED_TOP at the top of internal flash.
+ *  The linker script does not know about it, so the firmware image must stay below
+ *  FLASH_PORT_BASE_ADDR (checked at startup).
+ *
+ *  The flash controller is shared by the event log's producer and consumer, which may
+ *  run in different tasks, so each operation holds a mutex once the scheduler runs.
+ */
+/*************************************************************************************************/
+
+#include "flash_port.h"
+#include <stdio.h>
+#include <string.h>
+
+/* FreeRTOS includes */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+/* Maxim SDK includes */
+#include "mxc_device.h"
+#include "flc.h"
+
+/**************************************************************************************************
+  Macros
+**************************************************************************************************/
+
+#if FLASH_PORT_PAGE_SIZE != MXC_FLASH_PAGE_SIZE
+#error "FLASH_PORT_PAGE_SIZE must match the MAX32655 flash page size"
+#endif
+
+/* Pages at the very top of flash left to the Cordio PAL NVM database */
+#define FLASH_PORT_RESERVED_TOP     (2 * FLASH_PORT_PAGE_SIZE)
+
+#ifndef FLASH_PORT_BASE_ADDR
+#define FLASH_PORT_BASE_ADDR \
+    (MXC_FLASH_MEM_BASE + MXC_FLASH_MEM_SIZE - FLASH_PORT_RESERVED_TOP - FLASH_PORT_REGION_SIZE)
+#endif
+
+/* GCC linker script symbols: end of .text, and the RAM bounds of .data, whose initial
+ * values are stored in flash right after .text */
+extern uint32_t _etext;
+extern uint32_t _data;
+extern uint32_t _edata;
+
+/* End of the firmware image in flash, the .data load image included */
+#define FLASH_PORT_IMAGE_END \
+    ((uint32_t)&_etext + ((uint32_t)&_edata - (uint32_t)&_data))
+
+/**************************************************************************************************
+  Local Variables
+**************************************************************************************************/
+
+static StaticSemaphore_t s_flcMutexBuffer;
+static SemaphoreHandle_t s_flcMutex = NULL;
+
+/**************************************************************************************************
+  Local Functions
+**************************************************************************************************/
+
+/*************************************************************************************************/
+static void flcLock(void)
+{
+    if (xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED)
+    {
+        xSemaphoreTake(s_flcMutex, portMAX_DELAY);
+    }
+}
+
+/*************************************************************************************************/
+static void flcUnlock(void)
+{
+    if (xTaskGetSchedulerState() != taskSCHEDULER_NOT_STARTED)
+    {
+        xSemaphoreGive(s_flcMutex);
+    }
+}
+
+/**************************************************************************************************
+  Public Functions
+**************************************************************************************************/
+
+/*************************************************************************************************/
+bool FlashPort_Init(void)
+{
+    if (FLASH_PORT_IMAGE_END > FLASH_PORT_BASE_ADDR)
+    {
+        printf("[FLASH] ERROR: Image overlaps event log region (0x%08lx)\n",
+               (unsigned long)FLASH_PORT_BASE_ADDR);
+        return false;
+    }
+
+    if (s_flcMutex == NULL)
+    {
+        s_flcMutex = xSemaphoreCreateMutexStatic(&s_flcMutexBuffer);
+    }
+
+    return (MXC_FLC_Init() == E_NO_ERROR);
+}
+
+/*************************************************************************************************/
+bool FlashPort_Erase(uint32_t offset)
+{
+    int err;
+
+    if (offset >= FLASH_PORT_REGION_SIZE || (offset % FLASH_PORT_PAGE_SIZE) != 0)
+    {
+        return false;
+    }
+
+    flcLock();
+    err = MXC_FLC_PageErase(FLASH_PORT_BASE_ADDR + offset);
+    flcUnlock();
+
+    return (err == E_NO_ERROR);
+}
+
+/*************************************************************************************************/
+bool FlashPort_Write(uint32_t offset, const void *pData, uint32_t len)
+{
+    int err;
+
+    if (pData == NULL || (offset % FLASH_PORT_WRITE_ALIGN) != 0 ||
+        (len % FLASH_PORT_WRITE_ALIGN) != 0 || offset + len > FLASH_PORT_REGION_SIZE)
+    {
+        return false;
+    }
+
+    /* The driver takes a word pointer and programs 128 bits at a time */
+    flcLock();
+    err = MXC_FLC_Write(FLASH_PORT_BASE_ADDR + offset, len, (uint32_t *)pData);
+    flcUnlock();
+
+    return (err == E_NO_ERROR);
+}
+
+/*************************************************************************************************/
+const void *FlashPort_Map(uint32_t offset)
+{
+    return (const void *)(FLASH_PORT_BASE_ADDR + offset);
+}
@@ -0,0 +1,102 @@
+/*************************************************************************************************/
+/*!
+ *  \file   flash_port_sim.c
+ *
+ *  \brief  RAM-backed flash simulator for host builds.
+ *
+ *  Behaves like NOR flash: erase sets a page to 0xFF and programming ANDs data into the
+ *  array, so writing a slot twice without an erase corrupts it exactly as it would on
+ *  the part. The array survives Buffer_Init()/EventLog_Init(), which lets host code
+ *  simulate a reset by re-initializing the log. flash_port_sim.h adds test controls.
+ */
+/*************************************************************************************************/
+
+#include "flash_port_sim.h"
+#include <string.h>
+
+/**************************************************************************************************
+  Local Variables
+**************************************************************************************************/
+
+static uint8_t s_flash[FLASH_PORT_REGION_SIZE];
+static bool s_formatted = false;
+
+/*! Erase count per page, for wear checks */
+static uint32_t s_eraseCount[FLASH_PORT_REGION_PAGES];
+
+static FlashPortSimHook_t s_eraseHook = NULL;
+
+/**************************************************************************************************
+  Public Functions
+**************************************************************************************************/
+
+/*************************************************************************************************/
+bool FlashPort_Init(void)
+{
+    /* Factory-fresh part: everything erased, once per process */
+    if (!s_formatted)
+    {
+        memset(s_flash, 0xFF, sizeof(s_flash));
+        memset(s_eraseCount, 0, sizeof(s_eraseCount));
+        s_formatted = true;
+    }
+
+    return true;
+}
+
+/*************************************************************************************************/
+bool FlashPort_Erase(uint32_t offset)
+{
+    if (offset >= FLASH_PORT_REGION_SIZE || (offset % FLASH_PORT_PAGE_SIZE) != 0)
+    {
+        return false;
+    }
+
+    memset(&s_flash[offset], 0xFF, FLASH_PORT_PAGE_SIZE);
+    s_eraseCount[offset / FLASH_PORT_PAGE_SIZE]++;
+
+    if (s_eraseHook != NULL)
+    {
+        s_eraseHook(offset);
+    }
+
+    return true;
+}
+
+/*************************************************************************************************/
+bool FlashPort_Write(uint32_t offset, const void *pData, uint32_t len)
+{
+    const uint8_t *pSrc = (const uint8_t *)pData;
+    uint32_t i;
+
+    if (pData == NULL || (offset % FLASH_PORT_WRITE_ALIGN) != 0 ||
+        (len % FLASH_PORT_WRITE_ALIGN) != 0 || offset + len > FLASH_PORT_REGION_SIZE)
+    {
+        return false;
+    }
+
+    for (i = 0; i < len; i++)
+    {
+        s_flash[offset + i] &= pSrc[i];
+    }
+
+    return true;
+}
+
+/*************************************************************************************************/
+const void *FlashPort_Map(uint32_t offset)
+{
+    return &s_flash[offset];
+}
+
+/*************************************************************************************************/
+void FlashPort_SimSetEraseHook(FlashPortSimHook_t hook)
+{
+    s_eraseHook = hook;
+}
+
+/*************************************************************************************************/
+uint32_t FlashPort_SimEraseCount(uint32_t page)
+{
+    return (page < FLASH_PORT_REGION_PAGES) ? s_eraseCount[page] : 0;
+}
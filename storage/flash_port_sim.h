@@ -0,0 +1,54 @@
+/*************************************************************************************************/
+/*!
+ *  \file   flash_port_sim.h
+ *
+ *  \brief  Test controls of the RAM-backed flash simulator (flash_port_sim.c, host only).
+ */
+/*************************************************************************************************/
+
+#ifndef STORAGE_FLASH_PORT_SIM_H
+#define STORAGE_FLASH_PORT_SIM_H
+
+#include "flash_port.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**************************************************************************************************
+  Data Types
+**************************************************************************************************/
+
+/*! Called after each page erase, with the page's offset. A test simulates a reset at that
+ *  point by not returning (longjmp() back to its own code). */
+typedef void (*FlashPortSimHook_t)(uint32_t offset);
+
+/**************************************************************************************************
+  Function Declarations
+**************************************************************************************************/
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Set the function called after each page erase.
+ *
+ *  \param  hook    Hook, or NULL for none.
+ */
+/*************************************************************************************************/
+void FlashPort_SimSetEraseHook(FlashPortSimHook_t hook);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Get how often a page has been erased since the simulated part was formatted.
+ *
+ *  \param  page    Page index within the region.
+ *
+ *  \return Erase count, or 0 for a page outside the region.
+ */
+/*************************************************************************************************/
+uint32_t FlashPort_SimEraseCount(uint32_t page);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STORAGE_FLASH_PORT_SIM_H */
@@ -0,0 +1,76 @@
+#!/usr/bin/env python3
+"""Compare two microbenchmark reports (bench/bench.h) and flag regressions.
+
+Usage:
+    bench_compare.py baseline current [--threshold PCT]
+
+Each file is the JSON report, or any console capture containing it (the line that
+starts with {"bench":). A case regresses when its fastest-run cost per call grows by
+more than PCT percent (default 10), or when the bytes it produces per call change at
+all. Exits with status 1 if any case regressed or disappeared, so it can gate a CI job.
+"""
+
+import argparse
+import json
+import sys
+
+REPORT_PREFIX = '{"bench":'
+
+
+def load_report(path):
+    with open(path, "r", errors="replace") as f:
+        for line in f:
+            line = line.strip()
+            if line.startswith(REPORT_PREFIX):
+                return json.loads(line)
+
+    raise ValueError("%s contains no benchmark report" % path)
+
+
+def main(argv):
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("baseline")
+    parser.add_argument("current")
+    parser.add_argument("--threshold", type=float, default=10.0,
+                        help="allowed cost increase in percent (default 10)")
+    args = parser.parse_args(argv[1:])
+
+    base = load_report(args.baseline)
+    cur = load_report(args.current)
+
+    if base["unit"] != cur["unit"]:
+        sys.stderr.write("unit mismatch: %s vs %s (host and target reports do not compare)\n"
+                         % (base["unit"], cur["unit"]))
+        return 2
+
+    cur_cases = {r["name"]: r for r in cur["results"]}
+    failed = False
+
+    print("%-28s %12s %12s %8s  %s" % ("case", "baseline", "current", "change", "unit: " + cur["unit"]))
+
+    for old in base["results"]:
+        new = cur_cases.pop(old["name"], None)
+        if new is None:
+            print("%-28s %12.1f %12s %8s  MISSING" % (old["name"], old["min"], "-", "-"))
+            failed = True
+            continue
+
+        change = (new["min"] - old["min"]) * 100.0 / old["min"] if old["min"] else 0.0
+        notes = []
+        if change > args.threshold:
+            notes.append("SLOWER")
+        if new["bytes"] != old["bytes"]:
+            notes.append("BYTES %.1f -> %.1f" % (old["bytes"], new["bytes"]))
+        failed = failed or bool(notes)
+
+        print("%-28s %12.1f %12.1f %+7.1f%%  %s"
+              % (old["name"], old["min"], new["min"], change, " ".join(notes)))
+
+    for new in cur_cases.values():
+        print("%-28s %12s %12.1f %8s  NEW" % (new["name"], "-", new["min"], "-"))
+
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,173 @@
+#!/usr/bin/env python3
+"""Decode tokenized log output (LOG_TOKENIZED=1) back into text.
+
+Usage:
+    trace_decode.py firmware.elf [capture]
+
+Reads the console stream from the capture file, or stdin when omitted (e.g. piped from
+a serial terminal in raw mode). Plain text is passed through unchanged; each framed
+record is replaced with its formatted message. The format strings come from the
+.trace_fmt section of the ELF that was flashed; a record's token is the offset of its
+format string from the start of that section.
+
+Record layout (see utils/log.c):
+    0x01, COBS(varint token, desc, args...), 0x00
+    token: offset of the format string in .trace_fmt
+    desc: bits 0-3 argument count, bit 4 + n set when argument n is a string
+    args: LEB128 varint, or [len][bytes] for strings
+"""
+
+import re
+import struct
+import sys
+
+FRAME_START = 0x01
+FRAME_END = 0x00
+SECTION = ".trace_fmt"
+
+# printf conversion: flags, width, precision, length modifier, conversion
+SPEC_RE = re.compile(r"%([-+ #0]*)(\d+)?(?:\.(\d+))?(hh|h|ll|l|z|j|t)?([diouxXcsp%])")
+
+
+def load_formats(path):
+    """Return the contents of the .trace_fmt section of an ELF file."""
+    with open(path, "rb") as f:
+        elf = f.read()
+
+    if elf[:4] != b"\x7fELF":
+        raise ValueError("%s is not an ELF file" % path)
+
+    is64 = elf[4] == 2
+    endian = "<" if elf[5] == 1 else ">"
+
+    if is64:
+        shoff, = struct.unpack_from(endian + "Q", elf, 0x28)
+        shentsize, shnum, shstrndx = struct.unpack_from(endian + "HHH", elf, 0x3A)
+        sh_fmt = endian + "IIQQQQIIQQ"
+    else:
+        shoff, = struct.unpack_from(endian + "I", elf, 0x20)
+        shentsize, shnum, shstrndx = struct.unpack_from(endian + "HHH", elf, 0x2E)
+        sh_fmt = endian + "IIIIIIIIII"
+
+    headers = [struct.unpack_from(sh_fmt, elf, shoff + i * shentsize) for i in range(shnum)]
+    names_off = headers[shstrndx][4]
+
+    for hdr in headers:
+        name_off, offset, size = hdr[0], hdr[4], hdr[5]
+        end = elf.index(b"\0", names_off + name_off)
+        if elf[names_off + name_off:end].decode() == SECTION:
+            return elf[offset:offset + size]
+
+    raise ValueError("%s has no %s section (built without LOG_TOKENIZED=1?)" % (path, SECTION))
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+
+    while i < len(data):
+        code = data[i]
+        if code == 0 or i + code > len(data) + 1:
+            raise ValueError("bad COBS block")
+        out += data[i + 1:i + code]
+        i += code
+        if code < 0xFF and i < len(data):
+            out.append(0)
+
+    return bytes(out)
+
+
+def read_varint(data, pos):
+    value = 0
+    shift = 0
+
+    while True:
+        b = data[pos]
+        pos += 1
+        value |= (b & 0x7F) << shift
+        if b < 0x80:
+            return value, pos
+        shift += 7
+
+
+def format_message(fmt, args):
+    it = iter(args)
+
+    def convert(m):
+        flags, width, prec, _length, conv = m.groups()
+        if conv == "%":
+            return "%"
+        value = next(it, 0)
+        if conv in "di" and isinstance(value, int):
+            value = value - (1 << 32) if value & 0x80000000 else value
+        elif conv == "p":
+            return "0x%08x" % value
+        elif conv == "s" and isinstance(value, int):
+            return "<0x%08x>" % value
+        elif conv == "c":
+            value = chr(value & 0xFF)
+        spec = "%" + flags + (width or "") + ("." + prec if prec else "")
+        return (spec + ("s" if conv == "c" else conv)) % value
+
+    return SPEC_RE.sub(convert, fmt)
+
+
+def decode_record(formats, record):
+    token, pos = read_varint(record, 0)
+    desc = record[pos]
+    pos += 1
+    args = []
+
+    for n in range(desc & 0x0F):
+        if desc & (1 << (4 + n)):
+            length = record[pos]
+            args.append(record[pos + 1:pos + 1 + length].decode("utf-8", "replace"))
+            pos += 1 + length
+        else:
+            value, pos = read_varint(record, pos)
+            args.append(value)
+
+    if token >= len(formats):
+        return "<unknown token 0x%x %r>\n" % (token, args)
+
+    fmt = formats[token:formats.index(b"\0", token)].decode("utf-8", "replace")
+    return format_message(fmt, args)
+
+
+def main(argv):
+    if len(argv) not in (2, 3):
+        sys.stderr.write(__doc__)
+        return 2
+
+    formats = load_formats(argv[1])
+    src = open(argv[2], "rb") if len(argv) == 3 else sys.stdin.buffer
+    out = sys.stdout
+    frame = None
+
+    while True:
+        chunk = src.read(1 if src is sys.stdin.buffer else 4096)
+        if not chunk:
+            break
+
+        for b in chunk:
+            if frame is None:
+                if b == FRAME_START:
+                    frame = bytearray()
+                else:
+                    out.write(chr(b))
+            elif b == FRAME_END:
+                try:
+                    out.write(decode_record(formats, cobs_decode(bytes(frame))))
+                except (ValueError, IndexError):
+                    out.write("<bad frame %s>\n" % bytes(frame).hex())
+                frame = None
+            else:
+                frame.append(b)
+
+        out.flush()
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
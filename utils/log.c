@@ -0,0 +1,510 @@
+/*************************************************************************************************/
+/*!
+ *  \file   log.c
+ *
+ *  \brief  Deferred console logger - FULLY STATIC ALLOCATION.
+ *
+ *  The ring is a bounded multi-producer/single-consumer queue: each slot carries a sequence
+ *  number that tells producers when it is free and the drain task when it is filled. A
+ *  producer claims a slot with one compare-and-swap on the head, fills it and publishes
+ *  it, so no lock is taken and an ISR that interrupts a logging task cannot deadlock.
+ *
+ *  In text builds a slot holds the formatted message. In tokenized builds it holds the
+ *  format token and the arguments, taken from the va_list by the desc byte's string
+ *  flags, and the drain task encodes each message as
+ *
+ *      varint token, desc byte, per argument: varint value or [len][bytes] for strings
+ *
+ *  and COBS-frames it between LOG_FRAME_START and LOG_FRAME_END.
+ */
+/*************************************************************************************************/
+
+#include "log.h"
+#include "FreeRTOS.h"
+#include "task.h"
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+
+/**************************************************************************************************
+  Macros
+**************************************************************************************************/
+
+#define LOG_TASK_STACK_SIZE 256
+#define LOG_TASK_PRIORITY (tskIDLE_PRIORITY)  /* Only print when nothing else needs the CPU */
+#define LOG_RING_SIZE 32                      /* Messages; power of two */
+#define LOG_RING_MASK (LOG_RING_SIZE - 1)
+
+/* Overridable for ports that cannot tell (the POSIX host port has no ISRs) */
+#ifndef LOG_IN_ISR
+#define LOG_IN_ISR() xPortIsInsideInterrupt()
+#endif
+
+#define LOG_DESC_COUNT(desc) ((desc) & 0x0F)
+#define LOG_DESC_IS_STR(desc, n) (((desc) >> (4 + (n))) & 1)
+
+/* Largest record: token, desc, and four maximal string arguments */
+#define LOG_RECORD_MAX (5 + 1 + LOG_MAX_ARGS * (1 + LOG_STR_ARG_MAX))
+#define LOG_FRAME_MAX (1 + LOG_RECORD_MAX + LOG_RECORD_MAX / 254 + 1 + 1)
+
+/**************************************************************************************************
+  Data Types
+**************************************************************************************************/
+
+/*! One message */
+typedef struct
+{
+#if LOG_TOKENIZED
+    const char *fmt;
+    uintptr_t args[LOG_MAX_ARGS];
+    uint8_t desc;
+#else
+    char text[LOG_TEXT_MAX];
+#endif
+} LogMsg_t;
+
+/*! One ring slot */
+typedef struct
+{
+    atomic_uint_fast32_t seq;   /* pos: free for producer at pos, pos + 1: filled */
+    LogMsg_t msg;
+} LogEntry_t;
+
+/**************************************************************************************************
+  Static Memory for FreeRTOS Objects
+**************************************************************************************************/
+
+static StaticTask_t s_logTaskBuffer;
+static StackType_t s_logTaskStack[LOG_TASK_STACK_SIZE];
+
+/**************************************************************************************************
+  Global Variables
+**************************************************************************************************/
+
+volatile uint8_t g_logLevel[LOG_MOD_COUNT] = { [0 ... LOG_MOD_COUNT - 1] = LOG_DEFAULT_LEVEL };
+
+/**************************************************************************************************
+  Local Variables
+**************************************************************************************************/
+
+static LogEntry_t s_ring[LOG_RING_SIZE];
+static atomic_uint_fast32_t s_head;     /* Next position to claim (producers) */
+static uint32_t s_tail;                 /* Next position to print (drain task only) */
+static atomic_bool s_idle;              /* Drain task is about to block or blocked */
+static bool s_ready = false;
+
+static TaskHandle_t s_logTaskHandle = NULL;
+
+static atomic_uint_fast32_t s_written;
+static atomic_uint_fast32_t s_dropped;
+static uint16_t s_maxDepth;
+
+#if LOG_TOKENIZED
+/* Start of .trace_fmt, defined by utils/log_tokens.ld; tokens are offsets from it */
+extern const char __trace_fmt_start[];
+
+static LogSink_t s_sink = NULL;
+static uint8_t s_record[LOG_RECORD_MAX];
+static uint8_t s_frame[LOG_FRAME_MAX];
+#endif
+
+/**************************************************************************************************
+  Local Functions
+**************************************************************************************************/
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Wake the drain task if it has gone idle.
+ */
+/*************************************************************************************************/
+static void wakeDrainTask(void)
+{
+    BaseType_t woken = pdFALSE;
+
+    if (s_logTaskHandle == NULL || !atomic_load(&s_idle) || !atomic_exchange(&s_idle, false))
+    {
+        return;
+    }
+
+    if (LOG_IN_ISR())
+    {
+        vTaskNotifyGiveFromISR(s_logTaskHandle, &woken);
+        portYIELD_FROM_ISR(woken);
+    }
+    else
+    {
+        xTaskNotifyGive(s_logTaskHandle);
+    }
+}
+
+#if LOG_TOKENIZED
+/*************************************************************************************************/
+static uint16_t putVarint(uint8_t *pBuf, uint32_t value)
+{
+    uint16_t len = 0;
+
+    while (value >= 0x80)
+    {
+        pBuf[len++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    pBuf[len++] = (uint8_t)value;
+
+    return len;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  COBS-encode a record into s_frame between the start and end markers.
+ *
+ *  \return Frame length.
+ */
+/*************************************************************************************************/
+static uint16_t frameRecord(const uint8_t *pRecord, uint16_t len)
+{
+    uint16_t out = 2;       /* Start marker, then the first code byte */
+    uint16_t code = 1;
+    uint16_t codePos = 2;
+    uint16_t i;
+
+    s_frame[0] = LOG_FRAME_START;
+
+    for (i = 0; i < len; i++)
+    {
+        if (pRecord[i] != 0)
+        {
+            s_frame[out++] = pRecord[i];
+            code++;
+        }
+
+        if (pRecord[i] == 0 || code == 0xFF)
+        {
+            s_frame[codePos - 1] = (uint8_t)code;
+            codePos = ++out;
+            code = 1;
+        }
+    }
+
+    s_frame[codePos - 1] = (uint8_t)code;
+    s_frame[out++] = LOG_FRAME_END;
+
+    return out;
+}
+#endif
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Fill a message from the caller's arguments.
+ */
+/*************************************************************************************************/
+static void buildMessage(LogMsg_t *pMsg, uint8_t desc, const char *fmt, va_list ap)
+{
+#if LOG_TOKENIZED
+    uint8_t i;
+
+    pMsg->desc = desc;
+    pMsg->fmt = fmt;
+
+    for (i = 0; i < LOG_MAX_ARGS; i++)
+    {
+        if (i >= LOG_DESC_COUNT(desc))
+        {
+            pMsg->args[i] = 0;
+        }
+        else if (LOG_DESC_IS_STR(desc, i))
+        {
+            pMsg->args[i] = (uintptr_t)va_arg(ap, const char *);
+        }
+        else
+        {
+            pMsg->args[i] = (uintptr_t)va_arg(ap, unsigned int);
+        }
+    }
+#else
+    int len;
+
+    (void)desc;
+
+    len = vsnprintf(pMsg->text, sizeof(pMsg->text), fmt, ap);
+
+    /* Cut short: keep the line break so the next message starts on its own line */
+    if (len >= (int)sizeof(pMsg->text))
+    {
+        pMsg->text[sizeof(pMsg->text) - 2] = '\n';
+    }
+    else if (len < 0)
+    {
+        pMsg->text[0] = '\0';
+    }
+#endif
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Print one message, or encode and send it in tokenized builds.
+ */
+/*************************************************************************************************/
+static void emitMessage(const LogMsg_t *pMsg)
+{
+#if LOG_TOKENIZED
+    uint16_t len;
+    uint16_t strLen;
+    const char *pStr;
+    uint8_t i;
+
+    len = putVarint(s_record, (uint32_t)(pMsg->fmt - __trace_fmt_start));
+    s_record[len++] = pMsg->desc;
+
+    for (i = 0; i < LOG_DESC_COUNT(pMsg->desc) && i < LOG_MAX_ARGS; i++)
+    {
+        if (LOG_DESC_IS_STR(pMsg->desc, i))
+        {
+            pStr = (const char *)pMsg->args[i];
+            for (strLen = 0; pStr != NULL && pStr[strLen] != '\0' && strLen < LOG_STR_ARG_MAX;
+                 strLen++)
+            {
+                s_record[len + 1 + strLen] = (uint8_t)pStr[strLen];
+            }
+            s_record[len] = (uint8_t)strLen;
+            len += 1 + strLen;
+        }
+        else
+        {
+            len += putVarint(&s_record[len], (uint32_t)pMsg->args[i]);
+        }
+    }
+
+    len = frameRecord(s_record, len);
+
+    if (s_sink != NULL)
+    {
+        s_sink(s_frame, len);
+    }
+    else
+    {
+        fwrite(s_frame, 1, len, stdout);
+    }
+#else
+    fputs(pMsg->text, stdout);
+#endif
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Build a message from a format and arguments and emit it at once.
+ */
+/*************************************************************************************************/
+static void emitNow(uint8_t desc, const char *fmt, ...)
+{
+    LogMsg_t msg;
+    va_list ap;
+
+    va_start(ap, fmt);
+    buildMessage(&msg, desc, fmt, ap);
+    va_end(ap);
+
+    emitMessage(&msg);
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Copy the oldest message out and free its slot.
+ *
+ *  \return false if the next message has not been published yet.
+ */
+/*************************************************************************************************/
+static bool takeEntry(LogMsg_t *pMsg)
+{
+    LogEntry_t *pEntry = &s_ring[s_tail & LOG_RING_MASK];
+    uint32_t depth;
+
+    if (atomic_load_explicit(&pEntry->seq, memory_order_acquire) != s_tail + 1)
+    {
+        return false;
+    }
+
+    depth = (uint32_t)atomic_load_explicit(&s_head, memory_order_relaxed) - s_tail;
+    if (depth > s_maxDepth)
+    {
+        s_maxDepth = (uint16_t)depth;
+    }
+
+    *pMsg = pEntry->msg;
+
+    atomic_store_explicit(&pEntry->seq, s_tail + LOG_RING_SIZE, memory_order_release);
+    s_tail++;
+
+    return true;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Drain task - prints queued messages at idle priority.
+ */
+/*************************************************************************************************/
+static void LogTask(void *pvParameters)
+{
+    LogMsg_t msg;
+    uint32_t reportedDrops = 0;
+    uint32_t dropped;
+
+    (void)pvParameters;
+
+    while (1)
+    {
+        while (takeEntry(&msg))
+        {
+            emitMessage(&msg);
+        }
+
+        dropped = (uint32_t)atomic_load(&s_dropped);
+        if (dropped != reportedDrops)
+        {
+            emitNow(LOG_DESC_("[LOG] %u messages dropped\n", 0),
+                    LOG_FMT_("[LOG] %u messages dropped\n"), (unsigned)(dropped - reportedDrops));
+            reportedDrops = dropped;
+        }
+
+        /* Announce idle, then re-check so a message published meanwhile is not missed */
+        atomic_store(&s_idle, true);
+        if (takeEntry(&msg))
+        {
+            atomic_store(&s_idle, false);
+            emitMessage(&msg);
+            continue;
+        }
+
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+}
+
+/**************************************************************************************************
+  Public Functions
+**************************************************************************************************/
+
+/*************************************************************************************************/
+void Log_Init(void)
+{
+    uint32_t i;
+
+    for (i = 0; i < LOG_RING_SIZE; i++)
+    {
+        atomic_init(&s_ring[i].seq, i);
+    }
+
+    atomic_init(&s_head, 0);
+    atomic_init(&s_idle, false);
+    s_tail = 0;
+    s_ready = true;
+}
+
+/*************************************************************************************************/
+bool Log_StartTask(void)
+{
+    s_logTaskHandle = xTaskCreateStatic(
+        LogTask,
+        "LOG",
+        LOG_TASK_STACK_SIZE,
+        NULL,
+        LOG_TASK_PRIORITY,
+        s_logTaskStack,
+        &s_logTaskBuffer);
+
+    if (s_logTaskHandle == NULL)
+    {
+        printf("[LOG] ERROR: Failed to create task\n");
+        return false;
+    }
+
+    return true;
+}
+
+/*************************************************************************************************/
+void Log_Write(LogModule_t mod, uint8_t desc, const char *fmt, ...)
+{
+    LogEntry_t *pEntry;
+    va_list ap;
+    uint32_t pos;
+    int32_t diff;
+
+    (void)mod;
+
+    if (!s_ready)
+    {
+        LogMsg_t msg;
+
+        va_start(ap, fmt);
+        buildMessage(&msg, desc, fmt, ap);
+        va_end(ap);
+
+        emitMessage(&msg);
+        return;
+    }
+
+    pos = (uint32_t)atomic_load_explicit(&s_head, memory_order_relaxed);
+
+    while (1)
+    {
+        pEntry = &s_ring[pos & LOG_RING_MASK];
+        diff = (int32_t)((uint32_t)atomic_load_explicit(&pEntry->seq, memory_order_acquire) - pos);
+
+        if (diff == 0)
+        {
+            uint_fast32_t expected = pos;
+
+            if (atomic_compare_exchange_weak_explicit(&s_head, &expected, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+            {
+                break;
+            }
+            pos = (uint32_t)expected;
+        }
+        else if (diff < 0)
+        {
+            /* Slot still holds a message from the previous lap: ring is full */
+            atomic_fetch_add_explicit(&s_dropped, 1, memory_order_relaxed);
+            return;
+        }
+        else
+        {
+            /* Another producer took this slot first */
+            pos = (uint32_t)atomic_load_explicit(&s_head, memory_order_relaxed);
+        }
+    }
+
+    va_start(ap, fmt);
+    buildMessage(&pEntry->msg, desc, fmt, ap);
+    va_end(ap);
+    atomic_store_explicit(&pEntry->seq, pos + 1, memory_order_release);
+
+    atomic_fetch_add_explicit(&s_written, 1, memory_order_relaxed);
+    wakeDrainTask();
+}
+
+#if LOG_TOKENIZED
+/*************************************************************************************************/
+void Log_SetSink(LogSink_t sink)
+{
+    s_sink = sink;
+}
+#endif
+
+/*************************************************************************************************/
+void Log_SetLevel(LogModule_t mod, uint8_t level)
+{
+    if (mod < LOG_MOD_COUNT)
+    {
+        g_logLevel[mod] = (level > LOG_LEVEL_DEBUG) ? LOG_LEVEL_DEBUG : level;
+    }
+}
+
+/*************************************************************************************************/
+void Log_GetStats(LogStats_t *pStats)
+{
+    if (pStats != NULL)
+    {
+        pStats->written = (uint32_t)atomic_load(&s_written);
+        pStats->dropped = (uint32_t)atomic_load(&s_dropped);
+        pStats->maxDepth = s_maxDepth;
+    }
+}
@@ -0,0 +1,240 @@
+/*************************************************************************************************/
+/*!
+ *  \file   log.h
+ *
+ *  \brief  Deferred console logger.
+ *
+ *  A log call formats the message with vsnprintf() into a lock-free ring of LOG_TEXT_MAX
+ *  byte slots; a low-priority task writes it to the console later. This keeps UART time
+ *  off the tasks and interrupts that log, and it is safe from any context, including ISRs.
+ *  Longer messages are cut short.
+ *
+ *  Arguments are checked against the format at compile time. Tokenized builds (below)
+ *  store them instead of formatting them, so for the same code to work there they must be
+ *  int-sized integers or pointers to strings that outlive the call - string literals or
+ *  constant tables, never a buffer on the caller's stack. When the ring is full the message
+ *  is dropped and counted; the drain task reports the count once it catches up.
+ *
+ *  Messages below LOG_STRIP_LEVEL are compiled out. The rest are filtered at run time
+ *  against a per-module level set with Log_SetLevel().
+ *
+ *  With LOG_TOKENIZED=1 format strings are not kept in flash or formatted at all. Each
+ *  literal is placed in the .trace_fmt section, which utils/log_tokens.ld marks as not
+ *  loaded, and its offset from the start of that section is the message token. The call
+ *  stores the token and up to LOG_MAX_ARGS arguments; the drain task sends binary
+ *  records (token, argument types, varint arguments) to the log sink, and
+ *  tools/trace_decode.py turns them back into text using the ELF.
+ */
+/*************************************************************************************************/
+
+#ifndef UTILS_LOG_H
+#define UTILS_LOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**************************************************************************************************
+  Constants
+**************************************************************************************************/
+
+/* Levels, lowest value is most severe. Plain numbers so they work in #if. */
+#define LOG_LEVEL_NONE      0
+#define LOG_LEVEL_ERROR     1
+#define LOG_LEVEL_WARN      2
+#define LOG_LEVEL_INFO      3
+#define LOG_LEVEL_DEBUG     4
+
+/* Messages above this level are removed at compile time */
+#ifndef LOG_STRIP_LEVEL
+#define LOG_STRIP_LEVEL     LOG_LEVEL_INFO
+#endif
+
+/* Level each module starts with */
+#ifndef LOG_DEFAULT_LEVEL
+#define LOG_DEFAULT_LEVEL   LOG_LEVEL_INFO
+#endif
+
+#define LOG_MAX_ARGS        4       /* Format arguments per message */
+#define LOG_TEXT_MAX        96      /* Bytes of a formatted message, terminator included */
+
+/* 1: emit tokenized binary records instead of text (see file comment) */
+#ifndef LOG_TOKENIZED
+#define LOG_TOKENIZED       0
+#endif
+
+/* Tokenized frames: LOG_FRAME_START, COBS-encoded record, LOG_FRAME_END. Neither byte
+ * occurs in console text, so records and plain printf output can share the UART. */
+#define LOG_FRAME_START     0x01
+#define LOG_FRAME_END       0x00
+
+#define LOG_STR_ARG_MAX     32      /* Bytes of a %s argument sent in a tokenized record */
+
+/**************************************************************************************************
+  Data Types
+**************************************************************************************************/
+
+/*! Modules with their own run-time level */
+typedef enum
+{
+    LOG_MOD_APP = 0,
+    LOG_MOD_WORKOUT,
+    LOG_MOD_INPUT,
+    LOG_MOD_SENSOR,
+    LOG_MOD_BLE,
+    LOG_MOD_STORAGE,
+    LOG_MOD_COUNT
+} LogModule_t;
+
+/*! Receives encoded tokenized frames */
+typedef void (*LogSink_t)(const uint8_t *pData, uint16_t len);
+
+/*! Logger counters since boot */
+typedef struct
+{
+    uint32_t written;       /* Messages queued */
+    uint32_t dropped;       /* Messages lost because the ring was full */
+    uint16_t maxDepth;      /* Most messages waiting at once */
+} LogStats_t;
+
+/**************************************************************************************************
+  Global Variables
+**************************************************************************************************/
+
+/*! Current level per module (read inline by the LOG_* macros) */
+extern volatile uint8_t g_logLevel[LOG_MOD_COUNT];
+
+/**************************************************************************************************
+  Macros
+**************************************************************************************************/
+
+#if LOG_TOKENIZED
+/* The string lives in the non-loaded .trace_fmt section; its offset there is its token */
+#define LOG_FMT_(fmt)   __extension__({                                         \
+        static const char s_logFmt[] __attribute__((section(".trace_fmt"), used)) = fmt; \
+        s_logFmt; })
+#else
+#define LOG_FMT_(fmt)   (fmt)
+#endif
+
+/* Argument descriptor: count in bits 0-3, bit 4 + n set if argument n is a string */
+#define LOG_IS_STR_(x)  _Generic((x), char *: 1, const char *: 1, default: 0)
+#define LOG_NARGS_(fmt, a0, a1, a2, a3, n, ...) (n)
+#define LOG_STRS_(fmt, a0, a1, a2, a3, ...) \
+    ((LOG_IS_STR_(a0) << 4) | (LOG_IS_STR_(a1) << 5) | (LOG_IS_STR_(a2) << 6) | \
+     (LOG_IS_STR_(a3) << 7))
+#define LOG_DESC_(...)  (uint8_t)(LOG_NARGS_(__VA_ARGS__, 4, 3, 2, 1, 0) | \
+                                  LOG_STRS_(__VA_ARGS__, 0, 0, 0, 0, 0))
+
+/* Passes the arguments as written, so Log_Write() checks them against the format */
+#define LOG_CALL_(mod, desc, fmt, ...) \
+    Log_Write((mod), (desc), LOG_FMT_(fmt), ##__VA_ARGS__)
+
+/* A token is not a literal the compiler can check; this call never runs but is checked */
+#if LOG_TOKENIZED
+#define LOG_CHECK_(...) do { if (0) { Log_CheckFormat_(__VA_ARGS__); } } while (0)
+#else
+#define LOG_CHECK_(...) do { } while (0)
+#endif
+
+#define LOG_AT_(level, mod, ...)                                                \
+    do                                                                          \
+    {                                                                           \
+        LOG_CHECK_(__VA_ARGS__);                                                \
+        if ((level) <= LOG_STRIP_LEVEL && (level) <= g_logLevel[(mod)])         \
+        {                                                                       \
+            LOG_CALL_((mod), LOG_DESC_(__VA_ARGS__), __VA_ARGS__);              \
+        }                                                                       \
+    } while (0)
+
+/* Usage: LOG_INFO(LOG_MOD_WORKOUT, "[WORKOUT] Lap %d\n", lap); at most LOG_MAX_ARGS args */
+#define LOG_ERROR(mod, ...)     LOG_AT_(LOG_LEVEL_ERROR, mod, __VA_ARGS__)
+#define LOG_WARN(mod, ...)      LOG_AT_(LOG_LEVEL_WARN, mod, __VA_ARGS__)
+#define LOG_INFO(mod, ...)      LOG_AT_(LOG_LEVEL_INFO, mod, __VA_ARGS__)
+#define LOG_DEBUG(mod, ...)     LOG_AT_(LOG_LEVEL_DEBUG, mod, __VA_ARGS__)
+
+/* Expands a millisecond count to three arguments for a "%02u:%02u.%03u" format */
+#define LOG_MMSS(ms)    (unsigned)((ms) / 60000), (unsigned)(((ms) / 1000) % 60), \
+                        (unsigned)((ms) % 1000)
+
+/**************************************************************************************************
+  Function Declarations
+**************************************************************************************************/
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Initialize the ring. Messages logged before this are printed directly.
+ */
+/*************************************************************************************************/
+void Log_Init(void);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Start the drain task.
+ *
+ *  \return true if the task was created.
+ */
+/*************************************************************************************************/
+bool Log_StartTask(void);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Queue a message. Use the LOG_* macros instead of calling this directly.
+ *
+ *  \param  mod     Source module.
+ *  \param  desc    Argument count and string flags (LOG_DESC_).
+ *  \param  fmt     printf format. A token in tokenized builds, which must outlive the call
+ *                  (normally a literal).
+ *  \param  ...     Up to LOG_MAX_ARGS format arguments.
+ */
+/*************************************************************************************************/
+void Log_Write(LogModule_t mod, uint8_t desc, const char *fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+
+#if LOG_TOKENIZED
+/*! Format check for LOG_CHECK_(); never called */
+static inline __attribute__((format(printf, 1, 2))) void Log_CheckFormat_(const char *fmt, ...)
+{
+    (void)fmt;
+}
+#endif
+
+#if LOG_TOKENIZED
+/*************************************************************************************************/
+/*!
+ *  \brief  Send tokenized frames somewhere other than the console UART (e.g. BLE).
+ *
+ *  \param  sink    Called from the log task with one complete frame; NULL restores the
+ *                  console.
+ */
+/*************************************************************************************************/
+void Log_SetSink(LogSink_t sink);
+#endif
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Set the run-time level of a module.
+ *
+ *  \param  mod     Module.
+ *  \param  level   LOG_LEVEL_NONE to LOG_LEVEL_DEBUG.
+ */
+/*************************************************************************************************/
+void Log_SetLevel(LogModule_t mod, uint8_t level);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Get logger counters.
+ *
+ *  \param  pStats  Receives a copy of the counters.
+ */
+/*************************************************************************************************/
+void Log_GetStats(LogStats_t *pStats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* UTILS_LOG_H */
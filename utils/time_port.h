@@ -0,0 +1,70 @@
+/*************************************************************************************************/
+/*!
+ *  \file   time_port.h
+ *
+ *  \brief  Free-running capture timer behind Time_Capture().
+ *
+ *  The target implementation (time_port_mxc.c) runs a 32-bit MAX32655 timer from the
+ *  peripheral clock and measures its rate against the 32 kHz crystal through the wake-up
+ *  timer. The host implementation (time_port_sim.c) counts microseconds of the time
+ *  base in use, so virtual-clock builds stay deterministic.
+ */
+/*************************************************************************************************/
+
+#ifndef UTILS_TIME_PORT_H
+#define UTILS_TIME_PORT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**************************************************************************************************
+  Function Declarations
+**************************************************************************************************/
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Start the timer counting.
+ *
+ *  \return true if the timer runs.
+ */
+/*************************************************************************************************/
+bool TimePort_Init(void);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Read the timer. Safe from ISRs.
+ *
+ *  \return Current count; wraps modulo 2^32.
+ */
+/*************************************************************************************************/
+uint32_t TimePort_Read(void);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Get the rate the timer is configured for.
+ *
+ *  \return Nominal counts per second.
+ */
+/*************************************************************************************************/
+uint32_t TimePort_NominalHz(void);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Measure the timer rate against a reference clock.
+ *
+ *  Busy-waits for the measurement window. Call before the scheduler starts.
+ *
+ *  \return Measured counts per second, or 0 if the reference is not running.
+ */
+/*************************************************************************************************/
+uint32_t TimePort_Calibrate(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* UTILS_TIME_PORT_H */
@@ -0,0 +1,129 @@
+/*************************************************************************************************/
+/*!
+ *  \file   time_port_mxc.c
+ *
+ *  \brief  Capture timer for the MAX32655: TMR2 free-running from the peripheral clock.
+ *
+ *  The peripheral clock comes from the internal oscillator, so its real rate is measured
+ *  against the wake-up timer, which counts the trimmed 32 kHz crystal. TMR0/TMR1 belong
+ *  to the Cordio scheduler. The timer stops in deep sleep, so tickless builds must not
+ *  hold a stamp across a tickless idle period.
+ */
+/*************************************************************************************************/
+
+#include "time_port.h"
+
+/* Maxim SDK includes */
+#include "mxc_device.h"
+#include "mxc_errors.h"
+#include "tmr.h"
+#include "wut.h"
+
+/**************************************************************************************************
+  Macros
+**************************************************************************************************/
+
+#define TIME_PORT_TMR           MXC_TMR2
+#define TIME_PORT_PRES          TMR_PRES_16
+#define TIME_PORT_PRES_DIV      16      /* 3.125 MHz from a 50 MHz PCLK, wraps after ~22 min */
+
+#define TIME_PORT_REF_HZ        32768   /* Wake-up timer (32 kHz crystal) */
+#define TIME_PORT_CAL_REF_TICKS 3277    /* Measurement window, ~100 ms */
+
+/* Give up on the wake-up timer if it has not moved for 1 ms (about 33 of its periods) */
+#define TIME_PORT_REF_TIMEOUT   (TimePort_NominalHz() / 1000u)
+
+/**************************************************************************************************
+  Local Functions
+**************************************************************************************************/
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Wait for the next wake-up timer count.
+ *
+ *  \param  pRef    In: last count seen. Out: the new count.
+ *
+ *  \return true if the count moved before the timeout.
+ */
+/*************************************************************************************************/
+static bool waitRefEdge(uint32_t *pRef)
+{
+    uint32_t start = TimePort_Read();
+    uint32_t ref;
+
+    do
+    {
+        ref = MXC_WUT_GetCount(MXC_WUT0);
+        if (ref != *pRef)
+        {
+            *pRef = ref;
+            return true;
+        }
+    } while (TimePort_Read() - start < TIME_PORT_REF_TIMEOUT);
+
+    return false;
+}
+
+/**************************************************************************************************
+  Public Functions
+**************************************************************************************************/
+
+/*************************************************************************************************/
+bool TimePort_Init(void)
+{
+    mxc_tmr_cfg_t cfg = {0};
+
+    cfg.pres = TIME_PORT_PRES;
+    cfg.mode = TMR_MODE_CONTINUOUS;
+    cfg.bitMode = TMR_BIT_MODE_32;
+    cfg.clock = MXC_TMR_APB_CLK;
+    cfg.cmp_cnt = 0xFFFFFFFF;
+    cfg.pol = 0;
+
+    MXC_TMR_Shutdown(TIME_PORT_TMR);
+    if (MXC_TMR_Init(TIME_PORT_TMR, &cfg, false) != E_NO_ERROR)
+    {
+        return false;
+    }
+
+    MXC_TMR_Start(TIME_PORT_TMR);
+    return true;
+}
+
+/*************************************************************************************************/
+uint32_t TimePort_Read(void)
+{
+    return TIME_PORT_TMR->cnt;
+}
+
+/*************************************************************************************************/
+uint32_t TimePort_NominalHz(void)
+{
+    return PeripheralClock / TIME_PORT_PRES_DIV;
+}
+
+/*************************************************************************************************/
+uint32_t TimePort_Calibrate(void)
+{
+    uint32_t ref = MXC_WUT_GetCount(MXC_WUT0);
+    uint32_t refStart;
+    uint32_t start;
+
+    /* Start on a crystal edge so the window is a whole number of 32 kHz periods */
+    if (!waitRefEdge(&ref))
+    {
+        return 0;
+    }
+    start = TimePort_Read();
+    refStart = ref;
+
+    while (ref - refStart < TIME_PORT_CAL_REF_TICKS)
+    {
+        if (!waitRefEdge(&ref))
+        {
+            return 0;
+        }
+    }
+
+    return (uint32_t)((uint64_t)(TimePort_Read() - start) * TIME_PORT_REF_HZ / (ref - refStart));
+}
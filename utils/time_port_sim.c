@@ -0,0 +1,48 @@
+/*************************************************************************************************/
+/*!
+ *  \file   time_port_sim.c
+ *
+ *  \brief  Capture timer for host builds.
+ *
+ *  Counts microseconds of Time_GetUs64(), so under the replay build's virtual clock a
+ *  stamp converts back to exactly the virtual time it was taken at.
+ */
+/*************************************************************************************************/
+
+#include "time_port.h"
+#include "time_utils.h"
+
+/**************************************************************************************************
+  Macros
+**************************************************************************************************/
+
+#define TIME_PORT_SIM_HZ 1000000u
+
+/**************************************************************************************************
+  Public Functions
+**************************************************************************************************/
+
+/*************************************************************************************************/
+bool TimePort_Init(void)
+{
+    return true;
+}
+
+/*************************************************************************************************/
+uint32_t TimePort_Read(void)
+{
+    return (uint32_t)Time_GetUs64();
+}
+
+/*************************************************************************************************/
+uint32_t TimePort_NominalHz(void)
+{
+    return TIME_PORT_SIM_HZ;
+}
+
+/*************************************************************************************************/
+uint32_t TimePort_Calibrate(void)
+{
+    /* Already in microseconds - nothing to measure against */
+    return TIME_PORT_SIM_HZ;
+}
@@ -7,18 +7,215 @@
 /*************************************************************************************************/
 
 #include "time_utils.h"
+#include "time_port.h"
 #include "FreeRTOS.h"
 #include "task.h"
+#include "mxc_device.h"
 #include <stdio.h>
+#include <string.h>
+
+/**************************************************************************************************
+  Macros
+**************************************************************************************************/
+
+/* A build may name a function that replaces the tick as the time source, e.g. the virtual
+ * clock of the host replay build (-DTIME_SOURCE_MS=SimClock_GetMs) */
+#ifdef TIME_SOURCE_MS
+uint64_t TIME_SOURCE_MS(void);
+#endif
+
+/* Convert in 64 bits from the tick rate itself: portTICK_PERIOD_MS is 0 at the 10 kHz
+ * tickless rate */
+#define TICKS_TO_MS(t) ((uint64_t)(t) * 1000u / configTICK_RATE_HZ)
+#define TICKS_TO_US(t) ((uint64_t)(t) * 1000000u / configTICK_RATE_HZ)
+#define TICK_US (1000000u / configTICK_RATE_HZ)
+
+/* Division by constants as multiply-high and shift (exact for every uint32_t / every
+ * value below 1000), so formatting never reaches the divider */
+#define DIV1000(x)       ((uint32_t)(((uint64_t)(x) * 0x10624DD3u) >> 38))
+#define DIV60(x)         ((uint32_t)(((uint64_t)(x) * 0x88888889u) >> 37))
+#define DIV100_LT1000(x) (((uint32_t)(x) * 41u) >> 12)
+
+/* A measured capture rate further than 1/TIME_CAL_TOLERANCE_DIV from nominal is rejected */
+#define TIME_CAL_TOLERANCE_DIV 20
+
+/**************************************************************************************************
+  Local Variables
+**************************************************************************************************/
+
+/*! Capture timer counts per second (0 until Time_InitCapture()) */
+static uint32_t s_captureHz = 0;
+
+/*! "00" to "99", two characters per entry */
+static const char s_digitPairs[200] = {
+    '0','0','0','1','0','2','0','3','0','4','0','5','0','6','0','7','0','8','0','9',
+    '1','0','1','1','1','2','1','3','1','4','1','5','1','6','1','7','1','8','1','9',
+    '2','0','2','1','2','2','2','3','2','4','2','5','2','6','2','7','2','8','2','9',
+    '3','0','3','1','3','2','3','3','3','4','3','5','3','6','3','7','3','8','3','9',
+    '4','0','4','1','4','2','4','3','4','4','4','5','4','6','4','7','4','8','4','9',
+    '5','0','5','1','5','2','5','3','5','4','5','5','5','6','5','7','5','8','5','9',
+    '6','0','6','1','6','2','6','3','6','4','6','5','6','6','6','7','6','8','6','9',
+    '7','0','7','1','7','2','7','3','7','4','7','5','7','6','7','7','7','8','7','9',
+    '8','0','8','1','8','2','8','3','8','4','8','5','8','6','8','7','8','8','8','9',
+    '9','0','9','1','9','2','9','3','9','4','9','5','9','6','9','7','9','8','9','9',
+};
+
+/**************************************************************************************************
+  Local Functions
+**************************************************************************************************/
+
+#ifndef TIME_SOURCE_MS
+/*************************************************************************************************/
+/*!
+ *  \brief  Read the tick count extended to 64 bits.
+ *
+ *  vTaskSetTimeOutState() captures the tick count and the number of times it has
+ *  overflowed in one critical section, which together form the 64-bit count.
+ */
+/*************************************************************************************************/
+static uint64_t getTicks64(void)
+{
+    TimeOut_t now;
+
+    vTaskSetTimeOutState(&now);
+
+    return ((uint64_t)(uint32_t)now.xOverflowCount << 32) | (uint32_t)now.xTimeOnEntering;
+}
+#endif
+
+/**************************************************************************************************
+  Public Functions
+**************************************************************************************************/
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Get current time in milliseconds (64-bit).
+ */
+/*************************************************************************************************/
+uint64_t Time_GetMs64(void)
+{
+#ifdef TIME_SOURCE_MS
+    return TIME_SOURCE_MS();
+#else
+    return TICKS_TO_MS(getTicks64());
+#endif
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Get current time in microseconds (64-bit).
+ */
+/*************************************************************************************************/
+uint64_t Time_GetUs64(void)
+{
+#if defined(TIME_SOURCE_MS)
+    return TIME_SOURCE_MS() * 1000u;
+#elif defined(SysTick_CTRL_ENABLE_Msk)
+    uint64_t ticks;
+    uint32_t val;
+    uint32_t load;
+    uint32_t subUs;
+
+    /* SysTick counts down from LOAD once per tick; the tick interrupt cannot run in between */
+    taskENTER_CRITICAL();
+    ticks = getTicks64();
+    val = SysTick->VAL;
+    if (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk)
+    {
+        /* Reload happened but the tick is not counted yet - re-read past the reload */
+        val = SysTick->VAL;
+        ticks++;
+    }
+    load = SysTick->LOAD;
+    taskEXIT_CRITICAL();
+
+    subUs = (uint32_t)((uint64_t)(load - val) * TICK_US / (load + 1u));
+
+    return TICKS_TO_US(ticks) + subUs;
+#else
+    return TICKS_TO_US(getTicks64());
+#endif
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Start the capture timer and measure its rate.
+ */
+/*************************************************************************************************/
+bool Time_InitCapture(void)
+{
+    uint32_t nominal;
+    uint32_t measured;
+
+    if (!TimePort_Init())
+    {
+        printf("[TIME] ERROR: Capture timer failed to start\n");
+        return false;
+    }
+
+    nominal = TimePort_NominalHz();
+    measured = TimePort_Calibrate();
+
+    if (measured < nominal - nominal / TIME_CAL_TOLERANCE_DIV ||
+        measured > nominal + nominal / TIME_CAL_TOLERANCE_DIV)
+    {
+        printf("[TIME] WARNING: Capture timer calibration failed (%lu Hz), using nominal\n",
+               (unsigned long)measured);
+        measured = nominal;
+    }
+
+    s_captureHz = measured;
+    printf("[TIME] Capture timer %lu Hz (nominal %lu Hz)\n",
+           (unsigned long)measured, (unsigned long)nominal);
+
+    return true;
+}
 
 /*************************************************************************************************/
 /*!
- *  \brief  Get current time in milliseconds.
+ *  \brief  Take a raw high-resolution time stamp.
+ */
+/*************************************************************************************************/
+uint32_t Time_Capture(void)
+{
+    return TimePort_Read();
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Convert a stamp from Time_Capture() to the Time_GetUs64() timebase.
+ */
+/*************************************************************************************************/
+uint64_t Time_CaptureToUs64(uint32_t stamp)
+{
+    uint64_t nowUs;
+    uint64_t ageUs;
+    uint32_t age;
+
+    if (s_captureHz == 0)
+    {
+        return Time_GetUs64();
+    }
+
+    /* Read both clocks together, then step back by the stamp's age */
+    taskENTER_CRITICAL();
+    nowUs = Time_GetUs64();
+    age = TimePort_Read() - stamp;
+    taskEXIT_CRITICAL();
+
+    ageUs = (uint64_t)age * 1000000u / s_captureHz;
+
+    return (ageUs < nowUs) ? nowUs - ageUs : 0;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Get current time in milliseconds (32-bit).
  */
 /*************************************************************************************************/
 uint32_t Time_GetMs(void)
 {
-    return xTaskGetTickCount() * portTICK_PERIOD_MS;
+    return (uint32_t)Time_GetMs64();
 }
 
 /*************************************************************************************************/
@@ -28,18 +225,65 @@ uint32_t Time_GetMs(void)
 /*************************************************************************************************/
 uint32_t Time_ElapsedMs(uint32_t start_ms)
 {
-    uint32_t now = Time_GetMs();
-    
-    /* Handle wraparound (occurs every ~49 days at 1ms tick) */
-    if (now >= start_ms)
+    /* Unsigned subtraction is correct across one wrap of the 32-bit count */
+    return Time_GetMs() - start_ms;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Write a field of at least two digits. Values of 100 or more are rare (over 100
+ *          minutes or hours) and take a short loop.
+ *
+ *  \return Pointer past the last digit.
+ */
+/*************************************************************************************************/
+static char* putLeadField(char *p, uint32_t value, uint8_t digits)
+{
+    char *end = p + digits;
+
+    while (digits > 2)
     {
-        return now - start_ms;
+        p[--digits] = (char)('0' + value % 10u);
+        value /= 10u;
     }
-    else
+    memcpy(p, &s_digitPairs[value * 2u], 2);
+
+    return end;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Write ":SS.mmm" and the terminator.
+ */
+/*************************************************************************************************/
+static void putSecMillis(char *p, uint32_t seconds, uint32_t millis)
+{
+    uint32_t hundreds = DIV100_LT1000(millis);
+
+    p[0] = ':';
+    memcpy(&p[1], &s_digitPairs[seconds * 2u], 2);
+    p[3] = '.';
+    p[4] = (char)('0' + hundreds);
+    memcpy(&p[5], &s_digitPairs[(millis - hundreds * 100u) * 2u], 2);
+    p[7] = '\0';
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Number of digits in a leading field (at least two).
+ */
+/*************************************************************************************************/
+static uint8_t leadDigits(uint32_t value)
+{
+    uint8_t digits = 2;
+
+    while (value >= 100u)
     {
-        /* Wraparound occurred */
-        return (0xFFFFFFFF - start_ms) + now + 1;
+        value /= 10u;
+        digits++;
     }
+
+    return digits;
 }
 
 /*************************************************************************************************/
@@ -49,15 +293,99 @@ uint32_t Time_ElapsedMs(uint32_t start_ms)
 /*************************************************************************************************/
 char* Time_FormatMmSsMsss(uint32_t ms, char *buffer, uint8_t buf_len)
 {
-    uint32_t total_seconds = ms / 1000;
-    uint32_t minutes = total_seconds / 60;
-    uint32_t seconds = total_seconds % 60;
-    uint32_t millis = ms % 1000;
-    
-    snprintf(buffer, buf_len, "%02lu:%02lu.%03lu", 
-             (unsigned long)minutes, 
-             (unsigned long)seconds, 
-             (unsigned long)millis);
-    
+    uint32_t totalSec = DIV1000(ms);
+    uint32_t minutes = DIV60(totalSec);
+    uint8_t digits = leadDigits(minutes);
+    char *p;
+
+    /* digits + ":SS.mmm" + terminator */
+    if (buf_len < digits + 8u)
+    {
+        if (buf_len > 0)
+        {
+            buffer[0] = '\0';
+        }
+        return buffer;
+    }
+
+    p = putLeadField(buffer, minutes, digits);
+    putSecMillis(p, totalSec - minutes * 60u, ms - totalSec * 1000u);
+
+    return buffer;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Format milliseconds to HH:MM:SS.mmm string.
+ */
+/*************************************************************************************************/
+char* Time_FormatHhMmSsMsss(uint32_t ms, char *buffer, uint8_t buf_len)
+{
+    uint32_t totalSec = DIV1000(ms);
+    uint32_t totalMin = DIV60(totalSec);
+    uint32_t hours = DIV60(totalMin);
+    uint8_t digits = leadDigits(hours);
+    char *p;
+
+    /* digits + ":MM" + ":SS.mmm" + terminator */
+    if (buf_len < digits + 11u)
+    {
+        if (buf_len > 0)
+        {
+            buffer[0] = '\0';
+        }
+        return buffer;
+    }
+
+    p = putLeadField(buffer, hours, digits);
+    p[0] = ':';
+    memcpy(&p[1], &s_digitPairs[(totalMin - hours * 60u) * 2u], 2);
+    putSecMillis(&p[3], totalSec - totalMin * 60u, ms - totalSec * 1000u);
+
+    return buffer;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Format a 64-bit millisecond timestamp as decimal digits.
+ */
+/*************************************************************************************************/
+char* Time_FormatMs64(uint64_t ms, char *buffer, uint8_t buf_len)
+{
+    char digits[TIME_MS64_STR_LEN - 1];
+    uint32_t low;
+    uint8_t n = 0;
+    uint8_t i;
+
+    /* 64-bit division is a library call on the M4 - only use it for the high digits */
+    while (ms > UINT32_MAX)
+    {
+        digits[n++] = (char)('0' + (ms % 10u));
+        ms /= 10u;
+    }
+
+    low = (uint32_t)ms;
+    do
+    {
+        digits[n++] = (char)('0' + (low % 10u));
+        low /= 10u;
+    } while (low != 0);
+
+    if (buf_len == 0)
+    {
+        return buffer;
+    }
+
+    if (n >= buf_len)
+    {
+        n = 0;
+    }
+
+    for (i = 0; i < n; i++)
+    {
+        buffer[i] = digits[n - 1 - i];
+    }
+    buffer[n] = '\0';
+
     return buffer;
 }
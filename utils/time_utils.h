@@ -4,8 +4,19 @@
  *
  *  \brief  Time utility functions interface.
  *
- *  Provides millisecond timing using FreeRTOS ticks.
+ *  Provides a 64-bit monotonic clock derived from the FreeRTOS tick. The tick count is
+ *  extended with the kernel's overflow counter, so the clock never wraps and stays correct
+ *  across tickless sleeps (the kernel steps the tick count on wake-up).
  *  DO NOT use BLE timing - this is the authoritative time source.
+ *
+ *  Timestamps are taken with Time_GetMs64(). The 32-bit Time_GetMs() is kept for short
+ *  intervals measured with Time_ElapsedMs(); it wraps every ~49 days.
+ *
+ *  Events that must be timed where they happen (e.g. a button edge, possibly in an ISR)
+ *  take a raw stamp with Time_Capture() - one read of a free-running hardware timer
+ *  (time_port.h) - and the task that handles them converts it with Time_CaptureToUs64().
+ *  Time_InitCapture() measures the timer rate against the 32 kHz crystal, so the
+ *  correction does not carry the error of the internal oscillator.
  */
 /*************************************************************************************************/
 
@@ -19,6 +30,14 @@
 extern "C" {
 #endif
 
+/**************************************************************************************************
+  Macros
+**************************************************************************************************/
+
+#define TIME_MS64_STR_LEN 21 /* Buffer for Time_FormatMs64(): 20 digits and the terminator */
+#define TIME_MMSS_STR_LEN 13 /* Buffer for Time_FormatMmSsMsss() of any value, "71582:47.295" */
+#define TIME_HMS_STR_LEN  15 /* Buffer for Time_FormatHhMmSsMsss() of any value */
+
 /**************************************************************************************************
   Function Declarations
 **************************************************************************************************/
@@ -27,9 +46,70 @@ extern "C" {
 /*!
  *  \brief  Get current time in milliseconds.
  *
- *  \return Current time in milliseconds since system start.
+ *  \return Milliseconds since system start; does not wrap.
+ *
+ *  \note   Task context only (reads the kernel tick and overflow count together).
+ */
+/*************************************************************************************************/
+uint64_t Time_GetMs64(void);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Get current time in microseconds.
+ *
+ *  \return Microseconds since system start; does not wrap.
+ *
+ *  \note   On the target the tick is refined with the SysTick counter, so the resolution
+ *          is one CPU clock rather than one tick. Task context only.
+ */
+/*************************************************************************************************/
+uint64_t Time_GetUs64(void);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Start the capture timer and measure its rate.
+ *
+ *  Call before the scheduler starts, once the 32 kHz wake-up timer is running and the crystal
+ *  trim has completed (bleStartup() does this after trim32k()). If the measurement fails the
+ *  nominal rate is used.
+ *
+ *  \return true if the capture timer is running.
+ */
+/*************************************************************************************************/
+bool Time_InitCapture(void);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Take a raw high-resolution time stamp.
+ *
+ *  \return Capture timer count.
  *
- *  \note   Uses FreeRTOS tick count - safe to call from any task.
+ *  \note   Safe from any context, including ISRs. Convert it with Time_CaptureToUs64()
+ *          before the timer wraps (~22 minutes on the target).
+ */
+/*************************************************************************************************/
+uint32_t Time_Capture(void);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Convert a stamp from Time_Capture() to the Time_GetUs64() timebase.
+ *
+ *  \param  stamp   Value returned by Time_Capture().
+ *
+ *  \return Microseconds since system start at the moment the stamp was taken.
+ *
+ *  \note   Task context only.
+ */
+/*************************************************************************************************/
+uint64_t Time_CaptureToUs64(uint32_t stamp);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Get current time in milliseconds, truncated to 32 bits.
+ *
+ *  \return Low 32 bits of Time_GetMs64().
+ *
+ *  \note   Wraps every ~49 days - only for intervals measured with Time_ElapsedMs().
  */
 /*************************************************************************************************/
 uint32_t Time_GetMs(void);
@@ -38,9 +118,9 @@ uint32_t Time_GetMs(void);
 /*!
  *  \brief  Calculate elapsed time since a start time.
  *
- *  \param  start_ms    Start time in milliseconds.
+ *  \param  start_ms    Start time from Time_GetMs().
  *
- *  \return Elapsed milliseconds since start_ms.
+ *  \return Elapsed milliseconds since start_ms (correct across one wrap).
  */
 /*************************************************************************************************/
 uint32_t Time_ElapsedMs(uint32_t start_ms);
@@ -49,15 +129,49 @@ uint32_t Time_ElapsedMs(uint32_t start_ms);
 /*!
  *  \brief  Format milliseconds to MM:SS.mmm string.
  *
+ *  Table-driven, without libc formatting or division instructions. Minutes take more
+ *  than two digits from 100 minutes on.
+ *
  *  \param  ms          Time in milliseconds.
- *  \param  buffer      Output buffer (minimum 12 chars).
+ *  \param  buffer      Output buffer (10 chars below 100 minutes, TIME_MMSS_STR_LEN for any).
  *  \param  buf_len     Buffer length.
  *
- *  \return Pointer to buffer.
+ *  \return Pointer to buffer (empty string if the result does not fit).
  */
 /*************************************************************************************************/
 char* Time_FormatMmSsMsss(uint32_t ms, char *buffer, uint8_t buf_len);
 
+/*************************************************************************************************/
+/*!
+ *  \brief  Format milliseconds to HH:MM:SS.mmm string, for sessions of an hour or more.
+ *
+ *  Same method as Time_FormatMmSsMsss(). Hours take more than two digits from 100 hours on.
+ *
+ *  \param  ms          Time in milliseconds.
+ *  \param  buffer      Output buffer (13 chars below 100 hours, TIME_HMS_STR_LEN for any).
+ *  \param  buf_len     Buffer length.
+ *
+ *  \return Pointer to buffer (empty string if the result does not fit).
+ */
+/*************************************************************************************************/
+char* Time_FormatHhMmSsMsss(uint32_t ms, char *buffer, uint8_t buf_len);
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Format a 64-bit millisecond timestamp as decimal digits.
+ *
+ *  The target's newlib-nano printf has no %llu, so 64-bit values are formatted here and
+ *  printed with %s.
+ *
+ *  \param  ms          Time in milliseconds.
+ *  \param  buffer      Output buffer (TIME_MS64_STR_LEN chars holds any value).
+ *  \param  buf_len     Buffer length.
+ *
+ *  \return Pointer to buffer (empty string if the digits do not fit).
+ */
+/*************************************************************************************************/
+char* Time_FormatMs64(uint64_t ms, char *buffer, uint8_t buf_len);
+
 #ifdef __cplusplus
 }
 #endif
@@ -9,11 +9,15 @@
 #include "workout_control.h"
 #include "workout_state.h"
 #include "buttons.h"
-#include "time_utils.h"
+#include "sensor_task.h"
 #include "ble_tx.h"
+#include "time_utils.h"
+#include "log.h"
 #include "FreeRTOS.h"
 #include "task.h"
 #include "queue.h"
+#include "semphr.h"
+#include "timers.h"
 #include <stdio.h>
 #include <string.h>
 
@@ -24,6 +28,13 @@
 #define CONTROL_TASK_STACK_SIZE 256
 #define CONTROL_TASK_PRIORITY (tskIDLE_PRIORITY + 1)
 
+/* Recovery heart rate is measured for this long after each lap */
+#define CONTROL_HR_WINDOW_MS 15000
+
+/* Every item that can be pending across the set's members: button queue, HR window end,
+ * sensor frame ready */
+#define CONTROL_QUEUE_SET_LENGTH (BUTTON_QUEUE_LENGTH + 2)
+
 /**************************************************************************************************
   Static Memory for FreeRTOS Objects
 **************************************************************************************************/
@@ -32,29 +43,57 @@
 static StaticTask_t s_controlTaskBuffer;
 static StackType_t s_controlTaskStack[CONTROL_TASK_STACK_SIZE];
 
+/* HR window timer and the semaphore its callback gives */
+static StaticTimer_t s_hrTimerBuffer;
+static StaticSemaphore_t s_hrTimeoutSemBuffer;
+
+/* Given by the sensor task after each frame */
+static StaticSemaphore_t s_frameSemBuffer;
+
 /**************************************************************************************************
   Local Variables
 **************************************************************************************************/
 
 static TaskHandle_t s_controlTaskHandle = NULL;
 
+/* Every input of the task; it sleeps on the set until one of them has work */
+static QueueSetHandle_t s_ctrlQueueSet = NULL;
+
+/*
+ * One-shot HR window timer. Its callback runs in the timer service task and only gives
+ * s_hrTimeoutSem, which is a member of the queue set, so the window is closed in this
+ * task's context.
+ */
+static TimerHandle_t s_hrTimer = NULL;
+static SemaphoreHandle_t s_hrTimeoutSem = NULL;
+static bool s_hrWindowOpen = false;
+
+/* Sensor frames are drained here when s_frameSem is given (too large for the task stack) */
+static SemaphoreHandle_t s_frameSem = NULL;
+static SensorFrame_t s_frame;
+
+/* Lap the open window follows, and the newest valid reading in it (bpm 0 until one arrives) */
+static uint8_t s_hrLap;
+static uint8_t s_hrBpm;
+static uint8_t s_hrSpo2;
+
 /**************************************************************************************************
   Local Functions
 **************************************************************************************************/
 
 /*************************************************************************************************/
 /*!
- *  \brief  Send a workout event to the BLE TX task.
+ *  \brief  Send a workout event to the BLE TX task, stamped with the button press time.
  */
 /*************************************************************************************************/
-static void sendWorkoutEvent(EventType_t type, const LapRecord_t *lapData)
+static void sendWorkoutEvent(EventType_t type, const LapRecord_t *lapData, uint64_t pressUs)
 {
     WorkoutEvent_t event;
     const WorkoutSession_t *session = Workout_GetSession();
 
     memset(&event, 0, sizeof(event));
     event.type = type;
-    event.timestamp_ms = Time_GetMs();
+    event.timestamp_ms = pressUs / 1000u;
     event.current_lap = session->current_lap;
 
     if (lapData != NULL)
@@ -65,17 +104,302 @@ static void sendWorkoutEvent(EventType_t type, const LapRecord_t *lapData)
     BleTx_SendEvent(&event);
 }
 
+/*************************************************************************************************/
+static void hrTimerCallback(TimerHandle_t timer)
+{
+    (void)timer;
+    xSemaphoreGive(s_hrTimeoutSem);
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Take every frame waiting in the sensor stream, keeping the newest valid reading
+ *          while a window is open.
+ */
+/*************************************************************************************************/
+static void handleSensorFrames(void)
+{
+    while (SensorTask_ReceiveFrame(&s_frame, 0))
+    {
+        if (s_hrWindowOpen && s_frame.estimate.valid)
+        {
+            s_hrBpm = (s_frame.estimate.bpm > UINT8_MAX) ? UINT8_MAX
+                                                          : (uint8_t)s_frame.estimate.bpm;
+            s_hrSpo2 = s_frame.estimate.spo2;
+        }
+    }
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  End the open window and report its reading, if it got one.
+ */
+/*************************************************************************************************/
+static void hrWindowClose(void)
+{
+    WorkoutEvent_t event;
+
+    if (!s_hrWindowOpen)
+    {
+        return;
+    }
+
+    xTimerStop(s_hrTimer, 0);
+    SensorTask_StopHrMeasurement();
+    handleSensorFrames();
+    s_hrWindowOpen = false;
+
+    if (s_hrBpm == 0)
+    {
+        LOG_INFO(LOG_MOD_WORKOUT, "[CTRL] No HR reading after lap %d\n", s_hrLap);
+        return;
+    }
+
+    memset(&event, 0, sizeof(event));
+    event.type = EVENT_HR_RESULT;
+    event.timestamp_ms = Time_GetMs64();
+    event.current_lap = Workout_GetSession()->current_lap;
+    event.lap_data.lap_number = s_hrLap;
+    event.hr_bpm = s_hrBpm;
+    event.spo2 = s_hrSpo2;
+
+    LOG_INFO(LOG_MOD_WORKOUT, "[CTRL] Lap %d recovery HR %d bpm\n", s_hrLap, s_hrBpm);
+    BleTx_SendEvent(&event);
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Measure heart rate for the next CONTROL_HR_WINDOW_MS after a lap. A window still
+ *          open from the previous lap is closed and reported first.
+ */
+/*************************************************************************************************/
+static void hrWindowOpen(uint8_t lapNumber)
+{
+    hrWindowClose();
+
+    s_hrLap = lapNumber;
+    s_hrBpm = 0;
+    s_hrSpo2 = 0;
+
+    SensorTask_StartHrMeasurement();
+    xTimerReset(s_hrTimer, 0);
+    s_hrWindowOpen = true;
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  The HR window timer expired.
+ *
+ *  A timeout that raced a lap finds the timer running again and leaves the new window open.
+ */
+/*************************************************************************************************/
+static void handleHrTimeout(void)
+{
+    if (s_hrWindowOpen && xTimerIsTimerActive(s_hrTimer) == pdFALSE)
+    {
+        hrWindowClose();
+    }
+}
+
+/*************************************************************************************************/
+/*!
+ *  \brief  Drive the workout state machine with one button event.
+ */
+/*************************************************************************************************/
+static void handleButtonEvent(const ButtonEvent_t *pBtn)
+{
+    LapRecord_t lapData;
+    WorkoutState_t currentState = Workout_GetState();
+
+    switch (pBtn->type)
+    {
+    case BTN_START:
+        /*
+         * Start/Resume logic:
+         * - IDLE -> RUNNING (start new workout)
+         * - PAUSED -> RUNNING (resume)
+         * - RUNNING -> no effect
+         * - COMPLETED -> suggest reset
+         */
+        if (currentState == STATE_COMPLETED)
+        {
+            /* Auto-reset and start new workout */
+            Workout_Reset();
+        }
+        if (Workout_Start(pBtn->timestamp_us))
+        {
+            /* Send workout start event */
+            sendWorkoutEvent(EVENT_WORKOUT_START, NULL, pBtn->timestamp_us);
+        }
+        break;
+
+    case BTN_LAP:
+        /*
+         * Lap logic:
+         * - RUNNING -> record lap, advance or complete
+         * - Other states -> ignored
+         */
+        if (currentState == STATE_RUNNING)
+        {
+            if (Workout_RecordLap(pBtn->timestamp_us, &lapData))
+            {
+                /* Recovery heart rate after every lap, the last one included */
+                hrWindowOpen(lapData.lap_number);
+
+                /* Check if workout is now complete */
+                if (Workout_GetState() == STATE_COMPLETED)
+                {
+                    sendWorkoutEvent(EVENT_WORKOUT_DONE, &lapData, pBtn->timestamp_us);
+                }
+                else
+                {
+                    sendWorkoutEvent(EVENT_LAP_COMPLETE, &lapData, pBtn->timestamp_us);
+                }
+            }
+        }
+        else
+        {
+            printf("[CTRL] LAP ignored - not running\n");
+        }
+        break;
+
+    case BTN_STOP:
+        /*
+         * Stop/Pause logic:
+         * - RUNNING -> PAUSED
+         * - PAUSED -> COMPLETED (stop entirely)
+         * - Other states -> ignored
+         */
+        if (currentState == STATE_RUNNING)
+        {
+            Workout_Pause(pBtn->timestamp_us);
+            /* Don't send event for pause - only for stop */
+        }
+        else if (currentState == STATE_PAUSED)
+        {
+            if (Workout_Stop())
+            {
+                hrWindowClose();
+                sendWorkoutEvent(EVENT_WORKOUT_STOP, NULL, pBtn->timestamp_us);
+            }
+        }
+        else
+        {
+            printf("[CTRL] STOP ignored - not running or paused\n");
+        }
+        break;
+
+    case BTN_MODE_NEXT:
+        /*
+         * Mode cycle logic:
+         * - IDLE -> cycle to next mode
+         * - Other states -> ignored (can't change during workout)
+         */
+        if (currentState == STATE_IDLE || currentState == STATE_COMPLETED)
+        {
+            if (currentState == STATE_COMPLETED)
+            {
+                Workout_Reset();
+            }
+            Workout_CycleMode();
+        }
+        else
+        {
+            printf("[CTRL] MODE ignored - workout in progress\n");
+        }
+        break;
+
+    case BTN_MODE_SET:
+        /* Mode chosen by the central: only while idle, like BTN_MODE_NEXT */
+        if (currentState == STATE_IDLE)
+        {
+            Workout_SetMode((WorkoutMode_t)pBtn->arg);
+        }
+        else
+        {
+            printf("[CTRL] MODE ignored - workout in progress\n");
+        }
+        break;
+
+    case BTN_HR_DONE:
+        /* The central has the reading it needs; report what the window has so far */
+        if (s_hrWindowOpen)
+        {
+            hrWindowClose();
+        }
+        else
+        {
+            LOG_DEBUG(LOG_MOD_WORKOUT, "[CTRL] hr_done ignored - no HR window open\n");
+        }
+        break;
+
+    case BTN_STATUS:
+        /* Print current status and send status event */
+        Workout_PrintStatus();
+        sendWorkoutEvent(EVENT_STATUS_UPDATE, NULL, pBtn->timestamp_us);
+        break;
+
+    case BTN_RESET:
+        /*
+         * Reset logic:
+         * - PAUSED -> stop, then IDLE
+         * - COMPLETED -> IDLE
+         * - Other states -> ignored
+         */
+        if (currentState == STATE_PAUSED && Workout_Stop())
+        {
+            sendWorkoutEvent(EVENT_WORKOUT_STOP, NULL, pBtn->timestamp_us);
+            currentState = STATE_COMPLETED;
+        }
+        if (currentState == STATE_COMPLETED)
+        {
+            hrWindowClose();
+            Workout_Reset();
+        }
+        else
+        {
+            printf("[CTRL] RESET ignored - not paused or completed\n");
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
 /**************************************************************************************************
   Public Functions
 **************************************************************************************************/
 
 /*************************************************************************************************/
-void WorkoutControl_Init(void)
+bool WorkoutControl_Init(void)
 {
     /* Initialize workout state */
     Workout_Init();
 
+    /* Button queue is created by Button_Init(), which must run first. Queue sets are only
+     * available with dynamic allocation; created once, never freed. */
+    s_ctrlQueueSet = xQueueCreateSet(CONTROL_QUEUE_SET_LENGTH);
+    s_hrTimeoutSem = xSemaphoreCreateBinaryStatic(&s_hrTimeoutSemBuffer);
+    s_frameSem = xSemaphoreCreateBinaryStatic(&s_frameSemBuffer);
+    s_hrTimer = xTimerCreateStatic("HrWindow", pdMS_TO_TICKS(CONTROL_HR_WINDOW_MS), pdFALSE,
+                                   NULL, hrTimerCallback, &s_hrTimerBuffer);
+
+    if (g_buttonQueue == NULL || s_ctrlQueueSet == NULL || s_hrTimeoutSem == NULL ||
+        s_frameSem == NULL || s_hrTimer == NULL ||
+        xQueueAddToSet(g_buttonQueue, s_ctrlQueueSet) != pdPASS ||
+        xQueueAddToSet(s_hrTimeoutSem, s_ctrlQueueSet) != pdPASS ||
+        xQueueAddToSet(s_frameSem, s_ctrlQueueSet) != pdPASS)
+    {
+        printf("[CTRL] ERROR: Failed to create control queue set\n");
+        return false;
+    }
+
+    /* Runs before the sensor task starts (Tasks_Init), so no frame goes unsignalled */
+    SensorTask_SetFrameSignal(s_frameSem);
+
     printf("[CTRL] Workout control initialized\n");
+    return true;
 }
 
 /*************************************************************************************************/
@@ -101,13 +425,62 @@ bool WorkoutControl_StartTask(void)
     return true;
 }
 
+/*************************************************************************************************/
+bool WorkoutControl_SendCommand(const Cmd_t *pCmd)
+{
+    ButtonEvent_t btn;
+
+    btn.timestamp_us = Time_GetUs64();
+    btn.arg = 0;
+
+    switch (pCmd->id)
+    {
+    case CMD_START:
+        btn.type = BTN_START;
+        break;
+
+    case CMD_LAP:
+        btn.type = BTN_LAP;
+        break;
+
+    case CMD_STOP:
+        btn.type = BTN_STOP;
+        break;
+
+    case CMD_MODE:
+        if (pCmd->arg > MODE_1x4000M)
+        {
+            LOG_WARN(LOG_MOD_WORKOUT, "[CTRL] BLE mode %d out of range\n", (int)pCmd->arg);
+            return false;
+        }
+        btn.type = BTN_MODE_SET;
+        btn.arg = (uint8_t)pCmd->arg;
+        break;
+
+    case CMD_HR_DONE:
+        btn.type = BTN_HR_DONE;
+        break;
+
+    default:
+        return false;
+    }
+
+    if (g_buttonQueue == NULL || xQueueSend(g_buttonQueue, &btn, 0) != pdTRUE)
+    {
+        LOG_WARN(LOG_MOD_WORKOUT, "[CTRL] Queue full, BLE command %s dropped\n",
+                 CmdParser_Name(pCmd->id));
+        return false;
+    }
+
+    return true;
+}
+
 /*************************************************************************************************/
 void ControlTask(void *pvParameters)
 {
     (void)pvParameters;
     ButtonEvent_t btn;
-    LapRecord_t lapData;
-    WorkoutState_t currentState;
+    QueueSetMemberHandle_t member;
 
     printf("[CTRL] Control task running...\n");
 
@@ -116,114 +489,20 @@ void ControlTask(void *pvParameters)
 
     while (1)
     {
-        /* Wait for button event (blocks until event received) */
-        if (xQueueReceive(g_buttonQueue, &btn, portMAX_DELAY) == pdTRUE)
-        {
-            currentState = Workout_GetState();
+        /* Sleep until an input has work; each set entry stands for exactly one item */
+        member = xQueueSelectFromSet(s_ctrlQueueSet, portMAX_DELAY);
 
-            switch (btn.type)
-            {
-            case BTN_START:
-                /*
-                 * Start/Resume logic:
-                 * - IDLE -> RUNNING (start new workout)
-                 * - PAUSED -> RUNNING (resume)
-                 * - RUNNING -> no effect
-                 * - COMPLETED -> suggest reset
-                 */
-                if (currentState == STATE_COMPLETED)
-                {
-                    /* Auto-reset and start new workout */
-                    Workout_Reset();
-                }
-                if (Workout_Start())
-                {
-                    /* Send workout start event */
-                    sendWorkoutEvent(EVENT_WORKOUT_START, NULL);
-                }
-                break;
-
-            case BTN_LAP:
-                /*
-                 * Lap logic:
-                 * - RUNNING -> record lap, advance or complete
-                 * - Other states -> ignored
-                 */
-                if (currentState == STATE_RUNNING)
-                {
-                    if (Workout_RecordLap(&lapData))
-                    {
-                        /* Check if workout is now complete */
-                        if (Workout_GetState() == STATE_COMPLETED)
-                        {
-                            sendWorkoutEvent(EVENT_WORKOUT_DONE, &lapData);
-                        }
-                        else
-                        {
-                            sendWorkoutEvent(EVENT_LAP_COMPLETE, &lapData);
-                        }
-                    }
-                }
-                else
-                {
-                    printf("[CTRL] LAP ignored - not running\n");
-                }
-                break;
-
-            case BTN_STOP:
-                /*
-                 * Stop/Pause logic:
-                 * - RUNNING -> PAUSED
-                 * - PAUSED -> COMPLETED (stop entirely)
-                 * - Other states -> ignored
-                 */
-                if (currentState == STATE_RUNNING)
-                {
-                    Workout_Pause();
-                    /* Don't send event for pause - only for stop */
-                }
-                else if (currentState == STATE_PAUSED)
-                {
-                    if (Workout_Stop())
-                    {
-                        sendWorkoutEvent(EVENT_WORKOUT_STOP, NULL);
-                    }
-                }
-                else
-                {
-                    printf("[CTRL] STOP ignored - not running or paused\n");
-                }
-                break;
-
-            case BTN_MODE_NEXT:
-                /*
-                 * Mode cycle logic:
-                 * - IDLE -> cycle to next mode
-                 * - Other states -> ignored (can't change during workout)
-                 */
-                if (currentState == STATE_IDLE || currentState == STATE_COMPLETED)
-                {
-                    if (currentState == STATE_COMPLETED)
-                    {
-                        Workout_Reset();
-                    }
-                    Workout_CycleMode();
-                }
-                else
-                {
-                    printf("[CTRL] MODE ignored - workout in progress\n");
-                }
-                break;
-
-            case BTN_STATUS:
-                /* Print current status and send status event */
-                Workout_PrintStatus();
-                sendWorkoutEvent(EVENT_STATUS_UPDATE, NULL);
-                break;
-
-            default:
-                break;
-            }
+        if (member == g_buttonQueue && xQueueReceive(g_buttonQueue, &btn, 0) == pdTRUE)
+        {
+            handleButtonEvent(&btn);
+        }
+        else if (member == s_hrTimeoutSem && xSemaphoreTake(s_hrTimeoutSem, 0) == pdTRUE)
+        {
+            handleHrTimeout();
+        }
+        else if (member == s_frameSem && xSemaphoreTake(s_frameSem, 0) == pdTRUE)
+        {
+            handleSensorFrames();
         }
     }
 }
@@ -4,8 +4,9 @@
  *
  *  \brief  Workout control task interface.
  *
- *  The ControlTask receives button events from the queue and drives
- *  the workout state machine accordingly.
+ *  The ControlTask sleeps on a queue set of its inputs (button events, including
+ *  the workout commands a central sends) and drives the workout state machine
+ *  accordingly. It only wakes when one of them has work.
  */
 /*************************************************************************************************/
 
@@ -15,6 +16,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "workout_types.h"
+#include "cmd_parser.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -28,10 +30,13 @@ extern "C" {
 /*!
  *  \brief  Initialize the workout control module.
  *
- *  Initializes the workout state and prepares for control events.
+ *  Initializes the workout state and the queue set the Control Task waits on.
+ *  Button_Init() must have run first.
+ *
+ *  \return true if the control inputs were created.
  */
 /*************************************************************************************************/
-void WorkoutControl_Init(void);
+bool WorkoutControl_Init(void);
 
 /*************************************************************************************************/
 /*!
@@ -43,12 +48,32 @@ void WorkoutControl_Init(void);
  *  - BTN_STOP: Pause or stop workout
  *  - BTN_MODE_NEXT: Cycle workout mode (if idle)
  *  - BTN_STATUS: Print current status
+ *  - BTN_MODE_SET: Select a workout mode (if idle)
+ *  - BTN_HR_DONE: End the recovery HR window and report its reading
  *
  *  \return true if task created successfully.
  */
 /*************************************************************************************************/
 bool WorkoutControl_StartTask(void);
 
+/*************************************************************************************************/
+/*!
+ *  \brief  Hand a workout command received over BLE to the Control Task.
+ *
+ *  start, lap and stop are queued as the matching button events, mode as BTN_MODE_SET and
+ *  hr_done as BTN_HR_DONE, stamped with the time of receipt, so a command can never do what
+ *  a press could not. hr_done ends the recovery HR window opened by the last lap early and
+ *  sends its reading now; with no window open it does nothing. Does not block; safe to
+ *  call from the BLE stack's callbacks.
+ *
+ *  \param  pCmd    CMD_START, CMD_LAP, CMD_STOP, CMD_MODE or CMD_HR_DONE.
+ *
+ *  \return true if queued, false if the command is not a workout command or the queue is full
+ *          (logged).
+ */
+/*************************************************************************************************/
+bool WorkoutControl_SendCommand(const Cmd_t *pCmd);
+
 /*************************************************************************************************/
 /*!
  *  \brief  The Control Task function.
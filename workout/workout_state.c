@@ -8,9 +8,19 @@
 
 #include "workout_state.h"
 #include "time_utils.h"
+#include "log.h"
 #include <stdio.h>
 #include <string.h>
 
+/**************************************************************************************************
+  Macros
+**************************************************************************************************/
+
+/* Times are kept in microseconds; durations are reported in ms, rounded to nearest */
+#define US_TO_MS(us) ((uint32_t)(((us) + 500u) / 1000u))
+
+#define STATUS_HOURS_FROM_MS 3600000u /* Status times switch to HH:MM:SS.mmm from one hour */
+
 /**************************************************************************************************
   Local Variables
 **************************************************************************************************/
@@ -19,8 +29,8 @@
 static WorkoutSession_t s_session;
 
 /*! Paused time tracking (for accurate elapsed time when paused) */
-static uint32_t s_pauseStartMs = 0;
-static uint32_t s_totalPausedMs = 0;
+static uint64_t s_pauseStartUs = 0;
+static uint64_t s_totalPausedUs = 0;
 
 /**************************************************************************************************
   Local Function Prototypes
@@ -41,8 +51,8 @@ void Workout_Init(void)
     /* Set default mode */
     setModeConfig(MODE_4x500M);
 
-    s_pauseStartMs = 0;
-    s_totalPausedMs = 0;
+    s_pauseStartUs = 0;
+    s_totalPausedUs = 0;
 
     printf("[WORKOUT] Initialized - Mode: %s\n", Workout_ModeToString(s_session.config.mode));
 }
@@ -91,25 +101,23 @@ bool Workout_CycleMode(void)
 }
 
 /*************************************************************************************************/
-bool Workout_Start(void)
+bool Workout_Start(uint64_t now_us)
 {
-    uint32_t now = Time_GetMs();
-
     switch (s_session.state)
     {
     case STATE_IDLE:
         /* Start new workout */
         s_session.state = STATE_RUNNING;
         s_session.current_lap = 1;
-        s_session.workout_start_ms = now;
-        s_session.lap_start_ms = now;
-        s_totalPausedMs = 0;
-
-        printf("[WORKOUT] ===== WORKOUT STARTED =====\n");
-        printf("[WORKOUT] Mode: %s (%d laps)\n",
-               Workout_ModeToString(s_session.config.mode),
-               s_session.config.total_laps);
-        printf("[WORKOUT] Lap 1 started...\n");
+        s_session.workout_start_us = now_us;
+        s_session.lap_start_us = now_us;
+        s_totalPausedUs = 0;
+
+        LOG_INFO(LOG_MOD_WORKOUT, "[WORKOUT] ===== WORKOUT STARTED =====\n");
+        LOG_INFO(LOG_MOD_WORKOUT, "[WORKOUT] Mode: %s (%d laps)\n",
+                 Workout_ModeToString(s_session.config.mode),
+                 s_session.config.total_laps);
+        LOG_INFO(LOG_MOD_WORKOUT, "[WORKOUT] Lap 1 started...\n");
         return true;
 
     case STATE_PAUSED:
@@ -117,18 +125,18 @@ bool Workout_Start(void)
         s_session.state = STATE_RUNNING;
 
         /* Account for paused time */
-        s_totalPausedMs += (now - s_pauseStartMs);
+        s_totalPausedUs += (now_us - s_pauseStartUs);
 
-        printf("[WORKOUT] ===== WORKOUT RESUMED =====\n");
-        printf("[WORKOUT] Continuing lap %d...\n", s_session.current_lap);
+        LOG_INFO(LOG_MOD_WORKOUT, "[WORKOUT] ===== WORKOUT RESUMED =====\n");
+        LOG_INFO(LOG_MOD_WORKOUT, "[WORKOUT] Continuing lap %d...\n", s_session.current_lap);
         return true;
 
     case STATE_RUNNING:
-        printf("[WORKOUT] Already running\n");
+        LOG_WARN(LOG_MOD_WORKOUT, "[WORKOUT] Already running\n");
         return false;
 
     case STATE_COMPLETED:
-        printf("[WORKOUT] Workout completed - reset to start new\n");
+        LOG_WARN(LOG_MOD_WORKOUT, "[WORKOUT] Workout completed - reset to start new\n");
         return false;
 
     default:
@@ -137,31 +145,28 @@ bool Workout_Start(void)
 }
 
 /*************************************************************************************************/
-bool Workout_RecordLap(LapRecord_t *lap_out)
+bool Workout_RecordLap(uint64_t now_us, LapRecord_t *lap_out)
 {
     if (s_session.state != STATE_RUNNING)
     {
-        printf("[WORKOUT] Cannot record lap - not running\n");
+        LOG_WARN(LOG_MOD_WORKOUT, "[WORKOUT] Cannot record lap - not running\n");
         return false;
     }
 
-    uint32_t now = Time_GetMs();
     uint8_t lapIndex = s_session.current_lap - 1;
 
     /* Record lap data */
     LapRecord_t *lap = &s_session.laps[lapIndex];
     lap->lap_number = s_session.current_lap;
-    lap->lap_time_ms = now - s_session.lap_start_ms;
-    lap->split_time_ms = now - s_session.workout_start_ms - s_totalPausedMs;
+    lap->lap_time_ms = US_TO_MS(now_us - s_session.lap_start_us);
+    lap->split_time_ms = US_TO_MS(now_us - s_session.workout_start_us - s_totalPausedUs);
 
-    /* Format times for display */
-    char lapTimeStr[16], splitTimeStr[16];
-    Time_FormatMmSsMsss(lap->lap_time_ms, lapTimeStr, sizeof(lapTimeStr));
-    Time_FormatMmSsMsss(lap->split_time_ms, splitTimeStr, sizeof(splitTimeStr));
-
-    printf("[WORKOUT] *** LAP %d COMPLETE ***\n", lap->lap_number);
-    printf("[WORKOUT]     Lap Time:   %s\n", lapTimeStr);
-    printf("[WORKOUT]     Split Time: %s\n", splitTimeStr);
+    /* Times are formatted by the log task, not here */
+    LOG_INFO(LOG_MOD_WORKOUT, "[WORKOUT] *** LAP %d COMPLETE ***\n", lap->lap_number);
+    LOG_INFO(LOG_MOD_WORKOUT, "[WORKOUT]     Lap Time:   %02u:%02u.%03u\n",
+             LOG_MMSS(lap->lap_time_ms));
+    LOG_INFO(LOG_MOD_WORKOUT, "[WORKOUT]     Split Time: %02u:%02u.%03u\n",
+             LOG_MMSS(lap->split_time_ms));
 
     /* Return lap data if requested */
     if (lap_out != NULL)
@@ -173,46 +178,47 @@ bool Workout_RecordLap(LapRecord_t *lap_out)
     if (s_session.current_lap >= s_session.config.total_laps)
     {
         s_session.state = STATE_COMPLETED;
-        printf("[WORKOUT] ===== WORKOUT COMPLETE =====\n");
-        printf("[WORKOUT] Total time: %s\n", splitTimeStr);
+        LOG_INFO(LOG_MOD_WORKOUT, "[WORKOUT] ===== WORKOUT COMPLETE =====\n");
+        LOG_INFO(LOG_MOD_WORKOUT, "[WORKOUT] Total time: %02u:%02u.%03u\n",
+                 LOG_MMSS(lap->split_time_ms));
 
         /* Print all laps summary */
-        printf("[WORKOUT] --- LAP SUMMARY ---\n");
+        LOG_INFO(LOG_MOD_WORKOUT, "[WORKOUT] --- LAP SUMMARY ---\n");
         for (uint8_t i = 0; i < s_session.config.total_laps; i++)
         {
-            Time_FormatMmSsMsss(s_session.laps[i].lap_time_ms, lapTimeStr, sizeof(lapTimeStr));
-            printf("[WORKOUT]   Lap %d: %s\n", i + 1, lapTimeStr);
+            LOG_INFO(LOG_MOD_WORKOUT, "[WORKOUT]   Lap %d: %02u:%02u.%03u\n", i + 1,
+                     LOG_MMSS(s_session.laps[i].lap_time_ms));
         }
     }
     else
     {
         /* Start next lap */
         s_session.current_lap++;
-        s_session.lap_start_ms = now;
-        printf("[WORKOUT] Lap %d started...\n", s_session.current_lap);
+        s_session.lap_start_us = now_us;
+        LOG_INFO(LOG_MOD_WORKOUT, "[WORKOUT] Lap %d started...\n", s_session.current_lap);
     }
 
     return true;
 }
 
 /*************************************************************************************************/
-bool Workout_Pause(void)
+bool Workout_Pause(uint64_t now_us)
 {
     if (s_session.state != STATE_RUNNING)
     {
-        printf("[WORKOUT] Cannot pause - not running\n");
+        LOG_WARN(LOG_MOD_WORKOUT, "[WORKOUT] Cannot pause - not running\n");
         return false;
     }
 
     s_session.state = STATE_PAUSED;
-    s_pauseStartMs = Time_GetMs();
+    s_pauseStartUs = now_us;
 
-    char elapsedStr[16];
-    Time_FormatMmSsMsss(Workout_GetElapsedMs(), elapsedStr, sizeof(elapsedStr));
+    uint32_t elapsedMs = Workout_GetElapsedMs();
 
-    printf("[WORKOUT] ===== WORKOUT PAUSED =====\n");
-    printf("[WORKOUT] Elapsed: %s, Lap %d\n", elapsedStr, s_session.current_lap);
-    printf("[WORKOUT] Press START to resume, STOP to end\n");
+    LOG_INFO(LOG_MOD_WORKOUT, "[WORKOUT] ===== WORKOUT PAUSED =====\n");
+    LOG_INFO(LOG_MOD_WORKOUT, "[WORKOUT] Elapsed: %02u:%02u.%03u, Lap %d\n",
+             LOG_MMSS(elapsedMs), s_session.current_lap);
+    LOG_INFO(LOG_MOD_WORKOUT, "[WORKOUT] Press START to resume, STOP to end\n");
 
     return true;
 }
@@ -222,19 +228,18 @@ bool Workout_Stop(void)
 {
     if (s_session.state == STATE_IDLE || s_session.state == STATE_COMPLETED)
     {
-        printf("[WORKOUT] No active workout to stop\n");
+        LOG_WARN(LOG_MOD_WORKOUT, "[WORKOUT] No active workout to stop\n");
         return false;
     }
 
-    char elapsedStr[16];
-    Time_FormatMmSsMsss(Workout_GetElapsedMs(), elapsedStr, sizeof(elapsedStr));
+    uint32_t elapsedMs = Workout_GetElapsedMs();
 
     s_session.state = STATE_COMPLETED;
 
-    printf("[WORKOUT] ===== WORKOUT STOPPED =====\n");
-    printf("[WORKOUT] Completed %d of %d laps\n",
-           s_session.current_lap - 1, s_session.config.total_laps);
-    printf("[WORKOUT] Total time: %s\n", elapsedStr);
+    LOG_INFO(LOG_MOD_WORKOUT, "[WORKOUT] ===== WORKOUT STOPPED =====\n");
+    LOG_INFO(LOG_MOD_WORKOUT, "[WORKOUT] Completed %d of %d laps\n",
+             s_session.current_lap - 1, s_session.config.total_laps);
+    LOG_INFO(LOG_MOD_WORKOUT, "[WORKOUT] Total time: %02u:%02u.%03u\n", LOG_MMSS(elapsedMs));
 
     return true;
 }
@@ -242,7 +247,7 @@ bool Workout_Stop(void)
 /*************************************************************************************************/
 void Workout_Reset(void)
 {
-    printf("[WORKOUT] Resetting workout...\n");
+    LOG_INFO(LOG_MOD_WORKOUT, "[WORKOUT] Resetting workout...\n");
 
     WorkoutMode_t currentMode = s_session.config.mode;
 
@@ -250,10 +255,10 @@ void Workout_Reset(void)
     s_session.state = STATE_IDLE;
     setModeConfig(currentMode);
 
-    s_pauseStartMs = 0;
-    s_totalPausedMs = 0;
+    s_pauseStartUs = 0;
+    s_totalPausedUs = 0;
 
-    printf("[WORKOUT] Ready - Mode: %s\n", Workout_ModeToString(currentMode));
+    LOG_INFO(LOG_MOD_WORKOUT, "[WORKOUT] Ready - Mode: %s\n", Workout_ModeToString(currentMode));
 }
 
 /*************************************************************************************************/
@@ -264,15 +269,16 @@ uint32_t Workout_GetElapsedMs(void)
         return 0;
     }
 
-    uint32_t elapsed = Time_GetMs() - s_session.workout_start_ms - s_totalPausedMs;
+    uint64_t now = Time_GetUs64();
+    uint64_t elapsed = now - s_session.workout_start_us - s_totalPausedUs;
 
     /* If paused, don't count current pause time */
     if (s_session.state == STATE_PAUSED)
     {
-        elapsed -= (Time_GetMs() - s_pauseStartMs);
+        elapsed -= (now - s_pauseStartUs);
     }
 
-    return elapsed;
+    return US_TO_MS(elapsed);
 }
 
 /*************************************************************************************************/
@@ -283,13 +289,13 @@ uint32_t Workout_GetCurrentLapMs(void)
         return 0;
     }
 
-    return Time_GetMs() - s_session.lap_start_ms;
+    return US_TO_MS(Time_GetUs64() - s_session.lap_start_us);
 }
 
 /*************************************************************************************************/
 void Workout_PrintStatus(void)
 {
-    char timeStr[16];
+    char timeStr[TIME_HMS_STR_LEN];
 
     printf("\n");
     printf("======== WORKOUT STATUS ========\n");
@@ -301,7 +307,16 @@ void Workout_PrintStatus(void)
 
     if (s_session.state != STATE_IDLE)
     {
-        Time_FormatMmSsMsss(Workout_GetElapsedMs(), timeStr, sizeof(timeStr));
+        uint32_t elapsedMs = Workout_GetElapsedMs();
+
+        if (elapsedMs >= STATUS_HOURS_FROM_MS)
+        {
+            Time_FormatHhMmSsMsss(elapsedMs, timeStr, sizeof(timeStr));
+        }
+        else
+        {
+            Time_FormatMmSsMsss(elapsedMs, timeStr, sizeof(timeStr));
+        }
         printf("  Total:  %s\n", timeStr);
 
         if (s_session.state == STATE_RUNNING)
@@ -83,24 +83,27 @@ bool Workout_CycleMode(void);
  *  - From PAUSED: Resumes the workout
  *  - From RUNNING: No effect
  *
+ *  \param  now_us      Time of the start/resume press (Time_GetUs64() timebase).
+ *
  *  \return true if state changed, false otherwise.
  */
 /*************************************************************************************************/
-bool Workout_Start(void);
+bool Workout_Start(uint64_t now_us);
 
 /*************************************************************************************************/
 /*!
  *  \brief  Record a lap.
  *
- *  Only valid when RUNNING. Records the current lap time and
+ *  Only valid when RUNNING. Records the lap time up to now_us and
  *  advances to the next lap (or completes workout if last lap).
  *
+ *  \param  now_us      Time of the lap press (Time_GetUs64() timebase).
  *  \param  lap_out     Optional pointer to receive the recorded lap data.
  *
  *  \return true if lap was recorded, false if not in RUNNING state.
  */
 /*************************************************************************************************/
-bool Workout_RecordLap(LapRecord_t *lap_out);
+bool Workout_RecordLap(uint64_t now_us, LapRecord_t *lap_out);
 
 /*************************************************************************************************/
 /*!
@@ -108,10 +111,12 @@ bool Workout_RecordLap(LapRecord_t *lap_out);
  *
  *  Only valid when RUNNING. Workout can be resumed with Workout_Start().
  *
+ *  \param  now_us      Time of the pause press (Time_GetUs64() timebase).
+ *
  *  \return true if paused, false if not in RUNNING state.
  */
 /*************************************************************************************************/
-bool Workout_Pause(void);
+bool Workout_Pause(uint64_t now_us);
 
 /*************************************************************************************************/
 /*!
@@ -63,8 +63,8 @@ extern "C"
         WorkoutConfig_t config;
         WorkoutState_t state;
         uint8_t current_lap;
-        uint32_t workout_start_ms;
-        uint32_t lap_start_ms;
+        uint64_t workout_start_us; /* Time_GetUs64() timebase */
+        uint64_t lap_start_us;
         LapRecord_t laps[MAX_LAPS];
     } WorkoutSession_t;
 
@@ -75,16 +75,20 @@ extern "C"
         EVENT_WORKOUT_STOP,  /* Workout stopped/cancelled */
         EVENT_LAP_COMPLETE,  /* Lap finished */
         EVENT_WORKOUT_DONE,  /* All laps completed */
-        EVENT_STATUS_UPDATE  /* Periodic status update */
+        EVENT_STATUS_UPDATE, /* Periodic status update */
+        EVENT_HR_RESULT      /* Recovery heart rate after a lap */
     } EventType_t;
 
-    /*! Event structure for sending to app via BLE */
+    /*! Event structure for sending to app via BLE. Also the payload of an event log record,
+     *  so fields are ordered to keep it at 24 bytes. */
     typedef struct
     {
-        EventType_t type;      /* Event type */
-        uint32_t timestamp_ms; /* When event occurred */
-        uint8_t current_lap;   /* Current lap number */
+        uint64_t timestamp_ms; /* When event occurred (Time_GetMs64()) */
         LapRecord_t lap_data;  /* Lap data (valid for LAP_COMPLETE) */
+        uint8_t type;          /* Event type (EventType_t) */
+        uint8_t current_lap;   /* Current lap number */
+        uint8_t hr_bpm;        /* Heart rate (valid for HR_RESULT) */
+        uint8_t spo2;          /* SpO2 %, 0 if not known (valid for HR_RESULT) */
     } WorkoutEvent_t;
 #ifdef __cplusplus
 }